@@ -0,0 +1,65 @@
+#ifndef _FNV_HASH_H_
+#define _FNV_HASH_H_
+
+#include <cstddef>
+
+namespace Engine
+{
+	namespace FNV
+	{
+		// --------------------------------------------
+
+		const unsigned int kFNVOffsetBasis = 2166136261u;
+		const unsigned int kFNVPrime       = 16777619u;
+
+		// --------------------------------------------
+
+		// 32 bit FNV-1a - constexpr so that names known at compile time cost nothing at runtime
+		constexpr unsigned int Hash(const char* string)
+		{
+			unsigned int hash = kFNVOffsetBasis;
+
+			while (string && *string)
+			{
+				hash ^= (unsigned int)(unsigned char)(*string);
+				hash *= kFNVPrime;
+
+				string++;
+			}
+
+			return hash;
+		}
+
+		// Hashes the first length characters only, for names that are not null terminated where they need to stop
+		constexpr unsigned int Hash(const char* string, unsigned int length)
+		{
+			unsigned int hash = kFNVOffsetBasis;
+
+			for (unsigned int i = 0; i < length && string[i]; i++)
+			{
+				hash ^= (unsigned int)(unsigned char)(string[i]);
+				hash *= kFNVPrime;
+			}
+
+			return hash;
+		}
+
+		// Carries on from a previous hash rather than starting afresh, so that several buffers can be folded into one key
+		inline unsigned int Continue(unsigned int hash, const void* data, size_t length)
+		{
+			const unsigned char* bytes = (const unsigned char*)data;
+
+			for (size_t i = 0; i < length; i++)
+			{
+				hash ^= (unsigned int)bytes[i];
+				hash *= kFNVPrime;
+			}
+
+			return hash;
+		}
+
+		// --------------------------------------------
+	}
+}
+
+#endif
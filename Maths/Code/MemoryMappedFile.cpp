@@ -0,0 +1,134 @@
+#include "MemoryMappedFile.h"
+
+#ifdef _WIN32
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+
+	#include <Windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <cstdint>
+#endif
+
+namespace Engine
+{
+	// ------------------------------------
+
+	MemoryMappedFile::MemoryMappedFile()
+		: mData(nullptr)
+		, mSizeBytes(0)
+		, mFileHandle(nullptr)
+		, mMappingHandle(nullptr)
+	{
+
+	}
+
+	// ------------------------------------
+
+	MemoryMappedFile::~MemoryMappedFile()
+	{
+		Close();
+	}
+
+	// ------------------------------------
+
+	bool MemoryMappedFile::Open(const std::string& filePath)
+	{
+		Close();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (!mapping)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+		if (!view)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		mFileHandle    = (void*)file;
+		mMappingHandle = (void*)mapping;
+		mSizeBytes     = (size_t)fileSize.QuadPart;
+		mData          = (const unsigned char*)view;
+#else
+		int file = open(filePath.c_str(), O_RDONLY);
+
+		if (file < 0)
+			return false;
+
+		struct stat fileStats;
+		if (fstat(file, &fileStats) != 0 || fileStats.st_size == 0)
+		{
+			close(file);
+			return false;
+		}
+
+		void* view = mmap(nullptr, (size_t)fileStats.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+		if (view == MAP_FAILED)
+		{
+			close(file);
+			return false;
+		}
+
+		mFileHandle    = (void*)(intptr_t)file;
+		mMappingHandle = nullptr;
+		mSizeBytes     = (size_t)fileStats.st_size;
+		mData          = (const unsigned char*)view;
+#endif
+
+		return true;
+	}
+
+	// ------------------------------------
+
+	void MemoryMappedFile::Close()
+	{
+		if (!mData)
+			return;
+
+#ifdef _WIN32
+		UnmapViewOfFile(mData);
+		CloseHandle((HANDLE)mMappingHandle);
+		CloseHandle((HANDLE)mFileHandle);
+#else
+		munmap((void*)mData, mSizeBytes);
+		close((int)(intptr_t)mFileHandle);
+#endif
+
+		mData          = nullptr;
+		mSizeBytes     = 0;
+		mFileHandle    = nullptr;
+		mMappingHandle = nullptr;
+	}
+
+	// ------------------------------------
+}
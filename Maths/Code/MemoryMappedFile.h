@@ -0,0 +1,42 @@
+#ifndef _MEMORY_MAPPED_FILE_H_
+#define _MEMORY_MAPPED_FILE_H_
+
+#include <string>
+
+namespace Engine
+{
+	// --------------------------------------------
+
+	// Read-only view of a whole file mapped into the address space
+	// Lets large binary caches be handed straight to the GPU without copying them into a heap allocation first
+	class MemoryMappedFile final
+	{
+	public:
+		MemoryMappedFile();
+		~MemoryMappedFile();
+
+		// Returns false if the file does not exist, is empty, or could not be mapped
+		bool                 Open(const std::string& filePath);
+		void                 Close();
+
+		bool                 GetIsOpen()   const { return mData != nullptr; }
+
+		const unsigned char* GetData()     const { return mData; }
+		size_t               GetSizeBytes() const { return mSizeBytes; }
+
+	private:
+		MemoryMappedFile(const MemoryMappedFile&)            = delete;
+		MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+		const unsigned char* mData;
+		size_t               mSizeBytes;
+
+		// Platform handles - a HANDLE pair on Windows, a file descriptor elsewhere
+		void*                mFileHandle;
+		void*                mMappingHandle;
+	};
+
+	// --------------------------------------------
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace Engine
+{
+	namespace Parallel
+	{
+		// --------------------------------------------
+
+		// Number of threads worth splitting CPU heavy work across, always at least one
+		inline unsigned int GetWorkerThreadCount()
+		{
+			unsigned int threadCount = std::thread::hardware_concurrency();
+
+			return threadCount == 0 ? 1 : threadCount;
+		}
+
+		// --------------------------------------------
+
+		// Splits the range [begin, end) into contiguous chunks and calls function(chunkStart, chunkEnd) for each on its own thread
+		// The calling thread processes the first chunk itself, and this only returns once every chunk has been completed
+		// minimumChunkSize stops small ranges from paying the cost of spinning up threads they do not need
+		template<typename FunctionType>
+		void ParallelFor(unsigned int begin, unsigned int end, unsigned int minimumChunkSize, FunctionType function)
+		{
+			if (end <= begin)
+				return;
+
+			const unsigned int count = end - begin;
+
+			if (minimumChunkSize == 0)
+				minimumChunkSize = 1;
+
+			unsigned int chunkCount = std::min(GetWorkerThreadCount(), (count + minimumChunkSize - 1) / minimumChunkSize);
+
+			if (chunkCount <= 1)
+			{
+				function(begin, end);
+				return;
+			}
+
+			const unsigned int chunkSize = (count + chunkCount - 1) / chunkCount;
+
+			std::vector<std::thread> workers;
+			workers.reserve(chunkCount - 1);
+
+			for (unsigned int chunk = 1; chunk < chunkCount; chunk++)
+			{
+				unsigned int chunkStart = begin + (chunk * chunkSize);
+				unsigned int chunkEnd   = std::min(end, chunkStart + chunkSize);
+
+				if (chunkStart >= chunkEnd)
+					break;
+
+				workers.emplace_back(function, chunkStart, chunkEnd);
+			}
+
+			function(begin, std::min(end, begin + chunkSize));
+
+			for (unsigned int i = 0; i < workers.size(); i++)
+			{
+				workers[i].join();
+			}
+		}
+
+		// --------------------------------------------
+	}
+}
+
+#endif
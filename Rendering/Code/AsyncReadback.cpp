@@ -0,0 +1,564 @@
+#include "AsyncReadback.h"
+
+#include "Framebuffers.h"
+#include "Textures/Texture.h"
+
+#include "GLStateCache.h"
+#include "GLErrorChecking.h"
+#include "MemoryBarrierTracker.h"
+#include "Window.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Rendering
+{
+	// -----------------------------------------
+
+	ReadbackResult::ReadbackResult()
+		: mPixels()
+		, mWidth(0)
+		, mHeight(0)
+		, mSucceeded(false)
+	{
+
+	}
+
+	// -----------------------------------------
+
+	AsyncReadback::AsyncReadback()
+		: mCurrentRequests()
+		, mInFlightBatches()
+		, mFreeBuffers()
+		, mReadFramebuffer(0)
+		, mFrameNumber(0)
+		, mInFlightRequestCount(0)
+		, mLastLatencyFrames(0)
+		, mWorker()
+		, mCompletedLock()
+		, mCompletedAdded()
+		, mCompleted()
+		, mStopWorker(false)
+	{
+		mWorker = std::thread(&AsyncReadback::WorkerLoop, this);
+	}
+
+	// -----------------------------------------
+
+	AsyncReadback::~AsyncReadback()
+	{
+		// Anything the GPU has not finished is abandoned rather than waited on, but its future and callback still hear about it
+		if (!mCurrentRequests.empty())
+		{
+			Batch batch;
+			batch.mRequests    = std::move(mCurrentRequests);
+			batch.mFence       = nullptr;
+			batch.mFrameNumber = mFrameNumber;
+
+			mInFlightBatches.push_back(std::move(batch));
+		}
+
+		for (Batch& batch : mInFlightBatches)
+		{
+			for (Request& request : batch.mRequests)
+			{
+				CompletedRequest completed;
+				completed.mPromise  = std::move(request.mPromise);
+				completed.mCallback = std::move(request.mCallback);
+
+				Complete(std::move(completed));
+
+				ReleaseBuffer(request.mBuffer);
+			}
+
+			if (batch.mFence)
+			{
+				glDeleteSync(batch.mFence);
+			}
+		}
+
+		mInFlightBatches.clear();
+
+		// The worker drains what is left before it stops
+		{
+			std::lock_guard<std::mutex> lock(mCompletedLock);
+			mStopWorker = true;
+		}
+
+		mCompletedAdded.notify_all();
+
+		if (mWorker.joinable())
+		{
+			mWorker.join();
+		}
+
+		for (const PackBuffer& buffer : mFreeBuffers)
+		{
+			glDeleteBuffers(1, &buffer.mBufferID);
+			GLStateCache::OnBufferDeleted(buffer.mBufferID);
+		}
+
+		mFreeBuffers.clear();
+
+		if (mReadFramebuffer)
+		{
+			glDeleteFramebuffers(1, &mReadFramebuffer);
+			GLStateCache::OnFramebufferDeleted(mReadFramebuffer);
+
+			mReadFramebuffer = 0;
+		}
+
+		GL_CHECK_ERROR("Error deleting readback buffers");
+	}
+
+	// -----------------------------------------
+
+	size_t AsyncReadback::GetBytesPerPixel(GLenum format, GLenum type)
+	{
+		// Packed types hold the whole pixel in one value
+		switch (type)
+		{
+		case GL_UNSIGNED_BYTE_3_3_2:
+		case GL_UNSIGNED_BYTE_2_3_3_REV:
+		return 1;
+
+		case GL_UNSIGNED_SHORT_5_6_5:
+		case GL_UNSIGNED_SHORT_5_6_5_REV:
+		case GL_UNSIGNED_SHORT_4_4_4_4:
+		case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+		case GL_UNSIGNED_SHORT_5_5_5_1:
+		case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+		return 2;
+
+		case GL_UNSIGNED_INT_8_8_8_8:
+		case GL_UNSIGNED_INT_8_8_8_8_REV:
+		case GL_UNSIGNED_INT_10_10_10_2:
+		case GL_UNSIGNED_INT_2_10_10_10_REV:
+		case GL_UNSIGNED_INT_24_8:
+		case GL_UNSIGNED_INT_10F_11F_11F_REV:
+		case GL_UNSIGNED_INT_5_9_9_9_REV:
+		return 4;
+
+		case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+		return 8;
+
+		default:
+		break;
+		}
+
+		// ----------
+
+		size_t componentSize = 0;
+
+		switch (type)
+		{
+		case GL_UNSIGNED_BYTE:
+		case GL_BYTE:
+			componentSize = 1;
+		break;
+
+		case GL_UNSIGNED_SHORT:
+		case GL_SHORT:
+		case GL_HALF_FLOAT:
+			componentSize = 2;
+		break;
+
+		case GL_UNSIGNED_INT:
+		case GL_INT:
+		case GL_FLOAT:
+			componentSize = 4;
+		break;
+
+		default:
+		return 0;
+		}
+
+		switch (format)
+		{
+		case GL_STENCIL_INDEX:
+		case GL_DEPTH_COMPONENT:
+		case GL_RED:
+		case GL_GREEN:
+		case GL_BLUE:
+		case GL_RED_INTEGER:
+		return componentSize;
+
+		case GL_RG:
+		case GL_RG_INTEGER:
+		return componentSize * 2;
+
+		case GL_RGB:
+		case GL_BGR:
+		case GL_RGB_INTEGER:
+		return componentSize * 3;
+
+		case GL_RGBA:
+		case GL_BGRA:
+		case GL_RGBA_INTEGER:
+		return componentSize * 4;
+
+		default:
+		return 0;
+		}
+	}
+
+	// -----------------------------------------
+
+	std::future<ReadbackResult> AsyncReadback::ReadFramebuffer(Framebuffer* framebuffer, unsigned int attachmentID, int x, int y, int width, int height, GLenum format, GLenum type, ReadbackCallback callback)
+	{
+		int attachmentWidth  = 0;
+		int attachmentHeight = 0;
+
+		if (!GetAttachmentSize(framebuffer, attachmentID, format, attachmentWidth, attachmentHeight))
+			return Fail(std::move(callback));
+
+		if (x < 0 || y < 0 || x + width > attachmentWidth || y + height > attachmentHeight)
+			return Fail(std::move(callback));
+
+		Request request;
+		request.mCallback = std::move(callback);
+
+		GLint previousAlignment = 0;
+
+		if (!BeginRead(GetBytesPerPixel(format, type), width, height, request, previousAlignment))
+			return Fail(std::move(request.mCallback));
+
+		// Only the read binding is touched, as this is often called part way through drawing into something else
+		unsigned int previousReadFramebuffer = GLStateCache::GetBoundFramebuffer(GL_READ_FRAMEBUFFER);
+
+		GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer ? framebuffer->GetFBOID() : 0);
+
+		// The read buffer belongs to the framebuffer rather than the context, so is put back for whoever reads from it next
+		GLint previousReadBuffer = GL_NONE;
+		glGetIntegerv(GL_READ_BUFFER, &previousReadBuffer);
+
+		glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 + attachmentID : GL_BACK);
+
+			// With a pack buffer bound this only queues the copy, the last argument being the offset into it
+			glReadPixels(x, y, width, height, format, type, nullptr);
+
+		glReadBuffer((GLenum)previousReadBuffer);
+
+		GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebuffer);
+
+		return EndRead(request, previousAlignment);
+	}
+
+	// -----------------------------------------
+
+	std::future<ReadbackResult> AsyncReadback::ReadTexture(Texture::Texture2D* texture, int x, int y, int width, int height, GLenum format, GLenum type, unsigned int mipLevel, ReadbackCallback callback)
+	{
+		if (!texture || !texture->GetIsInitialised())
+			return Fail(std::move(callback));
+
+		const int levelWidth  = std::max(1, (int)texture->GetTextureWidth()  >> mipLevel);
+		const int levelHeight = std::max(1, (int)texture->GetTextureHeight() >> mipLevel);
+
+		if (x < 0 || y < 0 || x + width > levelWidth || y + height > levelHeight)
+			return Fail(std::move(callback));
+
+		Request request;
+		request.mCallback = std::move(callback);
+
+		GLint previousAlignment = 0;
+
+		if (!BeginRead(GetBytesPerPixel(format, type), width, height, request, previousAlignment))
+			return Fail(std::move(request.mCallback));
+
+		// Compute passes write these with image stores, which the copy would otherwise not be ordered after
+		MemoryBarrierTracker::Access(GPUResourceType::Texture, texture->GetTextureID(), GPUResourceAccess::TextureUpdate);
+		MemoryBarrierTracker::IssueBarriers();
+
+		if (GLAD_GL_VERSION_4_5 && glGetTextureSubImage)
+		{
+			glGetTextureSubImage(texture->GetTextureID(), (GLint)mipLevel, x, y, 0, width, height, 1, format, type, (GLsizei)request.mSizeBytes, nullptr);
+		}
+		else
+		{
+			// Before 4.5 only a framebuffer read can take a rectangle, so the texture is attached to one kept for this
+			if (mReadFramebuffer == 0)
+			{
+				glGenFramebuffers(1, &mReadFramebuffer);
+			}
+
+			GLenum attachment = GL_COLOR_ATTACHMENT0;
+
+			if (format == GL_DEPTH_COMPONENT)
+				attachment = GL_DEPTH_ATTACHMENT;
+			else if (format == GL_STENCIL_INDEX)
+				attachment = GL_STENCIL_ATTACHMENT;
+			else if (format == GL_DEPTH_STENCIL)
+				attachment = GL_DEPTH_STENCIL_ATTACHMENT;
+
+			unsigned int previousReadFramebuffer = GLStateCache::GetBoundFramebuffer(GL_READ_FRAMEBUFFER);
+
+			GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, mReadFramebuffer);
+
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture->GetTextureID(), (GLint)mipLevel);
+			glReadBuffer(attachment == GL_COLOR_ATTACHMENT0 ? GL_COLOR_ATTACHMENT0 : GL_NONE);
+
+				glReadPixels(x, y, width, height, format, type, nullptr);
+
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, attachment, GL_TEXTURE_2D, 0, 0);
+
+			GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebuffer);
+		}
+
+		return EndRead(request, previousAlignment);
+	}
+
+	// -----------------------------------------
+
+	bool AsyncReadback::GetAttachmentSize(Framebuffer* framebuffer, unsigned int attachmentID, GLenum format, int& width, int& height)
+	{
+		if (!framebuffer)
+		{
+			width  = (int)Window::GetWindowWidth();
+			height = (int)Window::GetWindowHeight();
+
+			return true;
+		}
+
+		Texture::Texture2D* attachment = nullptr;
+
+		if (format == GL_DEPTH_COMPONENT || format == GL_DEPTH_STENCIL)
+			attachment = framebuffer->GetDepthBuffer();
+		else if (format == GL_STENCIL_INDEX)
+			attachment = framebuffer->GetStencilBuffer();
+		else
+			attachment = framebuffer->GetColourBuffer(attachmentID);
+
+		if (!attachment)
+			return false;
+
+		width  = (int)attachment->GetTextureWidth();
+		height = (int)attachment->GetTextureHeight();
+
+		return true;
+	}
+
+	// -----------------------------------------
+
+	bool AsyncReadback::BeginRead(size_t bytesPerPixel, int width, int height, Request& request, GLint& previousAlignment)
+	{
+		if (bytesPerPixel == 0 || width <= 0 || height <= 0)
+			return false;
+
+		request.mWidth     = width;
+		request.mHeight    = height;
+		request.mSizeBytes = bytesPerPixel * (size_t)width * (size_t)height;
+		request.mBuffer    = AcquireBuffer(request.mSizeBytes);
+
+		GLStateCache::BindBuffer(GL_PIXEL_PACK_BUFFER, request.mBuffer.mBufferID);
+
+		// Rows tightly packed, so the size worked out above is exactly what is written
+		glGetIntegerv(GL_PACK_ALIGNMENT, &previousAlignment);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+		return true;
+	}
+
+	// -----------------------------------------
+
+	std::future<ReadbackResult> AsyncReadback::EndRead(Request& request, GLint previousAlignment)
+	{
+		glPixelStorei(GL_PACK_ALIGNMENT, previousAlignment);
+
+		GLStateCache::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		GL_CHECK_ERROR("Error queueing pixel readback");
+
+		std::future<ReadbackResult> future = request.mPromise.get_future();
+
+		mCurrentRequests.push_back(std::move(request));
+		mInFlightRequestCount++;
+
+		return future;
+	}
+
+	// -----------------------------------------
+
+	std::future<ReadbackResult> AsyncReadback::Fail(ReadbackCallback callback)
+	{
+		CompletedRequest completed;
+		completed.mCallback = std::move(callback);
+
+		std::future<ReadbackResult> future = completed.mPromise.get_future();
+
+		Complete(std::move(completed));
+
+		return future;
+	}
+
+	// -----------------------------------------
+
+	void AsyncReadback::EndFrame()
+	{
+		mFrameNumber++;
+
+		if (!mCurrentRequests.empty())
+		{
+			Batch batch;
+			batch.mRequests    = std::move(mCurrentRequests);
+			batch.mFence       = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			batch.mFrameNumber = mFrameNumber;
+
+			mInFlightBatches.push_back(std::move(batch));
+
+			mCurrentRequests.clear();
+		}
+
+		// ----------
+
+		while (!mInFlightBatches.empty())
+		{
+			Batch& batch = mInFlightBatches.front();
+
+			// A zero timeout only asks - the swap flushes the fence, so it is always reached eventually
+			GLenum fenceStatus = glClientWaitSync(batch.mFence, 0, 0);
+
+			if (fenceStatus != GL_ALREADY_SIGNALED && fenceStatus != GL_CONDITION_SATISFIED)
+				break;
+
+			glDeleteSync(batch.mFence);
+
+			for (Request& request : batch.mRequests)
+			{
+				CompletedRequest completed;
+				completed.mPromise          = std::move(request.mPromise);
+				completed.mCallback         = std::move(request.mCallback);
+				completed.mResult.mWidth    = request.mWidth;
+				completed.mResult.mHeight   = request.mHeight;
+
+				GLStateCache::BindBuffer(GL_PIXEL_PACK_BUFFER, request.mBuffer.mBufferID);
+
+				// The copy has landed, so mapping now returns straight away
+				const unsigned char* source = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)request.mSizeBytes, GL_MAP_READ_BIT);
+
+				if (source)
+				{
+					completed.mResult.mPixels.resize(request.mSizeBytes);
+					std::memcpy(completed.mResult.mPixels.data(), source, request.mSizeBytes);
+
+					completed.mResult.mSucceeded = true;
+
+					glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+				}
+
+				GLStateCache::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+				ReleaseBuffer(request.mBuffer);
+
+				Complete(std::move(completed));
+
+				mInFlightRequestCount--;
+			}
+
+			mLastLatencyFrames = (unsigned int)(mFrameNumber - batch.mFrameNumber);
+
+			mInFlightBatches.pop_front();
+		}
+
+		GL_CHECK_ERROR("Error collecting pixel readbacks");
+	}
+
+	// -----------------------------------------
+
+	AsyncReadback::PackBuffer AsyncReadback::AcquireBuffer(size_t sizeBytes)
+	{
+		int bestFit = -1;
+
+		for (unsigned int i = 0; i < mFreeBuffers.size(); i++)
+		{
+			if (mFreeBuffers[i].mCapacityBytes < sizeBytes)
+				continue;
+
+			if (bestFit < 0 || mFreeBuffers[i].mCapacityBytes < mFreeBuffers[bestFit].mCapacityBytes)
+			{
+				bestFit = (int)i;
+			}
+		}
+
+		if (bestFit >= 0)
+		{
+			PackBuffer buffer = mFreeBuffers[bestFit];
+			mFreeBuffers.erase(mFreeBuffers.begin() + bestFit);
+
+			return buffer;
+		}
+
+		// ----------
+
+		PackBuffer buffer;
+		buffer.mCapacityBytes = sizeBytes;
+
+		glGenBuffers(1, &buffer.mBufferID);
+
+		GLStateCache::BindBuffer(GL_PIXEL_PACK_BUFFER, buffer.mBufferID);
+
+		// Written by the GPU, read by the CPU
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)sizeBytes, nullptr, GL_STREAM_READ);
+
+		GLStateCache::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		return buffer;
+	}
+
+	// -----------------------------------------
+
+	void AsyncReadback::ReleaseBuffer(const PackBuffer& buffer)
+	{
+		if (mFreeBuffers.size() < kMaxPooledBuffers)
+		{
+			mFreeBuffers.push_back(buffer);
+			return;
+		}
+
+		glDeleteBuffers(1, &buffer.mBufferID);
+		GLStateCache::OnBufferDeleted(buffer.mBufferID);
+	}
+
+	// -----------------------------------------
+
+	void AsyncReadback::Complete(CompletedRequest&& completed)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mCompletedLock);
+			mCompleted.push_back(std::move(completed));
+		}
+
+		mCompletedAdded.notify_one();
+	}
+
+	// -----------------------------------------
+
+	void AsyncReadback::WorkerLoop()
+	{
+		while (true)
+		{
+			CompletedRequest completed;
+
+			{
+				std::unique_lock<std::mutex> lock(mCompletedLock);
+
+				mCompletedAdded.wait(lock, [this]() { return mStopWorker || !mCompleted.empty(); });
+
+				if (mCompleted.empty())
+					return;
+
+				completed = std::move(mCompleted.front());
+				mCompleted.pop_front();
+			}
+
+			// The callback sees the pixels before whoever holds the future takes them
+			if (completed.mCallback)
+			{
+				completed.mCallback(completed.mResult);
+			}
+
+			completed.mPromise.set_value(std::move(completed.mResult));
+		}
+	}
+
+	// -----------------------------------------
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <future>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		class Texture2D;
+	}
+
+	class Framebuffer;
+
+	// -----------------------------------------
+
+	struct ReadbackResult
+	{
+		ReadbackResult();
+
+		std::vector<unsigned char> mPixels;    // Tightly packed, rows bottom first as GL stores them
+		int                        mWidth;
+		int                        mHeight;
+		bool                       mSucceeded; // False if the request was invalid or was still in flight at shutdown
+	};
+
+	// Run on the readback worker, never the render thread, so it must not touch GL
+	using ReadbackCallback = std::function<void(const ReadbackResult& result)>;
+
+	// -----------------------------------------
+
+	// Reads rectangles of framebuffer attachments and textures back to the CPU without the render thread waiting on the GPU
+	// Each read is queued into a pixel pack buffer as soon as it is requested, so it sees exactly what had been drawn by then,
+	// and every read made in a frame shares the one fence inserted by EndFrame. A later EndFrame finds the fence signalled,
+	// usually a frame or two on, copies the pixels out and hands them to a worker that runs the callbacks and fulfils the futures
+	// Render thread only, apart from the futures and callbacks
+	class AsyncReadback final
+	{
+	public:
+		AsyncReadback();
+		~AsyncReadback();
+
+		// A null framebuffer reads the back buffer of the window
+		std::future<ReadbackResult> ReadFramebuffer(Framebuffer* framebuffer, unsigned int attachmentID, int x, int y, int width, int height, GLenum format, GLenum type, ReadbackCallback callback = nullptr);
+		std::future<ReadbackResult> ReadTexture(Texture::Texture2D* texture, int x, int y, int width, int height, GLenum format, GLenum type, unsigned int mipLevel = 0, ReadbackCallback callback = nullptr);
+
+		// Called once a frame after everything that frame has requested - fences the frame's reads and collects any that have landed
+		void                        EndFrame();
+
+		unsigned int                GetInFlightRequestCount() const { return mInFlightRequestCount; }
+		unsigned int                GetLastLatencyFrames()    const { return mLastLatencyFrames;    }
+
+		// Zero for combinations glReadPixels does not accept
+		static size_t               GetBytesPerPixel(GLenum format, GLenum type);
+
+	private:
+		AsyncReadback(const AsyncReadback&)            = delete;
+		AsyncReadback& operator=(const AsyncReadback&) = delete;
+
+		// Reused across frames, so steady use allocates no GL buffers
+		static const unsigned int kMaxPooledBuffers = 8;
+
+		struct PackBuffer
+		{
+			unsigned int mBufferID;
+			size_t       mCapacityBytes;
+		};
+
+		struct Request
+		{
+			PackBuffer                   mBuffer;
+			size_t                       mSizeBytes;
+			int                          mWidth;
+			int                          mHeight;
+			std::promise<ReadbackResult> mPromise;
+			ReadbackCallback             mCallback;
+		};
+
+		struct Batch
+		{
+			std::vector<Request> mRequests;
+			GLsync               mFence;
+			unsigned long long   mFrameNumber;
+		};
+
+		struct CompletedRequest
+		{
+			ReadbackResult               mResult;
+			std::promise<ReadbackResult> mPromise;
+			ReadbackCallback             mCallback;
+		};
+
+		// Size of whatever a read in this format would come from - the window for the back buffer - false if nothing is attached there
+		static bool                 GetAttachmentSize(Framebuffer* framebuffer, unsigned int attachmentID, GLenum format, int& width, int& height);
+
+		// Sets up the pack buffer and state for a read of this size - false if the request is not one that can be read
+		bool                        BeginRead(size_t bytesPerPixel, int width, int height, Request& request, GLint& previousAlignment);
+		std::future<ReadbackResult> EndRead(Request& request, GLint previousAlignment);
+		std::future<ReadbackResult> Fail(ReadbackCallback callback);
+
+		PackBuffer                  AcquireBuffer(size_t sizeBytes);
+		void                        ReleaseBuffer(const PackBuffer& buffer);
+
+		void                        Complete(CompletedRequest&& completed);
+		void                        WorkerLoop();
+
+		std::vector<Request>         mCurrentRequests;   // Issued this frame, not yet fenced
+		std::deque<Batch>            mInFlightBatches;   // Oldest first, which is also the order their fences signal in
+		std::vector<PackBuffer>      mFreeBuffers;
+
+		unsigned int                 mReadFramebuffer;   // Only for reading textures without glGetTextureSubImage
+
+		unsigned long long           mFrameNumber;
+		unsigned int                 mInFlightRequestCount;
+		unsigned int                 mLastLatencyFrames;
+
+		std::thread                  mWorker;
+		std::mutex                   mCompletedLock;
+		std::condition_variable      mCompletedAdded;
+		std::deque<CompletedRequest> mCompleted;
+		bool                         mStopWorker;
+	};
+
+	// -----------------------------------------
+}
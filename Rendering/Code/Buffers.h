@@ -7,6 +7,8 @@
 #include "Maths/Code/AssertMsg.h"
 
 #include "Rendering/Code/RenderingResourceTracking.h"
+#include "Rendering/Code/GLStateCache.h"
+#include "Rendering/Code/GLErrorChecking.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -69,9 +71,9 @@ namespace Rendering
 			// Binds to the stored target, which is GL_ARRAY_BUFFER by default
 			void Bind()
 			{
-				glBindBuffer(mTarget, mVBO);
+				GLStateCache::BindBuffer(mTarget, mVBO);
 
-				ASSERTMSG(glGetError() != 0, "Error binding buffer.");
+				GL_CHECK_ERROR("Error binding buffer.");
 			}
 
 			void Bind(GLenum target)
@@ -83,10 +85,9 @@ namespace Rendering
 
 			void UnBind()
 			{
-				glBindBuffer(mTarget, 0);
+				GLStateCache::BindBuffer(mTarget, 0);
 
-				GLenum error = glGetError();
-				ASSERTMSG(error != 0, "Error binding buffer.");
+				GL_CHECK_ERROR("Error binding buffer.");
 			}
 
 			void UnBind(GLenum target)
@@ -109,8 +110,7 @@ namespace Rendering
 				mBytesInData = bytesInData;
 				glBufferData(mTarget, mBytesInData, data, usage);
 
-				GLenum error = glGetError();
-				ASSERTMSG(error != 0, "Error setting buffer data.");
+				GL_CHECK_ERROR("Error setting buffer data.");
 			}
 
 			// --------------------------------
@@ -128,7 +128,7 @@ namespace Rendering
 				mBytesInData = bytesInData;
 				glBufferData(mTarget, bytesInData, data, usage);
 
-				ASSERTMSG(glGetError() != 0, "Error setting buffer data.");
+				GL_CHECK_ERROR("Error setting buffer data.");
 			}
 
 			void SubBufferUpdate(unsigned int offset, unsigned int bytesInData, const GLvoid* data)
@@ -141,14 +141,14 @@ namespace Rendering
 
 				glBufferSubData(mTarget, offset, bytesInData, data);
 
-				ASSERTMSG(glGetError() != 0, "Error setting buffer sub-data.");
+				GL_CHECK_ERROR("Error setting buffer sub-data.");
 			}
 
 			void ClearAllDataInBuffer(GLenum usage)
 			{
 				Bind();
 				glBufferData(mTarget, mBytesInData, NULL, usage);
-				ASSERTMSG(glGetError() != 0, "Error clearing buffer data.");
+				GL_CHECK_ERROR("Error clearing buffer data.");
 				mBytesInData = 0;
 			}
 
@@ -159,12 +159,12 @@ namespace Rendering
 				// Clear the existing memory
 				glBufferData(mTarget, mBytesInData, NULL, usage);
 
-				ASSERTMSG(glGetError() != 0, "Error clearing buffer data.");
+				GL_CHECK_ERROR("Error clearing buffer data.");
 
 				// Alloctae the new memory count
 				glBufferData(mTarget, bytes, NULL, usage);
 
-				ASSERTMSG(glGetError() != 0, "Error setting buffer size.");
+				GL_CHECK_ERROR("Error setting buffer size.");
 
 				// Store the count
 				mBytesInData = bytes;
@@ -183,8 +183,11 @@ namespace Rendering
 				Rendering::TrackingData::AdjustGPUMemoryUsed(-((int)mBytesInData));
 
 				glDeleteBuffers(1, &mVBO);
-				ASSERTMSG(glGetError() != 0, "Error deleteing buffers.");
+				GL_CHECK_ERROR("Error deleteing buffers.");
 
+				GLStateCache::OnBufferDeleted(mVBO);
+
+				mVBO         = 0;
 				mBytesInData = 0;
 			}
 
@@ -219,9 +222,7 @@ namespace Rendering
 			{
 				glGenBuffers(1, &mSSBO);
 
-				GLenum error = glGetError();
-
-				ASSERTMSG(error != 0, "Error generating SSBO");
+				GL_CHECK_ERROR("Error generating SSBO");
 			}
 
 			// --------------------------------
@@ -235,9 +236,9 @@ namespace Rendering
 
 			void Bind()
 			{
-				glBindBuffer(GL_SHADER_STORAGE_BUFFER, mSSBO);
+				GLStateCache::BindBuffer(GL_SHADER_STORAGE_BUFFER, mSSBO);
 
-				ASSERTMSG(glGetError() != 0, "Error binding SSBO");
+				GL_CHECK_ERROR("Error binding SSBO");
 			}
 
 			// --------------------------------
@@ -253,7 +254,7 @@ namespace Rendering
 				mBytesInData = bytesInData;
 				glBufferData(GL_SHADER_STORAGE_BUFFER, mBytesInData, data, usage);
 
-				ASSERTMSG(glGetError() != 0, "Error setting SSBO data");
+				GL_CHECK_ERROR("Error setting SSBO data");
 			}
 
 			// --------------------------------
@@ -271,7 +272,7 @@ namespace Rendering
 				mBytesInData = bytesInData;
 				glBufferData(GL_SHADER_STORAGE_BUFFER, bytesInData, data, usage);
 
-				ASSERTMSG(glGetError() != 0, "Error setting SSBO data");
+				GL_CHECK_ERROR("Error setting SSBO data");
 			}
 
 			void SubBufferUpdate(unsigned int offset, unsigned int bytesInData, const GLvoid* data)
@@ -284,7 +285,7 @@ namespace Rendering
 
 				glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, bytesInData, data);
 
-				ASSERTMSG(glGetError() != 0, "Error setting SSBO sub-data");
+				GL_CHECK_ERROR("Error setting SSBO sub-data");
 			}
 
 			void ClearAllDataInBuffer(GLenum usage)
@@ -292,7 +293,7 @@ namespace Rendering
 				Bind();
 				glBufferData(GL_SHADER_STORAGE_BUFFER, mBytesInData, NULL, usage);
 
-				ASSERTMSG(glGetError() != 0, "Error setting SSBO data");
+				GL_CHECK_ERROR("Error setting SSBO data");
 				mBytesInData = 0;
 			}
 
@@ -302,11 +303,11 @@ namespace Rendering
 
 				// Clear the existing memory
 				glBufferData(GL_SHADER_STORAGE_BUFFER, mBytesInData, NULL, usage);
-				ASSERTMSG(glGetError() != 0, "Error setting SSBO data");
+				GL_CHECK_ERROR("Error setting SSBO data");
 
 				// Alloctae the new memory count
 				glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, NULL, usage);
-				ASSERTMSG(glGetError() != 0, "Error setting SSBO data");
+				GL_CHECK_ERROR("Error setting SSBO data");
 
 				// Store the count
 				mBytesInData = bytes;
@@ -316,13 +317,46 @@ namespace Rendering
 
 			// --------------------------------
 
+			unsigned int GetSSBOID()        const { return mSSBO; }
 			unsigned int GetBytesInBuffer() const { return mBytesInData; }
 
 			// --------------------------------
 
 			void BindToBufferIndex(unsigned int index)
 			{
-				glBindBufferBase(GL_SHADER_STORAGE_BUFFER, index, mSSBO);
+				GLStateCache::BindBufferBase(GL_SHADER_STORAGE_BUFFER, index, mSSBO);
+			}
+
+			// Binds the buffer to a non-storage target, for when data written by a compute shader is consumed elsewhere in the pipeline
+			// (GL_DRAW_INDIRECT_BUFFER, GL_PARAMETER_BUFFER, GL_ARRAY_BUFFER etc)
+			void BindToTarget(GLenum target)
+			{
+				GLStateCache::BindBuffer(target, mSSBO);
+
+				GL_CHECK_ERROR("Error binding SSBO to target");
+			}
+
+			// Blocking copy back to the CPU - only use this for debugging/verification
+			void ReadBufferData(unsigned int offset, unsigned int bytesToRead, GLvoid* output)
+			{
+				Bind();
+
+				if (offset + bytesToRead > mBytesInData)
+					return;
+
+				glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, bytesToRead, output);
+
+				GL_CHECK_ERROR("Error reading SSBO data");
+			}
+
+			// Sets every byte in the buffer to zero without sending any data from the CPU
+			void ClearToZero()
+			{
+				Bind();
+
+				glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+				GL_CHECK_ERROR("Error clearing SSBO data");
 			}
 
 			// --------------------------------
@@ -332,6 +366,9 @@ namespace Rendering
 				Rendering::TrackingData::AdjustGPUMemoryUsed(-((int)mBytesInData));
 
 				glDeleteBuffers(1, &mSSBO);
+				GLStateCache::OnBufferDeleted(mSSBO);
+
+				mSSBO        = 0;
 				mBytesInData = 0;
 			}
 
@@ -342,6 +379,100 @@ namespace Rendering
 			unsigned int mBytesInData;
 		};
 
+		// ----------------------------------------------------
+		// ====================================================
+
+		// Backing store for a std140 uniform block, shared by every program that declares the block at the same binding point
+		class UniformBufferObject final : public Buffer
+		{
+		public:
+			// --------------------------------
+
+			UniformBufferObject()
+				: Buffer()
+
+				, mUBO(0)
+				, mBytesInData(0)
+			{
+				glGenBuffers(1, &mUBO);
+
+				GL_CHECK_ERROR("Error generating UBO");
+			}
+
+			// --------------------------------
+
+			~UniformBufferObject()
+			{
+				Delete();
+			}
+
+			// --------------------------------
+
+			void Bind()
+			{
+				GLStateCache::BindBuffer(GL_UNIFORM_BUFFER, mUBO);
+
+				GL_CHECK_ERROR("Error binding UBO");
+			}
+
+			// --------------------------------
+
+			// Reserves the storage once, the contents are then replaced each frame through SubBufferUpdate
+			void AllocateMemory(unsigned int bytes, GLenum usage)
+			{
+				Bind();
+
+				Rendering::TrackingData::AdjustGPUMemoryUsed((int)bytes - (int)mBytesInData);
+
+				mBytesInData = bytes;
+				glBufferData(GL_UNIFORM_BUFFER, bytes, NULL, usage);
+
+				GL_CHECK_ERROR("Error allocating UBO data");
+			}
+
+			void SubBufferUpdate(unsigned int offset, unsigned int bytesInData, const GLvoid* data)
+			{
+				Bind();
+
+				if (offset + bytesInData > mBytesInData)
+					return;
+
+				glBufferSubData(GL_UNIFORM_BUFFER, offset, bytesInData, data);
+
+				GL_CHECK_ERROR("Error setting UBO sub-data");
+			}
+
+			// --------------------------------
+
+			void BindToBufferIndex(unsigned int index)
+			{
+				GLStateCache::BindBufferBase(GL_UNIFORM_BUFFER, index, mUBO);
+
+				GL_CHECK_ERROR("Error binding UBO to index");
+			}
+
+			unsigned int GetBytesInBuffer() const { return mBytesInData; }
+
+			// --------------------------------
+
+			void Delete()
+			{
+				Rendering::TrackingData::AdjustGPUMemoryUsed(-((int)mBytesInData));
+
+				glDeleteBuffers(1, &mUBO);
+				GLStateCache::OnBufferDeleted(mUBO);
+
+				mUBO         = 0;
+				mBytesInData = 0;
+			}
+
+			// --------------------------------
+
+		private:
+			unsigned int mUBO;
+			unsigned int mBytesInData;
+		};
+
 
 		// ----------------------------------------------------
 		// ====================================================
@@ -356,7 +487,7 @@ namespace Rendering
 			{
 				glGenBuffers(1, &mEBO);
 
-				ASSERTMSG(glGetError() != 0, "Error generating buffer");
+				GL_CHECK_ERROR("Error generating buffer");
 			}
 
 			// --------------------------------------------------------
@@ -370,9 +501,9 @@ namespace Rendering
 
 			void Bind()
 			{
-				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+				GLStateCache::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
 
-				ASSERTMSG(glGetError() != 0, "Error binding EBO");
+				GL_CHECK_ERROR("Error binding EBO");
 			}
 
 			// --------------------------------------------------------
@@ -385,7 +516,7 @@ namespace Rendering
 
 				glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytesForBuffer, data, usage);
 
-				ASSERTMSG(glGetError() != 0, "Error setting buffer data");
+				GL_CHECK_ERROR("Error setting buffer data");
 				
 				Rendering::TrackingData::AdjustGPUMemoryUsed(bytesForBuffer);
 			}
@@ -396,7 +527,10 @@ namespace Rendering
 			{
 				glDeleteBuffers(1, &mEBO);
 
-				ASSERTMSG(glGetError() != 0, "Error deleting EBO");
+				GL_CHECK_ERROR("Error deleting EBO");
+
+				GLStateCache::OnBufferDeleted(mEBO);
+				mEBO = 0;
 			}
 
 			// --------------------------------------------------------
@@ -420,7 +554,7 @@ namespace Rendering
 			{
 				glGenVertexArrays(1, &mVAO);
 
-				ASSERTMSG(glGetError() != 0, "Error generating VAO");
+				GL_CHECK_ERROR("Error generating VAO");
 			}
 
 			// -----------------------------------------
@@ -429,32 +563,40 @@ namespace Rendering
 			{
 				glDeleteVertexArrays(1, &mVAO);
 
-				ASSERTMSG(glGetError() != 0, "Error deleting VAO");
+				GL_CHECK_ERROR("Error deleting VAO");
+
+				GLStateCache::OnVertexArrayDeleted(mVAO);
 			}
 
 			// -----------------------------------------
 
 			void Bind()
 			{
-				glBindVertexArray(mVAO);
+				GLStateCache::BindVertexArray(mVAO);
 
-				ASSERTMSG(glGetError() != 0, "Error binding VAO");
+				GL_CHECK_ERROR("Error binding VAO");
 			}
 
 			// -----------------------------------------
 
 			void Unbind()
 			{
-				glBindVertexArray(0);
+				GLStateCache::BindVertexArray(0);
 			}
 
 			// -----------------------------------------
 
+			unsigned int GetVAOID() const { return mVAO; }
+
+			// -----------------------------------------
+
 			void Delete()
 			{
 				glDeleteVertexArrays(1, &mVAO);
 
-				ASSERTMSG(glGetError() != 0, "Error deleting VAO");
+				GL_CHECK_ERROR("Error deleting VAO");
+
+				GLStateCache::OnVertexArrayDeleted(mVAO);
 			}
 
 			// -----------------------------------------
@@ -463,7 +605,7 @@ namespace Rendering
 			{
 				glEnableVertexAttribArray(index);
 
-				ASSERTMSG(glGetError() != 0, "Error enabling VAO vertex attribute");
+				GL_CHECK_ERROR("Error enabling VAO vertex attribute");
 			}
 
 			// -----------------------------------------
@@ -484,7 +626,7 @@ namespace Rendering
 			{
 				glVertexAttribPointer(index, floatsInSingleData, dataType, normalised, stride, (GLvoid*)offset);
 
-				ASSERTMSG(glGetError() != 0, "Error setting VAO attribute data");
+				GL_CHECK_ERROR("Error setting VAO attribute data");
 
 				if (perVertex)
 				{
@@ -495,7 +637,7 @@ namespace Rendering
 					glVertexAttribDivisor(index, 1);
 				}
 
-				ASSERTMSG(glGetError() != 0, "Error setting VAO attribute data");
+				GL_CHECK_ERROR("Error setting VAO attribute data");
 			}
 
 #pragma warning( pop )
@@ -512,7 +654,7 @@ namespace Rendering
 			{
 				glVertexAttribIPointer(index, floatsInSingleData, dataType, stride, offset);
 
-				ASSERTMSG(glGetError() != 0, "Error setting VAO attribute data");
+				GL_CHECK_ERROR("Error setting VAO attribute data");
 
 				if (perVertex)
 				{
@@ -536,7 +678,7 @@ namespace Rendering
 			{
 				glVertexAttribLPointer(index, size, dataType, stride, offset);
 
-				ASSERTMSG(glGetError() != 0, "Error setting VAO attribute data");
+				GL_CHECK_ERROR("Error setting VAO attribute data");
 
 				if (perVertex)
 				{
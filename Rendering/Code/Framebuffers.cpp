@@ -1,6 +1,10 @@
 #include "Framebuffers.h"
 
 #include "Textures/Texture.h"
+#include "Window.h"
+#include "OpenGLRenderPipeline.h"
+#include "GLStateCache.h"
+#include "GLErrorChecking.h"
 
 namespace Rendering
 {
@@ -15,7 +19,7 @@ namespace Rendering
 	{
 		glGenFramebuffers(1, &mFBO);
 
-		ASSERTMSG(glGetError() != 0, "Error creating framebuffer");
+		GL_CHECK_ERROR("Error creating framebuffer");
 	}
 
 	// ----------------------------------
@@ -55,38 +59,37 @@ namespace Rendering
 
 		// Delete the FBO
 		glDeleteFramebuffers(1, &mFBO);
+		GLStateCache::OnFramebufferDeleted(mFBO);
 
-		ASSERTMSG(glGetError() != 0, "Error deleting framebuffer");
+		GL_CHECK_ERROR("Error deleting framebuffer");
 	}
 
 	// ----------------------------------
 
 	void Framebuffer::SetActive(bool activeState, bool drawing)
 	{
-		int error = 0;
 		if (activeState)
 		{
 			if (drawing)
 			{
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mFBO);
-				glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+				GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, mFBO);
+				GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 			}
 			else
 			{
-				glBindFramebuffer(GL_READ_FRAMEBUFFER, mFBO);
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+				GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, mFBO);
+				GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 			}
 		}
 		else
 		{
 			if (drawing)
-				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+				GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 			else
-				glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+				GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 		}
 
-		error = glGetError();
-		ASSERTMSG(error != 0, "Error binding framebuffer to OpenGL!");
+		GL_CHECK_ERROR("Error binding framebuffer to OpenGL!");
 	}
 
 	// ----------------------------------
@@ -109,8 +112,7 @@ namespace Rendering
 			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + attachmentID, GL_TEXTURE_2D, textureID, 0);
 		}
 
-		int error = glGetError();
-		ASSERTMSG(error != 0, "Error attaching colour buffer to framebuffer!");
+		GL_CHECK_ERROR("Error attaching colour buffer to framebuffer!");
 
 		CheckComplete();
 
@@ -165,7 +167,7 @@ namespace Rendering
 		else
 			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, textureID, 0);
 
-		ASSERTMSG(glGetError() != 0, "Error attaching depth buffer to framebuffer!");
+		GL_CHECK_ERROR("Error attaching depth buffer to framebuffer!");
 
 		mDepthBuffer = depthTexture;
 	}
@@ -186,7 +188,7 @@ namespace Rendering
 		else
 			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_TEXTURE_2D, textureID, 0);
 
-		ASSERTMSG(glGetError() != 0, "Error attaching stencil buffer to framebuffer!");
+		GL_CHECK_ERROR("Error attaching stencil buffer to framebuffer!");
 
 		mStencilBuffer = stencilTexture;
 	}
@@ -207,7 +209,7 @@ namespace Rendering
 		else
 			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, textureID, 0);
 
-		ASSERTMSG(glGetError() != 0, "Error attaching depth + stencil buffer to framebuffer!");
+		GL_CHECK_ERROR("Error attaching depth + stencil buffer to framebuffer!");
 
 		mDepthBuffer   = depthStencilTexture;
 		mStencilBuffer = depthStencilTexture;
@@ -223,8 +225,7 @@ namespace Rendering
 
 		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-		GLenum error = glGetError();
-		ASSERTMSG(error != 0, "Error clearing texture");
+		GL_CHECK_ERROR("Error clearing texture");
 	}
 
 	// ----------------------------------
@@ -235,7 +236,7 @@ namespace Rendering
 
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		ASSERTMSG(glGetError() != 0, "Error clearing texture");
+		GL_CHECK_ERROR("Error clearing texture");
 	}
 
 	// ----------------------------------
@@ -246,7 +247,7 @@ namespace Rendering
 
 		glClear(GL_DEPTH_BUFFER_BIT);
 
-		ASSERTMSG(glGetError() != 0, "Error clearing texture");
+		GL_CHECK_ERROR("Error clearing texture");
 	}
 
 	// ----------------------------------
@@ -257,7 +258,7 @@ namespace Rendering
 
 		glClear(GL_STENCIL_BUFFER_BIT);
 
-		ASSERTMSG(glGetError() != 0, "Error clearing texture");
+		GL_CHECK_ERROR("Error clearing texture");
 	}
 
 	// ----------------------------------
@@ -268,7 +269,7 @@ namespace Rendering
 
 		glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-		ASSERTMSG(glGetError() != 0, "Error clearing texture");
+		GL_CHECK_ERROR("Error clearing texture");
 	}
 
 	// ----------------------------------
@@ -342,8 +343,7 @@ namespace Rendering
 			// Read the pixel from the image
 			glReadPixels((int)coord.x, (int)coord.y, 1, 1, format, type, &data);
 
-		int error = glGetError();
-		ASSERTMSG(error != 0, "error");
+		GL_CHECK_ERROR("Error reading pixel from framebuffer");
 
 		// Remove the buffer we are reading from
 		glReadBuffer(0);
@@ -356,6 +356,23 @@ namespace Rendering
 
 	// ----------------------------------
 
+	std::future<ReadbackResult> Framebuffer::ReadPixelsAsync(int x, int y, int width, int height, GLenum format, GLenum type, unsigned int attachmentID, ReadbackCallback callback)
+	{
+		OpenGLRenderPipeline* renderPipeline = (OpenGLRenderPipeline*)Window::GetRenderPipeline();
+
+		if (!renderPipeline || !renderPipeline->GetAsyncReadback())
+		{
+			std::promise<ReadbackResult> failed;
+			failed.set_value(ReadbackResult());
+
+			return failed.get_future();
+		}
+
+		return renderPipeline->GetAsyncReadback()->ReadFramebuffer(this, attachmentID, x, y, width, height, format, type, std::move(callback));
+	}
+
+	// ----------------------------------
+
 	void Framebuffer::ResizeBuffers(unsigned int width, unsigned int height)
 	{
 		// This can happen on minimise, which will get overridden when opening the window again
@@ -375,8 +392,7 @@ namespace Rendering
 			{
 				mColourBuffers[i].second->Resize(width, height);
 
-				GLenum error = glGetError();
-				ASSERTMSG(error != 0, "Error resizing the buffers for a framebuffer");
+				GL_CHECK_ERROR("Error resizing the buffers for a framebuffer");
 			}
 		}
 
@@ -384,16 +400,14 @@ namespace Rendering
 		{
 			mDepthBuffer->Resize(width, height);
 
-			GLenum error = glGetError();
-			ASSERTMSG(error != 0, ">");
+			GL_CHECK_ERROR("Error resizing the depth buffer for a framebuffer");
 		}
 
 		if (mStencilBuffer)
 		{
 			mStencilBuffer->Resize(width, height);
 
-			GLenum error = glGetError();
-			ASSERTMSG(error != 0, ">");
+			GL_CHECK_ERROR("Error resizing the stencil buffer for a framebuffer");
 		}
 
 		CheckComplete();
@@ -410,9 +424,7 @@ namespace Rendering
 
 		glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachmentMode, GL_RENDERBUFFER, buffer->GetID());
 
-		GLenum error = glGetError();
-
-		ASSERTMSG(error != 0, "Error binding renderbuffer to framebuffer");
+		GL_CHECK_ERROR("Error binding renderbuffer to framebuffer");
 	}
 
 	// ----------------------------------
@@ -424,7 +436,7 @@ namespace Rendering
 	{
 		glGenRenderbuffers(1, &mRBOID);
 
-		ASSERTMSG(glGetError() != 0, "Error creating renderbuffer");
+		GL_CHECK_ERROR("Error creating renderbuffer");
 	}
 
 	// ----------------------------------
@@ -433,7 +445,7 @@ namespace Rendering
 	{
 		glDeleteRenderbuffers(1, &mRBOID);
 
-		ASSERTMSG(glGetError() != 0, "Error deleting renderbuffer");
+		GL_CHECK_ERROR("Error deleting renderbuffer");
 	}
 
 	// ----------------------------------
@@ -442,7 +454,7 @@ namespace Rendering
 	{
 		glBindRenderbuffer(GL_RENDERBUFFER, mRBOID);
 
-		ASSERTMSG(glGetError() != 0, "Error binding renderbuffer");
+		GL_CHECK_ERROR("Error binding renderbuffer");
 	}
 
 	// ----------------------------------
@@ -453,7 +465,7 @@ namespace Rendering
 
 		glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
 
-		ASSERTMSG(glGetError() != 0, "Error setting renderbuffer data");
+		GL_CHECK_ERROR("Error setting renderbuffer data");
 	}
 
 	// ----------------------------------
@@ -2,6 +2,7 @@
 
 #include "Maths/Code/AssertMsg.h"
 #include "Rendering/Code/Buffers.h"
+#include "Rendering/Code/AsyncReadback.h"
 #include "Maths/Code/Vector.h"
 
 #include <glad/glad.h>
@@ -52,6 +53,8 @@ namespace Rendering
 		Texture::Texture2D* GetDepthBuffer()                      const { return mDepthBuffer; }
 		Texture::Texture2D* GetStencilBuffer()                    const { return mStencilBuffer; }
 
+		GLuint              GetFBOID()                            const { return mFBO; }
+
 		void RemoveColourBuffer(unsigned int attachmentID);
 
 		// --------------
@@ -62,8 +65,12 @@ namespace Rendering
 		// type = GL_UNSIGNED_BYTE, GL_BYTE, GL_UNSIGNED_SHORT, GL_SHORT, GL_UNSIGNED_INT, GL_INT, GL_HALF_FLOAT, GL_FLOAT, GL_UNSIGNED_BYTE_3_3_2, GL_UNSIGNED_BYTE_2_3_3_REV, GL_UNSIGNED_SHORT_5_6_5, GL_UNSIGNED_SHORT_5_6_5_REV, GL_UNSIGNED_SHORT_4_4_4_4, GL_UNSIGNED_SHORT_4_4_4_4_REV,
 		// GL_UNSIGNED_SHORT_5_5_5_1, GL_UNSIGNED_SHORT_1_5_5_5_REV, GL_UNSIGNED_INT_8_8_8_8, GL_UNSIGNED_INT_8_8_8_8_REV, GL_UNSIGNED_INT_10_10_10_2, GL_UNSIGNED_INT_2_10_10_10_REV, GL_UNSIGNED_INT_24_8, GL_UNSIGNED_INT_10F_11F_11F_REV,
 		// GL_UNSIGNED_INT_5_9_9_9_REV, or GL_FLOAT_32_UNSIGNED_INT_24_8_REV
+		// Stalls until the GPU has finished everything before it - ReadPixelsAsync takes the same formats and does not
 		Maths::Vector::Vector4D<unsigned int> GetPixelColour(Maths::Vector::Vector2D<float> coord, GLenum format, GLenum type, unsigned int attachmentID = 0);
 
+		// Resolved a frame or two later through the render pipeline's AsyncReadback
+		std::future<ReadbackResult> ReadPixelsAsync(int x, int y, int width, int height, GLenum format, GLenum type, unsigned int attachmentID = 0, ReadbackCallback callback = nullptr);
+
 		void ResizeBuffers(unsigned int width, unsigned int height);
 
 		void AssignRenderBuffer(RenderBuffer* bufffer, GLenum mode);
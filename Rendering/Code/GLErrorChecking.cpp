@@ -0,0 +1,141 @@
+#include "GLErrorChecking.h"
+
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <deque>
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	// Only the latest few are kept, so a message raised every frame can not grow this forever
+	static const unsigned int                kMaxStoredDebugMessages = 64;
+
+	static std::atomic<const GLCallSite*>    sLastCheckpoint(nullptr);
+	static std::atomic<unsigned int>         sDebugErrorCount(0);
+
+	static std::mutex                        sDebugMessageLock;
+	static std::deque<GLDebugMessage>        sDebugMessages;
+
+	bool GLDebugOutput::sSynchronous = false;
+
+	// ---------------------------------------
+
+	void GLDebugOutput::Enable()
+	{
+		int contextFlags = 0;
+		glGetIntegerv(GL_CONTEXT_FLAGS, &contextFlags);
+
+		if ((contextFlags & GL_CONTEXT_FLAG_DEBUG_BIT) == 0)
+		{
+			std::cout << "GL debug output requested, but the context is not a debug context - errors may not be reported" << std::endl;
+		}
+
+		glEnable(GL_DEBUG_OUTPUT);
+
+		SetSynchronous(sSynchronous);
+
+		glDebugMessageCallback(MessageCallback, nullptr);
+
+		// Notifications are mostly buffer placement hints, which would bury anything useful
+		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+	}
+
+	// ---------------------------------------
+
+	void GLDebugOutput::SetSynchronous(bool synchronous)
+	{
+		sSynchronous = synchronous;
+
+		if (synchronous)
+			glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		else
+			glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	}
+
+	// ---------------------------------------
+
+	void GLDebugOutput::SetCheckpoint(const GLCallSite* callSite)
+	{
+		sLastCheckpoint.store(callSite, std::memory_order_relaxed);
+	}
+
+	// ---------------------------------------
+
+	unsigned int GLDebugOutput::GetErrorCount()
+	{
+		return sDebugErrorCount.load();
+	}
+
+	// ---------------------------------------
+
+	void GLDebugOutput::GetRecentMessages(std::vector<GLDebugMessage>& output)
+	{
+		std::lock_guard<std::mutex> lock(sDebugMessageLock);
+
+		output.assign(sDebugMessages.begin(), sDebugMessages.end());
+	}
+
+	// ---------------------------------------
+
+	void GLDebugOutput::ClearMessages()
+	{
+		std::lock_guard<std::mutex> lock(sDebugMessageLock);
+
+		sDebugMessages.clear();
+		sDebugErrorCount = 0;
+	}
+
+	// ---------------------------------------
+
+	const char* GLDebugOutput::GetTypeName(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_DEBUG_TYPE_ERROR:               return "Error";
+		case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "Deprecated";
+		case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return "Undefined behaviour";
+		case GL_DEBUG_TYPE_PORTABILITY:         return "Portability";
+		case GL_DEBUG_TYPE_PERFORMANCE:         return "Performance";
+		case GL_DEBUG_TYPE_MARKER:              return "Marker";
+		default:                                return "Other";
+		}
+	}
+
+	// ---------------------------------------
+
+	void APIENTRY GLDebugOutput::MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParameter)
+	{
+		GLDebugMessage debugMessage;
+		debugMessage.mText       = length >= 0 ? std::string(message, (size_t)length) : std::string(message);
+		debugMessage.mType       = type;
+		debugMessage.mSeverity   = severity;
+		debugMessage.mCheckpoint = sLastCheckpoint.load(std::memory_order_relaxed);
+
+		if (type == GL_DEBUG_TYPE_ERROR)
+		{
+			sDebugErrorCount++;
+
+			std::cout << "GL error: " << debugMessage.mText;
+
+			if (debugMessage.mCheckpoint)
+			{
+				std::cout << " (after " << debugMessage.mCheckpoint->mFile << "(" << debugMessage.mCheckpoint->mLine << "): " << debugMessage.mCheckpoint->mMessage << ")";
+			}
+
+			std::cout << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock(sDebugMessageLock);
+
+		if (sDebugMessages.size() >= kMaxStoredDebugMessages)
+		{
+			sDebugMessages.pop_front();
+		}
+
+		sDebugMessages.push_back(debugMessage);
+	}
+
+	// ---------------------------------------
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Maths/Code/AssertMsg.h"
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <string>
+
+// ---------------------------------------
+// How GL errors are caught is picked at compile time:
+//  _GL_ERRORS_SYNCHRONOUS  - glGetError after every checked call, stopping on the exact call at the cost of a pipeline sync each time
+//  _GL_ERRORS_DEBUG_OUTPUT - the KHR_debug message callback, reported against the last checkpoint the render thread passed
+//  _GL_ERRORS_DISABLED     - checks are compiled out entirely
+// With none of them defined, debug builds use the callback and release/final builds compile the checks out
+
+#if !defined(_GL_ERRORS_SYNCHRONOUS) && !defined(_GL_ERRORS_DEBUG_OUTPUT) && !defined(_GL_ERRORS_DISABLED)
+	#ifdef _DEBUG_BUILD
+		#define _GL_ERRORS_DEBUG_OUTPUT
+	#else
+		#define _GL_ERRORS_DISABLED
+	#endif
+#endif
+
+#if defined(_GL_ERRORS_SYNCHRONOUS)
+
+	#define GL_CHECK_ERROR(failMessage)\
+	{\
+		ASSERTMSG(glGetError() != GL_NO_ERROR, failMessage);\
+	}
+
+#elif defined(_GL_ERRORS_DEBUG_OUTPUT)
+
+	// No GL call at all - just a pointer store, so the check costs nothing on the driver side
+	#define GL_CHECK_ERROR(failMessage)\
+	{\
+		static const Rendering::GLCallSite kGLCallSite = { __FILE__, __LINE__, failMessage };\
+		Rendering::GLDebugOutput::SetCheckpoint(&kGLCallSite);\
+	}
+
+#else
+
+	#define GL_CHECK_ERROR(failMessage)
+
+#endif
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	struct GLCallSite
+	{
+		const char*  mFile;
+		unsigned int mLine;
+		const char*  mMessage;
+	};
+
+	// ---------------------------------------
+
+	struct GLDebugMessage
+	{
+		std::string  mText;
+		GLenum       mType;
+		GLenum       mSeverity;
+
+		// The last GL_CHECK_ERROR passed before the message came in - with asynchronous output the call is at or after this point
+		const GLCallSite* mCheckpoint;
+	};
+
+	// ---------------------------------------
+
+	// Collects messages from the KHR_debug callback, which drivers can raise from their own threads
+	// Static in the same way as GLStateCache, as there is only the one context
+	class GLDebugOutput final
+	{
+	public:
+		// Needs a context created with GLFW_OPENGL_DEBUG_CONTEXT, otherwise drivers are free to send nothing
+		static void Enable();
+
+		// Synchronous output makes the callback fire inside the offending call, for use with a debugger when a checkpoint is not precise enough
+		static void SetSynchronous(bool synchronous);
+		static bool GetSynchronous() { return sSynchronous; }
+
+		static void SetCheckpoint(const GLCallSite* callSite);
+
+		static unsigned int GetErrorCount();
+
+		// Copies out the most recent messages, oldest first
+		static void GetRecentMessages(std::vector<GLDebugMessage>& output);
+		static void ClearMessages();
+
+		static const char* GetTypeName(GLenum type);
+
+	private:
+		static void APIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParameter);
+
+		static bool sSynchronous;
+	};
+
+	// ---------------------------------------
+}
@@ -0,0 +1,701 @@
+#include "GLStateCache.h"
+#include "TextureResidency.h"
+
+#include <cstring>
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	unsigned int                     GLStateCache::sProgram                                                          = GLStateCache::kUnknown;
+	unsigned int                     GLStateCache::sVertexArray                                                      = GLStateCache::kUnknown;
+
+	// The arrays start zeroed, which matches a fresh context - Invalidate() is called once the context exists anyway
+	unsigned int                     GLStateCache::sBufferBindings[(unsigned int)GLStateCache::BufferTargetSlot::Count];
+	unsigned int                     GLStateCache::sShaderStorageBindings[GLStateCache::kMaxIndexedBufferBindings];
+	unsigned int                     GLStateCache::sUniformBufferBindings[GLStateCache::kMaxIndexedBufferBindings];
+
+	unsigned int                     GLStateCache::sActiveTextureUnit                                                = GLStateCache::kUnknown;
+	unsigned int                     GLStateCache::sTextureBindings[GLStateCache::kMaxTextureUnits][2];
+
+	GLStateCache::ImageUnitBinding   GLStateCache::sImageUnits[GLStateCache::kMaxImageUnits];
+
+	unsigned int                     GLStateCache::sDrawFramebuffer                                                  = GLStateCache::kUnknown;
+	unsigned int                     GLStateCache::sReadFramebuffer                                                  = GLStateCache::kUnknown;
+
+	int                              GLStateCache::sViewport[4]                                                      = { -1, -1, -1, -1 };
+
+	int                              GLStateCache::sCapabilities[(unsigned int)GLStateCache::CapabilitySlot::Count];
+
+	GLenum                           GLStateCache::sDepthFunction                                                    = GLStateCache::kUnknown;
+	GLenum                           GLStateCache::sBlendSFactor                                                     = GLStateCache::kUnknown;
+	GLenum                           GLStateCache::sBlendDFactor                                                     = GLStateCache::kUnknown;
+	GLenum                           GLStateCache::sCullFaceMode                                                     = GLStateCache::kUnknown;
+	GLenum                           GLStateCache::sPolygonMode                                                      = GLStateCache::kUnknown;
+	int                              GLStateCache::sPatchVertices                                                    = -1;
+
+	GLStateCallCounts                GLStateCache::sCurrentFrameCounts                                               = {};
+	GLStateCallCounts                GLStateCache::sLastFrameCounts                                                  = {};
+
+	// ---------------------------------------
+
+	unsigned int GLStateCallCounts::GetTotalIssued() const
+	{
+		unsigned int total = 0;
+
+		for (unsigned int i = 0; i < (unsigned int)GLStateCategory::Count; i++)
+		{
+			total += mIssued[i];
+		}
+
+		return total;
+	}
+
+	// ---------------------------------------
+
+	unsigned int GLStateCallCounts::GetTotalElided() const
+	{
+		unsigned int total = 0;
+
+		for (unsigned int i = 0; i < (unsigned int)GLStateCategory::Count; i++)
+		{
+			total += mElided[i];
+		}
+
+		return total;
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::CountCall(GLStateCategory category, bool issued)
+	{
+		if (issued)
+			sCurrentFrameCounts.mIssued[(unsigned int)category]++;
+		else
+			sCurrentFrameCounts.mElided[(unsigned int)category]++;
+	}
+
+	// ---------------------------------------
+
+	GLStateCache::BufferTargetSlot GLStateCache::GetBufferTargetSlot(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER:             return BufferTargetSlot::Array;
+		case GL_ELEMENT_ARRAY_BUFFER:     return BufferTargetSlot::ElementArray;
+		case GL_SHADER_STORAGE_BUFFER:    return BufferTargetSlot::ShaderStorage;
+		case GL_UNIFORM_BUFFER:           return BufferTargetSlot::Uniform;
+		case GL_DRAW_INDIRECT_BUFFER:     return BufferTargetSlot::DrawIndirect;
+		case GL_DISPATCH_INDIRECT_BUFFER: return BufferTargetSlot::DispatchIndirect;
+		case GL_PARAMETER_BUFFER:         return BufferTargetSlot::Parameter;
+		case GL_PIXEL_PACK_BUFFER:        return BufferTargetSlot::PixelPack;
+		case GL_PIXEL_UNPACK_BUFFER:      return BufferTargetSlot::PixelUnpack;
+		case GL_COPY_READ_BUFFER:         return BufferTargetSlot::CopyRead;
+		case GL_COPY_WRITE_BUFFER:        return BufferTargetSlot::CopyWrite;
+
+		default:
+		return BufferTargetSlot::None;
+		}
+	}
+
+	// ---------------------------------------
+
+	GLStateCache::CapabilitySlot GLStateCache::GetCapabilitySlot(GLenum capability)
+	{
+		switch (capability)
+		{
+		case GL_DEPTH_TEST:                  return CapabilitySlot::DepthTest;
+		case GL_BLEND:                       return CapabilitySlot::Blend;
+		case GL_CULL_FACE:                   return CapabilitySlot::CullFace;
+		case GL_TEXTURE_CUBE_MAP_SEAMLESS:   return CapabilitySlot::TextureCubeMapSeamless;
+
+		default:
+		return CapabilitySlot::None;
+		}
+	}
+
+	// ---------------------------------------
+
+	unsigned int GLStateCache::GetTextureTargetSlot(GLenum target)
+	{
+		return target == GL_TEXTURE_CUBE_MAP ? 1 : 0;
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::BindProgram(unsigned int programID)
+	{
+		if (programID == sProgram)
+		{
+			CountCall(GLStateCategory::Program, false);
+			return;
+		}
+
+		sProgram = programID;
+		glUseProgram(programID);
+
+		CountCall(GLStateCategory::Program, true);
+	}
+
+	// ---------------------------------------
+
+	unsigned int GLStateCache::GetBoundProgram()
+	{
+		return sProgram == kUnknown ? 0 : sProgram;
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::BindVertexArray(unsigned int vaoID)
+	{
+		if (vaoID == sVertexArray)
+		{
+			CountCall(GLStateCategory::VertexArray, false);
+			return;
+		}
+
+		sVertexArray = vaoID;
+		glBindVertexArray(vaoID);
+
+		// The new VAO brings its own element array binding with it, which is not tracked per VAO
+		sBufferBindings[(unsigned int)BufferTargetSlot::ElementArray] = kUnknown;
+
+		CountCall(GLStateCategory::VertexArray, true);
+	}
+
+	// ---------------------------------------
+
+	unsigned int GLStateCache::GetBoundVertexArray()
+	{
+		return sVertexArray == kUnknown ? 0 : sVertexArray;
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::BindBuffer(GLenum target, unsigned int bufferID)
+	{
+		BufferTargetSlot slot = GetBufferTargetSlot(target);
+
+		if (slot != BufferTargetSlot::None)
+		{
+			if (sBufferBindings[(unsigned int)slot] == bufferID)
+			{
+				CountCall(GLStateCategory::Buffer, false);
+				return;
+			}
+
+			sBufferBindings[(unsigned int)slot] = bufferID;
+		}
+
+		glBindBuffer(target, bufferID);
+
+		CountCall(GLStateCategory::Buffer, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::BindBufferBase(GLenum target, unsigned int index, unsigned int bufferID)
+	{
+		unsigned int* indexedBindings = nullptr;
+
+		if (index < kMaxIndexedBufferBindings)
+		{
+			if (target == GL_SHADER_STORAGE_BUFFER)
+				indexedBindings = sShaderStorageBindings;
+			else if (target == GL_UNIFORM_BUFFER)
+				indexedBindings = sUniformBufferBindings;
+		}
+
+		if (indexedBindings)
+		{
+			if (indexedBindings[index] == bufferID)
+			{
+				CountCall(GLStateCategory::IndexedBuffer, false);
+				return;
+			}
+
+			indexedBindings[index] = bufferID;
+		}
+
+		glBindBufferBase(target, index, bufferID);
+
+		// Binding to an index also replaces the generic binding for the target
+		BufferTargetSlot slot = GetBufferTargetSlot(target);
+		if (slot != BufferTargetSlot::None)
+		{
+			sBufferBindings[(unsigned int)slot] = bufferID;
+		}
+
+		CountCall(GLStateCategory::IndexedBuffer, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::BindTexture(unsigned int textureUnit, GLenum target, unsigned int textureID)
+	{
+		if (textureUnit >= kMaxTextureUnits)
+			return;
+
+		// Before the elision check, so a texture left bound across frames still counts as used
+		TextureResidency::OnBind(textureID);
+
+		unsigned int& binding = sTextureBindings[textureUnit][GetTextureTargetSlot(target)];
+
+		if (binding == textureID)
+		{
+			CountCall(GLStateCategory::Texture, false);
+			return;
+		}
+
+		binding = textureID;
+
+		if (sActiveTextureUnit != textureUnit)
+		{
+			sActiveTextureUnit = textureUnit;
+			glActiveTexture(GL_TEXTURE0 + textureUnit);
+		}
+
+		glBindTexture(target, textureID);
+
+		CountCall(GLStateCategory::Texture, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::BindTextureForUpdate(unsigned int textureUnit, GLenum target, unsigned int textureID)
+	{
+		if (textureUnit >= kMaxTextureUnits)
+			return;
+
+		BindTexture(textureUnit, target, textureID);
+
+		if (sActiveTextureUnit != textureUnit)
+		{
+			sActiveTextureUnit = textureUnit;
+			glActiveTexture(GL_TEXTURE0 + textureUnit);
+		}
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::ForceBindTexture(unsigned int textureUnit, GLenum target, unsigned int textureID)
+	{
+		if (textureUnit >= kMaxTextureUnits)
+			return;
+
+		sActiveTextureUnit = textureUnit;
+		glActiveTexture(GL_TEXTURE0 + textureUnit);
+
+		sTextureBindings[textureUnit][GetTextureTargetSlot(target)] = textureID;
+		glBindTexture(target, textureID);
+
+		CountCall(GLStateCategory::Texture, true);
+	}
+
+	// ---------------------------------------
+
+	unsigned int GLStateCache::GetBoundTexture(unsigned int textureUnit, GLenum target)
+	{
+		if (textureUnit >= kMaxTextureUnits)
+			return 0;
+
+		unsigned int binding = sTextureBindings[textureUnit][GetTextureTargetSlot(target)];
+
+		return binding == kUnknown ? 0 : binding;
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::BindImageTexture(unsigned int imageUnit, unsigned int textureID, int level, bool layered, int layer, GLenum access, GLenum format)
+	{
+		TextureResidency::OnBind(textureID);
+
+		if (imageUnit < kMaxImageUnits)
+		{
+			ImageUnitBinding& binding = sImageUnits[imageUnit];
+
+			if (binding.mTextureID == textureID &&
+				binding.mLevel     == level     &&
+				binding.mLayered   == layered   &&
+				binding.mLayer     == layer     &&
+				binding.mAccess    == access    &&
+				binding.mFormat    == format)
+			{
+				CountCall(GLStateCategory::ImageUnit, false);
+				return;
+			}
+
+			binding.mTextureID = textureID;
+			binding.mLevel     = level;
+			binding.mLayered   = layered;
+			binding.mLayer     = layer;
+			binding.mAccess    = access;
+			binding.mFormat    = format;
+		}
+
+		glBindImageTexture(imageUnit, textureID, level, layered, layer, access, format);
+
+		CountCall(GLStateCategory::ImageUnit, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::BindFramebuffer(GLenum target, unsigned int framebufferID)
+	{
+		bool setDraw = (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER) && sDrawFramebuffer != framebufferID;
+		bool setRead = (target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER) && sReadFramebuffer != framebufferID;
+
+		if (!setDraw && !setRead)
+		{
+			CountCall(GLStateCategory::Framebuffer, false);
+			return;
+		}
+
+		// Only one half differing is still a single call when both were asked for
+		if (setDraw && setRead)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+		}
+		else
+		{
+			glBindFramebuffer(setDraw ? GL_DRAW_FRAMEBUFFER : GL_READ_FRAMEBUFFER, framebufferID);
+		}
+
+		if (setDraw)
+			sDrawFramebuffer = framebufferID;
+
+		if (setRead)
+			sReadFramebuffer = framebufferID;
+
+		CountCall(GLStateCategory::Framebuffer, true);
+	}
+
+	// ---------------------------------------
+
+	unsigned int GLStateCache::GetBoundFramebuffer(GLenum target)
+	{
+		bool          reading = target == GL_READ_FRAMEBUFFER;
+		unsigned int& binding = reading ? sReadFramebuffer : sDrawFramebuffer;
+
+		if (binding == kUnknown)
+		{
+			GLint boundFramebuffer = 0;
+			glGetIntegerv(reading ? GL_READ_FRAMEBUFFER_BINDING : GL_DRAW_FRAMEBUFFER_BINDING, &boundFramebuffer);
+
+			binding = (unsigned int)boundFramebuffer;
+		}
+
+		return binding;
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::SetViewport(int x, int y, int width, int height)
+	{
+		if (sViewport[0] == x && sViewport[1] == y && sViewport[2] == width && sViewport[3] == height)
+		{
+			CountCall(GLStateCategory::Viewport, false);
+			return;
+		}
+
+		sViewport[0] = x;
+		sViewport[1] = y;
+		sViewport[2] = width;
+		sViewport[3] = height;
+
+		glViewport(x, y, width, height);
+
+		CountCall(GLStateCategory::Viewport, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::GetViewport(int viewport[4])
+	{
+		if (sViewport[2] < 0)
+		{
+			glGetIntegerv(GL_VIEWPORT, sViewport);
+		}
+
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			viewport[i] = sViewport[i];
+		}
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::SetCapability(GLenum capability, bool enabled)
+	{
+		CapabilitySlot slot = GetCapabilitySlot(capability);
+
+		if (slot != CapabilitySlot::None)
+		{
+			if (sCapabilities[(unsigned int)slot] == (enabled ? 1 : 0))
+			{
+				CountCall(GLStateCategory::RasterState, false);
+				return;
+			}
+
+			sCapabilities[(unsigned int)slot] = enabled ? 1 : 0;
+		}
+
+		if (enabled)
+			glEnable(capability);
+		else
+			glDisable(capability);
+
+		CountCall(GLStateCategory::RasterState, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::SetDepthFunction(GLenum function)
+	{
+		if (function == sDepthFunction)
+		{
+			CountCall(GLStateCategory::RasterState, false);
+			return;
+		}
+
+		sDepthFunction = function;
+		glDepthFunc(function);
+
+		CountCall(GLStateCategory::RasterState, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::SetBlendFunction(GLenum sFactor, GLenum dFactor)
+	{
+		if (sFactor == sBlendSFactor && dFactor == sBlendDFactor)
+		{
+			CountCall(GLStateCategory::RasterState, false);
+			return;
+		}
+
+		sBlendSFactor = sFactor;
+		sBlendDFactor = dFactor;
+		glBlendFunc(sFactor, dFactor);
+
+		CountCall(GLStateCategory::RasterState, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::SetCullFaceMode(GLenum mode)
+	{
+		if (mode == sCullFaceMode)
+		{
+			CountCall(GLStateCategory::RasterState, false);
+			return;
+		}
+
+		sCullFaceMode = mode;
+		glCullFace(mode);
+
+		CountCall(GLStateCategory::RasterState, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::SetPolygonMode(GLenum mode)
+	{
+		if (mode == sPolygonMode)
+		{
+			CountCall(GLStateCategory::RasterState, false);
+			return;
+		}
+
+		sPolygonMode = mode;
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+
+		CountCall(GLStateCategory::RasterState, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::SetPatchVertices(int vertexCount)
+	{
+		if (vertexCount == sPatchVertices)
+		{
+			CountCall(GLStateCategory::RasterState, false);
+			return;
+		}
+
+		sPatchVertices = vertexCount;
+		glPatchParameteri(GL_PATCH_VERTICES, vertexCount);
+
+		CountCall(GLStateCategory::RasterState, true);
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::OnBufferDeleted(unsigned int bufferID)
+	{
+		if (bufferID == 0)
+			return;
+
+		for (unsigned int i = 0; i < (unsigned int)BufferTargetSlot::Count; i++)
+		{
+			if (sBufferBindings[i] == bufferID)
+				sBufferBindings[i] = 0;
+		}
+
+		for (unsigned int i = 0; i < kMaxIndexedBufferBindings; i++)
+		{
+			if (sShaderStorageBindings[i] == bufferID)
+				sShaderStorageBindings[i] = 0;
+
+			if (sUniformBufferBindings[i] == bufferID)
+				sUniformBufferBindings[i] = 0;
+		}
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::OnVertexArrayDeleted(unsigned int vaoID)
+	{
+		if (vaoID != 0 && sVertexArray == vaoID)
+		{
+			sVertexArray = 0;
+			sBufferBindings[(unsigned int)BufferTargetSlot::ElementArray] = kUnknown;
+		}
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::OnTextureDeleted(unsigned int textureID)
+	{
+		if (textureID == 0)
+			return;
+
+		for (unsigned int i = 0; i < kMaxTextureUnits; i++)
+		{
+			for (unsigned int j = 0; j < 2; j++)
+			{
+				if (sTextureBindings[i][j] == textureID)
+					sTextureBindings[i][j] = 0;
+			}
+		}
+
+		// Image units keep their other parameters, so force the next bind through
+		for (unsigned int i = 0; i < kMaxImageUnits; i++)
+		{
+			if (sImageUnits[i].mTextureID == textureID)
+				sImageUnits[i].mTextureID = kUnknown;
+		}
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::OnFramebufferDeleted(unsigned int framebufferID)
+	{
+		if (framebufferID == 0)
+			return;
+
+		if (sDrawFramebuffer == framebufferID)
+			sDrawFramebuffer = 0;
+
+		if (sReadFramebuffer == framebufferID)
+			sReadFramebuffer = 0;
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::OnProgramDeleted(unsigned int programID)
+	{
+		// A bound program stays in use until something else is bound, but its name must not be trusted after that
+		if (programID != 0 && sProgram == programID)
+			sProgram = kUnknown;
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::Invalidate()
+	{
+		sProgram           = kUnknown;
+		sVertexArray       = kUnknown;
+		sActiveTextureUnit = kUnknown;
+		sDrawFramebuffer   = kUnknown;
+		sReadFramebuffer   = kUnknown;
+
+		for (unsigned int i = 0; i < (unsigned int)BufferTargetSlot::Count; i++)
+		{
+			sBufferBindings[i] = kUnknown;
+		}
+
+		for (unsigned int i = 0; i < kMaxIndexedBufferBindings; i++)
+		{
+			sShaderStorageBindings[i] = kUnknown;
+			sUniformBufferBindings[i] = kUnknown;
+		}
+
+		for (unsigned int i = 0; i < kMaxTextureUnits; i++)
+		{
+			sTextureBindings[i][0] = kUnknown;
+			sTextureBindings[i][1] = kUnknown;
+		}
+
+		for (unsigned int i = 0; i < kMaxImageUnits; i++)
+		{
+			sImageUnits[i].mTextureID = kUnknown;
+		}
+
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			sViewport[i] = -1;
+		}
+
+		for (unsigned int i = 0; i < (unsigned int)CapabilitySlot::Count; i++)
+		{
+			sCapabilities[i] = -1;
+		}
+
+		sDepthFunction = kUnknown;
+		sBlendSFactor  = kUnknown;
+		sBlendDFactor  = kUnknown;
+		sCullFaceMode  = kUnknown;
+		sPolygonMode   = kUnknown;
+		sPatchVertices = -1;
+	}
+
+	// ---------------------------------------
+
+	void GLStateCache::BeginFrame()
+	{
+		sLastFrameCounts = sCurrentFrameCounts;
+
+		std::memset(&sCurrentFrameCounts, 0, sizeof(GLStateCallCounts));
+	}
+
+	// ---------------------------------------
+
+	const GLStateCallCounts& GLStateCache::GetLastFrameCounts()
+	{
+		return sLastFrameCounts;
+	}
+
+	// ---------------------------------------
+
+	const char* GLStateCache::GetCategoryName(GLStateCategory category)
+	{
+		switch (category)
+		{
+		case GLStateCategory::Program:       return "Program";
+		case GLStateCategory::VertexArray:   return "Vertex array";
+		case GLStateCategory::Buffer:        return "Buffer";
+		case GLStateCategory::IndexedBuffer: return "Indexed buffer";
+		case GLStateCategory::Texture:       return "Texture";
+		case GLStateCategory::ImageUnit:     return "Image unit";
+		case GLStateCategory::Framebuffer:   return "Framebuffer";
+		case GLStateCategory::Viewport:      return "Viewport";
+		case GLStateCategory::RasterState:   return "Raster state";
+
+		default:
+		return "Unknown";
+		}
+	}
+
+	// ---------------------------------------
+}
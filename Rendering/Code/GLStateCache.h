@@ -0,0 +1,200 @@
+#pragma once
+
+#include <glad/glad.h>
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	// Groups used for the per-frame issued/elided counters
+	enum class GLStateCategory : unsigned int
+	{
+		Program = 0,
+		VertexArray,
+		Buffer,
+		IndexedBuffer,
+		Texture,
+		ImageUnit,
+		Framebuffer,
+		Viewport,
+		RasterState,
+
+		Count
+	};
+
+	// ---------------------------------------
+
+	struct GLStateCallCounts
+	{
+		unsigned int mIssued[(unsigned int)GLStateCategory::Count];
+		unsigned int mElided[(unsigned int)GLStateCategory::Count];
+
+		unsigned int GetTotalIssued() const;
+		unsigned int GetTotalElided() const;
+	};
+
+	// ---------------------------------------
+
+	// Shadow copy of the GL binding and raster state for the one context the application uses
+	// Every bind/enable in the renderer goes through here so that calls which would not change anything never reach the driver
+	// Static in the same way as TrackingData so that the header only buffer wrappers can use it without a pipeline pointer
+	class GLStateCache final
+	{
+	public:
+		static const unsigned int kMaxTextureUnits          = 32;
+		static const unsigned int kMaxImageUnits            = 8;
+		static const unsigned int kMaxIndexedBufferBindings = 16;
+
+		// ---------------------------------------
+
+		static void         BindProgram(unsigned int programID);
+		static unsigned int GetBoundProgram();
+
+		// Changing the VAO also changes the element array binding, which is stored in the VAO
+		static void         BindVertexArray(unsigned int vaoID);
+		static unsigned int GetBoundVertexArray();
+
+		// Targets without a cache slot are passed straight through
+		static void         BindBuffer(GLenum target, unsigned int bufferID);
+
+		// Only GL_SHADER_STORAGE_BUFFER and GL_UNIFORM_BUFFER are tracked per index, the generic binding is updated as well
+		static void         BindBufferBase(GLenum target, unsigned int index, unsigned int bufferID);
+
+		// textureUnit is the index of the unit (0 for GL_TEXTURE0), target is GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+		static void         BindTexture(unsigned int textureUnit, GLenum target, unsigned int textureID);
+
+		// For binds followed by glTexImage2D, glTexParameter and the like, which act on the active unit rather than the one named here
+		// BindTexture can skip the bind and leave another unit active, this always leaves textureUnit active
+		static void         BindTextureForUpdate(unsigned int textureUnit, GLenum target, unsigned int textureID);
+
+		// Issues both the unit selection and the bind whatever the cache holds, and records the result
+		static void         ForceBindTexture(unsigned int textureUnit, GLenum target, unsigned int textureID);
+		static unsigned int GetBoundTexture(unsigned int textureUnit, GLenum target);
+
+		static void         BindImageTexture(unsigned int imageUnit, unsigned int textureID, int level, bool layered, int layer, GLenum access, GLenum format);
+
+		// GL_FRAMEBUFFER sets both the draw and read bindings
+		static void         BindFramebuffer(GLenum target, unsigned int framebufferID);
+
+		// GL_DRAW_FRAMEBUFFER or GL_READ_FRAMEBUFFER - asks GL if the binding is not known, so the result can always be bound back
+		static unsigned int GetBoundFramebuffer(GLenum target);
+
+		static void         SetViewport(int x, int y, int width, int height);
+
+		// Asks GL if the viewport is not known, the same as GetBoundFramebuffer
+		static void         GetViewport(int viewport[4]);
+
+		// Depth test, blending, back face culling and seamless cube maps are cached - anything else is passed straight through
+		static void         SetCapability(GLenum capability, bool enabled);
+
+		static void         SetDepthFunction(GLenum function);
+		static void         SetBlendFunction(GLenum sFactor, GLenum dFactor);
+		static void         SetCullFaceMode(GLenum mode);
+		static void         SetPolygonMode(GLenum mode);
+		static void         SetPatchVertices(int vertexCount);
+
+		// ---------------------------------------
+
+		// GL resets any binding of a deleted object to zero, so the shadow copy has to do the same or a recycled name would be skipped
+		static void         OnBufferDeleted(unsigned int bufferID);
+		static void         OnVertexArrayDeleted(unsigned int vaoID);
+		static void         OnTextureDeleted(unsigned int textureID);
+		static void         OnFramebufferDeleted(unsigned int framebufferID);
+		static void         OnProgramDeleted(unsigned int programID);
+
+		// Forgets everything, so the next call of every kind is issued - for after code that changes state behind the cache's back
+		static void         Invalidate();
+
+		// ---------------------------------------
+
+		// Moves the counts for the frame just finished into the last-frame slot and starts counting again
+		static void                     BeginFrame();
+		static const GLStateCallCounts& GetLastFrameCounts();
+
+		static const char*              GetCategoryName(GLStateCategory category);
+
+	private:
+		// Sentinel that no real GL name or enum matches, so the next call is always issued
+		static const unsigned int kUnknown = 0xFFFFFFFF;
+
+		enum class BufferTargetSlot : unsigned int
+		{
+			Array = 0,
+			ElementArray,
+			ShaderStorage,
+			Uniform,
+			DrawIndirect,
+			DispatchIndirect,
+			Parameter,
+			PixelPack,
+			PixelUnpack,
+			CopyRead,
+			CopyWrite,
+
+			Count,
+			None
+		};
+
+		enum class CapabilitySlot : unsigned int
+		{
+			DepthTest = 0,
+			Blend,
+			CullFace,
+			TextureCubeMapSeamless,
+
+			Count,
+			None
+		};
+
+		struct ImageUnitBinding
+		{
+			unsigned int mTextureID;
+			int          mLevel;
+			int          mLayer;
+			GLenum       mAccess;
+			GLenum       mFormat;
+			bool         mLayered;
+		};
+
+		static BufferTargetSlot GetBufferTargetSlot(GLenum target);
+		static CapabilitySlot   GetCapabilitySlot(GLenum capability);
+		static unsigned int     GetTextureTargetSlot(GLenum target);
+
+		static void             CountCall(GLStateCategory category, bool issued);
+
+		// ---------------------------------------
+
+		static unsigned int      sProgram;
+		static unsigned int      sVertexArray;
+
+		static unsigned int      sBufferBindings[(unsigned int)BufferTargetSlot::Count];
+		static unsigned int      sShaderStorageBindings[kMaxIndexedBufferBindings];
+		static unsigned int      sUniformBufferBindings[kMaxIndexedBufferBindings];
+
+		// Texture units keep a separate binding per target, [unit][0] is 2D and [unit][1] is the cube map
+		static unsigned int      sActiveTextureUnit;
+		static unsigned int      sTextureBindings[kMaxTextureUnits][2];
+
+		static ImageUnitBinding  sImageUnits[kMaxImageUnits];
+
+		static unsigned int      sDrawFramebuffer;
+		static unsigned int      sReadFramebuffer;
+
+		static int               sViewport[4];
+
+		// -1 for unknown, otherwise 0 or 1
+		static int               sCapabilities[(unsigned int)CapabilitySlot::Count];
+
+		static GLenum            sDepthFunction;
+		static GLenum            sBlendSFactor;
+		static GLenum            sBlendDFactor;
+		static GLenum            sCullFaceMode;
+		static GLenum            sPolygonMode;
+		static int               sPatchVertices;
+
+		static GLStateCallCounts sCurrentFrameCounts;
+		static GLStateCallCounts sLastFrameCounts;
+	};
+
+	// ---------------------------------------
+}
@@ -0,0 +1,315 @@
+#include "GridMesh.h"
+
+#include "Maths/Code/Parallel.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+	#include <xmmintrin.h>
+	#define GRID_MESH_USE_SSE
+#endif
+
+namespace Rendering
+{
+	// ---------------------------------------------
+
+	static const char         kGridMeshCacheDirectory[] = "MeshCache/";
+	static const char         kGridMeshCacheMagic[4]    = { 'W', 'G', 'M', 'C' };
+
+	// Bump this whenever the file layout changes
+	static const unsigned int kGridMeshCacheFileVersion = 1;
+
+	// Bump this whenever the order of the generated indicies changes (batching, optimiser tweaks etc)
+	static const unsigned int kGridIndexLayoutVersion   = 1;
+
+	// ---------------------------------------------
+
+	struct GridMeshCacheHeader
+	{
+		char         mMagic[4];
+		unsigned int mFileVersion;
+		unsigned int mIndexLayout;
+		unsigned int mDimensions;
+		float        mDistanceBetweenVerticies;
+		unsigned int mVertexCount;
+		unsigned int mIndexCount;
+		unsigned int mBatchCount;
+	};
+
+	// ---------------------------------------------
+
+	static unsigned int GetIndexLayoutKey()
+	{
+		return (kGridIndexLayoutVersion << 16) | MeshOptimisation::kDefaultPostTransformCacheSize;
+	}
+
+	// ---------------------------------------------
+
+	// The batches must tile the whole index buffer, and every index has to land inside the vertex buffer once its batch's base vertex is added
+	static bool CachedIndiciesAreValid(const unsigned short* indicies, unsigned int indexCount, const std::vector<MeshOptimisation::IndexBatch>& batches, unsigned int vertexCount)
+	{
+		unsigned int nextIndex = 0;
+
+		for (const MeshOptimisation::IndexBatch& batch : batches)
+		{
+			if (batch.mFirstIndex != nextIndex || batch.mIndexCount > indexCount - nextIndex || batch.mBaseVertex < 0)
+				return false;
+
+			const size_t batchVertexEnd = (size_t)batch.mBaseVertex + batch.mVertexCount;
+
+			if (batchVertexEnd > vertexCount)
+				return false;
+
+			for (unsigned int i = batch.mFirstIndex; i < batch.mFirstIndex + batch.mIndexCount; i++)
+			{
+				if (indicies[i] >= batch.mVertexCount)
+					return false;
+			}
+
+			nextIndex += batch.mIndexCount;
+		}
+
+		return nextIndex == indexCount;
+	}
+
+	// ---------------------------------------------
+
+	GridMesh::GridMesh()
+		: mVertexData(nullptr)
+		, mIndexData(nullptr)
+		, mVertexCount(0)
+		, mIndexCount(0)
+		, mBatches()
+		, mGeneratedVertexData()
+		, mGeneratedIndexData()
+		, mCacheFile()
+		, mLoadedFromCache(false)
+	{
+
+	}
+
+	// ---------------------------------------------
+
+	GridMesh::~GridMesh()
+	{
+		Release();
+	}
+
+	// ---------------------------------------------
+
+	void GridMesh::Release()
+	{
+		mCacheFile.Close();
+
+		mGeneratedVertexData.clear();
+		mGeneratedVertexData.shrink_to_fit();
+
+		mGeneratedIndexData.clear();
+		mGeneratedIndexData.shrink_to_fit();
+
+		mVertexData = nullptr;
+		mIndexData  = nullptr;
+	}
+
+	// ---------------------------------------------
+
+	std::string GridMesh::GetCacheFilePath(unsigned int dimensions, float distanceBetweenVerticies)
+	{
+		// The spacing is keyed by its bit pattern so that no precision is lost in the file name
+		unsigned int spacingBits = 0;
+		std::memcpy(&spacingBits, &distanceBetweenVerticies, sizeof(float));
+
+		std::stringstream path;
+		path << kGridMeshCacheDirectory << "Grid_" << dimensions << "_" << std::hex << std::setw(8) << std::setfill('0') << spacingBits << "_" << std::setw(8) << GetIndexLayoutKey() << ".mesh";
+
+		return path.str();
+	}
+
+	// ---------------------------------------------
+
+	void GridMesh::Create(unsigned int dimensions, float distanceBetweenVerticies)
+	{
+		Release();
+
+		std::string filePath = GetCacheFilePath(dimensions, distanceBetweenVerticies);
+
+		mLoadedFromCache = LoadFromCache(filePath, dimensions, distanceBetweenVerticies);
+
+		if (mLoadedFromCache)
+			return;
+
+		mVertexCount = (dimensions + 1) * (dimensions + 1);
+
+		mGeneratedVertexData.resize((size_t)mVertexCount * 2);
+		GenerateVertexData(dimensions, distanceBetweenVerticies, mGeneratedVertexData.data());
+
+		MeshOptimisation::GenerateGridIndexBatches(dimensions, true, mGeneratedIndexData, mBatches);
+
+		mIndexCount = (unsigned int)mGeneratedIndexData.size();
+		mVertexData = mGeneratedVertexData.data();
+		mIndexData  = mGeneratedIndexData.data();
+
+		WriteToCache(filePath, dimensions, distanceBetweenVerticies);
+	}
+
+	// ---------------------------------------------
+
+	void GridMesh::GenerateVertexData(unsigned int dimensions, float distanceBetweenVerticies, float* output)
+	{
+		const unsigned int verticiesPerRow            = dimensions + 1;
+		const unsigned int halfDimensions             = dimensions / 2;
+		const float        startingDistanceFromCentre = halfDimensions * distanceBetweenVerticies;
+
+		Engine::Parallel::ParallelFor(0, verticiesPerRow, 64, [=](unsigned int rowStart, unsigned int rowEnd)
+		{
+			for (unsigned int row = rowStart; row < rowEnd; row++)
+			{
+				// Rows are stored in reverse Z order to get the winding order correct
+				const unsigned int z       = dimensions - row;
+				const float        zPos    = -startingDistanceFromCentre + (z * distanceBetweenVerticies);
+				float*             rowData = output + ((size_t)row * verticiesPerRow * 2);
+
+				unsigned int x = 0;
+
+#ifdef GRID_MESH_USE_SSE
+				// Two verticies per register, laid out as (x0, z, x1, z)
+				const __m128 offset    = _mm_setr_ps(-startingDistanceFromCentre, zPos, -startingDistanceFromCentre, zPos);
+				const __m128 scale     = _mm_setr_ps(distanceBetweenVerticies, 0.0f, distanceBetweenVerticies, 0.0f);
+				const __m128 increment = _mm_setr_ps(4.0f, 0.0f, 4.0f, 0.0f);
+
+				__m128 indexFirstPair  = _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f);
+				__m128 indexSecondPair = _mm_setr_ps(2.0f, 0.0f, 3.0f, 0.0f);
+
+				for (; x + 4 <= verticiesPerRow; x += 4)
+				{
+					_mm_storeu_ps(rowData + (x * 2),       _mm_add_ps(offset, _mm_mul_ps(indexFirstPair,  scale)));
+					_mm_storeu_ps(rowData + (x * 2) + 4,   _mm_add_ps(offset, _mm_mul_ps(indexSecondPair, scale)));
+
+					indexFirstPair  = _mm_add_ps(indexFirstPair,  increment);
+					indexSecondPair = _mm_add_ps(indexSecondPair, increment);
+				}
+#endif
+
+				for (; x < verticiesPerRow; x++)
+				{
+					rowData[(x * 2)]     = -startingDistanceFromCentre + (x * distanceBetweenVerticies);
+					rowData[(x * 2) + 1] = zPos;
+				}
+			}
+		});
+	}
+
+	// ---------------------------------------------
+
+	bool GridMesh::LoadFromCache(const std::string& filePath, unsigned int dimensions, float distanceBetweenVerticies)
+	{
+		if (!mCacheFile.Open(filePath))
+			return false;
+
+		const unsigned char* data      = mCacheFile.GetData();
+		size_t               sizeBytes = mCacheFile.GetSizeBytes();
+
+		if (sizeBytes < sizeof(GridMeshCacheHeader))
+		{
+			mCacheFile.Close();
+			return false;
+		}
+
+		GridMeshCacheHeader header;
+		std::memcpy(&header, data, sizeof(GridMeshCacheHeader));
+
+		const size_t batchBytes  = (size_t)header.mBatchCount  * sizeof(MeshOptimisation::IndexBatch);
+		const size_t vertexBytes = (size_t)header.mVertexCount * 2 * sizeof(float);
+		const size_t indexBytes  = (size_t)header.mIndexCount  * sizeof(unsigned short);
+
+		// Anything that does not match exactly gets regenerated
+		if (std::memcmp(header.mMagic, kGridMeshCacheMagic, sizeof(kGridMeshCacheMagic)) != 0 ||
+			header.mFileVersion              != kGridMeshCacheFileVersion ||
+			header.mIndexLayout              != GetIndexLayoutKey()       ||
+			header.mDimensions               != dimensions                ||
+			header.mDistanceBetweenVerticies != distanceBetweenVerticies  ||
+			header.mVertexCount              != (dimensions + 1) * (dimensions + 1) ||
+			header.mIndexCount               != dimensions * dimensions * 6          ||
+			sizeBytes                        != sizeof(GridMeshCacheHeader) + batchBytes + vertexBytes + indexBytes)
+		{
+			mCacheFile.Close();
+			return false;
+		}
+
+		const unsigned char* batchData = data + sizeof(GridMeshCacheHeader);
+
+		mBatches.resize(header.mBatchCount);
+		std::memcpy(mBatches.data(), batchData, batchBytes);
+
+		// The header and batch table are multiples of four bytes, so the vertex data is correctly aligned within the mapping
+		mVertexCount = header.mVertexCount;
+		mIndexCount  = header.mIndexCount;
+		mVertexData  = (const float*)(batchData + batchBytes);
+		mIndexData   = (const unsigned short*)(batchData + batchBytes + vertexBytes);
+
+		// A corrupt index would read past the vertex buffer on the GPU, so the indicies are checked before any of them are used
+		if (!CachedIndiciesAreValid(mIndexData, mIndexCount, mBatches, mVertexCount))
+		{
+			mBatches.clear();
+
+			mVertexData  = nullptr;
+			mIndexData   = nullptr;
+			mVertexCount = 0;
+			mIndexCount  = 0;
+
+			mCacheFile.Close();
+			return false;
+		}
+
+		return true;
+	}
+
+	// ---------------------------------------------
+
+	void GridMesh::WriteToCache(const std::string& filePath, unsigned int dimensions, float distanceBetweenVerticies)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(kGridMeshCacheDirectory, error);
+
+		// Written to a temporary file first so that a partially written cache is never picked up
+		std::string   temporaryPath = filePath + ".tmp";
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+		if (!file.is_open())
+			return;
+
+		GridMeshCacheHeader header;
+		std::memcpy(header.mMagic, kGridMeshCacheMagic, sizeof(kGridMeshCacheMagic));
+		header.mFileVersion              = kGridMeshCacheFileVersion;
+		header.mIndexLayout              = GetIndexLayoutKey();
+		header.mDimensions               = dimensions;
+		header.mDistanceBetweenVerticies = distanceBetweenVerticies;
+		header.mVertexCount              = mVertexCount;
+		header.mIndexCount               = mIndexCount;
+		header.mBatchCount               = (unsigned int)mBatches.size();
+
+		file.write((const char*)&header,          sizeof(GridMeshCacheHeader));
+		file.write((const char*)mBatches.data(),  mBatches.size() * sizeof(MeshOptimisation::IndexBatch));
+		file.write((const char*)mVertexData,      GetVertexDataBytes());
+		file.write((const char*)mIndexData,       GetIndexDataBytes());
+
+		bool succeeded = file.good();
+
+		file.close();
+
+		if (succeeded)
+		{
+			std::filesystem::rename(temporaryPath, filePath, error);
+		}
+		else
+		{
+			std::filesystem::remove(temporaryPath, error);
+		}
+	}
+
+	// ---------------------------------------------
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Rendering/Code/MeshOptimisation.h"
+
+#include "Maths/Code/MemoryMappedFile.h"
+
+#include <vector>
+#include <string>
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	// CPU side vertex and index data for the flat grid that the water surface is displaced from
+	// Generation is split across threads and vectorised, and the result is written to a cache file so that later launches
+	// can map the file and upload straight from it instead of generating it again
+	class GridMesh final
+	{
+	public:
+		GridMesh();
+		~GridMesh();
+
+		// Loads from the cache if a matching file exists, otherwise generates the data and writes the cache
+		void                                           Create(unsigned int dimensions, float distanceBetweenVerticies);
+
+		// Frees the CPU side data - call once it has been uploaded to the GPU
+		void                                           Release();
+
+		// Interleaved X-Z pairs, one per vertex
+		const float*                                   GetVertexData()       const { return mVertexData; }
+		unsigned int                                   GetVertexCount()      const { return mVertexCount; }
+		unsigned int                                   GetVertexDataBytes()  const { return mVertexCount * 2 * sizeof(float); }
+
+		const unsigned short*                          GetIndexData()        const { return mIndexData; }
+		unsigned int                                   GetIndexCount()       const { return mIndexCount; }
+		unsigned int                                   GetIndexDataBytes()   const { return mIndexCount * sizeof(unsigned short); }
+
+		const std::vector<MeshOptimisation::IndexBatch>& GetBatches()        const { return mBatches; }
+
+		bool                                           GetLoadedFromCache()  const { return mLoadedFromCache; }
+
+		// Fills output with (dimensions + 1)^2 X-Z pairs, in the same order as the original serial generator
+		static void                                    GenerateVertexData(unsigned int dimensions, float distanceBetweenVerticies, float* output);
+
+		static std::string                             GetCacheFilePath(unsigned int dimensions, float distanceBetweenVerticies);
+
+	private:
+		bool LoadFromCache(const std::string& filePath, unsigned int dimensions, float distanceBetweenVerticies);
+		void WriteToCache(const std::string& filePath, unsigned int dimensions, float distanceBetweenVerticies);
+
+		// Pointers into either the generated vectors or the mapped cache file
+		const float*                              mVertexData;
+		const unsigned short*                     mIndexData;
+
+		unsigned int                              mVertexCount;
+		unsigned int                              mIndexCount;
+
+		std::vector<MeshOptimisation::IndexBatch> mBatches;
+
+		std::vector<float>                        mGeneratedVertexData;
+		std::vector<unsigned short>               mGeneratedIndexData;
+
+		Engine::MemoryMappedFile                  mCacheFile;
+
+		bool                                      mLoadedFromCache;
+	};
+
+	// ---------------------------------------
+}
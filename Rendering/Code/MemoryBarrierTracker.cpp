@@ -0,0 +1,193 @@
+#include "MemoryBarrierTracker.h"
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	std::unordered_map<unsigned long long, MemoryBarrierTracker::ResourceState> MemoryBarrierTracker::sResources;
+
+	MemoryBarrierTracker::PendingAccess MemoryBarrierTracker::sPendingAccesses[MemoryBarrierTracker::kMaxPendingAccesses];
+	unsigned int                        MemoryBarrierTracker::sPendingAccessCount = 0;
+	GLbitfield                          MemoryBarrierTracker::sPendingBits        = 0;
+
+	// Starts above zero so that a resource nobody has written never looks newer than a barrier
+	unsigned long long                  MemoryBarrierTracker::sEpoch              = 1;
+	unsigned long long                  MemoryBarrierTracker::sLastIssued[32]     = { 0 };
+
+	MemoryBarrierCounts                 MemoryBarrierTracker::sCurrentFrameCounts = { 0, 0 };
+	MemoryBarrierCounts                 MemoryBarrierTracker::sLastFrameCounts    = { 0, 0 };
+
+	// ---------------------------------------
+
+	unsigned long long MemoryBarrierTracker::MakeKey(GPUResourceType type, unsigned int resourceID)
+	{
+		// Textures and buffers have separate name spaces, so the same ID can be both
+		return ((unsigned long long)type << 32) | resourceID;
+	}
+
+	// ---------------------------------------
+
+	bool MemoryBarrierTracker::GetIsWrite(GPUResourceAccess access)
+	{
+		return access == GPUResourceAccess::ImageStore || access == GPUResourceAccess::StorageBufferWrite;
+	}
+
+	// ---------------------------------------
+
+	bool MemoryBarrierTracker::GetIsIncoherentRead(GPUResourceAccess access)
+	{
+		return access == GPUResourceAccess::ImageLoad || access == GPUResourceAccess::StorageBufferRead;
+	}
+
+	// ---------------------------------------
+
+	GLbitfield MemoryBarrierTracker::GetBarrierBit(GPUResourceAccess access)
+	{
+		switch (access)
+		{
+		case GPUResourceAccess::ImageStore:
+		case GPUResourceAccess::ImageLoad:          return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+
+		case GPUResourceAccess::StorageBufferWrite:
+		case GPUResourceAccess::StorageBufferRead:  return GL_SHADER_STORAGE_BARRIER_BIT;
+
+		case GPUResourceAccess::TextureFetch:       return GL_TEXTURE_FETCH_BARRIER_BIT;
+		case GPUResourceAccess::TextureUpdate:      return GL_TEXTURE_UPDATE_BARRIER_BIT;
+		case GPUResourceAccess::VertexAttribute:    return GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT;
+		case GPUResourceAccess::ElementArray:       return GL_ELEMENT_ARRAY_BARRIER_BIT;
+		case GPUResourceAccess::IndirectCommand:    return GL_COMMAND_BARRIER_BIT;
+		case GPUResourceAccess::UniformRead:        return GL_UNIFORM_BARRIER_BIT;
+		case GPUResourceAccess::BufferUpdate:       return GL_BUFFER_UPDATE_BARRIER_BIT;
+
+		default:                                    return GL_ALL_BARRIER_BITS;
+		}
+	}
+
+	// ---------------------------------------
+
+	unsigned long long MemoryBarrierTracker::GetLastIssued(GLbitfield barrierBit)
+	{
+		unsigned long long lastIssued = ~0ull;
+
+		// GL_ALL_BARRIER_BITS from an unknown access is only as recent as the oldest bit
+		for (unsigned int i = 0; i < 32; i++)
+		{
+			if ((barrierBit & (1u << i)) && sLastIssued[i] < lastIssued)
+				lastIssued = sLastIssued[i];
+		}
+
+		return lastIssued;
+	}
+
+	// ---------------------------------------
+
+	void MemoryBarrierTracker::Access(GPUResourceType type, unsigned int resourceID, GPUResourceAccess access)
+	{
+		if (resourceID == 0)
+			return;
+
+		unsigned long long key        = MakeKey(type, resourceID);
+		GLbitfield         barrierBit = GetBarrierBit(access);
+
+		std::unordered_map<unsigned long long, ResourceState>::iterator state = sResources.find(key);
+
+		if (state != sResources.end())
+		{
+			unsigned long long lastIssued = GetLastIssued(barrierBit);
+
+			// Read or write after an incoherent write
+			if (state->second.mLastWrite > lastIssued)
+				sPendingBits |= barrierBit;
+
+			// Write after an incoherent read - the earlier pass could still be reading when this one starts writing
+			if (GetIsWrite(access) && state->second.mLastIncoherentRead > lastIssued)
+				sPendingBits |= barrierBit;
+		}
+
+		// Only writes and incoherent reads change what later passes have to wait on
+		if (!GetIsWrite(access) && !GetIsIncoherentRead(access))
+			return;
+
+		// Should never happen with the passes in this renderer, but barriering early is only ever over-synchronising
+		if (sPendingAccessCount == kMaxPendingAccesses)
+			IssueBarriers();
+
+		sPendingAccesses[sPendingAccessCount].mResourceKey = key;
+		sPendingAccesses[sPendingAccessCount].mAccess      = access;
+		sPendingAccessCount++;
+	}
+
+	// ---------------------------------------
+
+	void MemoryBarrierTracker::ReadWriteImage(unsigned int textureID)
+	{
+		Access(GPUResourceType::Texture, textureID, GPUResourceAccess::ImageLoad);
+		Access(GPUResourceType::Texture, textureID, GPUResourceAccess::ImageStore);
+	}
+
+	// ---------------------------------------
+
+	void MemoryBarrierTracker::IssueBarriers()
+	{
+		if (sPendingBits != 0)
+		{
+			glMemoryBarrier(sPendingBits);
+
+			for (unsigned int i = 0; i < 32; i++)
+			{
+				if (sPendingBits & (1u << i))
+					sLastIssued[i] = sEpoch;
+			}
+
+			sCurrentFrameCounts.mBarriersIssued++;
+		}
+		else
+		{
+			sCurrentFrameCounts.mBarriersElided++;
+		}
+
+		sPendingBits = 0;
+
+		// This pass's accesses happen after the barrier, so they get a newer epoch than it
+		sEpoch++;
+
+		for (unsigned int i = 0; i < sPendingAccessCount; i++)
+		{
+			ResourceState& state = sResources[sPendingAccesses[i].mResourceKey];
+
+			if (GetIsWrite(sPendingAccesses[i].mAccess))
+				state.mLastWrite = sEpoch;
+			else
+				state.mLastIncoherentRead = sEpoch;
+		}
+
+		sPendingAccessCount = 0;
+	}
+
+	// ---------------------------------------
+
+	void MemoryBarrierTracker::Forget(GPUResourceType type, unsigned int resourceID)
+	{
+		sResources.erase(MakeKey(type, resourceID));
+	}
+
+	// ---------------------------------------
+
+	void MemoryBarrierTracker::Reset()
+	{
+		sResources.clear();
+
+		sPendingAccessCount = 0;
+		sPendingBits        = 0;
+	}
+
+	// ---------------------------------------
+
+	void MemoryBarrierTracker::BeginFrame()
+	{
+		sLastFrameCounts    = sCurrentFrameCounts;
+		sCurrentFrameCounts = { 0, 0 };
+	}
+
+	// ---------------------------------------
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	enum class GPUResourceType : unsigned int
+	{
+		Texture = 0,
+		Buffer
+	};
+
+	// ---------------------------------------
+
+	// How a pass touches a resource - each read maps onto the glMemoryBarrier bit that makes earlier shader writes visible to it
+	enum class GPUResourceAccess : unsigned int
+	{
+		// Incoherent shader writes, the only accesses that create hazards
+		ImageStore = 0,       // imageStore / image atomics
+		StorageBufferWrite,   // SSBO writes and atomics
+
+		// Consumers
+		ImageLoad,            // GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+		StorageBufferRead,    // GL_SHADER_STORAGE_BARRIER_BIT
+		TextureFetch,         // GL_TEXTURE_FETCH_BARRIER_BIT
+		TextureUpdate,        // GL_TEXTURE_UPDATE_BARRIER_BIT - glTexSubImage, glGenerateMipmap, glGetTexImage
+		VertexAttribute,      // GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+		ElementArray,         // GL_ELEMENT_ARRAY_BARRIER_BIT
+		IndirectCommand,      // GL_COMMAND_BARRIER_BIT
+		UniformRead,          // GL_UNIFORM_BARRIER_BIT
+		BufferUpdate,         // GL_BUFFER_UPDATE_BARRIER_BIT - glBufferSubData, glGetBufferSubData, mapping
+
+		Count
+	};
+
+	// ---------------------------------------
+
+	struct MemoryBarrierCounts
+	{
+		unsigned int mBarriersIssued;
+		unsigned int mBarriersElided;   // Passes that declared their accesses but had no outstanding hazard
+	};
+
+	// ---------------------------------------
+
+	// Tracks which resources have outstanding incoherent shader writes, so that glMemoryBarrier is only issued with the bits a pass
+	// actually needs and only when the data it reads was written since the last barrier of that kind
+	// Usage per dispatch/draw: declare every access, call IssueBarriers, then dispatch/draw
+	// Static in the same way as GLStateCache, as barriers are global to the one context
+	class MemoryBarrierTracker final
+	{
+	public:
+		static void                       Access(GPUResourceType type, unsigned int resourceID, GPUResourceAccess access);
+
+		// Shorthand for the read-modify-write image bindings used by the FFT ping-pong passes
+		static void                       ReadWriteImage(unsigned int textureID);
+
+		// Issues one glMemoryBarrier covering every hazard declared since the last call, then records this pass's writes
+		static void                       IssueBarriers();
+
+		// Drops anything known about a resource, for when its name is about to be deleted and may be recycled
+		static void                       Forget(GPUResourceType type, unsigned int resourceID);
+
+		// Assumes nothing is outstanding - for after code that issues its own barriers
+		static void                       Reset();
+
+		static void                       BeginFrame();
+		static const MemoryBarrierCounts& GetLastFrameCounts() { return sLastFrameCounts; }
+
+		static GLbitfield                 GetBarrierBit(GPUResourceAccess access);
+
+	private:
+		static const unsigned int kMaxPendingAccesses = 32;
+
+		struct ResourceState
+		{
+			unsigned long long mLastWrite;           // Epoch of the last incoherent write, zero if none
+			unsigned long long mLastIncoherentRead;  // Epoch of the last image load or SSBO read, for write-after-read
+		};
+
+		struct PendingAccess
+		{
+			unsigned long long mResourceKey;
+			GPUResourceAccess  mAccess;
+		};
+
+		static unsigned long long MakeKey(GPUResourceType type, unsigned int resourceID);
+		static bool               GetIsWrite(GPUResourceAccess access);
+		static bool               GetIsIncoherentRead(GPUResourceAccess access);
+		static unsigned long long GetLastIssued(GLbitfield barrierBit);
+
+		static std::unordered_map<unsigned long long, ResourceState> sResources;
+
+		static PendingAccess       sPendingAccesses[kMaxPendingAccesses];
+		static unsigned int        sPendingAccessCount;
+		static GLbitfield          sPendingBits;
+
+		static unsigned long long  sEpoch;
+
+		// The epoch each barrier bit was last issued at, indexed by bit position - anything written after it is still a hazard for that kind of access
+		static unsigned long long  sLastIssued[32];
+
+		static MemoryBarrierCounts sCurrentFrameCounts;
+		static MemoryBarrierCounts sLastFrameCounts;
+	};
+
+	// ---------------------------------------
+}
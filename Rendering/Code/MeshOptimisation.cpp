@@ -0,0 +1,419 @@
+#include "MeshOptimisation.h"
+
+#include "Maths/Code/AssertMsg.h"
+#include "Maths/Code/Parallel.h"
+
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+namespace Rendering
+{
+	namespace MeshOptimisation
+	{
+		// ---------------------------------------------
+		// Scoring constants from Forsyth's "Linear-Speed Vertex Cache Optimisation"
+
+		const float kCacheDecayPower   = 1.5f;
+		const float kLastTriangleScore = 0.75f;
+		const float kValenceBoostScale = 2.0f;
+		const float kValenceBoostPower = 0.5f;
+
+		// ---------------------------------------------
+
+		static float CalculateVertexScore(int cachePosition, unsigned int activeTriangleCount, unsigned int cacheSize)
+		{
+			// No triangles left to be drawn that use this vertex, so it should never be picked
+			if (activeTriangleCount == 0)
+				return -1.0f;
+
+			float score = 0.0f;
+
+			if (cachePosition >= 0)
+			{
+				if (cachePosition < 3)
+				{
+					// Used by the last triangle, so give it a fixed score to stop the same edge being used repeatedly
+					score = kLastTriangleScore;
+				}
+				else
+				{
+					// Points for being high in the cache
+					const float scaler = 1.0f / (float)(cacheSize - 3);
+
+					score = std::pow(1.0f - ((float)(cachePosition - 3) * scaler), kCacheDecayPower);
+				}
+			}
+
+			// Bonus for having few triangles left to draw, so that lone triangles are not left until the end
+			score += kValenceBoostScale * std::pow((float)activeTriangleCount, -kValenceBoostPower);
+
+			return score;
+		}
+
+		// ---------------------------------------------
+
+		void OptimiseVertexCacheOrder(unsigned short* indicies, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize)
+		{
+			ASSERTMSG(indexCount % 3 != 0, "Index data passed into the vertex cache optimiser is not a triangle list.");
+			ASSERTMSG(cacheSize <= 3,      "Vertex cache size is too small to optimise for.");
+
+			const unsigned int triangleCount = indexCount / 3;
+
+			if (triangleCount == 0 || vertexCount == 0)
+				return;
+
+			// ----------------
+			// Build the vertex -> triangle adjacency
+
+			std::vector<unsigned int> activeTriangleCount(vertexCount, 0);
+			std::vector<unsigned int> triangleListOffset(vertexCount + 1, 0);
+
+			for (unsigned int i = 0; i < indexCount; i++)
+			{
+				activeTriangleCount[indicies[i]]++;
+			}
+
+			for (unsigned int i = 0; i < vertexCount; i++)
+			{
+				triangleListOffset[i + 1] = triangleListOffset[i] + activeTriangleCount[i];
+			}
+
+			std::vector<unsigned int> vertexTriangles(indexCount);
+			std::vector<unsigned int> fillCount(vertexCount, 0);
+
+			for (unsigned int i = 0; i < indexCount; i++)
+			{
+				unsigned int vertex = indicies[i];
+
+				vertexTriangles[triangleListOffset[vertex] + fillCount[vertex]++] = i / 3;
+			}
+
+			// ----------------
+			// Initial scores
+
+			std::vector<int>   cachePosition(vertexCount, -1);
+			std::vector<float> vertexScore(vertexCount);
+
+			for (unsigned int i = 0; i < vertexCount; i++)
+			{
+				vertexScore[i] = CalculateVertexScore(-1, activeTriangleCount[i], cacheSize);
+			}
+
+			std::vector<float> triangleScore(triangleCount);
+			std::vector<bool>  triangleAdded(triangleCount, false);
+
+			int   bestTriangle      = -1;
+			float bestTriangleScore = -1.0f;
+
+			for (unsigned int i = 0; i < triangleCount; i++)
+			{
+				triangleScore[i] = vertexScore[indicies[(i * 3)]] + vertexScore[indicies[(i * 3) + 1]] + vertexScore[indicies[(i * 3) + 2]];
+
+				if (triangleScore[i] > bestTriangleScore)
+				{
+					bestTriangleScore = triangleScore[i];
+					bestTriangle      = (int)i;
+				}
+			}
+
+			// ----------------
+			// Emit the triangles one at a time, always picking the highest scoring one that touches the simulated cache
+
+			std::vector<unsigned short> output(indexCount);
+
+			// The cache is simulated as LRU, with three extra slots for the verticies being pushed in by the new triangle
+			std::vector<unsigned int> cache;
+			std::vector<unsigned int> newCache;
+			cache.reserve(cacheSize + 3);
+			newCache.reserve(cacheSize + 3);
+
+			unsigned int outputTriangleCount = 0;
+			unsigned int scanPosition        = 0;
+
+			while (outputTriangleCount < triangleCount)
+			{
+				// Nothing in the cache is connected to any remaining triangles, so find the next one that has not been drawn
+				if (bestTriangle < 0)
+				{
+					while (triangleAdded[scanPosition])
+						scanPosition++;
+
+					bestTriangle = (int)scanPosition;
+				}
+
+				const unsigned int triangle = (unsigned int)bestTriangle;
+
+				triangleAdded[triangle] = true;
+
+				newCache.clear();
+
+				for (unsigned int corner = 0; corner < 3; corner++)
+				{
+					unsigned short vertex = indicies[(triangle * 3) + corner];
+
+					output[(outputTriangleCount * 3) + corner] = vertex;
+
+					// Remove this triangle from the vertex's active list by swapping it to the end of the active range
+					unsigned int* triangles = &vertexTriangles[triangleListOffset[vertex]];
+
+					for (unsigned int i = 0; i < activeTriangleCount[vertex]; i++)
+					{
+						if (triangles[i] == triangle)
+						{
+							triangles[i]                                = triangles[activeTriangleCount[vertex] - 1];
+							triangles[activeTriangleCount[vertex] - 1] = triangle;
+							break;
+						}
+					}
+
+					activeTriangleCount[vertex]--;
+
+					newCache.push_back(vertex);
+				}
+
+				outputTriangleCount++;
+
+				// Move the rest of the old cache down behind the new triangle's verticies
+				for (unsigned int i = 0; i < cache.size(); i++)
+				{
+					unsigned int vertex = cache[i];
+
+					if (vertex != newCache[0] && vertex != newCache[1] && vertex != newCache[2])
+						newCache.push_back(vertex);
+				}
+
+				// Anything pushed past the end of the cache has been evicted
+				for (unsigned int i = cacheSize; i < newCache.size(); i++)
+				{
+					cachePosition[newCache[i]] = -1;
+					vertexScore[newCache[i]]   = CalculateVertexScore(-1, activeTriangleCount[newCache[i]], cacheSize);
+				}
+
+				if (newCache.size() > cacheSize)
+					newCache.resize(cacheSize);
+
+				for (unsigned int i = 0; i < newCache.size(); i++)
+				{
+					cachePosition[newCache[i]] = (int)i;
+					vertexScore[newCache[i]]   = CalculateVertexScore((int)i, activeTriangleCount[newCache[i]], cacheSize);
+				}
+
+				cache.swap(newCache);
+
+				// Re-score all triangles touched by the cache, and pick the best for the next iteration
+				bestTriangle      = -1;
+				bestTriangleScore = -1.0f;
+
+				for (unsigned int i = 0; i < cache.size(); i++)
+				{
+					unsigned int  vertex    = cache[i];
+					unsigned int* triangles = &vertexTriangles[triangleListOffset[vertex]];
+
+					for (unsigned int j = 0; j < activeTriangleCount[vertex]; j++)
+					{
+						unsigned int cachedTriangle = triangles[j];
+
+						triangleScore[cachedTriangle] = vertexScore[indicies[(cachedTriangle * 3)]] + vertexScore[indicies[(cachedTriangle * 3) + 1]] + vertexScore[indicies[(cachedTriangle * 3) + 2]];
+
+						if (triangleScore[cachedTriangle] > bestTriangleScore)
+						{
+							bestTriangleScore = triangleScore[cachedTriangle];
+							bestTriangle      = (int)cachedTriangle;
+						}
+					}
+				}
+			}
+
+			for (unsigned int i = 0; i < indexCount; i++)
+			{
+				indicies[i] = output[i];
+			}
+		}
+
+		// ---------------------------------------------
+
+		VertexCacheStatistics AnalyseVertexCache(const unsigned short* indicies, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize)
+		{
+			VertexCacheStatistics stats;
+
+			if (indexCount == 0 || vertexCount == 0 || cacheSize == 0)
+				return stats;
+
+			// A vertex is still in a FIFO cache if fewer than cacheSize misses have happened since it was inserted
+			std::vector<unsigned int> insertedAtMiss(vertexCount, 0);
+			std::vector<bool>         referenced(vertexCount, false);
+
+			unsigned int misses = 0;
+
+			for (unsigned int i = 0; i < indexCount; i++)
+			{
+				unsigned short vertex = indicies[i];
+
+				if (!referenced[vertex] || (misses - insertedAtMiss[vertex]) >= cacheSize)
+				{
+					if (!referenced[vertex])
+					{
+						referenced[vertex] = true;
+						stats.mVertexCount++;
+					}
+
+					insertedAtMiss[vertex] = misses;
+					misses++;
+				}
+			}
+
+			stats.mTriangleCount                 = indexCount / 3;
+			stats.mCacheMisses                   = misses;
+			stats.mAverageCacheMissRatio         = (float)misses / (float)stats.mTriangleCount;
+			stats.mAverageTransformToVertexRatio = (float)misses / (float)stats.mVertexCount;
+
+			return stats;
+		}
+
+		// ---------------------------------------------
+
+		VertexCacheStatistics AnalyseVertexCache(const unsigned short* indicies, const std::vector<IndexBatch>& batches, unsigned int cacheSize)
+		{
+			VertexCacheStatistics totals;
+
+			// Each batch is a separate draw call, so the cache is treated as cold at the start of each
+			for (unsigned int i = 0; i < batches.size(); i++)
+			{
+				VertexCacheStatistics batchStats = AnalyseVertexCache(&indicies[batches[i].mFirstIndex], batches[i].mIndexCount, batches[i].mVertexCount, cacheSize);
+
+				totals.mTriangleCount += batchStats.mTriangleCount;
+				totals.mVertexCount   += batchStats.mVertexCount;
+				totals.mCacheMisses   += batchStats.mCacheMisses;
+			}
+
+			if (totals.mTriangleCount > 0)
+			{
+				totals.mAverageCacheMissRatio         = (float)totals.mCacheMisses / (float)totals.mTriangleCount;
+				totals.mAverageTransformToVertexRatio = (float)totals.mCacheMisses / (float)totals.mVertexCount;
+			}
+
+			return totals;
+		}
+
+		// ---------------------------------------------
+
+		void GenerateGridIndexBatches(unsigned int dimensions, bool optimiseForVertexCache, std::vector<unsigned short>& indicies, std::vector<IndexBatch>& batches)
+		{
+			indicies.clear();
+			batches.clear();
+
+			if (dimensions == 0)
+				return;
+
+			const unsigned int verticiesPerRow = dimensions + 1;
+
+			// A batch needs at least two rows of verticies to make any triangles - checked in release too, as no batch could ever advance
+			if (verticiesPerRow * 2 > kMaxVerticiesPer16BitBatch)
+			{
+				ASSERTFAIL("Grid is too wide to be drawn with 16 bit indicies.");
+				return;
+			}
+
+			const unsigned int cellRowsPerBatch = (kMaxVerticiesPer16BitBatch / verticiesPerRow) - 1;
+
+			indicies.resize(dimensions * dimensions * 6);
+
+			for (unsigned int firstRow = 0; firstRow < dimensions; firstRow += cellRowsPerBatch)
+			{
+				unsigned int rowsInBatch = dimensions - firstRow;
+
+				if (rowsInBatch > cellRowsPerBatch)
+					rowsInBatch = cellRowsPerBatch;
+
+				IndexBatch batch;
+				batch.mFirstIndex  = firstRow * dimensions * 6;
+				batch.mIndexCount  = rowsInBatch * dimensions * 6;
+				batch.mBaseVertex  = (int)(firstRow * verticiesPerRow);
+				batch.mVertexCount = (rowsInBatch + 1) * verticiesPerRow;
+
+				batches.push_back(batch);
+			}
+
+			// Every row writes to its own section of the output, so they can all be filled in at once
+			unsigned short* output = indicies.data();
+
+			Engine::Parallel::ParallelFor(0, dimensions, 64, [=](unsigned int rowStart, unsigned int rowEnd)
+			{
+				for (unsigned int row = rowStart; row < rowEnd; row++)
+				{
+					// Same triangle layout as the original row-major grid, relative to the start of the batch
+					unsigned int    startOfRow     = verticiesPerRow * (row % cellRowsPerBatch);
+					unsigned int    startOfNextRow = startOfRow + verticiesPerRow;
+					unsigned short* rowOutput      = output + (row * dimensions * 6);
+
+					for (unsigned int x = 0; x < dimensions; x++)
+					{
+						*rowOutput++ = (unsigned short)(startOfRow     + x);
+						*rowOutput++ = (unsigned short)(startOfRow     + (x + 1));
+						*rowOutput++ = (unsigned short)(startOfNextRow + x);
+
+						*rowOutput++ = (unsigned short)(startOfRow     + (x + 1));
+						*rowOutput++ = (unsigned short)(startOfNextRow + (x + 1));
+						*rowOutput++ = (unsigned short)(startOfNextRow + x);
+					}
+				}
+			});
+
+			// The optimiser is serial within a batch, but batches are independent of each other
+			if (optimiseForVertexCache)
+			{
+				Engine::Parallel::ParallelFor(0, (unsigned int)batches.size(), 1, [&](unsigned int batchStart, unsigned int batchEnd)
+				{
+					for (unsigned int i = batchStart; i < batchEnd; i++)
+					{
+						OptimiseVertexCacheOrder(&indicies[batches[i].mFirstIndex], batches[i].mIndexCount, batches[i].mVertexCount);
+					}
+				});
+			}
+		}
+
+		// ---------------------------------------------
+
+		std::string GenerateGridReport(unsigned int dimensions)
+		{
+			std::stringstream report;
+
+			std::vector<unsigned short> rowMajorIndicies;
+			std::vector<IndexBatch>     rowMajorBatches;
+
+			std::vector<unsigned short> optimisedIndicies;
+			std::vector<IndexBatch>     optimisedBatches;
+
+			GenerateGridIndexBatches(dimensions, false, rowMajorIndicies,  rowMajorBatches);
+			GenerateGridIndexBatches(dimensions, true,  optimisedIndicies, optimisedBatches);
+
+			const unsigned int vertexCount = (dimensions + 1) * (dimensions + 1);
+
+			report << "Grid: " << dimensions << " x " << dimensions << " cells, " << vertexCount << " verticies, " << (dimensions * dimensions * 2) << " triangles\n";
+			report << "Batches: " << optimisedBatches.size() << " (16 bit indicies)\n";
+			report << "Index memory: " << (optimisedIndicies.size() * sizeof(unsigned short)) << " bytes (was " << (optimisedIndicies.size() * sizeof(unsigned int)) << " bytes with 32 bit indicies)\n\n";
+
+			report << std::fixed << std::setprecision(3);
+			report << "Cache size | Row-major ACMR | Row-major ATVR | Optimised ACMR | Optimised ATVR\n";
+
+			const unsigned int cacheSizes[] = { 8, 16, 24, 32 };
+
+			for (unsigned int cacheSize : cacheSizes)
+			{
+				VertexCacheStatistics rowMajor  = AnalyseVertexCache(rowMajorIndicies.data(),  rowMajorBatches,  cacheSize);
+				VertexCacheStatistics optimised = AnalyseVertexCache(optimisedIndicies.data(), optimisedBatches, cacheSize);
+
+				report << std::setw(10) << cacheSize << " | "
+					   << std::setw(14) << rowMajor.mAverageCacheMissRatio          << " | "
+					   << std::setw(14) << rowMajor.mAverageTransformToVertexRatio  << " | "
+					   << std::setw(14) << optimised.mAverageCacheMissRatio         << " | "
+					   << std::setw(14) << optimised.mAverageTransformToVertexRatio << "\n";
+			}
+
+			return report.str();
+		}
+
+		// ---------------------------------------------
+	}
+}
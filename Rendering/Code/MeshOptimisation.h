@@ -0,0 +1,78 @@
+#pragma once
+
+// Index buffer generation and optimisation for the grid meshes used by the water surface
+// The grid is split into bands of rows that can each be addressed with 16 bit indices, and the triangles in each band
+// are re-ordered so that the post-transform vertex cache is hit as often as possible - every vertex shader invocation
+// for the water performs texture fetches, so the fewer invocations the better
+
+#include <vector>
+#include <string>
+
+namespace Rendering
+{
+	namespace MeshOptimisation
+	{
+		// Largest number of verticies that can be referenced by a single batch using 16 bit indices
+		const unsigned int kMaxVerticiesPer16BitBatch     = 65536;
+
+		// Size of the post transform cache assumed when optimising and reporting
+		const unsigned int kDefaultPostTransformCacheSize = 32;
+
+		// ---------------------------------------
+
+		// A range of the index buffer which is drawn with glDrawElementsBaseVertex
+		// The indicies stored in the range are relative to mBaseVertex
+		struct IndexBatch
+		{
+			IndexBatch()
+				: mFirstIndex(0)
+				, mIndexCount(0)
+				, mBaseVertex(0)
+				, mVertexCount(0)
+			{ }
+
+			unsigned int mFirstIndex;
+			unsigned int mIndexCount;
+			int          mBaseVertex;
+			unsigned int mVertexCount;
+		};
+
+		// ---------------------------------------
+
+		struct VertexCacheStatistics
+		{
+			VertexCacheStatistics()
+				: mTriangleCount(0)
+				, mVertexCount(0)
+				, mCacheMisses(0)
+				, mAverageCacheMissRatio(0.0f)
+				, mAverageTransformToVertexRatio(0.0f)
+			{ }
+
+			unsigned int mTriangleCount;
+			unsigned int mVertexCount;
+			unsigned int mCacheMisses;                   // Equal to the number of vertex shader invocations
+
+			float        mAverageCacheMissRatio;         // ACMR - misses per triangle, 0.5 is the best possible on a large grid
+			float        mAverageTransformToVertexRatio; // ATVR - misses per vertex, 1.0 is the best possible
+		};
+
+		// ---------------------------------------
+
+		// Creates the index data for a grid of dimensions x dimensions cells, laid out in the same way as WaterSimulation::GenerateVertexData
+		// The output is split into batches which each reference no more than kMaxVerticiesPer16BitBatch verticies
+		// Both outputs are left empty if a single row is too wide for that
+		void                  GenerateGridIndexBatches(unsigned int dimensions, bool optimiseForVertexCache, std::vector<unsigned short>& indicies, std::vector<IndexBatch>& batches);
+
+		// Re-orders the triangles in the list to improve post-transform vertex cache usage (Tom Forsyth's linear-speed approach)
+		// Triangle winding is preserved
+		void                  OptimiseVertexCacheOrder(unsigned short* indicies, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize = kDefaultPostTransformCacheSize);
+
+		// Simulates a FIFO post-transform cache of the given size running over the index data
+		VertexCacheStatistics AnalyseVertexCache(const unsigned short* indicies, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize);
+		VertexCacheStatistics AnalyseVertexCache(const unsigned short* indicies, const std::vector<IndexBatch>& batches, unsigned int cacheSize);
+
+		// Human readable comparison between the plain row-major ordering and the optimised ordering for a given grid size
+		std::string           GenerateGridReport(unsigned int dimensions);
+	}
+}
@@ -5,37 +5,54 @@
 
 #include "Shaders/ShaderProgram.h"
 #include "Shaders/ShaderTypes.h"
+#include "Shaders/ShaderBinaryCache.h"
+#include "Textures/CubeMapCache.h"
+#include "Textures/VideoTexture.h"
 
 #include "Input/Code/Input.h"
 #include "Input/Code/KeyboardInput.h"
 #include "Input/Code/MouseInput.h"
 
+#include "Maths/Code/PerformanceAnalysis.h"
+#include "Maths/Code/Timer.h"
+
 #include "Include/imgui/imgui.h"
 #include "Include/imgui/imgui_impl_glfw.h"
 #include "Include/imgui/imgui_impl_opengl3.h"
 
 #include "Skybox.h"
+#include "SkyboxLibrary.h"
 #include "Framebuffers.h"
+#include "Buffers.h"
+#include "UniformBlocks.h"
+#include "GLStateCache.h"
+#include "GLErrorChecking.h"
+#include "MemoryBarrierTracker.h"
+#include "RenderCommandQueue.h"
+#include "AsyncReadback.h"
+#include "TextureResidency.h"
 
 #include "Rendering/Code/Skybox.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <future>
+
 namespace Rendering
 {
 	// ---------------------------------------
 
+	// Each of the shipped sets is 4.5MB once uploaded, so this keeps the last few shown resident
+	static const size_t kSkyboxResidentBudgetBytes = 32 * 1024 * 1024;
+
+	// Made with: ffmpeg -i <video> -pix_fmt yuv420p Video/Backdrop.y4m
+	static const char   kVideoFilePath[]           = "Video/Backdrop.y4m";
+
+	// ---------------------------------------
+
 	OpenGLRenderPipeline::OpenGLRenderPipeline()
 		: RenderPipeline()
-		, mShaderIDBound(0)
-		, mLineModeEnabled(false)
-		, mDepthTestEnabled(true)
-		, mDepthFunction(GL_LESS)
-		, mAlphaBlendingEnabled(false)
-		, mAlphaBlendingSFactor(GL_SRC_ALPHA)
-		, mAlphaBlendingDFactor(GL_ONE_MINUS_SRC_ALPHA)
-		, mBackFaceCullingEnabled(true)
 
 		, mVAOVideo(nullptr)
 		, mVBOVideo(nullptr)
@@ -44,9 +61,19 @@ namespace Rendering
 		, mDepthStencilTexture(nullptr)
 
 		, mFinalRenderProgram(nullptr)
+		, mPerFrameCameraUBO(nullptr)
+		, mRenderCommandQueue()
 
 		, mWaterSimulation(nullptr)
+		, mSkyboxLibrary(nullptr)
 		, mSkybox(nullptr)
+		, mVideoTexture(nullptr)
+		, mAsyncReadback(nullptr)
+		, mPixelProbeEnabled(false)
+		, mPixelProbe()
+		, mProbedColour()
+		, mProbedPixel()
+		, mProbedColourValid(false)
 	{
 
 	}
@@ -58,8 +85,16 @@ namespace Rendering
 		//delete mWaterSimulation;
 		//mWaterSimulation = nullptr;
 
-		//delete mSkybox;
-		//mSkybox = nullptr;
+		//delete mSkyboxLibrary;
+		//mSkyboxLibrary = nullptr;
+
+		// Joins the decode worker, which would otherwise be left waiting on a slot forever
+		delete mVideoTexture;
+		mVideoTexture = nullptr;
+
+		// Same for the readback worker, and anything still waiting on a readback hears that it failed
+		delete mAsyncReadback;
+		mAsyncReadback = nullptr;
 	}
 
 	// -------------------------------------------------
@@ -79,6 +114,11 @@ namespace Rendering
 		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 		glfwWindowHint(GLFW_DECORATED, GLFW_TRUE);
 
+#ifdef _GL_ERRORS_DEBUG_OUTPUT
+		// Drivers only promise KHR_debug messages for debug contexts
+		glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
+
 		// Get the current monitor
 		GLFWmonitor* monitor = glfwGetPrimaryMonitor();
 
@@ -120,6 +160,10 @@ namespace Rendering
 			return false;
 		}
 
+#ifdef _GL_ERRORS_DEBUG_OUTPUT
+		GLDebugOutput::Enable();
+#endif
+
 		// Set the default framebuffer callback for the window
 		glfwSetFramebufferSizeCallback(mWindow, Rendering::framebuffer_size_callback);
 
@@ -131,43 +175,53 @@ namespace Rendering
 		Input::MouseInput::RegisterMousePositionCallback(mWindow);
 		Input::MouseInput::RegisterMouseScrollCallback(mWindow);
 
-		// Update the viewport
-		glViewport(0, 0, mScreenWidth, mScreenHeight);
+		// Nothing is known about the new context yet, so every first call has to reach the driver
+		GLStateCache::Invalidate();
 
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		// Update the viewport
+		GLStateCache::SetViewport(0, 0, mScreenWidth, mScreenHeight);
 
 		glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
 
 		// Enable depth testing by default
-		glEnable(GL_DEPTH_TEST);
-		glDepthFunc(GL_LESS);
-		mDepthTestEnabled = true;
-		mDepthFunction = GL_LESS;
-
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glDisable(GL_BLEND);
+		GLStateCache::SetCapability(GL_DEPTH_TEST, true);
+		GLStateCache::SetDepthFunction(GL_LESS);
 
-		mAlphaBlendingEnabled = false;
-		mAlphaBlendingSFactor = GL_SRC_ALPHA;
-		mAlphaBlendingDFactor = GL_ONE_MINUS_SRC_ALPHA;
+		GLStateCache::SetBlendFunction(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		GLStateCache::SetCapability(GL_BLEND, false);
 
-		glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+		GLStateCache::SetCapability(GL_TEXTURE_CUBE_MAP_SEAMLESS, true);
 
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		mLineModeEnabled = false;
+		GLStateCache::SetPolygonMode(GL_FILL);
 
-		glEnable(GL_CULL_FACE);
-		glCullFace(GL_BACK);
+		GLStateCache::SetCapability(GL_CULL_FACE, true);
+		GLStateCache::SetCullFaceMode(GL_BACK);
 
 		glFrontFace(GL_CCW);
 
 		glfwMakeContextCurrent(mWindow);
 
+		ShaderPrograms::ShaderProgram::EnableParallelCompilation();
+
+		mAsyncReadback = new AsyncReadback();
+
+		// Each face decodes on a worker of its own while the shaders compile, and is uploaded once the render loop finds it finished
+		// Until then the sky is a plain colour, so nothing here waits on the images
+		mSkyboxLibrary = new SkyboxLibrary("Skybox/", kSkyboxResidentBudgetBytes, glm::vec3(0.53f, 0.71f, 0.88f));
+		mSkybox        = mSkyboxLibrary->SetActive("Day");
+
+		// The rest fill whatever budget is left, one at a time once the first set has finished streaming
+		mSkyboxLibrary->PreloadAll();
+
+		// The links overlap each other and the CPU setup in between, so only the wall clock time of the whole lot says what startup costs
+		Engine::Timer::Timer shaderSetupTimer;
+		shaderSetupTimer.Start();
+
 		SetupShaders();
 
 		mWaterSimulation = new WaterSimulation();
-		mSkybox          = new Skybox("Sky", "Skybox/Day/Right.bmp", "Skybox/Day/Left.bmp", "Skybox/Day/Top.bmp", "Skybox/Day/Bottom.bmp", "Skybox/Day/Front.bmp", "Skybox/Day/Back.bmp");
+
+		Engine::Timer::PerformanceTimings::AddTiming(Engine::Timer::PerformanceTimingAreas::Setup_CompileShaders, shaderSetupTimer.GetCurrentTimeSeconds());
 
 		return true;
 	}
@@ -194,6 +248,22 @@ namespace Rendering
 		delete vertexShader;
 		delete fragmentShader;
 
+		// Nothing about the full screen quad changes between frames
+		glm::mat4 identity = glm::mat4(1.0f);
+
+		mFinalRenderProgram->SetInt("imageToRender",  0);
+		mFinalRenderProgram->SetMat4("projectionMat", &identity[0][0]);
+		mFinalRenderProgram->SetMat4("modelMat",      &identity[0][0]);
+
+		// -------------------------------------------------------------
+
+		if (!mPerFrameCameraUBO)
+		{
+			mPerFrameCameraUBO = new Buffers::UniformBufferObject();
+			mPerFrameCameraUBO->AllocateMemory(sizeof(PerFrameCameraBlock), GL_DYNAMIC_DRAW);
+			mPerFrameCameraUBO->BindToBufferIndex((unsigned int)UniformBlockBindings::PerFrameCamera);
+		}
+
 		// -------------------------------------------------------------
 
 		mVAOVideo = new Buffers::VertexArrayObject();
@@ -235,6 +305,9 @@ namespace Rendering
 			mDepthStencilTexture = new Texture::Texture2D();
 			mDepthStencilTexture->InitEmpty(screenWidth, screenHeight, false, GL_UNSIGNED_INT_24_8, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL);
 
+			mColourTexture      ->SetResidencyCategory(TextureCategory::RenderTarget);
+			mDepthStencilTexture->SetResidencyCategory(TextureCategory::RenderTarget);
+
 			mFinalRenderFBO->AttachColourBuffer(mColourTexture);
 			mFinalRenderFBO->AttachDepthStencilBuffer(mDepthStencilTexture);
 
@@ -290,6 +363,11 @@ namespace Rendering
 		{
 			mWaterSimulation->Update(delayedUpdateDeltaTime);
 		}
+
+		if (mVideoTexture)
+		{
+			mVideoTexture->Update(deltaTime);
+		}
 	}
 
 	// -------------------------------------------------
@@ -299,40 +377,86 @@ namespace Rendering
 		if (!mFinalRenderFBO || !mWaterSimulation)
 			return;
 
+		if (!mActiveCamera)
+			return;
+
 		// -----------------------------------------------------------
 
-		SetLineModeEnabled(Window::GetLineMode());
+		// Anything that has to touch GL before recording happens here, on this thread
+		// Streaming a set in clears and fills through framebuffers of its own, so this is done before the offscreen buffer is bound
+		if (mSkyboxLibrary)
+		{
+			mSkyboxLibrary->Update();
 
-		// -----------------------------------------------------------
+			mSkybox = mSkyboxLibrary->GetActive();
+		}
 
 		// Make sure we are rendering to the offscreen buffer
 		mFinalRenderFBO->SetActive(true, true);
 
+		glm::mat4                      viewMat        = mActiveCamera->GetViewMatrix();
+		glm::mat4                      projectionMat  = mActiveCamera->GetPerspectiveMatrix();
+		Maths::Vector::Vector3D<float> cameraPosition = mActiveCamera->GetPosition();
+		float                          farDistance    = mActiveCamera->GetFarDistance();
+
+		// One upload covers the camera data for everything drawn this frame
+		UpdatePerFrameCameraBlock(viewMat, projectionMat, glm::vec3(cameraPosition.x, cameraPosition.y, cameraPosition.z), mActiveCamera->GetNearDistance(), farDistance);
+
+		// --------------------------------
+
 		if (mSkybox)
 		{
-			mSkybox->Render(mActiveCamera);
+			mWaterSimulation->SetSkyIrradiance(mSkybox->GetIrradianceSH());
+			mWaterSimulation->SetSkyReflection(mSkybox->GetPrefilteredTexture());
+		}
+		else
+		{
+			// Nothing to reflect, and a pointer into a set the library has let go of must not be kept
+			mWaterSimulation->SetSkyReflection(nullptr);
 		}
 
-		// --------------------------------
+		// See if the camera is above or below the surface
+		bool renderingWaterSurface = !mWaterSimulation->IsBelowSurface(cameraPosition);
 
-		OpenGLRenderPipeline::SetLineModeEnabled(Window::GetLineMode());
+		std::future<void> waterRecording;
 
-		// --------------------------------
+		if (renderingWaterSurface)
+		{
+			mWaterSimulation->PrepareRender(mActiveCamera);
 
-		// See if the camera is above or below the surface
-		if (mWaterSimulation->IsBelowSurface(mActiveCamera->GetPosition()))
+			// The CPU culling and packet building for the water runs on a worker while this thread records the rest
+			waterRecording = std::async(std::launch::async, [this, viewMat, projectionMat, cameraPosition, farDistance]()
+			{
+				RenderCommandList waterCommands;
+
+				mWaterSimulation->RecordRenderCommands(waterCommands, viewMat, projectionMat, glm::vec3(cameraPosition.x, cameraPosition.y, cameraPosition.z), farDistance);
+
+				mRenderCommandQueue.Submit(waterCommands);
+			});
+		}
+
+		if (mSkybox)
 		{
+			RenderCommandList skyboxCommands;
+
+			mSkybox->RecordRenderCommands(skyboxCommands, Window::GetLineMode());
 
+			mRenderCommandQueue.Submit(skyboxCommands);
 		}
-		else
+
+		if (waterRecording.valid())
 		{
-			// Render the sub-surface models
+			waterRecording.wait();
+		}
 
-			// Render the water's surface
-			//mWaterSimulation->Render(mActiveCamera, mSkybox->GetCubeMapTexture());
-			mWaterSimulation->Render(mActiveCamera, mSkybox->GetConvolutedTexture());
+		// Sorted by pass, program, textures and depth, then replayed - the sky pass lands after the water so its pixels are depth rejected
+		mRenderCommandQueue.Execute();
+
+		// --------------------------------
 
-			// Render everything above the surface
+		if (mPixelProbeEnabled)
+		{
+			UpdatePixelProbe();
 		}
 
 		// --------------------------------
@@ -345,6 +469,53 @@ namespace Rendering
 		FinalRenderToScreen();
 
 		// --------------------------------
+
+		// Fences this frame's readbacks and hands over any earlier ones the GPU has finished
+		if (mAsyncReadback)
+		{
+			mAsyncReadback->EndFrame();
+		}
+
+		// --------------------------------
+	}
+
+	// -------------------------------------------------
+
+	void OpenGLRenderPipeline::UpdatePixelProbe()
+	{
+		if (!mAsyncReadback || !mColourTexture)
+			return;
+
+		if (mPixelProbe.valid())
+		{
+			if (mPixelProbe.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return;
+
+			ReadbackResult result = mPixelProbe.get();
+
+			if (result.mSucceeded && result.mPixels.size() >= 3)
+			{
+				mProbedColour[0]   = result.mPixels[0];
+				mProbedColour[1]   = result.mPixels[1];
+				mProbedColour[2]   = result.mPixels[2];
+				mProbedColourValid = true;
+			}
+		}
+
+		if (Window::GetWindowWidth() == 0 || Window::GetWindowHeight() == 0)
+			return;
+
+		// The mouse is in window coordinates from the top left, the colour buffer is its own size from the bottom left
+		Maths::Vector::Vector2D<float> mousePosition = Input::MouseInput::MouseInputDevice::GetMousePosition();
+
+		int x = (int)(mousePosition.x * (float)mColourTexture->GetTextureWidth()  / (float)Window::GetWindowWidth());
+		int y = (int)mColourTexture->GetTextureHeight() - 1 - (int)(mousePosition.y * (float)mColourTexture->GetTextureHeight() / (float)Window::GetWindowHeight());
+
+		// With the mouse off the window the read is out of range and fails, which just leaves the last colour showing
+		mPixelProbe = mFinalRenderFBO->ReadPixelsAsync(x, y, 1, 1, GL_RGB, GL_UNSIGNED_BYTE);
+
+		mProbedPixel[0] = x;
+		mProbedPixel[1] = y;
 	}
 
 	// -------------------------------------------------
@@ -354,6 +525,11 @@ namespace Rendering
 		if (mWaterSimulation)
 			mWaterSimulation->RenderDebugMenu();
 
+		if (mSkyboxLibrary)
+			mSkyboxLibrary->RenderDebugMenu();
+
+		TextureResidency::RenderDebugMenu();
+
 		ImGui::Begin("Buffer visualisations");
 
 			if (ImGui::Button("View positional buffer"))
@@ -428,6 +604,109 @@ namespace Rendering
 			}
 
 		ImGui::End();
+
+		ImGui::Begin("Video");
+
+			if (!mVideoTexture || !mVideoTexture->GetIsOpen())
+			{
+				ImGui::Text("%s", kVideoFilePath);
+
+				if (ImGui::Button("Play"))
+				{
+					if (!mVideoTexture)
+						mVideoTexture = new Texture::VideoTexture();
+
+					mVideoTexture->Open(kVideoFilePath);
+				}
+			}
+			else
+			{
+				ImGui::Text("%d x %d through a %s", mVideoTexture->GetWidth(), mVideoTexture->GetHeight(), mVideoTexture->GetIsPersistentlyMapped() ? "persistently mapped ring" : "staging ring");
+				ImGui::Text("Frames: %u uploaded, %u skipped, %u late", mVideoTexture->GetUploadedFrameCount(), mVideoTexture->GetSkippedFrameCount(), mVideoTexture->GetLateFrameCount());
+
+				// Rows are top first, which is also how ImGui reads its texture coordinates
+				float previewWidth = 320.0f;
+				ImGui::Image((ImTextureID)(intptr_t)mVideoTexture->GetTextureID(), ImVec2(previewWidth, previewWidth * (float)mVideoTexture->GetHeight() / (float)mVideoTexture->GetWidth()));
+
+				if (ImGui::Button("Stop"))
+				{
+					mVideoTexture->Close();
+				}
+			}
+
+		ImGui::End();
+
+		ImGui::Begin("GL state");
+
+			const GLStateCallCounts& counts = GLStateCache::GetLastFrameCounts();
+
+			ImGui::Text("Last frame: %u calls issued, %u elided", counts.GetTotalIssued(), counts.GetTotalElided());
+			ImGui::Text("Render commands replayed: %u",            mRenderCommandQueue.GetLastExecutedCommandCount());
+			ImGui::Text("Memory barriers: %u issued, %u elided",   MemoryBarrierTracker::GetLastFrameCounts().mBarriersIssued, MemoryBarrierTracker::GetLastFrameCounts().mBarriersElided);
+			ImGui::Text("Shader programs: %u from binary cache, %u from source, %.2f ms to set up at startup",
+				ShaderPrograms::ShaderBinaryCache::GetHitCount(), ShaderPrograms::ShaderBinaryCache::GetMissCount(),
+				Engine::Timer::PerformanceTimings::GetTiming(Engine::Timer::PerformanceTimingAreas::Setup_CompileShaders) * 1000.0f);
+			ImGui::Text("Convoluted cube maps: %u from cache, %u rebuilt", Texture::CubeMapCache::GetHitCount(), Texture::CubeMapCache::GetMissCount());
+
+			if (mAsyncReadback)
+			{
+				ImGui::Text("Readbacks: %u in flight, last landed after %u frames", mAsyncReadback->GetInFlightRequestCount(), mAsyncReadback->GetLastLatencyFrames());
+
+				ImGui::Checkbox("Probe pixel under mouse", &mPixelProbeEnabled);
+
+				if (mPixelProbeEnabled && mProbedColourValid)
+				{
+					ImVec4 probedColour((float)mProbedColour[0] / 255.0f, (float)mProbedColour[1] / 255.0f, (float)mProbedColour[2] / 255.0f, 1.0f);
+
+					ImGui::ColorButton("##ProbedColour", probedColour);
+					ImGui::SameLine();
+					ImGui::Text("(%d, %d): %u %u %u", mProbedPixel[0], mProbedPixel[1], mProbedColour[0], mProbedColour[1], mProbedColour[2]);
+				}
+			}
+
+			for (unsigned int i = 0; i < (unsigned int)GLStateCategory::Count; i++)
+			{
+				ImGui::Text("%-16s issued: %5u   elided: %5u", GLStateCache::GetCategoryName((GLStateCategory)i), counts.mIssued[i], counts.mElided[i]);
+			}
+
+			if (ImGui::Button("Invalidate cache"))
+			{
+				GLStateCache::Invalidate();
+			}
+
+#ifdef _GL_ERRORS_DEBUG_OUTPUT
+			ImGui::Separator();
+
+			ImGui::Text("Debug output errors: %u", GLDebugOutput::GetErrorCount());
+
+			bool synchronousOutput = GLDebugOutput::GetSynchronous();
+			if (ImGui::Checkbox("Synchronous debug output", &synchronousOutput))
+			{
+				GLDebugOutput::SetSynchronous(synchronousOutput);
+			}
+
+			std::vector<GLDebugMessage> debugMessages;
+			GLDebugOutput::GetRecentMessages(debugMessages);
+
+			for (unsigned int i = 0; i < debugMessages.size(); i++)
+			{
+				const GLCallSite* checkpoint = debugMessages[i].mCheckpoint;
+
+				ImGui::TextWrapped("[%s] %s", GLDebugOutput::GetTypeName(debugMessages[i].mType), debugMessages[i].mText.c_str());
+
+				if (checkpoint)
+				{
+					ImGui::TextDisabled("    after %s(%u): %s", checkpoint->mFile, checkpoint->mLine, checkpoint->mMessage);
+				}
+			}
+
+			if (ImGui::Button("Clear messages"))
+			{
+				GLDebugOutput::ClearMessages();
+			}
+#endif
+
+		ImGui::End();
 	}
 
 	// -------------------------------------------------
@@ -492,14 +771,6 @@ namespace Rendering
 		break;
 		}
 
-		//float*    projMatrix = &GetActiveCamera()->GetOrthoMatrix()[0][0];
-		glm::mat4 model = glm::mat4(1.0f);
-		// model = glm::scale(model, glm::vec3((float)Window::GetWindowWidth(), (float)Window::GetWindowHeight(), 1.0f));
-
-		mFinalRenderProgram->SetInt("imageToRender",  0);
-		mFinalRenderProgram->SetMat4("projectionMat", &model[0][0]);
-		mFinalRenderProgram->SetMat4("modelMat",      &model[0][0]);
-
 		if (mVAOVideo && mVBOVideo)
 		{
 			mVAOVideo->Bind();
@@ -514,184 +785,114 @@ namespace Rendering
 
 	// -------------------------------------------------
 
-	void OpenGLRenderPipeline::BindTextureToTextureUnit(GLenum textureUnit, unsigned int textureUnitID, bool isTexture2D)
+	void OpenGLRenderPipeline::UpdatePerFrameCameraBlock(const glm::mat4& viewMat, const glm::mat4& projectionMat, const glm::vec3& cameraPosition, float nearDistance, float farDistance)
 	{
-		// Check if the texture unit is valid
-		if (textureUnit < GL_TEXTURE0 || textureUnit > GL_TEXTURE31)
-		{
+		if (!mPerFrameCameraUBO)
 			return;
-		}
-
-		unsigned int bindingsCount = (unsigned int)mTextureUnitBindings.size();
-		for (unsigned int i = 0; i < bindingsCount; i++)
-		{
-			if (mTextureUnitBindings[i].first == textureUnit)
-			{
-				// Check for setting to same value
-				if (mTextureUnitBindings[i].second == textureUnitID)
-				{
-					return;
-				}
-
-				mTextureUnitBindings[i].second = textureUnitID;
 
-				glActiveTexture(textureUnit);
+		PerFrameCameraBlock cameraBlock;
+		cameraBlock.mViewMat           = viewMat;
+		cameraBlock.mProjectionMat     = projectionMat;
+		cameraBlock.mViewProjectionMat = projectionMat * viewMat;
+		cameraBlock.mCameraPosition    = glm::vec4(cameraPosition, 1.0f);
+		cameraBlock.mViewport          = glm::vec4((float)GetScreenWidth(), (float)GetScreenHeight(), nearDistance, farDistance);
 
-				if (isTexture2D)
-				{
-					glBindTexture(GL_TEXTURE_2D, textureUnitID);
-				}
-				else
-				{
-					glBindTexture(GL_TEXTURE_CUBE_MAP, textureUnitID);
-				}
-
-				GLenum error = glGetError();
-				ASSERTMSG(error != 0, "Error binding texture");
-
-				return;
-			}
-		}
+		mPerFrameCameraUBO->SubBufferUpdate(0, sizeof(PerFrameCameraBlock), &cameraBlock);
+	}
 
-		mTextureUnitBindings.push_back({ textureUnit, textureUnitID });
+	// -------------------------------------------------
 
-		glActiveTexture(textureUnit);
-		if (isTexture2D)
-		{
-			glBindTexture(GL_TEXTURE_2D, textureUnitID);
-		}
-		else
+	void OpenGLRenderPipeline::BindTextureToTextureUnit(GLenum textureUnit, unsigned int textureUnitID, bool isTexture2D)
+	{
+		// Check if the texture unit is valid
+		if (textureUnit < GL_TEXTURE0 || textureUnit > GL_TEXTURE31)
 		{
-			glBindTexture(GL_TEXTURE_CUBE_MAP, textureUnitID);
+			return;
 		}
 
-		GLenum error = glGetError();
-		ASSERTMSG(error != 0, "Error binding texture");
+		GLStateCache::BindTexture(textureUnit - GL_TEXTURE0, isTexture2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP, textureUnitID);
+
+		GL_CHECK_ERROR("Error binding texture");
 	}
 
 	// -------------------------------------------------
 
 	unsigned int OpenGLRenderPipeline::QueryCurrentlyBoundTextureID(GLenum textureUnit)
 	{
-		unsigned int bindingsCount = (unsigned int)mTextureUnitBindings.size();
-		for (unsigned int i = 0; i < bindingsCount; i++)
+		if (textureUnit < GL_TEXTURE0 || textureUnit > GL_TEXTURE31)
 		{
-			if (mTextureUnitBindings[i].first == textureUnit)
-			{
-				return mTextureUnitBindings[i].second;
-			}
+			return 0;
 		}
 
-		return 0;
+		unsigned int boundTexture = GLStateCache::GetBoundTexture(textureUnit - GL_TEXTURE0, GL_TEXTURE_2D);
+
+		if (boundTexture == 0)
+			boundTexture = GLStateCache::GetBoundTexture(textureUnit - GL_TEXTURE0, GL_TEXTURE_CUBE_MAP);
+
+		return boundTexture;
 	}
 
 	// -------------------------------------------------
 
 	void OpenGLRenderPipeline::SetActiveShader(unsigned int shaderID)
 	{
-		if (shaderID == mShaderIDBound)
-			return;
+		GLStateCache::BindProgram(shaderID);
+	}
 
-		mShaderIDBound = shaderID;
+	// -------------------------------------------------
 
-		glUseProgram(shaderID);
+	unsigned int OpenGLRenderPipeline::QueryCurrentlyActiveShaderID()
+	{
+		return GLStateCache::GetBoundProgram();
 	}
 
 	// -------------------------------------------------
 
 	void OpenGLRenderPipeline::SetLineModeEnabled(bool state)
 	{
-		if (state == mLineModeEnabled)
-			return;
-
-		mLineModeEnabled = state;
-
-		if (state)
-		{
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		}
-		else
-		{
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-		}
+		GLStateCache::SetPolygonMode(state ? GL_LINE : GL_FILL);
 	}
 
 	// -------------------------------------------------
 
 	void OpenGLRenderPipeline::SetDepthTestEnabled(bool state)
 	{
-		if (state == mDepthTestEnabled)
-			return;
-
-		mDepthTestEnabled = state;
-
-		if (state)
-		{
-			glEnable(GL_DEPTH_TEST);
-		}
-		else
-		{
-			glDisable(GL_DEPTH_TEST);
-		}
+		GLStateCache::SetCapability(GL_DEPTH_TEST, state);
 	}
 
 	// -------------------------------------------------
 
-    void OpenGLRenderPipeline::SetAlphaBlending(bool state)
+	void OpenGLRenderPipeline::SetAlphaBlending(bool state)
 	{
-		if (state == mAlphaBlendingEnabled)
-			return;
-
-		mAlphaBlendingEnabled = state;
-
-		if (state)
-		{
-			glEnable(GL_BLEND);
-		}
-		else
-		{
-			glDisable(GL_BLEND);
-		}
+		GLStateCache::SetCapability(GL_BLEND, state);
 	}
 
 	// -------------------------------------------------
 
 	void OpenGLRenderPipeline::SetAlphaBlendingFunction(GLenum sFactor, GLenum dFactor)
 	{
-		if (sFactor == mAlphaBlendingSFactor && dFactor == mAlphaBlendingDFactor)
-			return;
-
-		mAlphaBlendingSFactor = sFactor;
-		mAlphaBlendingDFactor = dFactor;
-
-		glBlendFunc(sFactor, dFactor);
+		GLStateCache::SetBlendFunction(sFactor, dFactor);
 	}
 
 	// -------------------------------------------------
 
 	void OpenGLRenderPipeline::SetBackFaceCulling(bool state)
 	{
-		if (state == mBackFaceCullingEnabled)
-			return;
+		GLStateCache::SetCapability(GL_CULL_FACE, state);
+	}
 
-		mBackFaceCullingEnabled = state;
+	// -------------------------------------------------
 
-		if (mBackFaceCullingEnabled)
-			glEnable(GL_CULL_FACE);
-		else
-			glDisable(GL_CULL_FACE);
+	void OpenGLRenderPipeline::SetCullFaceMode(GLenum mode)
+	{
+		GLStateCache::SetCullFaceMode(mode);
 	}
 
 	// -------------------------------------------------
 
 	void OpenGLRenderPipeline::SetDepthTestFunction(GLenum state)
 	{
-		if (state == mDepthFunction)
-			return;
-
-		mDepthFunction = state;
-
-		glDepthFunc(state);
+		GLStateCache::SetDepthFunction(state);
 	}
 
 	// -------------------------------------------------
@@ -738,16 +939,9 @@ namespace Rendering
 
 	// -------------------------------------------------
 
-	void OpenGLRenderPipeline::ResetTextureBindingInfo()
-	{
-		mTextureUnitBindings.clear();
-	}
-
-	// -------------------------------------------------
-
 	void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	{
-		glViewport(0, 0, width, height);
+		GLStateCache::SetViewport(0, 0, width, height);
 
 		Window::GetRenderPipeline()->SetWindowWidth(width);
 		Window::GetRenderPipeline()->SetWindowHeight(height);
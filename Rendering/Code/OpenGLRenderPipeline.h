@@ -3,6 +3,8 @@
 #include "RenderPipeline.h"
 
 #include "Water.h"
+#include "RenderCommandQueue.h"
+#include "AsyncReadback.h"
 
 #include <mutex>
 #include <glad/glad.h>
@@ -13,6 +15,7 @@ namespace Rendering
 	{
 		class VertexArrayObject;
 		class VertexBufferObject;
+		class UniformBufferObject;
 	}
 
 	namespace ShaderPrograms
@@ -23,9 +26,12 @@ namespace Rendering
 	namespace Texture
 	{
 		class Texture2D;
+		class VideoTexture;
 	}
 
 	class Skybox;
+	class SkyboxLibrary;
+	class AsyncReadback;
 
 	// -----------------------------------------
 
@@ -63,7 +69,7 @@ namespace Rendering
 		unsigned int      QueryCurrentlyBoundTextureID(GLenum textureUnit);
 
 		void              SetActiveShader(unsigned int shaderID);
-		unsigned int      QueryCurrentlyActiveShaderID() { return mShaderIDBound; }
+		unsigned int      QueryCurrentlyActiveShaderID();
 
 		void              SetLineModeEnabled(bool state);
 		void              SetDepthTestEnabled(bool state);
@@ -73,11 +79,16 @@ namespace Rendering
 		void              SetAlphaBlendingFunction(GLenum sFactor, GLenum dFactor);
 
 		void              SetBackFaceCulling(bool state);
+		void              SetCullFaceMode(GLenum mode);
 
-		void              ResetTextureBindingInfo();
+		// Uploads the camera block shared by every shader at UniformBlockBindings::PerFrameCamera
+		void              UpdatePerFrameCameraBlock(const glm::mat4& viewMat, const glm::mat4& projectionMat, const glm::vec3& cameraPosition, float nearDistance, float farDistance);
 
 		void              RenderDebugMenu();
 
+		// Reads issued through here are collected at the end of Render
+		AsyncReadback*    GetAsyncReadback() const { return mAsyncReadback; }
+
 		// -------------------------------------------- //
 
 		bool              SetupGLFW()     override;
@@ -90,20 +101,12 @@ namespace Rendering
 		// -------------------------------------------- //
 
 	private:
-		std::vector<std::pair<GLenum, unsigned int>> mTextureUnitBindings;
-		unsigned int                                 mShaderIDBound;
-
-		bool                                         mLineModeEnabled;
-		bool                                         mDepthTestEnabled;
-		GLenum                                       mDepthFunction;
-
-		bool                                         mAlphaBlendingEnabled;
-		GLenum                                       mAlphaBlendingSFactor;
-		GLenum                                       mAlphaBlendingDFactor;
+		ShaderPrograms::ShaderProgram*               mFinalRenderProgram;
 
-		bool                                         mBackFaceCullingEnabled;
+		Buffers::UniformBufferObject*                mPerFrameCameraUBO;
 
-		ShaderPrograms::ShaderProgram*               mFinalRenderProgram;
+		// Everything drawn into the final render buffer is recorded here and replayed in sorted order
+		RenderCommandQueue                           mRenderCommandQueue;
 
 		Buffers::VertexArrayObject*                  mVAOVideo;
 		Buffers::VertexBufferObject*                 mVBOVideo;
@@ -114,7 +117,19 @@ namespace Rendering
 		// ---------------------------------------------------------------- //
 
 		WaterSimulation*    mWaterSimulation;
-		Skybox*             mSkybox;
+		SkyboxLibrary*      mSkyboxLibrary;
+		Skybox*             mSkybox;            // The library's active set, refreshed every frame
+
+		Texture::VideoTexture* mVideoTexture;
+
+		AsyncReadback*      mAsyncReadback;
+
+		// Debug picking - the colour under the mouse, read back without stalling and shown in the GL state window
+		bool                        mPixelProbeEnabled;
+		std::future<ReadbackResult> mPixelProbe;        // Only one in flight at a time, so a slow readback is never queued behind another
+		unsigned char               mProbedColour[3];
+		int                         mProbedPixel[2];    // The last pixel asked for, which the colour lags by the readback latency
+		bool                        mProbedColourValid;
 
 		BufferViewOverrideTypes mDebugVisualisationOverride;
 
@@ -124,7 +139,10 @@ namespace Rendering
 
 		// ---------------------------------------------------------------- //
 
-		void FinalRenderToScreen();		
+		void FinalRenderToScreen();
+
+		// Collects the last probe if it has landed and asks for the pixel now under the mouse - called once the frame is drawn
+		void UpdatePixelProbe();		
 		void SetupShaders();
 
 		// -------------------------------------------- //
@@ -0,0 +1,406 @@
+#include "RenderCommandQueue.h"
+
+#include "GLStateCache.h"
+#include "GLErrorChecking.h"
+#include "TextureResidency.h"
+
+#include "Maths/Code/AssertMsg.h"
+#include "Maths/Code/FNVHash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Rendering
+{
+	// ---------------------------------------------
+
+	RenderCommand::RenderCommand()
+		: mSortKey(0)
+		, mType(RenderCommandType::DrawArrays)
+		, mTextureCount(0)
+		, mStateFlags(kRenderStateDefault)
+		, mProgramID(0)
+		, mVertexArrayID(0)
+		, mTextures()
+	{
+		std::memset(&mDraw, 0, sizeof(RenderDrawParameters));
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommand::AddTexture(unsigned int unit, unsigned int textureID, bool isCubeMap)
+	{
+		ASSERTMSG(mTextureCount >= kMaxTextures, "Too many textures for a single render command");
+
+		if (mTextureCount >= kMaxTextures)
+			return;
+
+		mTextures[mTextureCount].mTextureID = textureID;
+		mTextures[mTextureCount].mUnit      = (unsigned short)unit;
+		mTextures[mTextureCount].mIsCubeMap = isCubeMap ? 1 : 0;
+
+		mTextureCount++;
+	}
+
+	// ---------------------------------------------
+
+	namespace RenderSortKey
+	{
+		static const unsigned int kPassBits    = 4;
+		static const unsigned int kProgramBits = 12;
+		static const unsigned int kTextureBits = 16;
+		static const unsigned int kDepthBits   = 24;
+
+		static const unsigned int kPassShift   = 60;
+
+		// ---------------------------------------------
+
+		unsigned long long Make(RenderPass pass, unsigned int programID, unsigned int textureSet, float normalisedDepth)
+		{
+			normalisedDepth = std::min(std::max(normalisedDepth, 0.0f), 1.0f);
+
+			const unsigned long long depth   = (unsigned long long)(normalisedDepth * (float)((1u << kDepthBits) - 1));
+			const unsigned long long program = programID  & ((1u << kProgramBits) - 1);
+			const unsigned long long texture = textureSet & ((1u << kTextureBits) - 1);
+
+			unsigned long long key = ((unsigned long long)pass & ((1u << kPassBits) - 1)) << kPassShift;
+
+			if (pass == RenderPass::Transparent)
+			{
+				// Back to front matters more than state changes when blending
+				const unsigned long long invertedDepth = ((1u << kDepthBits) - 1) - depth;
+
+				key |= invertedDepth << 36;
+				key |= program       << 24;
+				key |= texture       << 8;
+			}
+			else
+			{
+				key |= program       << 48;
+				key |= texture       << 32;
+				key |= depth         << 8;
+			}
+
+			return key;
+		}
+
+		// ---------------------------------------------
+
+		unsigned int HashTextures(const RenderCommand& command)
+		{
+			if (command.mTextureCount == 0)
+				return 0;
+
+			unsigned int hash = Engine::FNV::Hash((const char*)command.mTextures, (unsigned int)(command.mTextureCount * sizeof(RenderCommandTexture)));
+
+			// Fold the top half in rather than throwing it away
+			return (hash ^ (hash >> 16)) & 0xFFFF;
+		}
+
+		// ---------------------------------------------
+
+		unsigned long long SetDepth(unsigned long long key, float normalisedDepth)
+		{
+			normalisedDepth = std::min(std::max(normalisedDepth, 0.0f), 1.0f);
+
+			const unsigned long long depthMask = (1u << kDepthBits) - 1;
+			const unsigned long long depth     = (unsigned long long)(normalisedDepth * (float)depthMask);
+
+			if (GetPass(key) == RenderPass::Transparent)
+				return (key & ~(depthMask << 36)) | ((depthMask - depth) << 36);
+
+			return (key & ~(depthMask << 8)) | (depth << 8);
+		}
+
+		// ---------------------------------------------
+
+		RenderPass GetPass(unsigned long long key)
+		{
+			return (RenderPass)(key >> kPassShift);
+		}
+	}
+
+	// ---------------------------------------------
+
+	RenderCommandList::RenderCommandList()
+		: mCommands()
+		, mCallbacks()
+	{
+
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandList::AddDrawArrays(const RenderCommand& state, GLenum primitive, unsigned int firstVertex, unsigned int vertexCount)
+	{
+		RenderCommand command = state;
+
+		command.mType                 = RenderCommandType::DrawArrays;
+		command.mDraw.mPrimitive      = primitive;
+		command.mDraw.mFirst          = firstVertex;
+		command.mDraw.mCount          = vertexCount;
+		command.mDraw.mBaseVertex     = 0;
+		command.mDraw.mInstanceCount  = 1;
+		command.mDraw.mBaseInstance   = 0;
+
+		mCommands.push_back(command);
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandList::AddDrawElements(const RenderCommand& state, GLenum primitive, unsigned int indexCount, unsigned int firstIndex, int baseVertex, unsigned int instanceCount, unsigned int baseInstance)
+	{
+		RenderCommand command = state;
+
+		// The patch size is set by the caller for GL_PATCHES, so only the draw fields are written here
+		command.mType                 = RenderCommandType::DrawElements;
+		command.mDraw.mPrimitive      = primitive;
+		command.mDraw.mCount          = indexCount;
+		command.mDraw.mFirst          = firstIndex;
+		command.mDraw.mBaseVertex     = baseVertex;
+		command.mDraw.mInstanceCount  = instanceCount;
+		command.mDraw.mBaseInstance   = baseInstance;
+
+		mCommands.push_back(command);
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandList::AddDrawElementsIndirect(const RenderCommand& state, GLenum primitive, unsigned int commandBufferID, unsigned int countBufferID, unsigned int maxDrawCount)
+	{
+		RenderCommand command = state;
+
+		command.mType                      = RenderCommandType::DrawElementsIndirect;
+		command.mIndirect.mPrimitive       = primitive;
+		command.mIndirect.mCommandBufferID = commandBufferID;
+		command.mIndirect.mCountBufferID   = countBufferID;
+		command.mIndirect.mMaxDrawCount    = maxDrawCount;
+
+		mCommands.push_back(command);
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandList::AddDispatchCompute(unsigned long long sortKey, unsigned int programID, unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
+	{
+		RenderCommand command;
+
+		command.mSortKey              = sortKey;
+		command.mType                 = RenderCommandType::DispatchCompute;
+		command.mProgramID            = programID;
+		command.mDispatch.mGroups[0]  = groupsX;
+		command.mDispatch.mGroups[1]  = groupsY;
+		command.mDispatch.mGroups[2]  = groupsZ;
+
+		mCommands.push_back(command);
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandList::AddMemoryBarrier(unsigned long long sortKey, GLbitfield barrierBits)
+	{
+		RenderCommand command;
+
+		command.mSortKey     = sortKey;
+		command.mType        = RenderCommandType::MemoryBarrier;
+		command.mBarrierBits = barrierBits;
+
+		mCommands.push_back(command);
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandList::AddCallback(unsigned long long sortKey, std::function<void()> callback)
+	{
+		RenderCommand command;
+
+		command.mSortKey       = sortKey;
+		command.mType          = RenderCommandType::Callback;
+		command.mCallbackIndex = (unsigned int)mCallbacks.size();
+
+		mCallbacks.push_back(std::move(callback));
+		mCommands.push_back(command);
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandList::Clear()
+	{
+		mCommands.clear();
+		mCallbacks.clear();
+	}
+
+	// ---------------------------------------------
+
+	RenderCommandQueue::RenderCommandQueue()
+		: mSubmitLock()
+		, mCommands()
+		, mCallbacks()
+		, mExecutingCommands()
+		, mExecutingCallbacks()
+		, mSortEntries()
+		, mLastExecutedCommandCount(0)
+	{
+
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandQueue::Submit(RenderCommandList& list)
+	{
+		std::lock_guard<std::mutex> lock(mSubmitLock);
+
+		const unsigned int callbackOffset = (unsigned int)mCallbacks.size();
+
+		for (unsigned int i = 0; i < list.mCommands.size(); i++)
+		{
+			RenderCommand& command = list.mCommands[i];
+
+			if (command.mType == RenderCommandType::Callback)
+				command.mCallbackIndex += callbackOffset;
+
+			mCommands.push_back(command);
+		}
+
+		for (unsigned int i = 0; i < list.mCallbacks.size(); i++)
+		{
+			mCallbacks.push_back(std::move(list.mCallbacks[i]));
+		}
+
+		list.Clear();
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandQueue::Execute()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mSubmitLock);
+
+			mExecutingCommands.swap(mCommands);
+			mExecutingCallbacks.swap(mCallbacks);
+		}
+
+		mSortEntries.resize(mExecutingCommands.size());
+
+		for (unsigned int i = 0; i < mExecutingCommands.size(); i++)
+		{
+			mSortEntries[i].mSortKey      = mExecutingCommands[i].mSortKey;
+			mSortEntries[i].mCommandIndex = i;
+
+			// Any reload happens here, before the replay, rather than inside the binds it makes
+			for (unsigned int j = 0; j < mExecutingCommands[i].mTextureCount; j++)
+			{
+				TextureResidency::EnsureResident(mExecutingCommands[i].mTextures[j].mTextureID);
+			}
+		}
+
+		// Stable so that commands recorded with the same key, such as a dispatch and its barrier, stay in submission order
+		std::stable_sort(mSortEntries.begin(), mSortEntries.end(), [](const SortEntry& a, const SortEntry& b)
+		{
+			return a.mSortKey < b.mSortKey;
+		});
+
+		for (unsigned int i = 0; i < mSortEntries.size(); i++)
+		{
+			ExecuteCommand(mExecutingCommands[mSortEntries[i].mCommandIndex]);
+		}
+
+		mLastExecutedCommandCount = (unsigned int)mExecutingCommands.size();
+
+		mExecutingCommands.clear();
+		mExecutingCallbacks.clear();
+
+		// Leave the defaults the rest of the frame expects
+		GLStateCache::SetPolygonMode(GL_FILL);
+		GLStateCache::SetDepthFunction(GL_LESS);
+		GLStateCache::SetCapability(GL_DEPTH_TEST, true);
+		GLStateCache::SetCapability(GL_CULL_FACE,  true);
+		GLStateCache::SetCapability(GL_BLEND,      false);
+		GLStateCache::BindVertexArray(0);
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandQueue::ApplyState(const RenderCommand& command)
+	{
+		GLStateCache::BindProgram(command.mProgramID);
+		GLStateCache::BindVertexArray(command.mVertexArrayID);
+
+		for (unsigned int i = 0; i < command.mTextureCount; i++)
+		{
+			const RenderCommandTexture& texture = command.mTextures[i];
+
+			GLStateCache::BindTexture(texture.mUnit, texture.mIsCubeMap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, texture.mTextureID);
+		}
+
+		const unsigned int flags = command.mStateFlags;
+
+		GLStateCache::SetCapability(GL_DEPTH_TEST, (flags & kRenderStateDepthTest)       != 0);
+		GLStateCache::SetCapability(GL_CULL_FACE,  (flags & kRenderStateBackFaceCulling) != 0);
+		GLStateCache::SetCapability(GL_BLEND,      (flags & kRenderStateAlphaBlending)   != 0);
+
+		GLStateCache::SetDepthFunction((flags & kRenderStateDepthLessEqual) ? GL_LEQUAL : GL_LESS);
+		GLStateCache::SetPolygonMode(  (flags & kRenderStateWireframe)      ? GL_LINE   : GL_FILL);
+	}
+
+	// ---------------------------------------------
+
+	void RenderCommandQueue::ExecuteCommand(const RenderCommand& command)
+	{
+		switch (command.mType)
+		{
+		case RenderCommandType::DrawArrays:
+			ApplyState(command);
+
+			glDrawArraysInstancedBaseInstance(command.mDraw.mPrimitive, command.mDraw.mFirst, command.mDraw.mCount, command.mDraw.mInstanceCount, command.mDraw.mBaseInstance);
+		break;
+
+		case RenderCommandType::DrawElements:
+			ApplyState(command);
+
+			if (command.mDraw.mPrimitive == GL_PATCHES)
+				GLStateCache::SetPatchVertices(command.mDraw.mPatchVertices);
+
+			glDrawElementsInstancedBaseVertexBaseInstance(command.mDraw.mPrimitive, command.mDraw.mCount, GL_UNSIGNED_SHORT, (void*)((size_t)command.mDraw.mFirst * sizeof(unsigned short)),
+			                                              command.mDraw.mInstanceCount, command.mDraw.mBaseVertex, command.mDraw.mBaseInstance);
+		break;
+
+		case RenderCommandType::DrawElementsIndirect:
+			ApplyState(command);
+
+			GLStateCache::BindBuffer(GL_DRAW_INDIRECT_BUFFER, command.mIndirect.mCommandBufferID);
+
+			if (command.mIndirect.mCountBufferID != 0)
+			{
+				GLStateCache::BindBuffer(GL_PARAMETER_BUFFER, command.mIndirect.mCountBufferID);
+
+				glMultiDrawElementsIndirectCount(command.mIndirect.mPrimitive, GL_UNSIGNED_SHORT, 0, 0, (GLsizei)command.mIndirect.mMaxDrawCount, 0);
+			}
+			else
+			{
+				glMultiDrawElementsIndirect(command.mIndirect.mPrimitive, GL_UNSIGNED_SHORT, 0, (GLsizei)command.mIndirect.mMaxDrawCount, 0);
+			}
+		break;
+
+		case RenderCommandType::DispatchCompute:
+			GLStateCache::BindProgram(command.mProgramID);
+
+			glDispatchCompute(command.mDispatch.mGroups[0], command.mDispatch.mGroups[1], command.mDispatch.mGroups[2]);
+		break;
+
+		case RenderCommandType::MemoryBarrier:
+			glMemoryBarrier(command.mBarrierBits);
+		break;
+
+		case RenderCommandType::Callback:
+			if (command.mCallbackIndex < mExecutingCallbacks.size() && mExecutingCallbacks[command.mCallbackIndex])
+				mExecutingCallbacks[command.mCallbackIndex]();
+		break;
+		}
+
+		GL_CHECK_ERROR("Error executing render command");
+	}
+
+	// ---------------------------------------------
+}
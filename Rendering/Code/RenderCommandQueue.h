@@ -0,0 +1,209 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <functional>
+#include <mutex>
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	// Coarse ordering of the frame - the pass is the top of the sort key so nothing from a later pass is drawn before an earlier one
+	enum class RenderPass : unsigned int
+	{
+		Compute = 0,
+		Opaque,
+		Sky,         // After the opaque pass so that the depth test rejects everything already covered
+		Transparent,
+
+		Count
+	};
+
+	// ---------------------------------------
+
+	enum class RenderCommandType : unsigned char
+	{
+		DrawArrays = 0,
+		DrawElements,
+		DrawElementsIndirect,
+		DispatchCompute,
+		MemoryBarrier,
+		Callback          // Anything that is not a plain draw, such as uniform uploads, run on the render thread at its sorted position
+	};
+
+	// ---------------------------------------
+
+	// Raster state packed into the command, applied through GLStateCache when the command is replayed
+	enum RenderStateFlags : unsigned int
+	{
+		kRenderStateDepthTest       = 1 << 0,
+		kRenderStateDepthLessEqual  = 1 << 1,
+		kRenderStateBackFaceCulling = 1 << 2,
+		kRenderStateAlphaBlending   = 1 << 3,
+		kRenderStateWireframe       = 1 << 4,
+
+		kRenderStateDefault         = kRenderStateDepthTest | kRenderStateBackFaceCulling
+	};
+
+	// ---------------------------------------
+
+	struct RenderCommandTexture
+	{
+		unsigned int   mTextureID;
+		unsigned short mUnit;      // 0 for GL_TEXTURE0
+		unsigned short mIsCubeMap;
+	};
+
+	// ---------------------------------------
+
+	struct RenderDrawParameters
+	{
+		GLenum       mPrimitive;
+		unsigned int mCount;
+		unsigned int mFirst;         // First vertex for arrays, first index for elements
+		int          mBaseVertex;
+		unsigned int mInstanceCount;
+		unsigned int mBaseInstance;
+		unsigned int mPatchVertices; // Only read for GL_PATCHES
+	};
+
+	struct RenderIndirectParameters
+	{
+		GLenum       mPrimitive;
+		unsigned int mCommandBufferID;
+		unsigned int mCountBufferID; // Zero when every slot in the command buffer is submitted
+		unsigned int mMaxDrawCount;
+	};
+
+	struct RenderDispatchParameters
+	{
+		unsigned int mGroups[3];
+	};
+
+	// ---------------------------------------
+
+	// One draw, dispatch or callback - kept as plain data so it can be built on any thread without touching GL
+	struct RenderCommand
+	{
+		static const unsigned int kMaxTextures = 6;
+
+		RenderCommand();
+
+		void AddTexture(unsigned int unit, unsigned int textureID, bool isCubeMap = false);
+
+		unsigned long long   mSortKey;
+
+		RenderCommandType    mType;
+		unsigned char        mTextureCount;
+
+		unsigned int         mStateFlags;
+
+		unsigned int         mProgramID;
+		unsigned int         mVertexArrayID;
+
+		RenderCommandTexture mTextures[kMaxTextures];
+
+		union
+		{
+			RenderDrawParameters     mDraw;
+			RenderIndirectParameters mIndirect;
+			RenderDispatchParameters mDispatch;
+			GLbitfield               mBarrierBits;
+			unsigned int             mCallbackIndex;
+		};
+	};
+
+	// ---------------------------------------
+
+	// Builds the 64 bit keys the queue is sorted by:
+	// | pass (4) | program (12) | texture set (16) | depth (24) | unused (8) |
+	// The transparent pass swaps the depth to the top and inverts it, so those commands are drawn back to front
+	namespace RenderSortKey
+	{
+		// normalisedDepth is the distance from the camera divided by the far distance
+		unsigned long long Make(RenderPass pass, unsigned int programID, unsigned int textureSet, float normalisedDepth);
+
+		// Folds the command's texture IDs down to the 16 bits stored in the key
+		unsigned int       HashTextures(const RenderCommand& command);
+
+		// Replaces just the depth part of a key built by Make, for commands that share state but sit at different distances
+		unsigned long long SetDepth(unsigned long long key, float normalisedDepth);
+
+		RenderPass         GetPass(unsigned long long key);
+	}
+
+	// ---------------------------------------
+
+	// Commands recorded by a single thread - not thread safe, each recording thread uses its own list and submits it when done
+	class RenderCommandList final
+	{
+	public:
+		RenderCommandList();
+
+		void AddDrawArrays(const RenderCommand& state, GLenum primitive, unsigned int firstVertex, unsigned int vertexCount);
+		// Every index buffer in the renderer is 16 bit, so that is what the element draws assume
+		void AddDrawElements(const RenderCommand& state, GLenum primitive, unsigned int indexCount, unsigned int firstIndex, int baseVertex = 0, unsigned int instanceCount = 1, unsigned int baseInstance = 0);
+		void AddDrawElementsIndirect(const RenderCommand& state, GLenum primitive, unsigned int commandBufferID, unsigned int countBufferID, unsigned int maxDrawCount);
+
+		void AddDispatchCompute(unsigned long long sortKey, unsigned int programID, unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
+		void AddMemoryBarrier(unsigned long long sortKey, GLbitfield barrierBits);
+		void AddCallback(unsigned long long sortKey, std::function<void()> callback);
+
+		unsigned int GetCommandCount() const { return (unsigned int)mCommands.size(); }
+
+		void Clear();
+
+	private:
+		friend class RenderCommandQueue;
+
+		std::vector<RenderCommand>         mCommands;
+		std::vector<std::function<void()>> mCallbacks;
+	};
+
+	// ---------------------------------------
+
+	// Collects the lists recorded for a frame, then on the render thread sorts every command by key and replays them into GL
+	// All state goes through GLStateCache, so commands that share a program, VAO or textures after sorting do not rebind them
+	class RenderCommandQueue final
+	{
+	public:
+		RenderCommandQueue();
+
+		// Safe to call from any thread - the list is left empty
+		void         Submit(RenderCommandList& list);
+
+		// Render thread only - the lock is only held while the pending commands are taken, so a callback may Submit,
+		// which queues for the next Execute
+		void         Execute();
+
+		unsigned int GetLastExecutedCommandCount() const { return mLastExecutedCommandCount; }
+
+	private:
+		void         ApplyState(const RenderCommand& command);
+		void         ExecuteCommand(const RenderCommand& command);
+
+		struct SortEntry
+		{
+			unsigned long long mSortKey;
+			unsigned int       mCommandIndex;
+		};
+
+		std::mutex                         mSubmitLock;
+
+		std::vector<RenderCommand>         mCommands;
+		std::vector<std::function<void()>> mCallbacks;
+
+		// Swapped with the pending ones at the start of Execute, and kept between frames so neither side allocates
+		std::vector<RenderCommand>         mExecutingCommands;
+		std::vector<std::function<void()>> mExecutingCallbacks;
+
+		// Kept between frames so the sort does not allocate
+		std::vector<SortEntry>             mSortEntries;
+
+		unsigned int                       mLastExecutedCommandCount;
+	};
+
+	// ---------------------------------------
+}
@@ -0,0 +1,385 @@
+#include "ComputeKernel.h"
+
+#include "ShaderProgram.h"
+#include "ShaderProgramBatch.h"
+#include "ShaderBinaryCache.h"
+#include "Shader.h"
+
+#include "Maths/Code/FNVHash.h"
+
+#include "Rendering/Code/GLErrorChecking.h"
+
+#include <glad/glad.h>
+
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace Rendering
+{
+	namespace ShaderPrograms
+	{
+		// ---------------------------------------------
+
+		// 64 and 256 invocations, as square tiles and as rows, which between them cover what the common desktop GPUs prefer
+		const WorkgroupSize ComputeKernel::kCandidateSizes[ComputeKernel::kCandidateCount] = { { 8, 8 }, { 16, 16 }, { 32, 8 }, { 64, 1 } };
+
+		std::unordered_map<unsigned int, WorkgroupSize> ComputeKernel::sStoredSizes;
+		bool                                            ComputeKernel::sStoredSizesLoaded = false;
+
+		static const char kStoredSizesFileName[] = "WorkgroupSizes.txt";
+
+		// Largest total required by GL 4.3 - anything read from disk above this is ignored
+		static const unsigned int kMaxWorkgroupInvocations = 1024;
+
+		// ---------------------------------------------
+
+		ComputeKernel::ComputeKernel(const std::string& filePath)
+			: mFilePath(filePath)
+			, mSizes(kCandidateSizes, kCandidateSizes + kCandidateCount)
+			, mVariants()
+			, mSelected(0)
+			, mTuned(false)
+			, mTunedTimeMs(0.0f)
+			, mTuningKey(0)
+			, mSpecialisations()
+			, mActiveSpecialisation(nullptr)
+			, mTiming(false)
+			, mTimerQueries()
+		{
+
+		}
+
+		// ---------------------------------------------
+
+		ComputeKernel::ComputeKernel(const std::string& filePath, WorkgroupSize fixedSize)
+			: mFilePath(filePath)
+			, mSizes(1, fixedSize)
+			, mVariants()
+			, mSelected(0)
+			, mTuned(true)
+			, mTunedTimeMs(0.0f)
+			, mTuningKey(0)
+			, mSpecialisations()
+			, mActiveSpecialisation(nullptr)
+			, mTiming(false)
+			, mTimerQueries()
+		{
+
+		}
+
+		// ---------------------------------------------
+
+		ComputeKernel::~ComputeKernel()
+		{
+			for (unsigned int i = 0; i < mVariants.size(); i++)
+			{
+				delete mVariants[i];
+			}
+
+			mVariants.clear();
+
+			for (std::unordered_map<unsigned int, ShaderProgram*>::iterator specialisation = mSpecialisations.begin(); specialisation != mSpecialisations.end(); ++specialisation)
+			{
+				delete specialisation->second;
+			}
+
+			mSpecialisations.clear();
+			mActiveSpecialisation = nullptr;
+		}
+
+		// ---------------------------------------------
+
+		void ComputeKernel::AddToBatch(ShaderProgramBatch& batch)
+		{
+			if (!mVariants.empty())
+				return;
+
+			// Read once up front so the tuning key is taken from the source as written, before any defines are added
+			Shaders::ComputeShader* firstShader = new Shaders::ComputeShader(mFilePath);
+
+			if (!mTuned)
+			{
+				std::string keySource = std::to_string(ShaderBinaryCache::GetDriverHash()) + "|" + mFilePath + "|" + firstShader->GetSource();
+				mTuningKey            = Engine::FNV::Hash(keySource.c_str());
+
+				WorkgroupSize storedSize;
+
+				if (LoadStoredSize(mTuningKey, storedSize))
+				{
+					mSizes.assign(1, storedSize);
+					mTuned = true;
+				}
+			}
+
+			mVariants.assign(mSizes.size(), nullptr);
+			mSelected = 0;
+
+			for (unsigned int i = 0; i < mSizes.size(); i++)
+			{
+				Shaders::ComputeShader* shader = (i == 0) ? firstShader : new Shaders::ComputeShader(mFilePath);
+
+				shader->AddDefine("WORKGROUP_SIZE_X", std::to_string(mSizes[i].mX));
+				shader->AddDefine("WORKGROUP_SIZE_Y", std::to_string(mSizes[i].mY));
+
+				mVariants[i] = new ShaderProgram();
+
+				batch.Add(mVariants[i], { shader });
+			}
+		}
+
+		// ---------------------------------------------
+
+		void ComputeKernel::Dispatch(unsigned int width, unsigned int height)
+		{
+			const WorkgroupSize& size = mSizes[mSelected];
+
+			unsigned int groupsX = (width  + size.mX - 1) / size.mX;
+			unsigned int groupsY = (height + size.mY - 1) / size.mY;
+
+			if (!mTiming)
+			{
+				glDispatchCompute(groupsX, groupsY, 1);
+
+				GL_CHECK_ERROR("Error dispatching compute kernel");
+
+				return;
+			}
+
+			unsigned int query = 0;
+			glGenQueries(1, &query);
+
+			glBeginQuery(GL_TIME_ELAPSED, query);
+				glDispatchCompute(groupsX, groupsY, 1);
+			glEndQuery(GL_TIME_ELAPSED);
+
+			GL_CHECK_ERROR("Error timing compute kernel");
+
+			mTimerQueries.push_back(query);
+		}
+
+		// ---------------------------------------------
+
+		void ComputeKernel::Tune(const std::function<void()>& runPass)
+		{
+			if (mTuned || mVariants.empty())
+				return;
+
+			unsigned int bestIndex = mSelected;
+			GLuint64     bestTime  = std::numeric_limits<GLuint64>::max();
+
+			for (unsigned int i = 0; i < mVariants.size(); i++)
+			{
+				if (!mVariants[i])
+					continue;
+
+				// A size the driver can not build is never picked
+				int linked = 0;
+				glGetProgramiv(mVariants[i]->GetId(), GL_LINK_STATUS, &linked);
+
+				if (!linked)
+					continue;
+
+				mSelected = i;
+
+				// The first dispatch of a program can include driver work that the later ones do not
+				runPass();
+
+				mTiming = true;
+
+				for (unsigned int repeat = 0; repeat < kTuningRepeats; repeat++)
+				{
+					runPass();
+				}
+
+				mTiming = false;
+
+				// Reading the results blocks until the GPU has caught up, which is fine as this only happens at startup
+				GLuint64 totalTime = 0;
+
+				for (unsigned int query = 0; query < mTimerQueries.size(); query++)
+				{
+					GLuint64 elapsed = 0;
+					glGetQueryObjectui64v(mTimerQueries[query], GL_QUERY_RESULT, &elapsed);
+
+					totalTime += elapsed;
+				}
+
+				if (!mTimerQueries.empty())
+				{
+					glDeleteQueries((GLsizei)mTimerQueries.size(), mTimerQueries.data());
+					mTimerQueries.clear();
+				}
+
+				if (totalTime < bestTime)
+				{
+					bestTime  = totalTime;
+					bestIndex = i;
+				}
+			}
+
+			if (bestTime == std::numeric_limits<GLuint64>::max())
+			{
+				mSelected = bestIndex;
+				return;
+			}
+
+			mTunedTimeMs = (float)((double)bestTime / 1000000.0 / (double)kTuningRepeats);
+
+			DeleteVariants(bestIndex);
+
+			mTuned = true;
+
+			StoreSize(mTuningKey, mSizes[mSelected]);
+		}
+
+		// ---------------------------------------------
+
+		bool ComputeKernel::Specialise(const Shaders::ShaderDefines& defines)
+		{
+			if (!mTuned || mVariants.empty())
+				return false;
+
+			if (defines.GetIsEmpty())
+			{
+				mActiveSpecialisation = nullptr;
+				return true;
+			}
+
+			unsigned int key = defines.GetKey();
+
+			std::unordered_map<unsigned int, ShaderProgram*>::const_iterator existing = mSpecialisations.find(key);
+
+			if (existing != mSpecialisations.end())
+			{
+				mActiveSpecialisation = existing->second;
+				return true;
+			}
+
+			if (mSpecialisations.size() >= kMaxSpecialisations)
+			{
+				mActiveSpecialisation = nullptr;
+				return true;
+			}
+
+			// Built straight away as the caller is about to dispatch with it - the binary cache makes this a load on every launch after the first
+			Shaders::ComputeShader* shader = new Shaders::ComputeShader(mFilePath);
+
+			shader->SetDefines(defines);
+			shader->AddDefine("WORKGROUP_SIZE_X", std::to_string(mSizes[mSelected].mX));
+			shader->AddDefine("WORKGROUP_SIZE_Y", std::to_string(mSizes[mSelected].mY));
+
+			ShaderProgram* program = new ShaderProgram();
+
+			ShaderProgramBatch batch;
+			batch.Add(program, { shader });
+
+			if (!batch.LinkAll())
+			{
+				delete program;
+				program = nullptr;
+			}
+
+			mSpecialisations[key] = program;
+			mActiveSpecialisation = program;
+
+			return true;
+		}
+
+		// ---------------------------------------------
+
+		void ComputeKernel::DeleteVariants(unsigned int keepIndex)
+		{
+			WorkgroupSize  keptSize    = mSizes[keepIndex];
+			ShaderProgram* keptProgram = mVariants[keepIndex];
+
+			for (unsigned int i = 0; i < mVariants.size(); i++)
+			{
+				if (i != keepIndex)
+					delete mVariants[i];
+			}
+
+			mSizes.assign(1, keptSize);
+			mVariants.assign(1, keptProgram);
+
+			mSelected = 0;
+		}
+
+		// ---------------------------------------------
+
+		std::string ComputeKernel::GetStoredSizesFilePath()
+		{
+			return std::string(ShaderBinaryCache::GetCacheDirectory()) + kStoredSizesFileName;
+		}
+
+		// ---------------------------------------------
+
+		bool ComputeKernel::LoadStoredSize(unsigned int key, WorkgroupSize& size)
+		{
+			if (!sStoredSizesLoaded)
+			{
+				sStoredSizesLoaded = true;
+
+				// One "key x y" line per kernel
+				std::ifstream file(GetStoredSizesFilePath());
+
+				unsigned int  storedKey = 0;
+				WorkgroupSize storedSize;
+
+				while (file >> storedKey >> storedSize.mX >> storedSize.mY)
+				{
+					if (storedSize.mX == 0 || storedSize.mY == 0 || storedSize.mX * storedSize.mY > kMaxWorkgroupInvocations)
+						continue;
+
+					sStoredSizes[storedKey] = storedSize;
+				}
+			}
+
+			std::unordered_map<unsigned int, WorkgroupSize>::const_iterator entry = sStoredSizes.find(key);
+
+			if (entry == sStoredSizes.end())
+				return false;
+
+			size = entry->second;
+
+			return true;
+		}
+
+		// ---------------------------------------------
+
+		void ComputeKernel::StoreSize(unsigned int key, WorkgroupSize size)
+		{
+			sStoredSizes[key] = size;
+
+			std::error_code error;
+			std::filesystem::create_directories(ShaderBinaryCache::GetCacheDirectory(), error);
+
+			std::string filePath      = GetStoredSizesFilePath();
+			std::string temporaryPath = filePath + ".tmp";
+
+			// Every entry is written back out, so results from other kernels and drivers are kept
+			{
+				std::ofstream file(temporaryPath, std::ios::trunc);
+
+				if (!file.is_open())
+					return;
+
+				for (std::unordered_map<unsigned int, WorkgroupSize>::const_iterator entry = sStoredSizes.begin(); entry != sStoredSizes.end(); ++entry)
+				{
+					file << entry->first << " " << entry->second.mX << " " << entry->second.mY << "\n";
+				}
+
+				if (!file.good())
+				{
+					file.close();
+					std::filesystem::remove(temporaryPath, error);
+					return;
+				}
+			}
+
+			std::filesystem::rename(temporaryPath, filePath, error);
+		}
+
+		// ---------------------------------------------
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+namespace Rendering
+{
+	namespace Shaders
+	{
+		class ShaderDefines;
+	}
+
+	namespace ShaderPrograms
+	{
+		class ShaderProgram;
+		class ShaderProgramBatch;
+
+		// -----------------------------------------------
+
+		struct WorkgroupSize
+		{
+			unsigned int mX;
+			unsigned int mY;
+		};
+
+		// -----------------------------------------------
+
+		// A compute shader built once per candidate workgroup size, of which the fastest on this device is kept
+		// The size reaches the shader as WORKGROUP_SIZE_X/Y defines, and every kernel discards invocations outside its output image
+		// so that the group count can be rounded up for any resolution
+		class ComputeKernel final
+		{
+		public:
+			static const unsigned int  kCandidateCount = 4;
+			static const WorkgroupSize kCandidateSizes[kCandidateCount];
+
+			// ---------------------------------------
+
+			// Tuned across every candidate size
+			ComputeKernel(const std::string& filePath);
+
+			// For kernels that only run once, such as building the butterfly texture, where tuning would cost more than it saves
+			ComputeKernel(const std::string& filePath, WorkgroupSize fixedSize);
+
+			~ComputeKernel();
+
+			// Adds only the size chosen on a previous run if this driver has one stored, otherwise every candidate so Tune can pick
+			void                 AddToBatch(ShaderProgramBatch& batch);
+
+			// The active specialisation if there is one, otherwise the generic program at the chosen size
+			ShaderProgram*       GetProgram() const { return mActiveSpecialisation ? mActiveSpecialisation : mVariants[mSelected]; }
+			const WorkgroupSize& GetWorkgroupSize() const { return mSizes[mSelected]; }
+
+			// Rounds the group counts up - the bounds check in the shader handles the partial groups on the far edges
+			void                 Dispatch(unsigned int width, unsigned int height);
+
+			// ---------------------------------------
+
+			// Switches to a build of the kernel with these extra defines, at the chosen workgroup size - empty defines go back to the generic program
+			// Builds are kept by the key of their defines, so switching back to a set used before costs nothing
+			// Returns false while the kernel is still being tuned, in which case the generic program stays in use and the call should be repeated later
+			bool                 Specialise(const Shaders::ShaderDefines& defines);
+
+			unsigned int         GetSpecialisationCount() const { return (unsigned int)mSpecialisations.size(); }
+			bool                 GetIsSpecialised() const       { return mActiveSpecialisation != nullptr; }
+
+			// ---------------------------------------
+
+			bool                 GetNeedsTuning() const { return !mTuned; }
+
+			// Runs the pass once per candidate to warm it up, then kTuningRepeats more times with this kernel's dispatches timed on the GPU
+			// runPass has to go through GetProgram and Dispatch, so that each candidate is timed in the real pass with its real inputs
+			// The losing variants are deleted and the result is written out for the next launch
+			void                 Tune(const std::function<void()>& runPass);
+
+			// Average GPU time per pass of the chosen size, zero when the choice was loaded from disk
+			float                GetTunedTimeMs() const { return mTunedTimeMs; }
+
+			const std::string&   GetFilePath() const { return mFilePath; }
+
+		private:
+			static const unsigned int kTuningRepeats = 8;
+
+			// Each one is a full program, so a value that keeps changing, such as a wave count being dragged around, can not build without limit
+			static const unsigned int kMaxSpecialisations = 16;
+
+			void                 DeleteVariants(unsigned int keepIndex);
+
+			static bool          LoadStoredSize(unsigned int key, WorkgroupSize& size);
+			static void          StoreSize(unsigned int key, WorkgroupSize size);
+
+			static std::string   GetStoredSizesFilePath();
+
+			// ---------------------------------------
+
+			std::string                 mFilePath;
+
+			std::vector<WorkgroupSize>  mSizes;
+			std::vector<ShaderProgram*> mVariants;   // Parallel to mSizes, null for any size that was not built
+
+			unsigned int                mSelected;
+			bool                        mTuned;
+			float                       mTunedTimeMs;
+
+			// Driver and source hashed together, so a driver update or shader edit re-tunes
+			unsigned int                mTuningKey;
+
+			// Keyed by ShaderDefines::GetKey, null for a build that failed so it is not retried every frame
+			std::unordered_map<unsigned int, ShaderProgram*> mSpecialisations;
+			ShaderProgram*                                   mActiveSpecialisation;
+
+			// Filled in by Dispatch while Tune is running
+			bool                        mTiming;
+			std::vector<unsigned int>   mTimerQueries;
+
+			// Key to chosen size, read from disk the first time a kernel is added
+			static std::unordered_map<unsigned int, WorkgroupSize> sStoredSizes;
+			static bool                                            sStoredSizesLoaded;
+		};
+
+		// -----------------------------------------------
+	}
+}
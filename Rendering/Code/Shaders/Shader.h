@@ -1,7 +1,7 @@
 #ifndef _SHADER_H_
 #define _SHADER_H_
 
-// This file contains definitions for a generic Vertex, Fragment, Geomery and Compute shader implementation
+// This file contains definitions for a generic Vertex, Fragment, Geomery, Tessellation and Compute shader implementation
 
 // Required OpenGL headers
 #include <glad/glad.h>
@@ -10,6 +10,10 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <string>
+#include <vector>
+
+#include "ShaderPreprocessor.h"
 
 namespace Rendering
 {
@@ -20,97 +24,149 @@ namespace Rendering
 		class Shader abstract
 		{
 		public:
-			Shader() : mShaderID(0) { ; }
+			Shader() : mShaderID(0), mFilePath(), mFileSource(), mSource(), mDefines(), mIncludedFiles() { ; }
 
-			~Shader() { ; }
+			virtual ~Shader() { DeleteShader(); }
 
 			// --------------------------------------------------
 
+			// Zero until Compile has been called - programs loaded from the binary cache never compile their shaders
 			unsigned int GetShaderID()
 			{
 				return mShaderID;
 			}
 
+			const std::string& GetFilePath() const { return mFilePath; }
+
+			// The text handed to the driver - includes expanded and defines added
+			const std::string& GetSource()   const { return mSource; }
+
+			const ShaderDefines& GetDefines() const { return mDefines; }
+
+			// Identifies which variant of the file this is, zero for the file as written
+			unsigned int GetVariantKey() const { return mDefines.GetKey(); }
+
+			// --------------------------------------------------
+
+			// These have to be called before Compile - the defines go straight after the #version line, which GLSL requires to come first
+			void AddDefine(const std::string& name, const std::string& value)
+			{
+				mDefines.Set(name, value);
+
+				RebuildSource();
+			}
+
+			// Replaces any defines already added
+			void SetDefines(const ShaderDefines& defines)
+			{
+				mDefines = defines;
+
+				RebuildSource();
+			}
+
 			// --------------------------------------------------
 
 			void DeleteShader()
 			{
+				if (mShaderID == 0)
+					return;
+
 				glDeleteShader(mShaderID);
+				mShaderID = 0;
 			}
 
 			// ==================================================
 			// --------------------------------------------------
 
-			unsigned int CreateShader(const std::string& filePath)
+			// Compiles the source read in by the constructor, does nothing if it has already been compiled
+			unsigned int Compile()
 			{
+				if (mShaderID != 0)
+					return mShaderID;
+
 				// Create the shader
 				mShaderID = GenerateShaderID();
 
-				// Set the shader source file
-				std::string shaderSource;
-				LoadInShaderFromFile(filePath, shaderSource);
-
-				const char* sourceCode = shaderSource.c_str();
+				const char* sourceCode = mSource.c_str();
 
 				glShaderSource(mShaderID, 1, &sourceCode, NULL);
 
-				// Compile the shader
+				// Compile the shader - the status is left unchecked so that the driver can carry on compiling in the background
 				glCompileShader(mShaderID);
 
-				CompilationErrorChecking();
-
 				return mShaderID;
 			}
 
-		protected:
 			// -----------------------------------------------------------
 
-			virtual unsigned int GenerateShaderID() = 0;
-
-			void LoadInShaderFromFile(const std::string& filePath, std::string& fileContents)
+			// Blocks until the compile has finished, so is only called once a link using this shader has failed
+			void CompilationErrorChecking()
 			{
-				std::string   shaderCode = "";
-				std::ifstream shaderFile;
+				int  success = 0;
+				char infoLog[512];
 
-				shaderFile.open(filePath);
+				// Get the error state
+				glGetShaderiv(mShaderID, GL_COMPILE_STATUS, &success);
 
-				if (shaderFile.is_open())
+				if (!success)
 				{
-					std::stringstream shaderStream;
-
-					shaderStream << shaderFile.rdbuf();
+					glGetShaderInfoLog(mShaderID, 512, NULL, infoLog);
 
-					shaderFile.close();
+					std::cout << "Error loading shader " << mFilePath << ": " + std::string(infoLog);
 
-					fileContents = shaderStream.str();
-				}
-				else
-				{
-					std::cout << "Failed to open shader: " << filePath << std::endl;
+					// Errors are reported against source string numbers, which the preprocessor gave to each included file in turn
+					if (mIncludedFiles.size() > 1)
+					{
+						for (unsigned int i = 0; i < mIncludedFiles.size(); i++)
+						{
+							std::cout << "  " << i << ": " << mIncludedFiles[i] << std::endl;
+						}
+					}
 				}
 			}
 
+		protected:
 			// -----------------------------------------------------------
 
-			void CompilationErrorChecking()
+			virtual unsigned int GenerateShaderID() = 0;
+
+			// Only reads the file - compiling is left until the program knows whether it has a cached binary
+			void LoadSource(const std::string& filePath)
 			{
-				int  success = 0;
-				char infoLog[512];
+				mFilePath = filePath;
 
-				// Get the error state
-				glGetShaderiv(mShaderID, GL_COMPILE_STATUS, &success);
+				LoadInShaderFromFile(filePath, mFileSource);
 
-				if (!success)
-				{
-					glGetShaderInfoLog(mShaderID, 512, NULL, infoLog);
+				RebuildSource();
+			}
 
-					std::cout << "Error loading shader: " + std::string(infoLog);
-				}
+			// Expands the file's #includes - anything that fails to load is reported by the preprocessor
+			void LoadInShaderFromFile(const std::string& filePath, std::string& fileContents)
+			{
+				ShaderPreprocessor::LoadSource(filePath, fileContents, mIncludedFiles);
+			}
+
+			void RebuildSource()
+			{
+				mSource = mFileSource;
+
+				ShaderPreprocessor::InsertDefines(mSource, mDefines);
 			}
 
 			// -----------------------------------------------------------
 
-			unsigned int mShaderID;
+			unsigned int  mShaderID;
+
+			std::string   mFilePath;
+
+			// After #include expansion but before the defines are added, so the defines can be changed without reading the file again
+			std::string   mFileSource;
+			std::string   mSource;
+
+			ShaderDefines mDefines;
+
+			// Index zero is mFilePath
+			std::vector<std::string> mIncludedFiles;
 		};
 
 		// --------------------------------------------------------------
@@ -124,7 +180,7 @@ namespace Rendering
 
 			VertexShader(const std::string& filePath)
 			{
-				CreateShader(filePath);
+				LoadSource(filePath);
 			}
 
 			// --------------------------------------
@@ -153,7 +209,7 @@ namespace Rendering
 
 			FragmentShader(const std::string& filePath)
 			{
-				CreateShader(filePath);
+				LoadSource(filePath);
 			}
 
 			// ------------------------------------
@@ -181,7 +237,7 @@ namespace Rendering
 
 			GeometryShader(const std::string& filePath)
 			{
-				CreateShader(filePath);
+				LoadSource(filePath);
 			}
 
 			~GeometryShader()
@@ -198,6 +254,54 @@ namespace Rendering
 
 		// --------------------------------------------------------------
 
+		class TessellationControlShader final : public Shader
+		{
+		public:
+			TessellationControlShader() { ; }
+
+			TessellationControlShader(const std::string& filePath)
+			{
+				LoadSource(filePath);
+			}
+
+			~TessellationControlShader()
+			{
+
+			}
+
+		private:
+			unsigned int GenerateShaderID() override
+			{
+				return glCreateShader(GL_TESS_CONTROL_SHADER);
+			}
+		};
+
+		// --------------------------------------------------------------
+
+		class TessellationEvaluationShader final : public Shader
+		{
+		public:
+			TessellationEvaluationShader() { ; }
+
+			TessellationEvaluationShader(const std::string& filePath)
+			{
+				LoadSource(filePath);
+			}
+
+			~TessellationEvaluationShader()
+			{
+
+			}
+
+		private:
+			unsigned int GenerateShaderID() override
+			{
+				return glCreateShader(GL_TESS_EVALUATION_SHADER);
+			}
+		};
+
+		// --------------------------------------------------------------
+
 		class ComputeShader final : public Shader
 		{
 		public:
@@ -205,7 +309,7 @@ namespace Rendering
 
 			ComputeShader(const std::string & filePath)
 			{
-				CreateShader(filePath);
+				LoadSource(filePath);
 			}
 
 			~ComputeShader()
@@ -0,0 +1,295 @@
+#include "ShaderBinaryCache.h"
+
+#include "Shader.h"
+
+#include "Maths/Code/FNVHash.h"
+#include "Maths/Code/MemoryMappedFile.h"
+
+#include <glad/glad.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+namespace Rendering
+{
+	namespace ShaderPrograms
+	{
+		// ---------------------------------------------
+
+		static const char         kShaderCacheDirectory[] = "ShaderCache/";
+		static const char         kShaderCacheMagic[4]    = { 'W', 'S', 'B', 'C' };
+
+		// Bump this whenever the file layout changes
+		static const unsigned int kShaderCacheFileVersion = 2;
+
+		// A context that has been lost reports GL_CONTEXT_LOST on every call, so draining the error queue has to stop somewhere
+		static const unsigned int kMaxErrorsToClear       = 16;
+
+		// ---------------------------------------------
+
+		struct ShaderBinaryCacheHeader
+		{
+			char         mMagic[4];
+			unsigned int mFileVersion;
+			unsigned int mKey;
+			unsigned int mSourceLength;
+			unsigned int mSourceCheck;
+			unsigned int mDriverHash;
+			unsigned int mBinaryFormat;
+			unsigned int mBinaryLength;
+		};
+
+		// ---------------------------------------------
+
+		int          ShaderBinaryCache::sSupported  = -1;
+		unsigned int ShaderBinaryCache::sDriverHash = 0;
+		unsigned int ShaderBinaryCache::sHitCount   = 0;
+		unsigned int ShaderBinaryCache::sMissCount  = 0;
+
+		// ---------------------------------------------
+
+		// Carries on an FNV-1a hash from a previous value, so that several strings can be folded into one key
+		static unsigned int ContinueHash(unsigned int hash, const char* data, size_t length)
+		{
+			return Engine::FNV::Continue(hash, data, length);
+		}
+
+		static unsigned int ContinueHash(unsigned int hash, const GLubyte* string)
+		{
+			if (!string)
+				return hash;
+
+			return ContinueHash(hash, (const char*)string, std::strlen((const char*)string));
+		}
+
+		// sdbm, which shares nothing with FNV-1a, so a text that collides under one is no more likely to collide under the other
+		static unsigned int ContinueCheck(unsigned int check, const char* data, size_t length)
+		{
+			for (size_t i = 0; i < length; i++)
+			{
+				check = (unsigned int)(unsigned char)data[i] + (check << 6) + (check << 16) - check;
+			}
+
+			return check;
+		}
+
+		// ---------------------------------------------
+
+		ShaderBinaryCacheKey::ShaderBinaryCacheKey()
+			: mHash(0)
+			, mSourceLength(0)
+			, mSourceCheck(0)
+		{
+
+		}
+
+		// ---------------------------------------------
+
+		bool ShaderBinaryCache::GetIsSupported()
+		{
+			if (sSupported == -1)
+			{
+				int formatCount = 0;
+				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+				sSupported = formatCount > 0 ? 1 : 0;
+			}
+
+			return sSupported == 1;
+		}
+
+		// ---------------------------------------------
+
+		unsigned int ShaderBinaryCache::GetDriverHash()
+		{
+			if (sDriverHash == 0)
+			{
+				unsigned int hash = Engine::FNV::kFNVOffsetBasis;
+
+				// Binaries are only valid for the exact driver that produced them
+				hash = ContinueHash(hash, glGetString(GL_VENDOR));
+				hash = ContinueHash(hash, glGetString(GL_RENDERER));
+				hash = ContinueHash(hash, glGetString(GL_VERSION));
+
+				sDriverHash = hash;
+			}
+
+			return sDriverHash;
+		}
+
+		// ---------------------------------------------
+
+		const char* ShaderBinaryCache::GetCacheDirectory()
+		{
+			return kShaderCacheDirectory;
+		}
+
+		// ---------------------------------------------
+
+		ShaderBinaryCacheKey ShaderBinaryCache::GenerateKey(const std::vector<Shaders::Shader*>& shaders)
+		{
+			ShaderBinaryCacheKey key;
+
+			if (!GetIsSupported())
+				return key;
+
+			unsigned int hash = GetDriverHash();
+
+			// The path is included so that the same text used for two different stages gives two different keys
+			for (unsigned int i = 0; i < shaders.size(); i++)
+			{
+				const std::string& path   = shaders[i]->GetFilePath();
+				const std::string& source = shaders[i]->GetSource();
+
+				hash = ContinueHash(hash, path.c_str(),   path.size() + 1);
+				hash = ContinueHash(hash, source.c_str(), source.size() + 1);
+
+				key.mSourceCheck   = ContinueCheck(key.mSourceCheck, path.c_str(),   path.size() + 1);
+				key.mSourceCheck   = ContinueCheck(key.mSourceCheck, source.c_str(), source.size() + 1);
+
+				key.mSourceLength += (unsigned int)(path.size() + source.size());
+			}
+
+			// Zero is used for 'no key'
+			key.mHash = hash == 0 ? 1 : hash;
+
+			return key;
+		}
+
+		// ---------------------------------------------
+
+		std::string ShaderBinaryCache::GetCacheFilePath(unsigned int key)
+		{
+			std::stringstream path;
+
+			path << kShaderCacheDirectory << std::hex << std::setw(8) << std::setfill('0') << key << ".bin";
+
+			return path.str();
+		}
+
+		// ---------------------------------------------
+
+		bool ShaderBinaryCache::Load(unsigned int programID, const ShaderBinaryCacheKey& key)
+		{
+			if (key.mHash == 0)
+				return false;
+
+			Engine::MemoryMappedFile file;
+
+			if (!file.Open(GetCacheFilePath(key.mHash)))
+			{
+				sMissCount++;
+				return false;
+			}
+
+			const unsigned char* data      = file.GetData();
+			size_t               sizeBytes = file.GetSizeBytes();
+
+			ShaderBinaryCacheHeader header;
+
+			if (sizeBytes < sizeof(ShaderBinaryCacheHeader))
+			{
+				sMissCount++;
+				return false;
+			}
+
+			std::memcpy(&header, data, sizeof(ShaderBinaryCacheHeader));
+
+			if (std::memcmp(header.mMagic, kShaderCacheMagic, sizeof(kShaderCacheMagic)) != 0 ||
+				header.mFileVersion  != kShaderCacheFileVersion ||
+				header.mKey          != key.mHash ||
+				header.mSourceLength != key.mSourceLength ||
+				header.mSourceCheck  != key.mSourceCheck ||
+				header.mDriverHash   != GetDriverHash() ||
+				sizeBytes            != sizeof(ShaderBinaryCacheHeader) + header.mBinaryLength)
+			{
+				sMissCount++;
+				return false;
+			}
+
+			glProgramBinary(programID, (GLenum)header.mBinaryFormat, data + sizeof(ShaderBinaryCacheHeader), (GLsizei)header.mBinaryLength);
+
+			// A driver update can silently invalidate the binary even when the version string does not change
+			int linked = 0;
+			glGetProgramiv(programID, GL_LINK_STATUS, &linked);
+
+			// Clear out any error from a rejected binary so that it is not blamed on the source link that follows
+			for (unsigned int i = 0; i < kMaxErrorsToClear && glGetError() != GL_NO_ERROR; i++) { }
+
+			if (!linked)
+			{
+				sMissCount++;
+				return false;
+			}
+
+			sHitCount++;
+
+			return true;
+		}
+
+		// ---------------------------------------------
+
+		void ShaderBinaryCache::Save(unsigned int programID, const ShaderBinaryCacheKey& key)
+		{
+			if (key.mHash == 0)
+				return;
+
+			int binaryLength = 0;
+			glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+
+			if (binaryLength <= 0)
+				return;
+
+			std::vector<unsigned char> binary((size_t)binaryLength);
+			GLenum                     binaryFormat = 0;
+
+			glGetProgramBinary(programID, (GLsizei)binaryLength, &binaryLength, &binaryFormat, binary.data());
+
+			if (glGetError() != GL_NO_ERROR || binaryLength <= 0)
+				return;
+
+			std::error_code error;
+			std::filesystem::create_directories(kShaderCacheDirectory, error);
+
+			std::string filePath = GetCacheFilePath(key.mHash);
+
+			// Written to a temporary file first so that a partially written cache is never picked up
+			std::string   temporaryPath = filePath + ".tmp";
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+			if (!file.is_open())
+				return;
+
+			ShaderBinaryCacheHeader header;
+			std::memcpy(header.mMagic, kShaderCacheMagic, sizeof(kShaderCacheMagic));
+			header.mFileVersion  = kShaderCacheFileVersion;
+			header.mKey          = key.mHash;
+			header.mSourceLength = key.mSourceLength;
+			header.mSourceCheck  = key.mSourceCheck;
+			header.mDriverHash   = GetDriverHash();
+			header.mBinaryFormat = (unsigned int)binaryFormat;
+			header.mBinaryLength = (unsigned int)binaryLength;
+
+			file.write((const char*)&header,       sizeof(ShaderBinaryCacheHeader));
+			file.write((const char*)binary.data(), binaryLength);
+
+			bool succeeded = file.good();
+
+			file.close();
+
+			if (succeeded)
+			{
+				std::filesystem::rename(temporaryPath, filePath, error);
+			}
+			else
+			{
+				std::filesystem::remove(temporaryPath, error);
+			}
+		}
+
+		// ---------------------------------------------
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+namespace Rendering
+{
+	namespace Shaders
+	{
+		class Shader;
+	}
+
+	namespace ShaderPrograms
+	{
+		// -----------------------------------------------
+
+		// The 32 bit hash names the file, the rest is stored in it and compared on load so that two programs whose hashes collide
+		// never pick up each other's binary
+		struct ShaderBinaryCacheKey
+		{
+			ShaderBinaryCacheKey();
+
+			unsigned int mHash;         // Zero for 'no key'
+			unsigned int mSourceLength; // Every path and source added together
+			unsigned int mSourceCheck;  // A second hash of the same text, made with a different function to mHash
+		};
+
+		// -----------------------------------------------
+
+		// On-disk store of linked program binaries, so that later launches skip compiling and linking from source
+		// Entries are keyed on the shader sources and the driver that produced them - any change to either just misses the cache
+		class ShaderBinaryCache final
+		{
+		public:
+			// A zero hash if the driver exposes no binary formats, in which case nothing is loaded or saved
+			static ShaderBinaryCacheKey GenerateKey(const std::vector<Shaders::Shader*>& shaders);
+
+			// Returns false if there is no entry, it was made from different sources, or the driver rejects it - the program is then left for a normal link
+			static bool         Load(unsigned int programID, const ShaderBinaryCacheKey& key);
+
+			// Expects the program to have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+			static void         Save(unsigned int programID, const ShaderBinaryCacheKey& key);
+
+			static unsigned int GetHitCount()  { return sHitCount; }
+			static unsigned int GetMissCount() { return sMissCount; }
+
+			// Vendor, renderer and version folded together - also used to key anything else that is only valid for one driver
+			static unsigned int GetDriverHash();
+
+			static const char*  GetCacheDirectory();
+
+		private:
+			static bool         GetIsSupported();
+
+			static std::string  GetCacheFilePath(unsigned int key);
+
+			static int          sSupported;   // -1 until the driver has been asked
+			static unsigned int sDriverHash;
+
+			static unsigned int sHitCount;
+			static unsigned int sMissCount;
+		};
+
+		// -----------------------------------------------
+	}
+}
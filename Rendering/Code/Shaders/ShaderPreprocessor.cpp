@@ -0,0 +1,215 @@
+#include "ShaderPreprocessor.h"
+
+#include "Maths/Code/FNVHash.h"
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <algorithm>
+
+namespace Rendering
+{
+	namespace Shaders
+	{
+		// ---------------------------------------------
+
+		// Shader files are loaded relative to the working directory as "Code/Shaders/...", includes are written relative to this
+		static const char kIncludeRoot[]      = "Code/Shaders/";
+		static const char kIncludeDirective[] = "#include";
+
+		// ---------------------------------------------
+
+		ShaderDefines::ShaderDefines()
+			: mEntries()
+		{
+
+		}
+
+		// ---------------------------------------------
+
+		void ShaderDefines::Set(const std::string& name, const std::string& value)
+		{
+			std::vector<Entry>::iterator entry = std::lower_bound(mEntries.begin(), mEntries.end(), name,
+				[](const Entry& lhs, const std::string& rhs) { return lhs.mName < rhs; });
+
+			if (entry != mEntries.end() && entry->mName == name)
+			{
+				entry->mValue = value;
+				return;
+			}
+
+			Entry newEntry;
+			newEntry.mName  = name;
+			newEntry.mValue = value;
+
+			mEntries.insert(entry, newEntry);
+		}
+
+		// ---------------------------------------------
+
+		void ShaderDefines::Set(const std::string& name, int value)
+		{
+			Set(name, std::to_string(value));
+		}
+
+		// ---------------------------------------------
+
+		unsigned int ShaderDefines::GetKey() const
+		{
+			if (mEntries.empty())
+				return 0;
+
+			return Engine::FNV::Hash(ToSource().c_str());
+		}
+
+		// ---------------------------------------------
+
+		std::string ShaderDefines::ToSource() const
+		{
+			std::string source;
+
+			for (unsigned int i = 0; i < mEntries.size(); i++)
+			{
+				source += "#define " + mEntries[i].mName + " " + mEntries[i].mValue + "\n";
+			}
+
+			return source;
+		}
+
+		// ---------------------------------------------
+
+		bool ShaderPreprocessor::LoadSource(const std::string& filePath, std::string& source, std::vector<std::string>& includedFiles)
+		{
+			source.clear();
+
+			includedFiles.clear();
+			includedFiles.push_back(filePath);
+
+			return ExpandIncludes(filePath, source, includedFiles, 0);
+		}
+
+		// ---------------------------------------------
+
+		void ShaderPreprocessor::InsertDefines(std::string& source, const ShaderDefines& defines)
+		{
+			if (defines.GetIsEmpty())
+				return;
+
+			std::string defineSource = defines.ToSource();
+
+			size_t versionStart = source.find("#version");
+
+			if (versionStart == std::string::npos)
+			{
+				source.insert(0, defineSource + "#line 1 0\n");
+				return;
+			}
+
+			size_t lineEnd = source.find('\n', versionStart);
+
+			if (lineEnd == std::string::npos)
+			{
+				source += "\n" + defineSource;
+				return;
+			}
+
+			// #line sets the number of the line that follows it, which is the one after #version in the original file
+			unsigned int versionLine = 1 + (unsigned int)std::count(source.begin(), source.begin() + versionStart, '\n');
+
+			source.insert(lineEnd + 1, defineSource + "#line " + std::to_string(versionLine + 1) + " 0\n");
+		}
+
+		// ---------------------------------------------
+
+		bool ShaderPreprocessor::ExpandIncludes(const std::string& filePath, std::string& output, std::vector<std::string>& includedFiles, unsigned int depth)
+		{
+			if (depth > kMaxIncludeDepth)
+			{
+				std::cout << "Shader includes nested too deeply: " << filePath << std::endl;
+				return false;
+			}
+
+			std::string contents;
+
+			if (!ReadFile(filePath, contents))
+			{
+				std::cout << "Failed to open shader: " << filePath << std::endl;
+				return false;
+			}
+
+			// The caller adds this file to the list just before expanding it
+			unsigned int fileIndex = (unsigned int)includedFiles.size() - 1;
+
+			std::istringstream stream(contents);
+			std::string        line;
+			unsigned int       lineNumber = 0;
+			bool               succeeded  = true;
+
+			while (std::getline(stream, line))
+			{
+				lineNumber++;
+
+				size_t firstCharacter = line.find_first_not_of(" \t");
+
+				if (firstCharacter == std::string::npos || line.compare(firstCharacter, sizeof(kIncludeDirective) - 1, kIncludeDirective) != 0)
+				{
+					output += line;
+					output += '\n';
+					continue;
+				}
+
+				size_t pathStart = line.find('"', firstCharacter + sizeof(kIncludeDirective) - 1);
+				size_t pathEnd   = (pathStart == std::string::npos) ? std::string::npos : line.find('"', pathStart + 1);
+
+				// Anything skipped still leaves a blank line behind, so the lines after it keep their numbers
+				if (pathEnd == std::string::npos)
+				{
+					std::cout << filePath << "(" << lineNumber << "): expected #include \"path\"" << std::endl;
+
+					output += '\n';
+					succeeded = false;
+					continue;
+				}
+
+				std::string includePath = kIncludeRoot + line.substr(pathStart + 1, pathEnd - pathStart - 1);
+
+				if (std::find(includedFiles.begin(), includedFiles.end(), includePath) != includedFiles.end())
+				{
+					output += '\n';
+					continue;
+				}
+
+				includedFiles.push_back(includePath);
+
+				output += "#line 1 " + std::to_string(includedFiles.size() - 1) + "\n";
+
+				if (!ExpandIncludes(includePath, output, includedFiles, depth + 1))
+					succeeded = false;
+
+				// Back to the line after the #include
+				output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+			}
+
+			return succeeded;
+		}
+
+		// ---------------------------------------------
+
+		bool ShaderPreprocessor::ReadFile(const std::string& filePath, std::string& contents)
+		{
+			std::ifstream file(filePath);
+
+			if (!file.is_open())
+				return false;
+
+			std::stringstream fileStream;
+			fileStream << file.rdbuf();
+
+			contents = fileStream.str();
+
+			return true;
+		}
+
+		// ---------------------------------------------
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+namespace Rendering
+{
+	namespace Shaders
+	{
+		// -----------------------------------------------
+
+		// The set of #defines one variant of a shader is built with
+		// Kept sorted by name, so the same set always gives the same source text and the same key however it was built up
+		class ShaderDefines final
+		{
+		public:
+			ShaderDefines();
+
+			// Replaces the value if the name is already set
+			void         Set(const std::string& name, const std::string& value);
+			void         Set(const std::string& name, int value);
+
+			bool         GetIsEmpty() const { return mEntries.empty(); }
+
+			// Hash of every name and value - zero when nothing is set, so the plain shader has a key of its own
+			unsigned int GetKey() const;
+
+			// One "#define NAME VALUE" line per entry
+			std::string  ToSource() const;
+
+		private:
+			struct Entry
+			{
+				std::string mName;
+				std::string mValue;
+			};
+
+			std::vector<Entry> mEntries;
+		};
+
+		// -----------------------------------------------
+
+		// Text level work done on a shader's source before it reaches the driver
+		class ShaderPreprocessor final
+		{
+		public:
+			// Reads the file and expands every #include "path" in it, with paths relative to Code/Shaders/
+			// Each file is only expanded once per shader, as if it started with #pragma once
+			// #line directives are added around each include so compile errors point at the right line - the source string number
+			// in an error is the index into includedFiles, with zero being filePath itself
+			static bool LoadSource(const std::string& filePath, std::string& source, std::vector<std::string>& includedFiles);
+
+			// Adds the defines straight after the #version line, then resets the line number so errors still match the file
+			static void InsertDefines(std::string& source, const ShaderDefines& defines);
+
+		private:
+			static bool ExpandIncludes(const std::string& filePath, std::string& output, std::vector<std::string>& includedFiles, unsigned int depth);
+
+			static bool ReadFile(const std::string& filePath, std::string& contents);
+
+			// Deep enough for any sensible nesting, and stops a file that includes itself under another path from recursing forever
+			static const unsigned int kMaxIncludeDepth = 16;
+		};
+
+		// -----------------------------------------------
+	}
+}
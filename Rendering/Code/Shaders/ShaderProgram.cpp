@@ -3,11 +3,17 @@
 #include "Rendering/Code/OpenGLRenderPipeline.h"
 #include "Rendering/Code/Window.h"
 
+#include "ShaderBinaryCache.h"
+
 namespace Rendering
 {
 	namespace ShaderPrograms
 	{
-		unsigned int ShaderPrograms::ShaderProgram::sThisShaderProgramCount = 0;
+		unsigned int ShaderPrograms::ShaderProgram::sThisShaderProgramCount       = 0;
+		bool         ShaderPrograms::ShaderProgram::sParallelCompilationSupported = false;
+
+		// GL_COMPLETION_STATUS_KHR - the same value as the ARB version of the extension
+		static const GLenum kCompletionStatus = 0x91B1;
 
 		void ShaderProgram::UseProgram()
 		{
@@ -18,5 +24,107 @@ namespace Rendering
 
 			renderPipeline->SetActiveShader(mShaderProgramID);
 		}
+
+		// ----------------------------------------------------------
+
+		bool ShaderProgram::LinkShadersToProgram()
+		{
+			BeginLink();
+
+			return FinishLink();
+		}
+
+		// ----------------------------------------------------------
+
+		void ShaderProgram::BeginLink()
+		{
+			mLinkCacheKey = ShaderBinaryCache::GenerateKey(mAttachedShaders);
+
+			if (ShaderBinaryCache::Load(mShaderProgramID, mLinkCacheKey))
+				return;
+
+			// Has to be set before linking for the driver to keep hold of the binary
+			if (mLinkCacheKey.mHash != 0)
+				glProgramParameteri(mShaderProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+			for (unsigned int i = 0; i < mAttachedShaders.size(); i++)
+			{
+				glAttachShader(mShaderProgramID, mAttachedShaders[i]->Compile());
+
+				GL_CHECK_ERROR("Failed to attach shader to program");
+			}
+
+			mShadersAttachedInGL = true;
+
+			// Nothing is queried here, so with parallel compilation this returns while the driver is still working
+			glLinkProgram(mShaderProgramID);
+		}
+
+		// ----------------------------------------------------------
+
+		bool ShaderProgram::GetIsLinkComplete()
+		{
+			// Without the extension the only way to find out is to block on the link status, so report it as done and let FinishLink wait
+			if (!sParallelCompilationSupported || !mShadersAttachedInGL)
+				return true;
+
+			int complete = 0;
+			glGetProgramiv(mShaderProgramID, kCompletionStatus, &complete);
+
+			return complete != 0;
+		}
+
+		// ----------------------------------------------------------
+
+		bool ShaderProgram::FinishLink()
+		{
+			if (mShadersAttachedInGL)
+			{
+				if (!LinkErrorChecking())
+				{
+					for (unsigned int i = 0; i < mAttachedShaders.size(); i++)
+					{
+						mAttachedShaders[i]->CompilationErrorChecking();
+					}
+
+					return false;
+				}
+
+				ShaderBinaryCache::Save(mShaderProgramID, mLinkCacheKey);
+			}
+
+			CacheUniformLocations();
+
+			return true;
+		}
+
+		// ----------------------------------------------------------
+
+		void ShaderProgram::EnableParallelCompilation()
+		{
+			typedef void (APIENTRYP MaxShaderCompilerThreadsFunction)(GLuint count);
+
+			MaxShaderCompilerThreadsFunction maxShaderCompilerThreads = nullptr;
+
+			// Not part of the loader's generated set, so fetched by hand - the KHR and ARB versions behave the same
+			if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+			{
+				maxShaderCompilerThreads = (MaxShaderCompilerThreadsFunction)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+			}
+			else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+			{
+				maxShaderCompilerThreads = (MaxShaderCompilerThreadsFunction)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+			}
+
+			sParallelCompilationSupported = maxShaderCompilerThreads != nullptr;
+
+			if (sParallelCompilationSupported)
+			{
+				// Leaves the thread count up to the driver
+				maxShaderCompilerThreads(0xFFFFFFFF);
+			}
+		}
+
+		// ----------------------------------------------------------
 	}
 }
\ No newline at end of file
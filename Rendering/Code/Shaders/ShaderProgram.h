@@ -5,8 +5,17 @@
 
 #include "Maths/Code/Vector.h"
 #include "Maths/Code/AssertMsg.h"
+#include "Maths/Code/FNVHash.h"
+
+#include "Rendering/Code/GLStateCache.h"
+#include "Rendering/Code/GLErrorChecking.h"
 
 #include "ShaderTypes.h"
+#include "ShaderBinaryCache.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
 
 namespace Rendering
 {
@@ -14,14 +23,62 @@ namespace Rendering
 	{
 		// -----------------------------------------------
 
+		// A uniform name reduced to its hash - constructed implicitly from literals and strings so callers can keep passing names
+		struct UniformName
+		{
+			constexpr UniformName(const char* name)
+				: mHash(Engine::FNV::Hash(name))
+			{ }
+
+			UniformName(const std::string& name)
+				: mHash(Engine::FNV::Hash(name.c_str()))
+			{ }
+
+			// For names hashed ahead of time, e.g. constexpr UniformName kViewMat = UniformName::FromHash(...)
+			static constexpr UniformName FromHash(unsigned int hash)
+			{
+				return UniformName(hash, 0);
+			}
+
+			unsigned int mHash;
+
+		private:
+			constexpr UniformName(unsigned int hash, int)
+				: mHash(hash)
+			{ }
+		};
+
+		// -----------------------------------------------
+
+		// A location resolved from a program's uniform table, for use on per-frame paths
+		struct UniformHandle
+		{
+			UniformHandle()
+				: mLocation(-1)
+			{ }
+
+			explicit UniformHandle(int location)
+				: mLocation(location)
+			{ }
+
+			bool IsValid() const { return mLocation != -1; }
+
+			int mLocation;
+		};
+
+		// -----------------------------------------------
+
 		class ShaderProgram
 		{
 		public:
 			// ----------------------------------------------------------
 
 			ShaderProgram()
-				: mAttachedCount(0)
+				: mUniformLocations()
+				, mAttachedShaders()
 				, mShaderProgramID(0)
+				, mShadersAttachedInGL(false)
+				, mLinkCacheKey()
 				, mProgramType(ShaderProgramTypes::ProgramCount)
 			{
 				mShaderProgramID = glCreateProgram();
@@ -32,55 +89,62 @@ namespace Rendering
 			~ShaderProgram()
 			{
 				glDeleteProgram(mShaderProgramID);
+				GLStateCache::OnProgramDeleted(mShaderProgramID);
 			}
 
 			// ----------------------------------------------------------
 
-			// Attaching a shader to the program
+			// Attaching a shader to the program - compiling and attaching in GL is held back until link time, as a cached binary needs neither
 			bool AttachShader(Shaders::Shader* shaderToAttach)
 			{
-				// 4 to allow 1 vertex, fragment, geometry and compute shaders
-				if (mAttachedCount++ >= 4)
+				// 5 to allow the largest graphics pipeline - vertex, tessellation control, tessellation evaluation, geometry and fragment
+				if (mAttachedShaders.size() >= 5)
 				{
 					std::cout << "Too many shaders being attached to the program!" << std::endl;
 					return false;
 				}
 
-				glAttachShader(mShaderProgramID, shaderToAttach->GetShaderID());
-
-				int error = glGetError();
-				ASSERTMSG(error != 0, "Failed to attach shader to program");
+				mAttachedShaders.push_back(shaderToAttach);
 
 				return true;
 			}
 
 			void DetachShader(Shaders::Shader* shaderToDetach)
 			{
-				if (mAttachedCount == 0)
+				std::vector<Shaders::Shader*>::iterator attached = std::find(mAttachedShaders.begin(), mAttachedShaders.end(), shaderToDetach);
+
+				if (attached == mAttachedShaders.end())
 				{
-					std::cout << "Trying to detach a shader from a program with none attached!" << std::endl;
+					std::cout << "Trying to detach a shader from a program it is not attached to!" << std::endl;
 					return;
 				}
 
-				glDetachShader(mShaderProgramID, shaderToDetach->GetShaderID());
+				mAttachedShaders.erase(attached);
 
-				int error = glGetError();
-				ASSERTMSG(error != 0, "Failed to attach shader to program");
+				// Only shaders that were compiled for a source link are actually attached in GL
+				if (mShadersAttachedInGL)
+				{
+					glDetachShader(mShaderProgramID, shaderToDetach->GetShaderID());
 
-				mAttachedCount--;
+					GL_CHECK_ERROR("Failed to detach shader from program");
+				}
 
 				return;
 			}
 
 			// ----------------------------------------------------------
 
-			// Function to link all attached shaders to the program
-			bool LinkShadersToProgram()
-			{
-				glLinkProgram(mShaderProgramID);
+			// Function to link all attached shaders to the program, using the binary cache when there is a valid entry
+			bool LinkShadersToProgram();
 
-				return LinkErrorChecking();
-			}
+			// The same link split in two, so that several programs can be compiling on the driver's threads at once
+			// Attached shaders have to stay alive until FinishLink, as their logs are only read if the link fails
+			void BeginLink();
+			bool GetIsLinkComplete();
+			bool FinishLink();
+
+			// Gives the driver background compiler threads when GL_KHR_parallel_shader_compile is exposed - without it links complete on FinishLink
+			static void EnableParallelCompilation();
 
 			// ----------------------------------------------------------
 
@@ -89,150 +153,202 @@ namespace Rendering
 			// ==========================================================
 			// ----------------------------------------------------------
 
-			void SetBool(std::string name, bool value)
+			// Name based setters - the location comes from the table built at link time, so there is no driver lookup or string allocation
+			// These still bind the program first, as a lot of callers rely on that before dispatching or drawing
+			void SetBool(UniformName name, bool value)
 			{
 				UseProgram();
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+				SetBool(GetUniformHandle(name), value);
+			}
 
-				if (uniformLocation != -1)
-				{
-					glUniform1i(uniformLocation, (int)value);
+			void SetInt(UniformName name, int value)
+			{
+				UseProgram();
 
-					ASSERTMSG(glGetError() != 0, "Error setting uniform data!");
-				}
+				SetInt(GetUniformHandle(name), value);
 			}
 
-			void SetInt(std::string name, int value)
+			void SetUnsignedInt(UniformName name, int value)
 			{
 				UseProgram();
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+				SetUnsignedInt(GetUniformHandle(name), value);
+			}
 
-				if (uniformLocation != -1)
-				{
-					glUniform1i(uniformLocation, value);
+			void SetFloat(UniformName name, float value)
+			{
+				UseProgram();
 
-					ASSERTMSG(glGetError() != 0, "Error setting uniform data!");
-				}
+				SetFloat(GetUniformHandle(name), value);
 			}
 
-			void SetUnsignedInt(std::string name, int value)
+			void SetVec2(UniformName name, Maths::Vector::Vector2D<float> value)
 			{
 				UseProgram();
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+				SetVec2(GetUniformHandle(name), value.x, value.y);
+			}
 
-				if (uniformLocation != -1)
-				{
-					glUniform1ui(uniformLocation, value);
+			void SetVec2(UniformName name, float x, float y)
+			{
+				UseProgram();
 
-					ASSERTMSG(glGetError() != 0, "Error setting uniform data!");
-				}
+				SetVec2(GetUniformHandle(name), x, y);
 			}
 
-			void SetFloat(std::string name, float value)
+			void SetVec3(UniformName name, Maths::Vector::Vector3D<float> value)
 			{
 				UseProgram();
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+				SetVec3(GetUniformHandle(name), value.x, value.y, value.z);
+			}
 
-				if (uniformLocation != -1)
-				{
-					glUniform1f(uniformLocation, value);
+			void SetVec3(UniformName name, float x, float y, float z)
+			{
+				UseProgram();
 
-					ASSERTMSG(glGetError() != 0, "Error setting uniform data!");
-				}
+				SetVec3(GetUniformHandle(name), x, y, z);
 			}
 
-			void SetVec2(std::string name, Maths::Vector::Vector2D<float> value)
+			void SetVec4(UniformName name, Maths::Vector::Vector4D<float> value)
 			{
 				UseProgram();
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+				SetVec4(GetUniformHandle(name), value);
+			}
 
-				if (uniformLocation != -1)
-				{
-					glUniform2f(uniformLocation, value.x, value.y);
+			void SetVec4Array(UniformName name, unsigned int count, const float* values)
+			{
+				UseProgram();
 
-					ASSERTMSG(glGetError() != 0, "Error setting uniform data!");
-				}
+				SetVec4Array(GetUniformHandle(name), count, values);
 			}
 
-			void SetVec2(std::string name, float x, float y)
+			void SetMat4(UniformName name, float* matrix)
 			{
 				UseProgram();
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+				SetMat4(GetUniformHandle(name), matrix);
+			}
 
-				if (uniformLocation != -1)
+			// ==========================================================
+			// ----------------------------------------------------------
+
+			// Handle based setters - these write straight into the program with glProgramUniform*, so the program does not need to be bound
+			void SetBool(UniformHandle handle, bool value)
+			{
+				if (handle.IsValid())
 				{
-					glUniform2f(uniformLocation, x, y);
+					glProgramUniform1i(mShaderProgramID, handle.mLocation, (int)value);
 
-					ASSERTMSG(glGetError() != 0, "Error setting uniform data!");
+					GL_CHECK_ERROR("Error setting uniform data!");
 				}
 			}
 
-			void SetVec3(std::string name, Maths::Vector::Vector3D<float> value)
+			void SetInt(UniformHandle handle, int value)
 			{
-				UseProgram();
+				if (handle.IsValid())
+				{
+					glProgramUniform1i(mShaderProgramID, handle.mLocation, value);
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+					GL_CHECK_ERROR("Error setting uniform data!");
+				}
+			}
 
-				if (uniformLocation != -1)
+			void SetUnsignedInt(UniformHandle handle, int value)
+			{
+				if (handle.IsValid())
 				{
-					glUniform3f(uniformLocation, value.x, value.y, value.z);
+					glProgramUniform1ui(mShaderProgramID, handle.mLocation, value);
 
-					ASSERTMSG(glGetError() != 0, "Error setting uniform data!");
+					GL_CHECK_ERROR("Error setting uniform data!");
 				}
 			}
 
-			void SetVec4(std::string name, Maths::Vector::Vector4D<float> value)
+			void SetFloat(UniformHandle handle, float value)
 			{
-				UseProgram();
+				if (handle.IsValid())
+				{
+					glProgramUniform1f(mShaderProgramID, handle.mLocation, value);
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+					GL_CHECK_ERROR("Error setting uniform data!");
+				}
+			}
 
-				if (uniformLocation != -1)
+			void SetVec2(UniformHandle handle, float x, float y)
+			{
+				if (handle.IsValid())
 				{
-					glUniform4f(uniformLocation, value.x, value.y, value.z, value.w);
+					glProgramUniform2f(mShaderProgramID, handle.mLocation, x, y);
 
-					ASSERTMSG(glGetError() != 0, "Error setting uniform data!");
+					GL_CHECK_ERROR("Error setting uniform data!");
 				}
 			}
 
-			void SetVec3(std::string name, float x, float y, float z)
+			void SetVec3(UniformHandle handle, Maths::Vector::Vector3D<float> value)
 			{
-				UseProgram();
+				SetVec3(handle, value.x, value.y, value.z);
+			}
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+			void SetVec3(UniformHandle handle, float x, float y, float z)
+			{
+				if (handle.IsValid())
+				{
+					glProgramUniform3f(mShaderProgramID, handle.mLocation, x, y, z);
+
+					GL_CHECK_ERROR("Error setting uniform data!");
+				}
+			}
 
-				if (uniformLocation != -1)
+			void SetVec4(UniformHandle handle, Maths::Vector::Vector4D<float> value)
+			{
+				if (handle.IsValid())
 				{
-					glUniform3f(uniformLocation, x, y, z);
+					glProgramUniform4f(mShaderProgramID, handle.mLocation, value.x, value.y, value.z, value.w);
 
-					ASSERTMSG(glGetError() != 0, "Error setting uniform data!");
+					GL_CHECK_ERROR("Error setting uniform data!");
 				}
 			}
 
-			void SetMat4(std::string name, float* matrix)
+			void SetVec4Array(UniformHandle handle, unsigned int count, const float* values)
 			{
-				UseProgram();
+				if (handle.IsValid())
+				{
+					glProgramUniform4fv(mShaderProgramID, handle.mLocation, count, (const GLfloat*)values);
 
-				int uniformLocation = glGetUniformLocation(mShaderProgramID, name.c_str());
+					GL_CHECK_ERROR("Error setting uniform data!");
+				}
+			}
 
-				if (uniformLocation != -1)
+			void SetMat4(UniformHandle handle, const float* matrix)
+			{
+				if (handle.IsValid())
 				{
-					glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, (const GLfloat*)matrix);
+					glProgramUniformMatrix4fv(mShaderProgramID, handle.mLocation, 1, GL_FALSE, (const GLfloat*)matrix);
 
-					int error = glGetError();
-					ASSERTMSG(error != 0, "Error setting uniform data!");
+					GL_CHECK_ERROR("Error setting uniform data!");
 				}
 			}
 
 			// ==========================================================
 			// ----------------------------------------------------------
 
+			// Resolves a uniform once so that hot paths can hold onto the handle, invalid if the uniform is not active in this program
+			UniformHandle GetUniformHandle(UniformName name) const
+			{
+				std::vector<UniformLocationEntry>::const_iterator entry = std::lower_bound(mUniformLocations.begin(), mUniformLocations.end(), name.mHash,
+					[](const UniformLocationEntry& lhs, unsigned int hash) { return lhs.mNameHash < hash; });
+
+				if (entry == mUniformLocations.end() || entry->mNameHash != name.mHash)
+					return UniformHandle();
+
+				return UniformHandle(entry->mLocation);
+			}
+
+			// ==========================================================
+			// ----------------------------------------------------------
+
 			unsigned int GetId() { return mShaderProgramID; }
 
 			static unsigned int sThisShaderProgramCount;
@@ -276,9 +392,79 @@ namespace Rendering
 
 			// ----------------------------------------------------------
 
+			// Walks every active uniform once and stores its location against the hash of its name
+			void CacheUniformLocations()
+			{
+				mUniformLocations.clear();
+
+				int activeUniformCount = 0;
+				int longestNameLength  = 0;
+
+				glGetProgramiv(mShaderProgramID, GL_ACTIVE_UNIFORMS,           &activeUniformCount);
+				glGetProgramiv(mShaderProgramID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &longestNameLength);
+
+				std::vector<char> nameBuffer((size_t)longestNameLength + 1, '\0');
+
+				for (int i = 0; i < activeUniformCount; i++)
+				{
+					int     nameLength = 0;
+					int     arraySize  = 0;
+					GLenum  type       = 0;
+
+					glGetActiveUniform(mShaderProgramID, (GLuint)i, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+
+					int location = glGetUniformLocation(mShaderProgramID, nameBuffer.data());
+
+					// Members of uniform blocks have no location of their own
+					if (location == -1)
+						continue;
+
+					// Arrays are reported as "name[0]", but are set through the plain name
+					std::string  name(nameBuffer.data(), nameLength);
+					size_t       bracket = name.find('[');
+
+					if (bracket != std::string::npos)
+						name.resize(bracket);
+
+					UniformLocationEntry entry;
+					entry.mNameHash = Engine::FNV::Hash(name.c_str());
+					entry.mLocation = location;
+
+					mUniformLocations.push_back(entry);
+				}
+
+				std::sort(mUniformLocations.begin(), mUniformLocations.end(),
+					[](const UniformLocationEntry& lhs, const UniformLocationEntry& rhs) { return lhs.mNameHash < rhs.mNameHash; });
+
+				for (unsigned int i = 1; i < mUniformLocations.size(); i++)
+				{
+					ASSERTMSG(mUniformLocations[i].mNameHash == mUniformLocations[i - 1].mNameHash, "Two uniform names in the same program hash to the same value");
+				}
+
+				GL_CHECK_ERROR("Error querying active uniforms");
+			}
+
+			// ----------------------------------------------------------
+
+			struct UniformLocationEntry
+			{
+				unsigned int mNameHash;
+				int          mLocation;
+			};
+
+			// Sorted by hash, so lookups are a binary search over a small flat array
+			std::vector<UniformLocationEntry> mUniformLocations;
+
+			std::vector<Shaders::Shader*> mAttachedShaders;
+
 			unsigned int mShaderProgramID;
 
-			unsigned int mAttachedCount;
+			bool         mShadersAttachedInGL;
+
+			// Carried from BeginLink to FinishLink
+			ShaderBinaryCacheKey mLinkCacheKey;
+
+			static bool  sParallelCompilationSupported;
 
 			ShaderProgramTypes mProgramType;
 		};
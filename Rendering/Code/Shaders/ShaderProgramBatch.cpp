@@ -0,0 +1,103 @@
+#include "ShaderProgramBatch.h"
+
+#include "ShaderProgram.h"
+#include "Shader.h"
+
+#include <thread>
+
+namespace Rendering
+{
+	namespace ShaderPrograms
+	{
+		// ----------------------------------------------------------
+
+		ShaderProgramBatch::ShaderProgramBatch()
+			: mPendingLinks()
+		{
+
+		}
+
+		// ----------------------------------------------------------
+
+		ShaderProgramBatch::~ShaderProgramBatch()
+		{
+			LinkAll();
+		}
+
+		// ----------------------------------------------------------
+
+		void ShaderProgramBatch::Add(ShaderProgram* program, std::initializer_list<Shaders::Shader*> shaders)
+		{
+			if (!program)
+				return;
+
+			PendingLink pendingLink;
+			pendingLink.mProgram = program;
+			pendingLink.mShaders = shaders;
+
+			for (unsigned int i = 0; i < pendingLink.mShaders.size(); i++)
+			{
+				program->AttachShader(pendingLink.mShaders[i]);
+			}
+
+			// Submitted straight away so the driver can be compiling this one while the next one's files are read in
+			program->BeginLink();
+
+			mPendingLinks.push_back(pendingLink);
+		}
+
+		// ----------------------------------------------------------
+
+		bool ShaderProgramBatch::LinkAll()
+		{
+			bool allLinked = true;
+
+			while (!mPendingLinks.empty())
+			{
+				bool anyFinished = false;
+
+				for (unsigned int i = 0; i < mPendingLinks.size(); )
+				{
+					if (!mPendingLinks[i].mProgram->GetIsLinkComplete())
+					{
+						i++;
+						continue;
+					}
+
+					allLinked &= FinishLink(mPendingLinks[i]);
+
+					mPendingLinks.erase(mPendingLinks.begin() + i);
+
+					anyFinished = true;
+				}
+
+				if (!anyFinished)
+				{
+					std::this_thread::yield();
+				}
+			}
+
+			return allLinked;
+		}
+
+		// ----------------------------------------------------------
+
+		bool ShaderProgramBatch::FinishLink(PendingLink& pendingLink)
+		{
+			bool linked = pendingLink.mProgram->FinishLink();
+
+			for (unsigned int i = 0; i < pendingLink.mShaders.size(); i++)
+			{
+				pendingLink.mProgram->DetachShader(pendingLink.mShaders[i]);
+
+				delete pendingLink.mShaders[i];
+			}
+
+			pendingLink.mShaders.clear();
+
+			return linked;
+		}
+
+		// ----------------------------------------------------------
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <initializer_list>
+
+namespace Rendering
+{
+	namespace Shaders
+	{
+		class Shader;
+	}
+
+	namespace ShaderPrograms
+	{
+		class ShaderProgram;
+
+		// -----------------------------------------------
+
+		// Starts each program's link as soon as it is added and only waits once everything has been submitted
+		// With GL_KHR_parallel_shader_compile the driver works through them together, so startup pays for the slowest program rather than all of them
+		class ShaderProgramBatch final
+		{
+		public:
+			ShaderProgramBatch();
+
+			// Finishes anything that LinkAll was not called for
+			~ShaderProgramBatch();
+
+			// Takes ownership of the shaders, which are detached and deleted once the program has finished linking
+			void Add(ShaderProgram* program, std::initializer_list<Shaders::Shader*> shaders);
+
+			// Polls until every program has linked, finishing them in whatever order they complete - false if any failed
+			bool LinkAll();
+
+		private:
+			struct PendingLink
+			{
+				ShaderProgram*                mProgram;
+				std::vector<Shaders::Shader*> mShaders;
+			};
+
+			bool FinishLink(PendingLink& pendingLink);
+
+			std::vector<PendingLink> mPendingLinks;
+		};
+
+		// -----------------------------------------------
+	}
+}
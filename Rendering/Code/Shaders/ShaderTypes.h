@@ -11,6 +11,9 @@ namespace Rendering
 		GeometryShader = 2,
 		ComputeShader  = 3,
 
+		TessellationControlShader    = 4,
+		TessellationEvaluationShader = 5,
+
 		ShaderTypeCount
 	};
 
@@ -7,6 +7,14 @@
 #include "Shaders/ShaderProgram.h"
 
 #include "Camera.h"
+#include "RenderCommandQueue.h"
+
+#include "Textures/SpecularPrefilter.h"
+
+#include <filesystem>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 
 namespace Rendering
 {
@@ -52,56 +60,128 @@ namespace Rendering
 		                                                     { -1.0f, -1.0f,  1.0f },
 		                                                     {  1.0f, -1.0f,  1.0f } };
 
+	Buffers::VertexArrayObject*    Skybox::mCubeVAO        = nullptr;
+	ShaderPrograms::ShaderProgram* Skybox::mSkyBoxProgram  = nullptr;
+	Buffers::VertexBufferObject*   Skybox::mCubeVBO        = nullptr;
+
+	unsigned int                   Skybox::mInstanceCount  = 0;
+
 	// -----------------------------------------
 
 	Skybox::Skybox(std::string name, std::string filePaths[6])
 		: mCubeMapTexture(nullptr)
+		, mConvolutedVersion(nullptr)
+		, mPrefilteredVersion(nullptr)
 		, mFilePaths{ filePaths[0], filePaths[1], filePaths[2], filePaths[3], filePaths[4], filePaths[5] }
 		, mInternalName("Skybox_Cubemap_" + name)
 		, mName(name)
-		, mCubeVAO(nullptr)
-		, mSkyBoxProgram(nullptr)
+		, mIrradianceCacheKey(0)
+		, mIrradianceSH()
+		, mProjectedIrradianceSH()
+		, mIrradianceProjection()
 		, mShowingIrradianceMap(false)
+		, mConvolutedFromCache(false)
+		, mPrefilteredLookedUp(false)
 	{
 		LoadCubeMapTextures(mFilePaths);
 
-		if (!mCubeVAO)
+		if (mInstanceCount++ == 0)
 		{
 			SetupBufferData();
+			SetupShaders();
 		}
 
-		SetupShaders();
+		StartIrradianceProjection();
 	}
 
 	// -----------------------------------------
 
 	Skybox::Skybox(std::string name, std::string filePath1, std::string filePath2, std::string filePath3, std::string filePath4, std::string filePath5, std::string filePath6)
 		: mCubeMapTexture(nullptr)
+		, mConvolutedVersion(nullptr)
+		, mPrefilteredVersion(nullptr)
 		, mFilePaths{ filePath1, filePath2, filePath3, filePath4, filePath5, filePath6 }
 		, mInternalName("Skybox_Cubemap_" + name)
 		, mName(name)
-		, mCubeVAO(nullptr)
+		, mIrradianceCacheKey(0)
+		, mIrradianceSH()
+		, mProjectedIrradianceSH()
+		, mIrradianceProjection()
+		, mShowingIrradianceMap(false)
+		, mConvolutedFromCache(false)
+		, mPrefilteredLookedUp(false)
 	{
 		LoadCubeMapTextures(mFilePaths);
 
-		if (!mCubeVAO)
+		if (mInstanceCount++ == 0)
 		{
 			SetupBufferData();
+			SetupShaders();
 		}
 
-		SetupShaders();
+		StartIrradianceProjection();
+	}
+
+	// -----------------------------------------
+
+	Skybox::Skybox(std::string name, std::string filePaths[6], glm::vec3 placeholderColour)
+		: mCubeMapTexture(nullptr)
+		, mConvolutedVersion(nullptr)
+		, mPrefilteredVersion(nullptr)
+		, mFilePaths{ filePaths[0], filePaths[1], filePaths[2], filePaths[3], filePaths[4], filePaths[5] }
+		, mInternalName("Skybox_Cubemap_" + name)
+		, mName(name)
+		, mIrradianceCacheKey(0)
+		, mIrradianceSH()
+		, mProjectedIrradianceSH()
+		, mIrradianceProjection()
+		, mShowingIrradianceMap(false)
+		, mConvolutedFromCache(false)
+		, mPrefilteredLookedUp(false)
+	{
+		StreamCubeMapTextures(mFilePaths, placeholderColour);
+
+		// Lights the scene the same colour as the placeholder sky until the real faces have been projected
+		mIrradianceSH = IrradianceSH9::FromConstant(placeholderColour);
+
+		if (mInstanceCount++ == 0)
+		{
+			SetupBufferData();
+			SetupShaders();
+		}
+
+		StartIrradianceProjection();
 	}
 
 	// -----------------------------------------
 
 	Skybox::~Skybox()
 	{
+		// The worker reads mFilePaths and writes into this object
+		if (mIrradianceProjection.valid())
+		{
+			mIrradianceProjection.wait();
+		}
+
 		// Clear up the cubemap resources used
 		delete mCubeMapTexture;
 		delete mConvolutedVersion;
+		delete mPrefilteredVersion;
 
-		mCubeMapTexture    = nullptr;
-		mConvolutedVersion = nullptr;
+		mCubeMapTexture     = nullptr;
+		mConvolutedVersion  = nullptr;
+		mPrefilteredVersion = nullptr;
+
+		if (--mInstanceCount == 0)
+		{
+			delete mSkyBoxProgram;
+			delete mCubeVAO;
+			delete mCubeVBO;
+
+			mSkyBoxProgram = nullptr;
+			mCubeVAO       = nullptr;
+			mCubeVBO       = nullptr;
+		}
 	}
 
 	// -----------------------------------------
@@ -122,6 +202,9 @@ namespace Rendering
 
 			delete vertexShader;
 			delete fragmentShader;
+
+			// Only ever sampled from unit 0
+			mSkyBoxProgram->SetInt("skyboxImage", 0);
 		}
 	}
 
@@ -152,147 +235,224 @@ namespace Rendering
 	void Skybox::LoadCubeMapTextures(std::string filePaths[6])
 	{
 		mCubeMapTexture = new Texture::CubeMapTexture();
+		mCubeMapTexture->SetResidencyCategory(TextureCategory::Skybox);
 
 		mCubeMapTexture->LoadInTextures(filePaths);
 	}
 
+	void Skybox::StreamCubeMapTextures(std::string filePaths[6], glm::vec3 placeholderColour)
+	{
+		mCubeMapTexture = new Texture::CubeMapTexture();
+		mCubeMapTexture->SetResidencyCategory(TextureCategory::Skybox);
+
+		if (!mCubeMapTexture->BeginStreamedLoad(filePaths, placeholderColour))
+		{
+			// Without a readable header there is nothing to size the texture from, so fall back to loading in one go
+			mCubeMapTexture->LoadInTextures(filePaths);
+		}
+	}
+
 	// -----------------------------------------
 
-	void Skybox::Render(Camera* camera, Texture::CubeMapTexture* textureToReplaceSkybox)
+	void Skybox::StartIrradianceProjection()
 	{
-		OpenGLRenderPipeline* renderPipeline = (OpenGLRenderPipeline*)Window::GetRenderPipeline();
+		// Reads the faces from disk itself rather than waiting on the upload, so it runs alongside the streamed load
+		mIrradianceProjection = std::async(std::launch::async, [this]()
+		{
+			return IrradianceSH9::ProjectCubeMapFaces(mFilePaths, mProjectedIrradianceSH);
+		});
+	}
 
-		if (!renderPipeline)
-			return;
+	// -----------------------------------------
 
-		// First turn off blending and turn on back face culling
-		renderPipeline->SetAlphaBlending(false);
-		renderPipeline->SetBackFaceCulling(false);
+	void Skybox::UpdateStreaming()
+	{
+		if (mIrradianceProjection.valid() && mIrradianceProjection.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			if (mIrradianceProjection.get())
+			{
+				mIrradianceSH = mProjectedIrradianceSH;
+			}
+		}
 
-		if (!mConvolutedVersion)
+		// The irradiance map is only for looking at now the water lights itself from the coefficients, so is built on demand
+		if (mShowingIrradianceMap)
 		{
-			// This is used within the PBR irradiance mapping to give the illusion of global illumination
-			// It is essentially a blurred version
-			mConvolutedVersion = mCubeMapTexture->ConvoluteTexture(mCubeVAO);
+			ConvoluteTexture();
 		}
 
-		if (!mCubeMapTexture || !camera || !mCubeVAO || !mSkyBoxProgram)
+		if (!mCubeMapTexture || !mCubeMapTexture->GetIsStreaming())
 			return;
 
-		mCubeVAO->Bind();
-
-		mSkyBoxProgram->UseProgram();
+		// An irradiance map convoluted from the placeholder is rebuilt from the real faces on next use
+		if (mCubeMapTexture->UpdateStreamedLoad() && !mConvolutedFromCache)
+		{
+			delete mConvolutedVersion;
+			mConvolutedVersion = nullptr;
+		}
+	}
 
-		// Allow the early out depth test to work
-		renderPipeline->SetDepthTestFunction(GL_LEQUAL);
+	// -----------------------------------------
 
-		// Bind the cube map
-		mSkyBoxProgram->SetInt("skyboxImage", 0);
+	void Skybox::RecordRenderCommands(RenderCommandList& commandList, bool wireframe, Texture::CubeMapTexture* textureToReplaceSkybox)
+	{
+		if (!mCubeMapTexture || !mCubeVAO || !mSkyBoxProgram)
+			return;
 
-		glm::mat4 view = glm::mat4(glm::mat3(camera->GetViewMatrix()));
-		mSkyBoxProgram->SetMat4("viewMat", &view[0][0]);
+		RenderCommand command;
+		command.mProgramID     = mSkyBoxProgram->GetId();
+		command.mVertexArrayID = mCubeVAO->GetVAOID();
 
-		glm::mat4 projection = camera->GetPerspectiveMatrix();
-		mSkyBoxProgram->SetMat4("projectionMat", &projection[0][0]);
+		// No blending or back face culling, and the early out depth test needs less-equal as the sky sits exactly on the far plane
+		command.mStateFlags    = kRenderStateDepthTest | kRenderStateDepthLessEqual | (wireframe ? (unsigned int)kRenderStateWireframe : 0u);
 
 		if (textureToReplaceSkybox)
 		{
-			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, textureToReplaceSkybox->GetTextureID(), false);
+			command.AddTexture(0, textureToReplaceSkybox->GetTextureID(), true);
 		}
 		else
 		{
 			if (mShowingIrradianceMap && mConvolutedVersion)
 			{
-				renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, mConvolutedVersion->GetTextureID(), false);
+				command.AddTexture(0, mConvolutedVersion->GetTextureID(), true);
 			}
 			else
 			{
-				renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, mCubeMapTexture->GetTextureID(), false);
+				command.AddTexture(0, mCubeMapTexture->GetTextureID(), true);
 			}
 		}
 
-		// Draw
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+		// View and projection come from the per-frame camera block, already uploaded by the render pipeline
+		command.mSortKey = RenderSortKey::Make(RenderPass::Sky, command.mProgramID, RenderSortKey::HashTextures(command), 1.0f);
 
-		// Reset depth func back to default
-		renderPipeline->SetDepthTestFunction(GL_LESS);
-
-		renderPipeline->SetBackFaceCulling(true);
+		commandList.AddDrawArrays(command, GL_TRIANGLES, 0, 36);
 	}
 
 	// -----------------------------------------
 
-	void Skybox::Render(glm::mat4 viewMatrix, glm::mat4 projectionMatrix, Texture::CubeMapTexture* textureToReplaceSkybox)
+	void Skybox::ConvoluteTexture()
 	{
-		OpenGLRenderPipeline* renderPipeline = (OpenGLRenderPipeline*)Window::GetRenderPipeline();
-
-		if (!renderPipeline)
+		if (mConvolutedVersion)
 			return;
 
-		renderPipeline->SetAlphaBlending(false);
-		renderPipeline->SetBackFaceCulling(false);
-
-		if (!mCubeMapTexture || !mCubeVAO || !mSkyBoxProgram)
-			return;
-
-		mCubeVAO->Bind();
-
-		mSkyBoxProgram->UseProgram();
+		if (mIrradianceCacheKey == 0)
+		{
+			mIrradianceCacheKey = Texture::CubeMapTexture::GetIrradianceCacheKey(mFilePaths);
+		}
 
-		// Allow the early out depth test to work
-		renderPipeline->SetDepthTestFunction(GL_LEQUAL);
+		// Keyed on the faces on disk, so this can hit before a streamed skybox has finished loading
+		mConvolutedVersion = new Texture::CubeMapTexture();
+		mConvolutedVersion->SetResidencyCategory(TextureCategory::Debug);
 
-		// Bind the cube map
-		mSkyBoxProgram->SetInt("skyboxImage", 0);
+		if (mConvolutedVersion->LoadFromCache(mIrradianceCacheKey, { GL_LINEAR, GL_LINEAR }, { GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE }))
+		{
+			mConvolutedFromCache = true;
+			return;
+		}
 
-		glm::mat4 view = glm::mat4(glm::mat3(viewMatrix));
-		mSkyBoxProgram->SetMat4("viewMat", &view[0][0]);
+		delete mConvolutedVersion;
 
-		mSkyBoxProgram->SetMat4("projectionMat", &projectionMatrix[0][0]);
+		// This is used within the PBR irradiance mapping to give the illusion of global illumination
+		// It is essentially a blurred version
+		mConvolutedVersion   = mCubeMapTexture->ConvoluteTexture(mCubeVAO);
+		mConvolutedFromCache = false;
 
-		if (textureToReplaceSkybox)
+		if (mConvolutedVersion)
 		{
-			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, textureToReplaceSkybox->GetTextureID(), false);
+			mConvolutedVersion->SetResidencyCategory(TextureCategory::Debug);
 		}
-		else
+
+		// A convolution of the placeholder colour is not worth keeping
+		if (mConvolutedVersion && !mCubeMapTexture->GetIsStreaming())
 		{
-			if (mShowingIrradianceMap && mConvolutedVersion)
-			{
-				renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, mConvolutedVersion->GetTextureID(), false);
-			}
-			else
-			{
-				renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, mCubeMapTexture->GetTextureID(), false);
-			}
+			mConvolutedVersion->SaveToCache(mIrradianceCacheKey);
 		}
+	}
 
-		// Draw
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+	// -----------------------------------------
 
-		// Reset depth func back to default
-		renderPipeline->SetDepthTestFunction(GL_LESS);
+	Texture::CubeMapTexture* Skybox::GetConvolutedTexture()
+	{
+		if (!mConvolutedVersion) 
+			ConvoluteTexture(); 
+		
+		return mConvolutedVersion; 
 	}
 
 	// -----------------------------------------
 
-	void Skybox::ConvoluteTexture()
+	Texture::CubeMapTexture* Skybox::GetPrefilteredTexture()
 	{
-		if (!mConvolutedVersion)
+		if (mPrefilteredLookedUp)
+			return mPrefilteredVersion;
+
+		// Hashing the faces is not free, so a miss is remembered rather than retried every call
+		mPrefilteredLookedUp = true;
+
+		unsigned int key = Texture::SpecularPrefilter::GetCacheKey(mFilePaths, Texture::SpecularPrefilter::Settings());
+
+		mPrefilteredVersion = new Texture::CubeMapTexture();
+		mPrefilteredVersion->SetResidencyCategory(TextureCategory::BakedCache);
+
+		if (!mPrefilteredVersion->LoadFromCache(key, { GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR }, { GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE }))
 		{
-			// This is used within the PBR irradiance mapping to give the illusion of global illumination
-			// It is essentially a blurred version
-			mConvolutedVersion = mCubeMapTexture->ConvoluteTexture(mCubeVAO);
+			delete mPrefilteredVersion;
+			mPrefilteredVersion = nullptr;
 		}
+
+		return mPrefilteredVersion;
 	}
 
 	// -----------------------------------------
 
-	Texture::CubeMapTexture* Skybox::GetConvolutedTexture()
+	bool Skybox::FindFaceFilePaths(const std::string& directory, std::string faceFilePaths[6])
 	{
-		if (!mConvolutedVersion) 
-			ConvoluteTexture(); 
-		
-		return mConvolutedVersion; 
+		// Alternative names for each face, in the order the cube map takes them
+		static const char* const kFaceNames[6][2] = { { "right", nullptr }, { "left", nullptr }, { "top", "up" }, { "bottom", "down" }, { "front", nullptr }, { "back", nullptr } };
+
+		for (unsigned int i = 0; i < 6; i++)
+		{
+			faceFilePaths[i].clear();
+		}
+
+		std::error_code                     error;
+		std::filesystem::directory_iterator files(directory, error);
+
+		if (error)
+			return false;
+
+		for (const std::filesystem::directory_entry& entry : files)
+		{
+			if (!entry.is_regular_file(error))
+				continue;
+
+			std::string name = entry.path().stem().string();
+			std::transform(name.begin(), name.end(), name.begin(), [](unsigned char character) { return (char)std::tolower(character); });
+
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				for (const char* faceName : kFaceNames[i])
+				{
+					if (!faceName)
+						continue;
+
+					size_t length = std::strlen(faceName);
+
+					if (name.size() >= length && name.compare(name.size() - length, length, faceName) == 0)
+					{
+						faceFilePaths[i] = entry.path().generic_string();
+					}
+				}
+			}
+		}
+
+		for (unsigned int i = 0; i < 6; i++)
+		{
+			if (faceFilePaths[i].empty())
+				return false;
+		}
+
+		return true;
 	}
 
 	// -----------------------------------------
@@ -3,14 +3,17 @@
 #include "Textures/Texture.h"
 #include "Maths/Code/Vector.h"
 #include "Rendering/Code/Buffers.h"
+#include "Rendering/Code/SphericalHarmonics.h"
 
 #include <string>
+#include <future>
 
 namespace Rendering
 {
 	// --------------------------------------
 
 	class Camera;
+	class RenderCommandList;
 
 	// --------------------------------------
 
@@ -19,18 +22,34 @@ namespace Rendering
 	public:
 		Skybox(std::string name, std::string filePaths[6]);
 		Skybox(std::string name, std::string filePaths1, std::string filePaths2, std::string filePaths3, std::string filePaths4, std::string filePaths5, std::string filePaths6);
+
+		// Usable straight away, showing placeholderColour - the faces are decoded on worker threads and fill in as UpdateStreaming uploads them
+		Skybox(std::string name, std::string filePaths[6], glm::vec3 placeholderColour);
 		~Skybox();
 
 		Texture::CubeMapTexture* GetCubeMapTexture()     const { return mCubeMapTexture;    }
 		Texture::CubeMapTexture* GetConvolutedTexture();
 
+		// Roughness prefiltered mip chain made offline with --bake-skyboxes, the convolution is never run here
+		// Looked up in the cube map cache on first call, at the default settings - null if this sky has not been baked with them
+		Texture::CubeMapTexture* GetPrefilteredTexture();
+
 		void                     ConvoluteTexture();
 
-		// Make sure to call this when everything else has already been drawn, 
-		// Otherwise it would ruin the draw rate
-		void Render(Camera* camera, Texture::CubeMapTexture* textureToReplaceSkybox = nullptr);
+		// Uploads any faces that have finished decoding and picks up the irradiance once it has been projected
+		// Has to be called on the render thread before the skybox is used each frame
+		void                     UpdateStreaming();
+
+		// Projected from the face images on a worker thread - until that finishes this is the placeholder colour, or black
+		const IrradianceSH9&     GetIrradianceSH() const { return mIrradianceSH; }
 
-		void Render(glm::mat4 viewMatrix, glm::mat4 projectionMatrix, Texture::CubeMapTexture* textureToReplaceSkybox = nullptr);
+		// Recorded into the sky pass, which the queue replays after everything opaque so the depth test rejects covered pixels
+		// The camera comes from the shared camera block
+		void RecordRenderCommands(RenderCommandList& commandList, bool wireframe, Texture::CubeMapTexture* textureToReplaceSkybox = nullptr);
+
+		// Finds the faces in a skybox folder by the end of their names - right, left, top or up, bottom or down, front and back
+		// Written out in cube map face order, false unless all six are there
+		static bool  FindFaceFilePaths(const std::string& directory, std::string faceFilePaths[6]);
 
 		std::string* GetFilePaths()                  { return mFilePaths; }
 		std::string  GetName()                       { return mName; }
@@ -44,22 +63,42 @@ namespace Rendering
 		static Maths::Vector::Vector3D<float> mCubeData[36];
 
 		void LoadCubeMapTextures(std::string filePaths[6]);
+		void StreamCubeMapTextures(std::string filePaths[6], glm::vec3 placeholderColour);
 		void SetupBufferData();
 
+		void StartIrradianceProjection();
+
 		// Array of 6 textures, one for each side
 		Texture::CubeMapTexture*       mCubeMapTexture;
 		Texture::CubeMapTexture*       mConvolutedVersion;
+		Texture::CubeMapTexture*       mPrefilteredVersion;
 
 		std::string                    mFilePaths[6];
 		std::string                    mName;
 		std::string                    mInternalName;
 
-		Buffers::VertexArrayObject*    mCubeVAO;
-		ShaderPrograms::ShaderProgram* mSkyBoxProgram;
+		// Shared by every skybox, so a set streamed in by the library links nothing and uploads no mesh of its own
+		// Made by the first skybox and freed with the last
+		static Buffers::VertexArrayObject*    mCubeVAO;
+		static ShaderPrograms::ShaderProgram* mSkyBoxProgram;
 
-		Buffers::VertexBufferObject*   mCubeVBO;
+		static Buffers::VertexBufferObject*   mCubeVBO;
+
+		static unsigned int                   mInstanceCount;
+
+		// Hashed from the face images the first time the irradiance map is needed, zero until then
+		unsigned int                   mIrradianceCacheKey;
+
+		IrradianceSH9                  mIrradianceSH;
+		IrradianceSH9                  mProjectedIrradianceSH; // Written by the worker, only read once mIrradianceProjection is ready
+		std::future<bool>              mIrradianceProjection;
 
 		bool mShowingIrradianceMap;
+
+		// A map loaded from the cache was made from the real faces, so is kept when streaming finishes
+		bool mConvolutedFromCache;
+
+		bool mPrefilteredLookedUp;
 	};
 
 	// --------------------------------------
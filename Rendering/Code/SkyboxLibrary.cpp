@@ -0,0 +1,344 @@
+#include "SkyboxLibrary.h"
+
+#include "Skybox.h"
+
+#include "Rendering/Code/STB_Image/stb_image.h"
+
+#include "Include/imgui/imgui.h"
+
+#include <filesystem>
+#include <algorithm>
+
+namespace Rendering
+{
+	// -----------------------------------------
+
+	static const size_t kBytesPerMegabyte = 1024 * 1024;
+
+	// -----------------------------------------
+
+	SkyboxLibrary::Entry::Entry()
+		: mName()
+		, mFaceFilePaths()
+		, mSkybox(nullptr)
+		, mSizeBytes(0)
+		, mLastUsedFrame(0)
+		, mQueuedForPreload(false)
+	{
+
+	}
+
+	// -----------------------------------------
+
+	SkyboxLibrary::SkyboxLibrary(const std::string& directory, size_t residentBudgetBytes, glm::vec3 placeholderColour)
+		: mEntries()
+		, mPreloadQueue()
+		, mActiveIndex(-1)
+		, mResidentBudget(residentBudgetBytes)
+		, mResidentBytes(0)
+		, mFrameNumber(0)
+		, mPlaceholderColour(placeholderColour)
+	{
+		std::error_code                     error;
+		std::filesystem::directory_iterator folders(directory, error);
+
+		if (error)
+			return;
+
+		for (const std::filesystem::directory_entry& folder : folders)
+		{
+			if (!folder.is_directory(error))
+				continue;
+
+			Entry entry;
+			entry.mName = folder.path().filename().string();
+
+			if (!Skybox::FindFaceFilePaths(folder.path().generic_string(), entry.mFaceFilePaths))
+				continue;
+
+			// Only the header is read, the faces are decoded when the set is loaded
+			int width        = 0;
+			int height       = 0;
+			int channelCount = 0;
+
+			if (!stbi_info(entry.mFaceFilePaths[0].c_str(), &width, &height, &channelCount))
+				continue;
+
+			// Uploaded as RGB8
+			entry.mSizeBytes = (size_t)width * (size_t)height * 3 * 6;
+
+			mEntries.push_back(entry);
+		}
+
+		std::sort(mEntries.begin(), mEntries.end(), [](const Entry& a, const Entry& b) { return a.mName < b.mName; });
+	}
+
+	// -----------------------------------------
+
+	SkyboxLibrary::~SkyboxLibrary()
+	{
+		for (unsigned int i = 0; i < mEntries.size(); i++)
+		{
+			delete mEntries[i].mSkybox;
+			mEntries[i].mSkybox = nullptr;
+		}
+	}
+
+	// -----------------------------------------
+
+	void SkyboxLibrary::Update()
+	{
+		mFrameNumber++;
+
+		if (mActiveIndex >= 0)
+		{
+			mEntries[mActiveIndex].mLastUsedFrame = mFrameNumber;
+		}
+
+		for (unsigned int i = 0; i < mEntries.size(); i++)
+		{
+			if (mEntries[i].mSkybox)
+			{
+				mEntries[i].mSkybox->UpdateStreaming();
+			}
+		}
+
+		// One set at a time, so the preloads never hold up the active set's own faces or flood the decode workers
+		if (GetIsAnyStreaming())
+			return;
+
+		while (!mPreloadQueue.empty())
+		{
+			unsigned int index = mPreloadQueue.front();
+			Entry&       entry = mEntries[index];
+
+			if (entry.mSkybox)
+			{
+				entry.mQueuedForPreload = false;
+				mPreloadQueue.pop_front();
+				continue;
+			}
+
+			// Left queued in case space frees up later, such as the budget being raised
+			if (mResidentBytes + entry.mSizeBytes > mResidentBudget)
+				return;
+
+			entry.mQueuedForPreload = false;
+			mPreloadQueue.pop_front();
+
+			Load(index);
+
+			return;
+		}
+	}
+
+	// -----------------------------------------
+
+	Skybox* SkyboxLibrary::SetActive(const std::string& name)
+	{
+		int index = FindEntry(name);
+
+		if (index < 0)
+			return GetActive();
+
+		mActiveIndex = index;
+
+		Entry& entry = mEntries[index];
+		entry.mLastUsedFrame = mFrameNumber;
+
+		if (!entry.mSkybox)
+		{
+			// The active set always loads, even if nothing else could be evicted to make room for it
+			MakeRoom(entry.mSizeBytes);
+
+			Load((unsigned int)index);
+		}
+
+		return entry.mSkybox;
+	}
+
+	// -----------------------------------------
+
+	Skybox* SkyboxLibrary::GetActive() const
+	{
+		if (mActiveIndex < 0)
+			return nullptr;
+
+		return mEntries[mActiveIndex].mSkybox;
+	}
+
+	// -----------------------------------------
+
+	void SkyboxLibrary::Preload(const std::string& name)
+	{
+		int index = FindEntry(name);
+
+		if (index < 0)
+			return;
+
+		Entry& entry = mEntries[index];
+
+		if (entry.mSkybox || entry.mQueuedForPreload)
+			return;
+
+		entry.mQueuedForPreload = true;
+		mPreloadQueue.push_back((unsigned int)index);
+	}
+
+	// -----------------------------------------
+
+	void SkyboxLibrary::PreloadAll()
+	{
+		for (unsigned int i = 0; i < mEntries.size(); i++)
+		{
+			Preload(mEntries[i].mName);
+		}
+	}
+
+	// -----------------------------------------
+
+	void SkyboxLibrary::SetResidentBudget(size_t bytes)
+	{
+		mResidentBudget = bytes;
+
+		if (mResidentBytes > mResidentBudget)
+		{
+			MakeRoom(0);
+		}
+	}
+
+	// -----------------------------------------
+
+	int SkyboxLibrary::FindEntry(const std::string& name) const
+	{
+		for (unsigned int i = 0; i < mEntries.size(); i++)
+		{
+			if (mEntries[i].mName == name)
+				return (int)i;
+		}
+
+		return -1;
+	}
+
+	// -----------------------------------------
+
+	void SkyboxLibrary::Load(unsigned int index)
+	{
+		Entry& entry = mEntries[index];
+
+		if (entry.mSkybox)
+			return;
+
+		// Only reads the headers here, the decoding happens on workers and the uploads in UpdateStreaming
+		entry.mSkybox        = new Skybox(entry.mName, entry.mFaceFilePaths, mPlaceholderColour);
+		entry.mLastUsedFrame = mFrameNumber;
+
+		mResidentBytes += entry.mSizeBytes;
+	}
+
+	// -----------------------------------------
+
+	void SkyboxLibrary::Evict(unsigned int index)
+	{
+		Entry& entry = mEntries[index];
+
+		if (!entry.mSkybox)
+			return;
+
+		delete entry.mSkybox;
+		entry.mSkybox = nullptr;
+
+		mResidentBytes -= std::min(mResidentBytes, entry.mSizeBytes);
+	}
+
+	// -----------------------------------------
+
+	bool SkyboxLibrary::MakeRoom(size_t bytesNeeded)
+	{
+		while (mResidentBytes + bytesNeeded > mResidentBudget)
+		{
+			int leastRecentlyUsed = -1;
+
+			for (unsigned int i = 0; i < mEntries.size(); i++)
+			{
+				const Entry& entry = mEntries[i];
+
+				if (!entry.mSkybox || (int)i == mActiveIndex)
+					continue;
+
+				// Deleting a set mid-stream would wait on its decodes, so it is left until it has finished
+				if (entry.mSkybox->GetCubeMapTexture() && entry.mSkybox->GetCubeMapTexture()->GetIsStreaming())
+					continue;
+
+				if (leastRecentlyUsed < 0 || entry.mLastUsedFrame < mEntries[leastRecentlyUsed].mLastUsedFrame)
+				{
+					leastRecentlyUsed = (int)i;
+				}
+			}
+
+			if (leastRecentlyUsed < 0)
+				return false;
+
+			Evict((unsigned int)leastRecentlyUsed);
+		}
+
+		return true;
+	}
+
+	// -----------------------------------------
+
+	bool SkyboxLibrary::GetIsAnyStreaming() const
+	{
+		for (unsigned int i = 0; i < mEntries.size(); i++)
+		{
+			const Skybox* skybox = mEntries[i].mSkybox;
+
+			if (skybox && skybox->GetCubeMapTexture() && skybox->GetCubeMapTexture()->GetIsStreaming())
+				return true;
+		}
+
+		return false;
+	}
+
+	// -----------------------------------------
+
+	void SkyboxLibrary::RenderDebugMenu()
+	{
+		ImGui::Begin("Skybox");
+
+			ImGui::Text("Resident: %.1f MB of %.1f MB", (float)mResidentBytes / (float)kBytesPerMegabyte, (float)mResidentBudget / (float)kBytesPerMegabyte);
+			ImGui::Text("Queued for preload: %u", (unsigned int)mPreloadQueue.size());
+
+			int budgetMegabytes = (int)(mResidentBudget / kBytesPerMegabyte);
+			if (ImGui::SliderInt("Budget (MB)", &budgetMegabytes, 0, 256))
+			{
+				SetResidentBudget((size_t)budgetMegabytes * kBytesPerMegabyte);
+			}
+
+			const char* activeName = mActiveIndex >= 0 ? mEntries[mActiveIndex].mName.c_str() : "None";
+
+			if (ImGui::BeginCombo("Sky", activeName))
+			{
+				for (unsigned int i = 0; i < mEntries.size(); i++)
+				{
+					std::string label = mEntries[i].mName + (mEntries[i].mSkybox ? " (resident)" : "");
+
+					if (ImGui::Selectable(label.c_str(), (int)i == mActiveIndex))
+					{
+						SetActive(mEntries[i].mName);
+					}
+				}
+
+				ImGui::EndCombo();
+			}
+
+			if (ImGui::Button("Preload all"))
+			{
+				PreloadAll();
+			}
+
+		ImGui::End();
+	}
+
+	// -----------------------------------------
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <glm/matrix.hpp>
+
+#include <string>
+#include <vector>
+#include <deque>
+
+namespace Rendering
+{
+	// --------------------------------------
+
+	class Skybox;
+
+	// --------------------------------------
+
+	// Every skybox set found under a directory, with as many of them kept on the GPU as a memory budget allows
+	// Sets are streamed in through the skybox's own worker decode, so neither preloading nor switching waits on the images,
+	// and switching to a set that is already resident only swaps the pointer handed out by GetActive
+	// Once over budget the least recently shown set is the first to go
+	// This is the only budget the face textures are under - TextureResidency counts them but never evicts them
+	class SkyboxLibrary final
+	{
+	public:
+		SkyboxLibrary(const std::string& directory, size_t residentBudgetBytes, glm::vec3 placeholderColour);
+		~SkyboxLibrary();
+
+		// Called once a frame on the render thread, before the active skybox is used
+		// Pushes every streaming set forward, and starts the next preload once nothing else is streaming
+		void               Update();
+
+		// Starts streaming the set in if it is not resident, showing the placeholder colour until its faces arrive
+		// Returns the new active skybox, or the old one if there is no set of that name
+		Skybox*            SetActive(const std::string& name);
+		Skybox*            GetActive() const;
+
+		// Loaded in the background one at a time, and only into budget that is free - a preload never evicts another set
+		void               Preload(const std::string& name);
+		void               PreloadAll();
+
+		// Lowering the budget evicts straight away, down to the active set if needs be
+		void               SetResidentBudget(size_t bytes);
+		size_t             GetResidentBudget() const { return mResidentBudget; }
+		size_t             GetResidentBytes()  const { return mResidentBytes;  }
+
+		unsigned int       GetSetCount()                      const { return (unsigned int)mEntries.size(); }
+		const std::string& GetSetName(unsigned int index)     const { return mEntries[index].mName; }
+		bool               GetIsResident(unsigned int index)  const { return mEntries[index].mSkybox != nullptr; }
+
+		void               RenderDebugMenu();
+
+	private:
+		SkyboxLibrary(const SkyboxLibrary&)            = delete;
+		SkyboxLibrary& operator=(const SkyboxLibrary&) = delete;
+
+		struct Entry
+		{
+			Entry();
+
+			std::string        mName;
+			std::string        mFaceFilePaths[6];
+
+			Skybox*            mSkybox;
+
+			// Worked out from the image headers when the directory is scanned, as the faces are uploaded
+			size_t             mSizeBytes;
+			unsigned long long mLastUsedFrame;
+			bool               mQueuedForPreload;
+		};
+
+		int  FindEntry(const std::string& name) const;
+
+		void Load(unsigned int index);
+		void Evict(unsigned int index);
+
+		// Evicts the least recently used sets until bytesNeeded more would fit - the active set and any still streaming are left alone
+		// Returns false if that can not be done
+		bool MakeRoom(size_t bytesNeeded);
+
+		bool GetIsAnyStreaming() const;
+
+		std::vector<Entry>       mEntries;
+		std::deque<unsigned int> mPreloadQueue;
+
+		int                      mActiveIndex;
+
+		size_t                   mResidentBudget;
+		size_t                   mResidentBytes;
+
+		unsigned long long       mFrameNumber;
+
+		glm::vec3                mPlaceholderColour;
+	};
+
+	// --------------------------------------
+}
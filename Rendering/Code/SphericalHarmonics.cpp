@@ -0,0 +1,306 @@
+#include "SphericalHarmonics.h"
+
+#include "Textures/BMPImage.h"
+
+#include "Rendering/Code/STB_Image/stb_image.h"
+
+#include "Maths/Code/Parallel.h"
+
+#include <emmintrin.h>
+
+#include <vector>
+#include <mutex>
+
+namespace Rendering
+{
+	// --------------------------------------
+
+	// Real spherical harmonic basis constants for bands 0 to 2
+	static const float kBasisBand0   = 0.282095f;
+	static const float kBasisBand1   = 0.488603f;
+	static const float kBasisBand2   = 1.092548f;
+	static const float kBasisBand2_0 = 0.315392f;
+	static const float kBasisBand2_2 = 0.546274f;
+
+	// The cosine lobe convolved per band is pi, 2pi/3 and pi/4 - divided through by pi, as the convolution shader does for the irradiance map
+	static const float kBandScales[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+	static const float kFourPi        = 12.5663706144f;
+
+	// --------------------------------------
+
+	// Where each face sits on the unit cube - the texel at (u, v) in [-1, 1] points along mMajor + u * mUAxis + v * mVAxis
+	// This follows the GL cube map face layout, with v increasing down the image as the rows are uploaded top first
+	struct CubeMapFaceAxes
+	{
+		glm::vec3 mMajor;
+		glm::vec3 mUAxis;
+		glm::vec3 mVAxis;
+	};
+
+	static const CubeMapFaceAxes kFaceAxes[6] =
+	{
+		{ {  1.0f,  0.0f,  0.0f }, {  0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f,  0.0f } },
+		{ { -1.0f,  0.0f,  0.0f }, {  0.0f, 0.0f,  1.0f }, { 0.0f, -1.0f,  0.0f } },
+		{ {  0.0f,  1.0f,  0.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f,  1.0f } },
+		{ {  0.0f, -1.0f,  0.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f, -1.0f } },
+		{ {  0.0f,  0.0f,  1.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } },
+		{ {  0.0f,  0.0f, -1.0f }, { -1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } }
+	};
+
+	// --------------------------------------
+
+	// One face's pixels, either mapped straight from a BMP or decoded by stb_image
+	struct SourceFace
+	{
+		SourceFace() : mMappedImage(), mDecodedPixels(nullptr), mSize(0), mBlueFirst(false) { }
+		~SourceFace() { stbi_image_free(mDecodedPixels); }
+
+		bool Load(const std::string& filePath)
+		{
+			if (mMappedImage.Open(filePath))
+			{
+				if (mMappedImage.GetWidth() != mMappedImage.GetHeight())
+					return false;
+
+				mSize      = mMappedImage.GetWidth();
+				mBlueFirst = true;
+
+				return true;
+			}
+
+			int width        = 0;
+			int height       = 0;
+			int channelCount = 0;
+
+			mDecodedPixels = stbi_load(filePath.c_str(), &width, &height, &channelCount, 3);
+
+			if (!mDecodedPixels || width != height)
+				return false;
+
+			mSize      = width;
+			mBlueFirst = false;
+
+			return true;
+		}
+
+		// Counted from the top, three bytes a texel
+		const unsigned char* GetRow(int row) const
+		{
+			if (mDecodedPixels)
+				return mDecodedPixels + (size_t)row * (size_t)mSize * 3;
+
+			return mMappedImage.GetRow(row);
+		}
+
+		Texture::BMPImage mMappedImage;
+		unsigned char*    mDecodedPixels;
+		int               mSize;
+		bool              mBlueFirst;
+	};
+
+	// --------------------------------------
+
+	static float HorizontalSum(__m128 value)
+	{
+		float lanes[4];
+		_mm_storeu_ps(lanes, value);
+
+		return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	}
+
+	// --------------------------------------
+
+	IrradianceSH9::IrradianceSH9()
+		: mCoefficients{ glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(0.0f) }
+	{
+
+	}
+
+	// --------------------------------------
+
+	IrradianceSH9 IrradianceSH9::FromConstant(glm::vec3 radiance)
+	{
+		// Only band 0 is non-zero, and evaluating it has to give the radiance straight back
+		IrradianceSH9 constant;
+		constant.mCoefficients[0] = radiance / kBasisBand0;
+
+		return constant;
+	}
+
+	// --------------------------------------
+
+	bool IrradianceSH9::ProjectCubeMapFaces(const std::string faceFilePaths[6], IrradianceSH9& output)
+	{
+		SourceFace faces[6];
+
+		for (unsigned int i = 0; i < 6; i++)
+		{
+			if (!faces[i].Load(faceFilePaths[i]) || faces[i].mSize != faces[0].mSize || faces[i].mSize == 0)
+				return false;
+		}
+
+		const int size = faces[0].mSize;
+
+		// Padded out to whole groups of four, with the extra columns masked to a weight of zero
+		const int paddedSize = (size + 3) & ~3;
+
+		std::vector<float> columnU(paddedSize, 0.0f);
+		std::vector<float> columnMask(paddedSize, 0.0f);
+
+		for (int column = 0; column < size; column++)
+		{
+			columnU[column]    = (2.0f * ((float)column + 0.5f) / (float)size) - 1.0f;
+			columnMask[column] = 1.0f;
+		}
+
+		// ----------
+
+		float      totalSums[9][3] = {};
+		float      totalWeight     = 0.0f;
+		std::mutex totalsLock;
+
+		// Every row of every face is one item, so the six faces share out across the workers however many of them there are
+		Engine::Parallel::ParallelFor(0, 6 * (unsigned int)size, (unsigned int)size / 4, [&](unsigned int rowStart, unsigned int rowEnd)
+		{
+			__m128 sums[9][3];
+			__m128 weightSum = _mm_setzero_ps();
+
+			for (unsigned int k = 0; k < 9; k++)
+			{
+				sums[k][0] = _mm_setzero_ps();
+				sums[k][1] = _mm_setzero_ps();
+				sums[k][2] = _mm_setzero_ps();
+			}
+
+			const __m128 one        = _mm_set1_ps(1.0f);
+			const __m128 three      = _mm_set1_ps(3.0f);
+			const __m128 byteToUnit = _mm_set1_ps(1.0f / 255.0f);
+
+			const __m128 band1      = _mm_set1_ps(kBasisBand1);
+			const __m128 band2      = _mm_set1_ps(kBasisBand2);
+			const __m128 band2_0    = _mm_set1_ps(kBasisBand2_0);
+			const __m128 band2_2    = _mm_set1_ps(kBasisBand2_2);
+
+			for (unsigned int row = rowStart; row < rowEnd; row++)
+			{
+				const unsigned int     faceIndex = row / (unsigned int)size;
+				const int              y         = (int)(row % (unsigned int)size);
+				const SourceFace&      face      = faces[faceIndex];
+				const CubeMapFaceAxes& axes      = kFaceAxes[faceIndex];
+
+				const float v = (2.0f * ((float)y + 0.5f) / (float)size) - 1.0f;
+
+				// The part of the direction shared by the whole row
+				const glm::vec3 rowBase = axes.mMajor + v * axes.mVAxis;
+
+				const __m128 baseX = _mm_set1_ps(rowBase.x);
+				const __m128 baseY = _mm_set1_ps(rowBase.y);
+				const __m128 baseZ = _mm_set1_ps(rowBase.z);
+
+				const __m128 uAxisX = _mm_set1_ps(axes.mUAxis.x);
+				const __m128 uAxisY = _mm_set1_ps(axes.mUAxis.y);
+				const __m128 uAxisZ = _mm_set1_ps(axes.mUAxis.z);
+
+				const unsigned char* pixels     = face.GetRow(y);
+				const int            redOffset  = face.mBlueFirst ? 2 : 0;
+				const int            blueOffset = face.mBlueFirst ? 0 : 2;
+
+				for (int x = 0; x < paddedSize; x += 4)
+				{
+					__m128 u = _mm_loadu_ps(&columnU[x]);
+
+					__m128 directionX = _mm_add_ps(baseX, _mm_mul_ps(u, uAxisX));
+					__m128 directionY = _mm_add_ps(baseY, _mm_mul_ps(u, uAxisY));
+					__m128 directionZ = _mm_add_ps(baseZ, _mm_mul_ps(u, uAxisZ));
+
+					// 1 + u^2 + v^2, as one of the components is always the unit major axis
+					__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, directionX), _mm_mul_ps(directionY, directionY)), _mm_mul_ps(directionZ, directionZ));
+					__m128 inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+
+					// The solid angle a texel covers falls off with the cube of the distance to it
+					__m128 weight = _mm_mul_ps(_mm_mul_ps(inverseLength, _mm_mul_ps(inverseLength, inverseLength)), _mm_loadu_ps(&columnMask[x]));
+
+					__m128 normalX = _mm_mul_ps(directionX, inverseLength);
+					__m128 normalY = _mm_mul_ps(directionY, inverseLength);
+					__m128 normalZ = _mm_mul_ps(directionZ, inverseLength);
+
+					// ----------
+
+					float red[4]   = { 0.0f, 0.0f, 0.0f, 0.0f };
+					float green[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					float blue[4]  = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+					const int laneCount = std::min(4, size - x);
+
+					for (int lane = 0; lane < laneCount; lane++)
+					{
+						const unsigned char* texel = pixels + (size_t)(x + lane) * 3;
+
+						red[lane]   = (float)texel[redOffset];
+						green[lane] = (float)texel[1];
+						blue[lane]  = (float)texel[blueOffset];
+					}
+
+					__m128 texelScale = _mm_mul_ps(weight, byteToUnit);
+
+					__m128 colour[3] = { _mm_mul_ps(_mm_loadu_ps(red),   texelScale),
+						                 _mm_mul_ps(_mm_loadu_ps(green), texelScale),
+						                 _mm_mul_ps(_mm_loadu_ps(blue),  texelScale) };
+
+					// ----------
+
+					// Band 0 is a constant, so is applied once at the end rather than per texel
+					__m128 basis[9];
+					basis[0] = one;
+					basis[1] = _mm_mul_ps(band1, normalY);
+					basis[2] = _mm_mul_ps(band1, normalZ);
+					basis[3] = _mm_mul_ps(band1, normalX);
+					basis[4] = _mm_mul_ps(band2, _mm_mul_ps(normalX, normalY));
+					basis[5] = _mm_mul_ps(band2, _mm_mul_ps(normalY, normalZ));
+					basis[6] = _mm_mul_ps(band2_0, _mm_sub_ps(_mm_mul_ps(three, _mm_mul_ps(normalZ, normalZ)), one));
+					basis[7] = _mm_mul_ps(band2, _mm_mul_ps(normalX, normalZ));
+					basis[8] = _mm_mul_ps(band2_2, _mm_sub_ps(_mm_mul_ps(normalX, normalX), _mm_mul_ps(normalY, normalY)));
+
+					for (unsigned int k = 0; k < 9; k++)
+					{
+						sums[k][0] = _mm_add_ps(sums[k][0], _mm_mul_ps(basis[k], colour[0]));
+						sums[k][1] = _mm_add_ps(sums[k][1], _mm_mul_ps(basis[k], colour[1]));
+						sums[k][2] = _mm_add_ps(sums[k][2], _mm_mul_ps(basis[k], colour[2]));
+					}
+
+					weightSum = _mm_add_ps(weightSum, weight);
+				}
+			}
+
+			// Once per chunk, so the lock is never contended for long
+			std::lock_guard<std::mutex> lock(totalsLock);
+
+			for (unsigned int k = 0; k < 9; k++)
+			{
+				totalSums[k][0] += HorizontalSum(sums[k][0]);
+				totalSums[k][1] += HorizontalSum(sums[k][1]);
+				totalSums[k][2] += HorizontalSum(sums[k][2]);
+			}
+
+			totalWeight += HorizontalSum(weightSum);
+		});
+
+		if (totalWeight <= 0.0f)
+			return false;
+
+		// The weights were left without the texel area, so they are normalised to cover the whole sphere instead
+		const float normalisation = kFourPi / totalWeight;
+
+		for (unsigned int k = 0; k < 9; k++)
+		{
+			float scale = normalisation * kBandScales[k] * (k == 0 ? kBasisBand0 : 1.0f);
+
+			output.mCoefficients[k] = glm::vec3(totalSums[k][0], totalSums[k][1], totalSums[k][2]) * scale;
+		}
+
+		return true;
+	}
+
+	// --------------------------------------
+}
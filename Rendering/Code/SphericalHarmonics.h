@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glm/matrix.hpp>
+
+#include <string>
+
+namespace Rendering
+{
+	// --------------------------------------
+
+	// The light arriving from a cube map as nine spherical harmonic coefficients, already convolved with the cosine lobe
+	// Evaluating it for a normal gives what the 32x32 irradiance map would have held in that direction, without a render pass to build it
+	// or a cube map fetch to read it - see EvaluateIrradianceSH in Include/SphericalHarmonics.glsl
+	struct IrradianceSH9
+	{
+		IrradianceSH9();
+
+		// Uniform light from every direction, such as a placeholder sky
+		static IrradianceSH9 FromConstant(glm::vec3 radiance);
+
+		// Projects six face images onto the basis in a single pass over their texels, split across the worker threads
+		// Uncompressed BMPs are read in place from a file mapping, anything else goes through stb_image
+		// CPU only, so it can run on any thread - returns false if a face can not be read or the faces differ in size
+		static bool          ProjectCubeMapFaces(const std::string faceFilePaths[6], IrradianceSH9& output);
+
+		// Band 0, then the three of band 1 in y, z, x order, then the five of band 2
+		glm::vec3            mCoefficients[9];
+	};
+
+	// --------------------------------------
+}
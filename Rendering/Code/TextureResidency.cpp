@@ -0,0 +1,457 @@
+#include "TextureResidency.h"
+
+#include "GLStateCache.h"
+
+#include "Include/imgui/imgui.h"
+
+#include <algorithm>
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	static const size_t kBytesPerMegabyte = 1024 * 1024;
+
+	// ---------------------------------------
+
+	std::unordered_map<unsigned int, TextureResidency::Entry> TextureResidency::sEntries;
+	std::vector<unsigned int>                                TextureResidency::sPendingReloads;
+
+	size_t                                                   TextureResidency::sBudgetBytes                                          = 128 * kBytesPerMegabyte;
+	size_t                                                   TextureResidency::sResidentBytes[(unsigned int)TextureCategory::Count] = { 0 };
+	size_t                                                   TextureResidency::sEvictedBytes[(unsigned int)TextureCategory::Count]  = { 0 };
+
+	unsigned long long                                       TextureResidency::sFrameNumber                                          = 0;
+
+	unsigned int                                             TextureResidency::sEvictionCount                                        = 0;
+	unsigned int                                             TextureResidency::sReloadCount                                          = 0;
+
+	// ---------------------------------------
+
+	// Evicting and reloading both go through unit 0, which may be half way through being set up for whatever triggered them
+	// The texture is most likely still bound there from the frame that asked for it, so the texture's own bind would be skipped and
+	// leave another unit active - each one is bound to unit 0 with ForceBindTexture first, so every upload lands in the right texture
+	struct UnitZeroBindings
+	{
+		UnitZeroBindings()
+			: mTexture2D(GLStateCache::GetBoundTexture(0, GL_TEXTURE_2D))
+			, mCubeMap(GLStateCache::GetBoundTexture(0, GL_TEXTURE_CUBE_MAP))
+		{
+
+		}
+
+		~UnitZeroBindings()
+		{
+			GLStateCache::BindTexture(0, GL_TEXTURE_2D,       mTexture2D);
+			GLStateCache::BindTexture(0, GL_TEXTURE_CUBE_MAP, mCubeMap);
+		}
+
+		unsigned int mTexture2D;
+		unsigned int mCubeMap;
+	};
+
+	// ---------------------------------------
+
+	void TextureResidency::Register(ResidentTexture* texture, unsigned int textureID, GLenum target, TextureCategory category)
+	{
+		if (!texture || textureID == 0)
+			return;
+
+		Unregister(textureID);
+
+		Entry& entry = sEntries[textureID];
+
+		entry.mTexture       = texture;
+		entry.mTarget        = target;
+		entry.mCategory      = category;
+		entry.mSizeBytes     = 0;
+		entry.mLastUsedFrame = sFrameNumber;
+		entry.mResident      = true;
+		entry.mReloadFailed  = false;
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::Unregister(unsigned int textureID)
+	{
+		std::unordered_map<unsigned int, Entry>::iterator found = sEntries.find(textureID);
+
+		if (found == sEntries.end())
+			return;
+
+		AccountFor(found->second, false);
+
+		sEntries.erase(found);
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::SetSize(unsigned int textureID, size_t sizeBytes)
+	{
+		std::unordered_map<unsigned int, Entry>::iterator found = sEntries.find(textureID);
+
+		if (found == sEntries.end())
+			return;
+
+		AccountFor(found->second, false);
+
+		// Whatever set the size has just filled the texture, so it is resident again and can be tried again
+		found->second.mSizeBytes    = sizeBytes;
+		found->second.mResident     = true;
+		found->second.mReloadFailed = false;
+
+		AccountFor(found->second, true);
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::SetCategory(unsigned int textureID, TextureCategory category)
+	{
+		std::unordered_map<unsigned int, Entry>::iterator found = sEntries.find(textureID);
+
+		if (found == sEntries.end())
+			return;
+
+		AccountFor(found->second, false);
+
+		found->second.mCategory = category;
+
+		AccountFor(found->second, true);
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::AccountFor(const Entry& entry, bool adding)
+	{
+		size_t* totals = entry.mResident ? sResidentBytes : sEvictedBytes;
+
+		if (adding)
+			totals[(unsigned int)entry.mCategory] += entry.mSizeBytes;
+		else
+			totals[(unsigned int)entry.mCategory] -= entry.mSizeBytes;
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::OnBind(unsigned int textureID)
+	{
+		if (textureID == 0)
+			return;
+
+		std::unordered_map<unsigned int, Entry>::iterator found = sEntries.find(textureID);
+
+		if (found == sEntries.end())
+			return;
+
+		Entry& entry = found->second;
+
+		entry.mLastUsedFrame = sFrameNumber;
+
+		// Reloading here would bind and upload in the middle of whatever is setting up this bind
+		if (!entry.mResident && !entry.mReloadFailed && std::find(sPendingReloads.begin(), sPendingReloads.end(), textureID) == sPendingReloads.end())
+		{
+			sPendingReloads.push_back(textureID);
+		}
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::EnsureResident(unsigned int textureID)
+	{
+		if (textureID == 0)
+			return;
+
+		std::unordered_map<unsigned int, Entry>::iterator found = sEntries.find(textureID);
+
+		if (found == sEntries.end())
+			return;
+
+		Entry& entry = found->second;
+
+		entry.mLastUsedFrame = sFrameNumber;
+
+		if (!entry.mResident && !entry.mReloadFailed)
+		{
+			Reload(textureID, entry);
+		}
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::Evict(unsigned int textureID, Entry& entry)
+	{
+		{
+			UnitZeroBindings savedBindings;
+
+			GLStateCache::ForceBindTexture(0, entry.mTarget, textureID);
+
+			entry.mTexture->Evict();
+		}
+
+		// Only marked once the texture's own binds are done, or they would bring it straight back
+		AccountFor(entry, false);
+		entry.mResident = false;
+		AccountFor(entry, true);
+
+		sEvictionCount++;
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::Reload(unsigned int textureID, Entry& entry)
+	{
+		// Marked first, so the binds made while reloading do not queue it up again
+		AccountFor(entry, false);
+		entry.mResident = true;
+		AccountFor(entry, true);
+
+		bool reloaded;
+
+		{
+			UnitZeroBindings savedBindings;
+
+			GLStateCache::ForceBindTexture(0, entry.mTarget, textureID);
+
+			reloaded = entry.mTexture->Reload();
+		}
+
+		sReloadCount++;
+
+		if (reloaded)
+			return;
+
+		AccountFor(entry, false);
+		entry.mResident     = false;
+		entry.mReloadFailed = true;
+		AccountFor(entry, true);
+	}
+
+	// ---------------------------------------
+
+	bool TextureResidency::GetIsCold(TextureCategory category)
+	{
+		return category == TextureCategory::BakedCache ||
+			   category == TextureCategory::Debug      ||
+			   category == TextureCategory::General;
+	}
+
+	// ---------------------------------------
+
+	bool TextureResidency::GetIsBound(unsigned int textureID, GLenum target)
+	{
+		for (unsigned int i = 0; i < GLStateCache::kMaxTextureUnits; i++)
+		{
+			if (GLStateCache::GetBoundTexture(i, target) == textureID)
+				return true;
+		}
+
+		return false;
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::BeginFrame()
+	{
+		sFrameNumber++;
+
+		// Anything unregistered or already brought back since it was queued is skipped by EnsureResident
+		for (unsigned int textureID : sPendingReloads)
+		{
+			EnsureResident(textureID);
+		}
+
+		sPendingReloads.clear();
+
+		if (GetResidentBytes() <= sBudgetBytes)
+			return;
+
+		std::vector<unsigned int> candidates;
+
+		for (std::pair<const unsigned int, Entry>& pair : sEntries)
+		{
+			const Entry& entry = pair.second;
+
+			if (!entry.mResident || entry.mSizeBytes == 0 || !GetIsCold(entry.mCategory))
+				continue;
+
+			if (sFrameNumber - entry.mLastUsedFrame < kMinIdleFrames)
+				continue;
+
+			// Still bound from last frame, and anything sampling it would not go back through OnBind to reload it
+			if (GetIsBound(pair.first, entry.mTarget) || !entry.mTexture->GetCanEvict())
+				continue;
+
+			candidates.push_back(pair.first);
+		}
+
+		// Least recently used first
+		std::sort(candidates.begin(), candidates.end(), [](unsigned int a, unsigned int b)
+		{
+			return sEntries[a].mLastUsedFrame < sEntries[b].mLastUsedFrame;
+		});
+
+		for (unsigned int textureID : candidates)
+		{
+			if (GetResidentBytes() <= sBudgetBytes)
+				break;
+
+			Evict(textureID, sEntries[textureID]);
+		}
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::SetBudget(size_t bytes)
+	{
+		// Applied at the start of the next frame rather than here, which may be in the middle of recording one
+		sBudgetBytes = bytes;
+	}
+
+	// ---------------------------------------
+
+	size_t TextureResidency::GetResidentBytes()
+	{
+		size_t total = 0;
+
+		for (unsigned int i = 0; i < (unsigned int)TextureCategory::Count; i++)
+		{
+			total += sResidentBytes[i];
+		}
+
+		return total;
+	}
+
+	// ---------------------------------------
+
+	const char* TextureResidency::GetCategoryName(TextureCategory category)
+	{
+		switch (category)
+		{
+		case TextureCategory::RenderTarget: return "Render target";
+		case TextureCategory::Simulation:   return "Simulation";
+		case TextureCategory::Video:        return "Video";
+		case TextureCategory::Skybox:       return "Skybox";
+		case TextureCategory::BakedCache:   return "Baked cache";
+		case TextureCategory::Debug:        return "Debug";
+		case TextureCategory::General:      return "General";
+
+		default:
+		break;
+		}
+
+		return "Unknown";
+	}
+
+	// ---------------------------------------
+
+	size_t TextureResidency::GetBytesPerTexel(GLenum internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_R8:
+		case GL_RED:
+			return 1;
+
+		case GL_RG8:
+		case GL_RG:
+		case GL_R16F:
+		case GL_DEPTH_COMPONENT16:
+			return 2;
+
+		// Three byte texels are padded out to four
+		case GL_RGB:
+		case GL_RGB8:
+		case GL_SRGB8:
+		case GL_RGBA:
+		case GL_RGBA8:
+		case GL_SRGB8_ALPHA8:
+		case GL_RG16F:
+		case GL_R32F:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32F:
+		case GL_DEPTH24_STENCIL8:
+		case GL_DEPTH_STENCIL:
+			return 4;
+
+		case GL_RGB16F:
+		case GL_RGBA16F:
+		case GL_RG32F:
+			return 8;
+
+		case GL_RGB32F:
+			return 12;
+
+		case GL_RGBA32F:
+			return 16;
+
+		default:
+		break;
+		}
+
+		return 4;
+	}
+
+	// ---------------------------------------
+
+	size_t TextureResidency::GetLevelChainBytes(unsigned int width, unsigned int height, GLenum internalFormat, unsigned int levelCount)
+	{
+		size_t bytesPerTexel = GetBytesPerTexel(internalFormat);
+		size_t total         = 0;
+
+		for (unsigned int level = 0; level < levelCount; level++)
+		{
+			total += (size_t)width * (size_t)height * bytesPerTexel;
+
+			width  = std::max(width  >> 1, 1u);
+			height = std::max(height >> 1, 1u);
+		}
+
+		return total;
+	}
+
+	// ---------------------------------------
+
+	unsigned int TextureResidency::GetFullChainLevelCount(unsigned int width, unsigned int height)
+	{
+		unsigned int largest    = std::max(width, height);
+		unsigned int levelCount = 1;
+
+		while (largest > 1)
+		{
+			largest >>= 1;
+			levelCount++;
+		}
+
+		return levelCount;
+	}
+
+	// ---------------------------------------
+
+	void TextureResidency::RenderDebugMenu()
+	{
+		ImGui::Begin("Texture residency");
+
+			ImGui::Text("Resident: %.1f MB of %.1f MB", (float)GetResidentBytes() / (float)kBytesPerMegabyte, (float)sBudgetBytes / (float)kBytesPerMegabyte);
+			ImGui::Text("Textures tracked: %u   evictions: %u   reloads: %u", (unsigned int)sEntries.size(), sEvictionCount, sReloadCount);
+
+			int budgetMegabytes = (int)(sBudgetBytes / kBytesPerMegabyte);
+			if (ImGui::SliderInt("Budget (MB)", &budgetMegabytes, 0, 1024))
+			{
+				SetBudget((size_t)budgetMegabytes * kBytesPerMegabyte);
+			}
+
+			ImGui::Separator();
+
+			for (unsigned int i = 0; i < (unsigned int)TextureCategory::Count; i++)
+			{
+				ImGui::Text("%-14s resident: %7.1f MB   evicted: %7.1f MB%s", GetCategoryName((TextureCategory)i),
+					(float)sResidentBytes[i] / (float)kBytesPerMegabyte,
+					(float)sEvictedBytes[i]  / (float)kBytesPerMegabyte,
+					GetIsCold((TextureCategory)i) ? "" : "   (kept)");
+			}
+
+		ImGui::End();
+	}
+
+	// ---------------------------------------
+}
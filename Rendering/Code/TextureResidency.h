@@ -0,0 +1,135 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	// What a texture is for, which decides whether it is ever worth evicting - only the cold kinds are
+	enum class TextureCategory : unsigned int
+	{
+		RenderTarget = 0, // Written to every frame
+		Simulation,       // Ping-ponged by the water compute passes
+		Video,
+		Skybox,           // Left to the SkyboxLibrary budget, which drops whole sets rather than single faces
+		BakedCache,       // Cube maps built from a cache entry or a convolution
+		Debug,            // Only ever looked at through a debug view
+		General,
+
+		Count
+	};
+
+	// ---------------------------------------
+
+	// Implemented by the texture classes so that the residency tracker can drop their storage and bring it back
+	class ResidentTexture
+	{
+	public:
+		virtual ~ResidentTexture() {}
+
+		// False while there is nothing the contents could be rebuilt from, or they are still being streamed in
+		virtual bool GetCanEvict() const = 0;
+
+		// Frees the storage of every level but keeps the texture name, so IDs held elsewhere stay valid
+		virtual void Evict()             = 0;
+
+		// Rebuilds the contents from wherever they first came from - false if that is no longer possible
+		virtual bool Reload()            = 0;
+	};
+
+	// ---------------------------------------
+
+	// Keeps the textures the renderer owns under a GPU memory budget
+	// Every texture registers itself with its size and category, and each bind stamps the frame it was last used on
+	// Once over budget, BeginFrame evicts the least recently used of the cold categories
+	// Nothing is reloaded inside a bind - the render command queue makes its textures resident before replaying anything,
+	// and an evicted texture bound any other way is reloaded at the start of the next frame, so is empty for that one frame at most
+	// Static in the same way as GLStateCache, as it sits underneath the same binds
+	class TextureResidency final
+	{
+	public:
+		static void         Register(ResidentTexture* texture, unsigned int textureID, GLenum target, TextureCategory category);
+		static void         Unregister(unsigned int textureID);
+
+		static void         SetSize(unsigned int textureID, size_t sizeBytes);
+		static void         SetCategory(unsigned int textureID, TextureCategory category);
+
+		// Called by GLStateCache for every texture and image unit bind, elided or not - only stamps the frame and notes an evicted texture is wanted
+		static void         OnBind(unsigned int textureID);
+
+		// Reloads the texture now if it has been evicted - for before a batch of binds, never from inside one
+		static void         EnsureResident(unsigned int textureID);
+
+		// Reloads whatever was bound while evicted last frame, then evicts down to the budget
+		// Called at the start of the frame, when nothing from the last one is still being recorded
+		static void         BeginFrame();
+
+		static void         SetBudget(size_t bytes);
+		static size_t       GetBudget()                                         { return sBudgetBytes; }
+
+		static size_t       GetResidentBytes();
+		static size_t       GetResidentBytes(TextureCategory category)          { return sResidentBytes[(unsigned int)category]; }
+		static size_t       GetEvictedBytes(TextureCategory category)           { return sEvictedBytes[(unsigned int)category];  }
+
+		static unsigned int GetEvictionCount()                                  { return sEvictionCount; }
+		static unsigned int GetReloadCount()                                    { return sReloadCount;   }
+
+		static const char*  GetCategoryName(TextureCategory category);
+
+		// Includes the padding drivers give three channel formats, which are stored as four
+		static size_t       GetBytesPerTexel(GLenum internalFormat);
+
+		// The first levelCount levels of a texture this size, one face's worth for a cube map
+		static size_t       GetLevelChainBytes(unsigned int width, unsigned int height, GLenum internalFormat, unsigned int levelCount);
+
+		// Levels from the given size down to 1x1, as glGenerateMipmap makes
+		static unsigned int GetFullChainLevelCount(unsigned int width, unsigned int height);
+
+		static void         RenderDebugMenu();
+
+	private:
+		// Anything used this recently is assumed to be used again soon, so is never worth the reload
+		static const unsigned long long kMinIdleFrames = 120;
+
+		struct Entry
+		{
+			ResidentTexture*   mTexture;
+			GLenum             mTarget;
+			TextureCategory    mCategory;
+			size_t             mSizeBytes;
+			unsigned long long mLastUsedFrame;
+			bool               mResident;
+			bool               mReloadFailed; // Kept evicted rather than retried every frame
+		};
+
+		static bool         GetIsCold(TextureCategory category);
+		static bool         GetIsBound(unsigned int textureID, GLenum target);
+
+		static void         Evict(unsigned int textureID, Entry& entry);
+		static void         Reload(unsigned int textureID, Entry& entry);
+
+		static void         AccountFor(const Entry& entry, bool adding);
+
+		// ---------------------------------------
+
+		static std::unordered_map<unsigned int, Entry> sEntries;
+
+		static std::vector<unsigned int>               sPendingReloads; // Bound while evicted, reloaded by the next BeginFrame
+
+		static size_t             sBudgetBytes;
+		static size_t             sResidentBytes[(unsigned int)TextureCategory::Count];
+		static size_t             sEvictedBytes[(unsigned int)TextureCategory::Count];
+
+		static unsigned long long sFrameNumber;
+
+		static unsigned int       sEvictionCount;
+		static unsigned int       sReloadCount;
+	};
+
+	// ---------------------------------------
+}
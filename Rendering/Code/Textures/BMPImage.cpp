@@ -0,0 +1,212 @@
+#include "BMPImage.h"
+
+#include "Rendering/Code/GLStateCache.h"
+#include "Rendering/Code/GLErrorChecking.h"
+
+#include <cstring>
+#include <cstdint>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		// ----------------------------------------------------------------------------------------------------------
+
+		// BITMAPFILEHEADER followed by at least a BITMAPINFOHEADER
+		static const size_t       kFileHeaderSize    = 14;
+		static const unsigned int kInfoHeaderSize    = 40;
+
+		static const unsigned int kUncompressed      = 0; // BI_RGB
+		static const unsigned int kSupportedBitCount = 24;
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		// The headers make no promise about alignment, and BMP is always little endian like every platform this builds for
+		template<typename T>
+		static T ReadHeaderValue(const unsigned char* data, size_t offset)
+		{
+			T value;
+			std::memcpy(&value, data + offset, sizeof(T));
+
+			return value;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		BMPImage::BMPImage()
+			: mFile()
+			, mPixels(nullptr)
+			, mWidth(0)
+			, mHeight(0)
+			, mRowStride(0)
+			, mTopDown(false)
+		{
+
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		BMPImage::~BMPImage()
+		{
+			Close();
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool BMPImage::Open(const std::string& filePath)
+		{
+			Close();
+
+			// Saves mapping a PNG or JPEG only to find the signature is wrong
+			size_t extensionStart = filePath.find_last_of('.');
+
+			if (extensionStart == std::string::npos)
+				return false;
+
+			std::string extension = filePath.substr(extensionStart + 1);
+
+			if (extension != "bmp" && extension != "BMP")
+				return false;
+
+			if (!mFile.Open(filePath))
+				return false;
+
+			const unsigned char* data     = mFile.GetData();
+			size_t               fileSize = mFile.GetSizeBytes();
+
+			if (fileSize < kFileHeaderSize + kInfoHeaderSize || data[0] != 'B' || data[1] != 'M')
+			{
+				Close();
+				return false;
+			}
+
+			uint32_t pixelOffset = ReadHeaderValue<uint32_t>(data, 10);
+			uint32_t headerSize  = ReadHeaderValue<uint32_t>(data, 14);
+			int32_t  width       = ReadHeaderValue<int32_t>(data,  18);
+			int32_t  height      = ReadHeaderValue<int32_t>(data,  22);
+			uint16_t planes      = ReadHeaderValue<uint16_t>(data, 26);
+			uint16_t bitCount    = ReadHeaderValue<uint16_t>(data, 28);
+			uint32_t compression = ReadHeaderValue<uint32_t>(data, 30);
+
+			// A negative height marks rows stored top first, INT_MIN has no positive counterpart
+			if (headerSize < kInfoHeaderSize || planes != 1 || bitCount != kSupportedBitCount || compression != kUncompressed || width <= 0 || height == 0 || height == INT32_MIN)
+			{
+				Close();
+				return false;
+			}
+
+			uint64_t rowStride = (((uint64_t)width * 3) + (kRowAlignment - 1)) & ~(uint64_t)(kRowAlignment - 1);
+			uint64_t rowCount  = (uint64_t)(height < 0 ? -(int64_t)height : (int64_t)height);
+
+			// Truncated files are rejected here rather than read past the end of the mapping
+			if (pixelOffset < kFileHeaderSize + headerSize || (uint64_t)pixelOffset + rowStride * rowCount > (uint64_t)fileSize)
+			{
+				Close();
+				return false;
+			}
+
+			mPixels    = data + pixelOffset;
+			mWidth     = (int)width;
+			mHeight    = (int)rowCount;
+			mRowStride = (unsigned int)rowStride;
+			mTopDown   = height < 0;
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void BMPImage::Close()
+		{
+			mFile.Close();
+
+			mPixels    = nullptr;
+			mWidth     = 0;
+			mHeight    = 0;
+			mRowStride = 0;
+			mTopDown   = false;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		const unsigned char* BMPImage::GetRow(int row) const
+		{
+			if (!mPixels || row < 0 || row >= mHeight)
+				return nullptr;
+
+			int storedRow = mTopDown ? row : (mHeight - 1 - row);
+
+			return mPixels + (size_t)storedRow * mRowStride;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void BMPImage::CopyRowsTopDown(unsigned char* destination) const
+		{
+			if (!mPixels || !destination)
+				return;
+
+			if (mTopDown)
+			{
+				std::memcpy(destination, mPixels, GetPixelDataSize());
+				return;
+			}
+
+			for (int row = 0; row < mHeight; row++)
+			{
+				std::memcpy(destination + (size_t)row * mRowStride, GetRow(row), mRowStride);
+			}
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void BMPImage::Upload(GLenum target) const
+		{
+			if (!mPixels)
+				return;
+
+			GLint previousAlignment = 0;
+			glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+
+			glPixelStorei(GL_UNPACK_ALIGNMENT, kRowAlignment);
+
+			if (mTopDown)
+			{
+				glTexSubImage2D(target, 0, 0, 0, mWidth, mHeight, GL_BGR, GL_UNSIGNED_BYTE, mPixels);
+			}
+			else
+			{
+				// The copy into this buffer stands in for the one the driver makes of client memory anyway, so the flip adds no extra pass
+				unsigned int pixelUnpackBuffer = 0;
+				glGenBuffers(1, &pixelUnpackBuffer);
+
+				GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelUnpackBuffer);
+
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)GetPixelDataSize(), nullptr, GL_STREAM_DRAW);
+
+				unsigned char* destination = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)GetPixelDataSize(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+				if (destination)
+				{
+					CopyRowsTopDown(destination);
+
+					if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE)
+					{
+						glTexSubImage2D(target, 0, 0, 0, mWidth, mHeight, GL_BGR, GL_UNSIGNED_BYTE, nullptr);
+					}
+				}
+
+				GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+				glDeleteBuffers(1, &pixelUnpackBuffer);
+				GLStateCache::OnBufferDeleted(pixelUnpackBuffer);
+			}
+
+			glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+
+			GL_CHECK_ERROR("Error uploading BMP image");
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Maths/Code/MemoryMappedFile.h"
+
+#include <glad/glad.h>
+
+#include <string>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		// ---------------------------------------------------
+
+		// An uncompressed 24 bit BMP read in place from a memory mapped file, so the pixels reach GL without being decoded into a heap copy first
+		// The rows are left as the file stores them - blue first and padded out to four bytes - and the upload describes that through the unpack state
+		class BMPImage final
+		{
+		public:
+			// Every BMP row is padded to a multiple of this many bytes
+			static const int kRowAlignment = 4;
+
+			BMPImage();
+			~BMPImage();
+
+			// False for anything other than a well formed, uncompressed, 24 bit BMP - the caller falls back to stb_image for those
+			bool                 Open(const std::string& filePath);
+			void                 Close();
+
+			bool                 GetIsOpen()        const { return mPixels != nullptr; }
+
+			int                  GetWidth()         const { return mWidth;  }
+			int                  GetHeight()        const { return mHeight; }
+			unsigned int         GetRowStride()     const { return mRowStride; }
+
+			// Padding included, so a buffer this size holds the image exactly as the file lays it out
+			size_t               GetPixelDataSize() const { return (size_t)mRowStride * (size_t)mHeight; }
+
+			// Counted from the top of the image, whichever way up the file stores its rows
+			const unsigned char* GetRow(int row)    const;
+
+			// Writes the rows top first into a buffer of GetPixelDataSize bytes, keeping the padding
+			void                 CopyRowsTopDown(unsigned char* destination) const;
+
+			// Fills level 0 of target, which has to be bound and already allocated at this size
+			// Top down files are handed to GL straight from the mapping, bottom up ones are flipped on their way into a pixel unpack buffer
+			// as there is no unpack state that reverses the row order
+			void                 Upload(GLenum target) const;
+
+		private:
+			BMPImage(const BMPImage&)            = delete;
+			BMPImage& operator=(const BMPImage&) = delete;
+
+			Engine::MemoryMappedFile mFile;
+
+			const unsigned char*     mPixels;
+
+			int                      mWidth;
+			int                      mHeight;
+			unsigned int             mRowStride;
+
+			bool                     mTopDown;
+		};
+
+		// ---------------------------------------------------
+	}
+}
@@ -0,0 +1,270 @@
+#include "CubeMapCache.h"
+
+#include "Rendering/Code/Shaders/ShaderPreprocessor.h"
+
+#include "Maths/Code/FNVHash.h"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		// ----------------------------------------------------------------------------------------------------------
+
+		static const char         kCubeMapCacheDirectory[] = "TextureCache/";
+		static const char         kCubeMapCacheMagic[4]    = { 'W', 'C', 'M', 'C' };
+
+		// Bump this whenever the file layout changes
+		static const unsigned int kCubeMapCacheFileVersion = 1;
+
+		// Half float RGB
+		static const size_t       kBytesPerTexel           = 6;
+
+		// A 4096 face has 13 levels - anything claiming more is not a file this wrote
+		static const unsigned int kMaxMipCount             = 16;
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		struct CubeMapCacheHeader
+		{
+			char         mMagic[4];
+			unsigned int mFileVersion;
+			unsigned int mKey;
+			unsigned int mFaceSize;
+			unsigned int mMipCount;
+		};
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		unsigned int CubeMapCache::sHitCount  = 0;
+		unsigned int CubeMapCache::sMissCount = 0;
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		CubeMapCache::CubeMapCache()
+			: mFile()
+			, mFaceSize(0)
+			, mMipCount(0)
+		{
+
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		CubeMapCache::~CubeMapCache()
+		{
+			Close();
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		unsigned int CubeMapCache::GenerateKey(const std::string faceFilePaths[6], const std::vector<std::string>& shaderFilePaths, const std::string& outputDescription)
+		{
+			unsigned int hash = Engine::FNV::kFNVOffsetBasis;
+
+			// The contents rather than the paths, so that replacing the images in a skybox folder is noticed
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				Engine::MemoryMappedFile face;
+
+				if (!face.Open(faceFilePaths[i]))
+					return 0;
+
+				hash = Engine::FNV::Continue(hash, face.GetData(), face.GetSizeBytes());
+			}
+
+			// Expanded, so that an edit to a shared include is caught as well
+			for (unsigned int i = 0; i < shaderFilePaths.size(); i++)
+			{
+				std::string              source;
+				std::vector<std::string> includedFiles;
+
+				Shaders::ShaderPreprocessor::LoadSource(shaderFilePaths[i], source, includedFiles);
+
+				hash = Engine::FNV::Continue(hash, source.c_str(), source.size() + 1);
+			}
+
+			hash = Engine::FNV::Continue(hash, outputDescription.c_str(), outputDescription.size() + 1);
+
+			// Zero is used for 'no key'
+			return hash == 0 ? 1 : hash;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		std::string CubeMapCache::GetCacheFilePath(unsigned int key)
+		{
+			std::stringstream path;
+
+			path << kCubeMapCacheDirectory << std::hex << std::setw(8) << std::setfill('0') << key << ".cube";
+
+			return path.str();
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		size_t CubeMapCache::GetFaceSizeBytes(unsigned int faceSize, unsigned int mipLevel)
+		{
+			size_t levelSize = (size_t)faceSize >> mipLevel;
+
+			if (levelSize == 0)
+				levelSize = 1;
+
+			return levelSize * levelSize * kBytesPerTexel;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool CubeMapCache::Open(unsigned int key)
+		{
+			Close();
+
+			if (key == 0)
+				return false;
+
+			if (!mFile.Open(GetCacheFilePath(key)))
+			{
+				sMissCount++;
+				return false;
+			}
+
+			const unsigned char* data      = mFile.GetData();
+			size_t               sizeBytes = mFile.GetSizeBytes();
+
+			CubeMapCacheHeader header;
+
+			if (sizeBytes < sizeof(CubeMapCacheHeader))
+			{
+				Close();
+				sMissCount++;
+				return false;
+			}
+
+			std::memcpy(&header, data, sizeof(CubeMapCacheHeader));
+
+			bool valid = std::memcmp(header.mMagic, kCubeMapCacheMagic, sizeof(kCubeMapCacheMagic)) == 0 &&
+				         header.mFileVersion == kCubeMapCacheFileVersion &&
+				         header.mKey         == key &&
+				         header.mFaceSize    != 0 &&
+				         header.mMipCount    != 0 &&
+				         header.mMipCount    <= kMaxMipCount;
+
+			if (valid)
+			{
+				size_t expectedSize = sizeof(CubeMapCacheHeader);
+
+				for (unsigned int mipLevel = 0; mipLevel < header.mMipCount; mipLevel++)
+				{
+					expectedSize += GetFaceSizeBytes(header.mFaceSize, mipLevel) * 6;
+				}
+
+				valid = sizeBytes == expectedSize;
+			}
+
+			if (!valid)
+			{
+				Close();
+				sMissCount++;
+				return false;
+			}
+
+			mFaceSize = header.mFaceSize;
+			mMipCount = header.mMipCount;
+
+			sHitCount++;
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapCache::Close()
+		{
+			mFile.Close();
+
+			mFaceSize = 0;
+			mMipCount = 0;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		const unsigned char* CubeMapCache::GetFaceData(unsigned int mipLevel, unsigned int face) const
+		{
+			if (!mFile.GetIsOpen() || mipLevel >= mMipCount || face >= 6)
+				return nullptr;
+
+			size_t offset = sizeof(CubeMapCacheHeader);
+
+			for (unsigned int level = 0; level < mipLevel; level++)
+			{
+				offset += GetFaceSizeBytes(mFaceSize, level) * 6;
+			}
+
+			offset += GetFaceSizeBytes(mFaceSize, mipLevel) * face;
+
+			return mFile.GetData() + offset;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool CubeMapCache::Save(unsigned int key, unsigned int faceSize, const std::vector<std::vector<unsigned char>>& levelData)
+		{
+			if (key == 0 || faceSize == 0 || levelData.empty() || levelData.size() > kMaxMipCount)
+				return false;
+
+			for (unsigned int mipLevel = 0; mipLevel < levelData.size(); mipLevel++)
+			{
+				if (levelData[mipLevel].size() != GetFaceSizeBytes(faceSize, mipLevel) * 6)
+					return false;
+			}
+
+			std::error_code error;
+			std::filesystem::create_directories(kCubeMapCacheDirectory, error);
+
+			std::string filePath = GetCacheFilePath(key);
+
+			// Written to a temporary file first so that a partially written entry is never picked up
+			std::string   temporaryPath = filePath + ".tmp";
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+			if (!file.is_open())
+				return false;
+
+			CubeMapCacheHeader header;
+			std::memcpy(header.mMagic, kCubeMapCacheMagic, sizeof(kCubeMapCacheMagic));
+			header.mFileVersion = kCubeMapCacheFileVersion;
+			header.mKey         = key;
+			header.mFaceSize    = faceSize;
+			header.mMipCount    = (unsigned int)levelData.size();
+
+			file.write((const char*)&header, sizeof(CubeMapCacheHeader));
+
+			for (unsigned int mipLevel = 0; mipLevel < levelData.size(); mipLevel++)
+			{
+				file.write((const char*)levelData[mipLevel].data(), (std::streamsize)levelData[mipLevel].size());
+			}
+
+			bool succeeded = file.good();
+
+			file.close();
+
+			if (succeeded)
+			{
+				std::filesystem::rename(temporaryPath, filePath, error);
+
+				return !error;
+			}
+
+			std::filesystem::remove(temporaryPath, error);
+
+			return false;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Maths/Code/MemoryMappedFile.h"
+
+#include <vector>
+#include <string>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		// ---------------------------------------------------
+
+		// On-disk store of convoluted cube maps, so they are only rebuilt when the skybox they came from actually changes
+		// One file per entry - a header, then every mip level in turn, each holding all six faces as half float RGB
+		// Half floats are the same on every driver, so unlike program binaries an entry is not tied to the machine that wrote it
+		class CubeMapCache final
+		{
+		public:
+			CubeMapCache();
+			~CubeMapCache();
+
+			// Folds the bytes of the six faces, the expanded source of every shader used in the convolution, and a description of the
+			// output into one key, so that editing any of them misses the cache
+			// Zero if a face can not be read, in which case nothing is loaded or saved
+			static unsigned int  GenerateKey(const std::string faceFilePaths[6], const std::vector<std::string>& shaderFilePaths, const std::string& outputDescription);
+
+			// Maps the entry for this key - false if there is none, or it does not match the key or layout
+			bool                 Open(unsigned int key);
+			void                 Close();
+
+			unsigned int         GetFaceSize() const { return mFaceSize; }
+			unsigned int         GetMipCount() const { return mMipCount; }
+
+			// Tightly packed half float RGB, straight out of the mapping
+			const unsigned char* GetFaceData(unsigned int mipLevel, unsigned int face) const;
+
+			// levelData holds one entry per mip level, each with the six faces back to back - false if nothing was written
+			static bool          Save(unsigned int key, unsigned int faceSize, const std::vector<std::vector<unsigned char>>& levelData);
+
+			// Bytes for one face of one level, which is also how the entries are laid out
+			static size_t        GetFaceSizeBytes(unsigned int faceSize, unsigned int mipLevel);
+
+			static unsigned int  GetHitCount()  { return sHitCount; }
+			static unsigned int  GetMissCount() { return sMissCount; }
+
+		private:
+			CubeMapCache(const CubeMapCache&)            = delete;
+			CubeMapCache& operator=(const CubeMapCache&) = delete;
+
+			static std::string   GetCacheFilePath(unsigned int key);
+
+			Engine::MemoryMappedFile mFile;
+
+			unsigned int             mFaceSize;
+			unsigned int             mMipCount;
+
+			static unsigned int      sHitCount;
+			static unsigned int      sMissCount;
+		};
+
+		// ---------------------------------------------------
+	}
+}
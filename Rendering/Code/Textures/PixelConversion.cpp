@@ -0,0 +1,559 @@
+#include "PixelConversion.h"
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+
+	#define PIXEL_CONVERSION_TARGET(features)
+#else
+	#include <cpuid.h>
+
+	// Lets the one function use the instructions without building the whole file for a CPU that has them
+	#define PIXEL_CONVERSION_TARGET(features) __attribute__((target(features)))
+#endif
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <immintrin.h>
+
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		namespace PixelConversion
+		{
+			// ---------------------------------------------
+
+			struct CPUFeatures
+			{
+				bool mSSSE3;
+				bool mF16C;
+			};
+
+			// ---------------------------------------------
+
+			static unsigned long long ReadExtendedControlRegister()
+			{
+#if defined(_MSC_VER)
+				return _xgetbv(0);
+#else
+				unsigned int low  = 0;
+				unsigned int high = 0;
+
+				__asm__ volatile ("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+
+				return ((unsigned long long)high << 32) | low;
+#endif
+			}
+
+			// ---------------------------------------------
+
+			static CPUFeatures DetectCPUFeatures()
+			{
+				CPUFeatures features = { false, false };
+
+				unsigned int featureFlags = 0;
+
+#if defined(_MSC_VER)
+				int registers[4] = { 0 };
+				__cpuid(registers, 1);
+
+				featureFlags = (unsigned int)registers[2];
+#else
+				unsigned int eax = 0, ebx = 0, edx = 0;
+
+				if (!__get_cpuid(1, &eax, &ebx, &featureFlags, &edx))
+					return features;
+#endif
+
+				features.mSSSE3 = (featureFlags & (1u << 9)) != 0;
+
+				// F16C is VEX encoded, so it also needs the OS to be saving the AVX registers across context switches
+				const bool hasXSAVE = (featureFlags & (1u << 27)) != 0;
+				const bool hasAVX   = (featureFlags & (1u << 28)) != 0;
+
+				if (hasXSAVE && hasAVX && (ReadExtendedControlRegister() & 6) == 6)
+				{
+					features.mF16C = (featureFlags & (1u << 29)) != 0;
+				}
+
+				return features;
+			}
+
+			// ---------------------------------------------
+
+			static const CPUFeatures& GetCPUFeatures()
+			{
+				static const CPUFeatures features = DetectCPUFeatures();
+
+				return features;
+			}
+
+			// ---------------------------------------------
+
+			bool GetHasSSSE3()
+			{
+				return GetCPUFeatures().mSSSE3;
+			}
+
+			// ---------------------------------------------
+
+			bool GetHasF16C()
+			{
+				return GetCPUFeatures().mF16C;
+			}
+
+			// ---------------------------------------------
+
+			// Rounds to nearest even, the same as the F16C instruction, so both paths give identical bits
+			static uint16_t FloatToHalf(float value)
+			{
+				uint32_t bits = 0;
+				std::memcpy(&bits, &value, sizeof(bits));
+
+				const uint32_t sign     = (bits >> 16) & 0x8000u;
+				uint32_t       absolute = bits & 0x7FFFFFFFu;
+				uint32_t       half     = 0;
+
+				if (absolute >= 0x47800000u)
+				{
+					// Too large for a half, infinity, or NaN
+					half = absolute > 0x7F800000u ? 0x7E00u : 0x7C00u;
+				}
+				else if (absolute < 0x38800000u)
+				{
+					// Below the smallest normal half - adding one half lines the denormal bits up at the bottom, with the FPU doing the rounding
+					float magnitude = 0.0f;
+					std::memcpy(&magnitude, &absolute, sizeof(magnitude));
+
+					magnitude += 0.5f;
+
+					std::memcpy(&absolute, &magnitude, sizeof(absolute));
+
+					half = absolute - 0x3F000000u;
+				}
+				else
+				{
+					const uint32_t mantissaOdd = (absolute >> 13) & 1u;
+
+					// Rebiases the exponent from 127 to 15 and rounds the dropped mantissa bits, carrying into the exponent if need be
+					absolute += 0xC8000FFFu + mantissaOdd;
+
+					half = absolute >> 13;
+				}
+
+				return (uint16_t)(sign | half);
+			}
+
+			// ---------------------------------------------
+
+			struct HalfTables
+			{
+				uint16_t mUnorm[256];
+				uint16_t mSRGB[256];
+			};
+
+			// ---------------------------------------------
+
+			static HalfTables BuildHalfTables()
+			{
+				HalfTables tables;
+
+				for (unsigned int i = 0; i < 256; i++)
+				{
+					const float encoded = (float)i * (1.0f / 255.0f);
+					const float linear  = encoded <= 0.04045f ? encoded / 12.92f : std::pow((encoded + 0.055f) / 1.055f, 2.4f);
+
+					tables.mUnorm[i] = FloatToHalf(encoded);
+					tables.mSRGB[i]  = FloatToHalf(linear);
+				}
+
+				return tables;
+			}
+
+			// ---------------------------------------------
+
+			// There are only 256 inputs, so a table beats converting each one - there is no gather to vectorise it with before AVX2
+			static const HalfTables& GetHalfTables()
+			{
+				static const HalfTables tables = BuildHalfTables();
+
+				return tables;
+			}
+
+			// ---------------------------------------------
+
+			static void SwapRedBlue_Plain(const unsigned char* source, unsigned char* destination, size_t pixelCount)
+			{
+				for (size_t i = 0; i < pixelCount; i++, source += 3, destination += 3)
+				{
+					const unsigned char first = source[0];
+					const unsigned char third = source[2];
+
+					destination[0] = third;
+					destination[1] = source[1];
+					destination[2] = first;
+				}
+			}
+
+			// ---------------------------------------------
+
+			PIXEL_CONVERSION_TARGET("ssse3")
+			static void SwapRedBlue_SSSE3(const unsigned char* source, unsigned char* destination, size_t pixelCount)
+			{
+				const __m128i swapMask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+
+				size_t i = 0;
+
+				// Five pixels a step, with the sixteenth byte read and written back as it was - so a step always needs one pixel after it
+				for (; i + 6 <= pixelCount; i += 5)
+				{
+					const __m128i pixels = _mm_loadu_si128((const __m128i*)(source + (i * 3)));
+
+					_mm_storeu_si128((__m128i*)(destination + (i * 3)), _mm_shuffle_epi8(pixels, swapMask));
+				}
+
+				SwapRedBlue_Plain(source + (i * 3), destination + (i * 3), pixelCount - i);
+			}
+
+			// ---------------------------------------------
+
+			void SwapRedBlue(const unsigned char* source, unsigned char* destination, size_t pixelCount)
+			{
+				if (GetHasSSSE3())
+					SwapRedBlue_SSSE3(source, destination, pixelCount);
+				else
+					SwapRedBlue_Plain(source, destination, pixelCount);
+			}
+
+			// ---------------------------------------------
+
+			static void ExpandToFourChannels_Plain(const unsigned char* source, unsigned char* destination, size_t pixelCount, unsigned char alpha)
+			{
+				for (size_t i = 0; i < pixelCount; i++, source += 3, destination += 4)
+				{
+					destination[0] = source[0];
+					destination[1] = source[1];
+					destination[2] = source[2];
+					destination[3] = alpha;
+				}
+			}
+
+			// ---------------------------------------------
+
+			PIXEL_CONVERSION_TARGET("ssse3")
+			static void ExpandToFourChannels_SSSE3(const unsigned char* source, unsigned char* destination, size_t pixelCount, unsigned char alpha)
+			{
+				// 0x80 in a shuffle mask writes a zero, which the alpha is then ORed into
+				const __m128i expandMask = _mm_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11, -128);
+				const __m128i alphaBits  = _mm_set1_epi32((int)((unsigned int)alpha << 24));
+
+				size_t i = 0;
+
+				// Sixteen pixels from three loads, realigned so that each shuffle starts on a pixel
+				for (; i + 16 <= pixelCount; i += 16)
+				{
+					const __m128i first  = _mm_loadu_si128((const __m128i*)(source + (i * 3)));
+					const __m128i second = _mm_loadu_si128((const __m128i*)(source + (i * 3) + 16));
+					const __m128i third  = _mm_loadu_si128((const __m128i*)(source + (i * 3) + 32));
+
+					__m128i* output = (__m128i*)(destination + (i * 4));
+
+					_mm_storeu_si128(output + 0, _mm_or_si128(_mm_shuffle_epi8(first,                             expandMask), alphaBits));
+					_mm_storeu_si128(output + 1, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(second, first, 12), expandMask), alphaBits));
+					_mm_storeu_si128(output + 2, _mm_or_si128(_mm_shuffle_epi8(_mm_alignr_epi8(third, second, 8), expandMask), alphaBits));
+					_mm_storeu_si128(output + 3, _mm_or_si128(_mm_shuffle_epi8(_mm_srli_si128(third, 4),          expandMask), alphaBits));
+				}
+
+				// Four at a time from single loads, which read a pixel and a third past the ones they use
+				for (; i + 6 <= pixelCount; i += 4)
+				{
+					const __m128i pixels = _mm_loadu_si128((const __m128i*)(source + (i * 3)));
+
+					_mm_storeu_si128((__m128i*)(destination + (i * 4)), _mm_or_si128(_mm_shuffle_epi8(pixels, expandMask), alphaBits));
+				}
+
+				ExpandToFourChannels_Plain(source + (i * 3), destination + (i * 4), pixelCount - i, alpha);
+			}
+
+			// ---------------------------------------------
+
+			void ExpandToFourChannels(const unsigned char* source, unsigned char* destination, size_t pixelCount, unsigned char alpha)
+			{
+				if (GetHasSSSE3())
+					ExpandToFourChannels_SSSE3(source, destination, pixelCount, alpha);
+				else
+					ExpandToFourChannels_Plain(source, destination, pixelCount, alpha);
+			}
+
+			// ---------------------------------------------
+
+			static void ConvertUnormToHalf_Plain(const unsigned char* source, uint16_t* destination, size_t componentCount)
+			{
+				const HalfTables& tables = GetHalfTables();
+
+				for (size_t i = 0; i < componentCount; i++)
+				{
+					destination[i] = tables.mUnorm[source[i]];
+				}
+			}
+
+			// ---------------------------------------------
+
+			PIXEL_CONVERSION_TARGET("f16c")
+			static void ConvertUnormToHalf_F16C(const unsigned char* source, uint16_t* destination, size_t componentCount)
+			{
+				const __m128  byteToUnit = _mm_set1_ps(1.0f / 255.0f);
+				const __m128i zero       = _mm_setzero_si128();
+
+				size_t i = 0;
+
+				for (; i + 8 <= componentCount; i += 8)
+				{
+					const __m128i bytes = _mm_loadl_epi64((const __m128i*)(source + i));
+					const __m128i words = _mm_unpacklo_epi8(bytes, zero);
+
+					const __m128 low  = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), byteToUnit);
+					const __m128 high = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)), byteToUnit);
+
+					_mm_storeu_si128((__m128i*)(destination + i), _mm_unpacklo_epi64(_mm_cvtps_ph(low, 0), _mm_cvtps_ph(high, 0)));
+				}
+
+				ConvertUnormToHalf_Plain(source + i, destination + i, componentCount - i);
+			}
+
+			// ---------------------------------------------
+
+			void ConvertUnormToHalf(const unsigned char* source, uint16_t* destination, size_t componentCount)
+			{
+				if (GetHasF16C())
+					ConvertUnormToHalf_F16C(source, destination, componentCount);
+				else
+					ConvertUnormToHalf_Plain(source, destination, componentCount);
+			}
+
+			// ---------------------------------------------
+
+			static void ConvertFloatToHalf_Plain(const float* source, uint16_t* destination, size_t count)
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					destination[i] = FloatToHalf(source[i]);
+				}
+			}
+
+			// ---------------------------------------------
+
+			PIXEL_CONVERSION_TARGET("f16c")
+			static void ConvertFloatToHalf_F16C(const float* source, uint16_t* destination, size_t count)
+			{
+				size_t i = 0;
+
+				for (; i + 8 <= count; i += 8)
+				{
+					const __m128i low  = _mm_cvtps_ph(_mm_loadu_ps(source + i),     0);
+					const __m128i high = _mm_cvtps_ph(_mm_loadu_ps(source + i + 4), 0);
+
+					_mm_storeu_si128((__m128i*)(destination + i), _mm_unpacklo_epi64(low, high));
+				}
+
+				ConvertFloatToHalf_Plain(source + i, destination + i, count - i);
+			}
+
+			// ---------------------------------------------
+
+			void ConvertFloatToHalf(const float* source, uint16_t* destination, size_t count)
+			{
+				if (GetHasF16C())
+					ConvertFloatToHalf_F16C(source, destination, count);
+				else
+					ConvertFloatToHalf_Plain(source, destination, count);
+			}
+
+			// ---------------------------------------------
+
+			void DecodeSRGBToHalf(const unsigned char* source, uint16_t* destination, size_t pixelCount, unsigned int channelCount)
+			{
+				const HalfTables& tables = GetHalfTables();
+
+				if (channelCount == 4)
+				{
+					for (size_t i = 0; i < pixelCount; i++, source += 4, destination += 4)
+					{
+						destination[0] = tables.mSRGB[source[0]];
+						destination[1] = tables.mSRGB[source[1]];
+						destination[2] = tables.mSRGB[source[2]];
+						destination[3] = tables.mUnorm[source[3]];
+					}
+
+					return;
+				}
+
+				const size_t componentCount = pixelCount * channelCount;
+
+				for (size_t i = 0; i < componentCount; i++)
+				{
+					destination[i] = tables.mSRGB[source[i]];
+				}
+			}
+
+			// ---------------------------------------------
+
+			// The decode done per component, as it would be without the table
+			static void DecodeSRGBToHalf_Direct(const unsigned char* source, uint16_t* destination, size_t pixelCount, unsigned int channelCount)
+			{
+				const size_t componentCount = pixelCount * channelCount;
+
+				for (size_t i = 0; i < componentCount; i++)
+				{
+					const float encoded = (float)source[i] * (1.0f / 255.0f);
+
+					if (channelCount == 4 && (i & 3) == 3)
+					{
+						destination[i] = FloatToHalf(encoded);
+					}
+					else
+					{
+						destination[i] = FloatToHalf(encoded <= 0.04045f ? encoded / 12.92f : std::pow((encoded + 0.055f) / 1.055f, 2.4f));
+					}
+				}
+			}
+
+			// ---------------------------------------------
+
+			// Best of a few runs, in megabytes of source read a second
+			static double MeasureThroughput(size_t sourceBytes, const std::function<void()>& conversion)
+			{
+				const unsigned int kRunCount = 5;
+
+				double fastestSeconds = 0.0;
+
+				for (unsigned int run = 0; run < kRunCount; run++)
+				{
+					std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+					conversion();
+
+					const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+					if (run == 0 || seconds < fastestSeconds)
+					{
+						fastestSeconds = seconds;
+					}
+				}
+
+				return ((double)sourceBytes / (1024.0 * 1024.0)) / std::max(fastestSeconds, 1e-9);
+			}
+
+			// ---------------------------------------------
+
+			static void ReportRow(std::stringstream& report, const char* name, double plainRate, double fastRate, bool supported, bool matches)
+			{
+				report << std::left << std::setw(26) << name << std::right << std::setw(12) << plainRate;
+
+				if (!supported)
+				{
+					report << std::setw(14) << "-" << "   not supported by this CPU\n";
+					return;
+				}
+
+				report << std::setw(14) << fastRate << std::setw(9) << (fastRate / std::max(plainRate, 1e-9)) << "x" << (matches ? "" : "   MISMATCH") << "\n";
+			}
+
+			// ---------------------------------------------
+
+			std::string RunBenchmark(unsigned int megapixelCount)
+			{
+				std::stringstream report;
+
+				const size_t pixelCount = (size_t)std::max(megapixelCount, 1u) * 1024 * 1024;
+
+				std::vector<unsigned char> threeChannel(pixelCount * 3);
+				std::vector<unsigned char> fourChannel(pixelCount * 4);
+				std::vector<float>         floats(pixelCount * 3);
+
+				std::vector<unsigned char> plainBytes(pixelCount * 4);
+				std::vector<unsigned char> fastBytes(pixelCount * 4);
+				std::vector<uint16_t>      plainHalves(pixelCount * 4);
+				std::vector<uint16_t>      fastHalves(pixelCount * 4);
+
+				// Anything but a flat colour, and the same every run
+				unsigned int seed = 12345;
+
+				for (size_t i = 0; i < threeChannel.size(); i++)
+				{
+					seed = (seed * 1664525u) + 1013904223u;
+
+					threeChannel[i] = (unsigned char)(seed >> 24);
+					floats[i]       = ((float)(seed >> 8) / (float)(1u << 24)) * 64.0f;
+				}
+
+				ExpandToFourChannels_Plain(threeChannel.data(), fourChannel.data(), pixelCount, 255);
+
+				const bool hasSSSE3 = GetHasSSSE3();
+				const bool hasF16C  = GetHasF16C();
+
+				report << std::fixed << std::setprecision(1);
+				report << "Pixel conversion over " << pixelCount << " pixels - SSSE3 " << (hasSSSE3 ? "yes" : "no") << ", F16C " << (hasF16C ? "yes" : "no") << "\n";
+				report << std::left << std::setw(26) << "Conversion" << std::right << std::setw(12) << "Plain MB/s" << std::setw(14) << "Vector MB/s" << std::setw(10) << "Speedup" << "\n";
+
+				// ----------
+
+				double plainRate = MeasureThroughput(pixelCount * 3, [&]() { SwapRedBlue_Plain(threeChannel.data(), plainBytes.data(), pixelCount); });
+				double fastRate  = 0.0;
+
+				if (hasSSSE3)
+					fastRate = MeasureThroughput(pixelCount * 3, [&]() { SwapRedBlue_SSSE3(threeChannel.data(), fastBytes.data(), pixelCount); });
+
+				ReportRow(report, "BGR <-> RGB", plainRate, fastRate, hasSSSE3, std::memcmp(plainBytes.data(), fastBytes.data(), pixelCount * 3) == 0);
+
+				// ----------
+
+				plainRate = MeasureThroughput(pixelCount * 3, [&]() { ExpandToFourChannels_Plain(threeChannel.data(), plainBytes.data(), pixelCount, 255); });
+
+				if (hasSSSE3)
+					fastRate = MeasureThroughput(pixelCount * 3, [&]() { ExpandToFourChannels_SSSE3(threeChannel.data(), fastBytes.data(), pixelCount, 255); });
+
+				ReportRow(report, "RGB -> RGBA", plainRate, fastRate, hasSSSE3, std::memcmp(plainBytes.data(), fastBytes.data(), pixelCount * 4) == 0);
+
+				// ----------
+
+				plainRate = MeasureThroughput(pixelCount * 4, [&]() { ConvertUnormToHalf_Plain(fourChannel.data(), plainHalves.data(), pixelCount * 4); });
+
+				if (hasF16C)
+					fastRate = MeasureThroughput(pixelCount * 4, [&]() { ConvertUnormToHalf_F16C(fourChannel.data(), fastHalves.data(), pixelCount * 4); });
+
+				ReportRow(report, "RGBA8 -> RGBA16F", plainRate, fastRate, hasF16C, std::memcmp(plainHalves.data(), fastHalves.data(), pixelCount * 4 * sizeof(uint16_t)) == 0);
+
+				// ----------
+
+				plainRate = MeasureThroughput(pixelCount * 3 * sizeof(float), [&]() { ConvertFloatToHalf_Plain(floats.data(), plainHalves.data(), pixelCount * 3); });
+
+				if (hasF16C)
+					fastRate = MeasureThroughput(pixelCount * 3 * sizeof(float), [&]() { ConvertFloatToHalf_F16C(floats.data(), fastHalves.data(), pixelCount * 3); });
+
+				ReportRow(report, "RGB32F -> RGB16F", plainRate, fastRate, hasF16C, std::memcmp(plainHalves.data(), fastHalves.data(), pixelCount * 3 * sizeof(uint16_t)) == 0);
+
+				// ----------
+
+				// Here the plain column is the decode done per component, and the vector column the table the loaders use
+				plainRate = MeasureThroughput(pixelCount * 4, [&]() { DecodeSRGBToHalf_Direct(fourChannel.data(), plainHalves.data(), pixelCount, 4); });
+				fastRate  = MeasureThroughput(pixelCount * 4, [&]() { DecodeSRGBToHalf(fourChannel.data(), fastHalves.data(), pixelCount, 4); });
+
+				ReportRow(report, "sRGBA8 -> linear RGBA16F", plainRate, fastRate, true, std::memcmp(plainHalves.data(), fastHalves.data(), pixelCount * 4 * sizeof(uint16_t)) == 0);
+
+				return report.str();
+			}
+
+			// ---------------------------------------------
+		}
+	}
+}
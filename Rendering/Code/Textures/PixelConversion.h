@@ -0,0 +1,45 @@
+#pragma once
+
+// Puts decoded images into the layout the GPU stores them in before they are uploaded, so the driver copies rather than converts
+// Three byte pixels are the main case - every desktop driver pads RGB8 out to four bytes, one pixel at a time on the CPU, when it is
+// handed three channel data. Each conversion picks an SSSE3 or F16C version at run time and falls back to plain C++ without them
+// Nothing here touches GL, so the decode workers can call any of it
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		namespace PixelConversion
+		{
+			// ---------------------------------------
+
+			// Swaps the first and third byte of every three byte pixel, so BGR to RGB or back - destination may be source
+			void        SwapRedBlue(const unsigned char* source, unsigned char* destination, size_t pixelCount);
+
+			// Three byte pixels to four, the fourth set to alpha - the channel order is kept, so RGB becomes RGBA and BGR becomes BGRA
+			void        ExpandToFourChannels(const unsigned char* source, unsigned char* destination, size_t pixelCount, unsigned char alpha = 255);
+
+			// Every byte as a half float in [0, 1]
+			void        ConvertUnormToHalf(const unsigned char* source, uint16_t* destination, size_t componentCount);
+
+			void        ConvertFloatToHalf(const float* source, uint16_t* destination, size_t count);
+
+			// sRGB encoded bytes to linear half floats - with four channels the fourth is alpha, which is already linear
+			void        DecodeSRGBToHalf(const unsigned char* source, uint16_t* destination, size_t pixelCount, unsigned int channelCount);
+
+			// ---------------------------------------
+
+			bool        GetHasSSSE3();
+			bool        GetHasF16C();
+
+			// Times each conversion over megapixelCount million pixels, vectorised against plain C++, as a printable table
+			std::string RunBenchmark(unsigned int megapixelCount);
+
+			// ---------------------------------------
+		}
+	}
+}
@@ -0,0 +1,628 @@
+#include "SpecularPrefilter.h"
+
+#include "CubeMapCache.h"
+#include "BMPImage.h"
+
+#include "Rendering/Code/Skybox.h"
+#include "Rendering/Code/STB_Image/stb_image.h"
+
+#include "Maths/Code/Parallel.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <emmintrin.h>
+
+#include <filesystem>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		namespace SpecularPrefilter
+		{
+			// ---------------------------------------------
+
+			// Bump this whenever the output of the baker changes, so that old bakes stop being picked up
+			static const unsigned int kBakerVersion = 1;
+
+			static const float        kPi           = 3.14159265359f;
+
+			// ---------------------------------------------
+
+			// The same face layout as the GL cube map - the texel at (u, v) in [-1, 1] points along mMajor + u * mUAxis + v * mVAxis, with v
+			// increasing down the image as the rows are uploaded top first
+			struct CubeMapFaceAxes
+			{
+				glm::vec3 mMajor;
+				glm::vec3 mUAxis;
+				glm::vec3 mVAxis;
+			};
+
+			static const CubeMapFaceAxes kFaceAxes[6] =
+			{
+				{ {  1.0f,  0.0f,  0.0f }, {  0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f,  0.0f } },
+				{ { -1.0f,  0.0f,  0.0f }, {  0.0f, 0.0f,  1.0f }, { 0.0f, -1.0f,  0.0f } },
+				{ {  0.0f,  1.0f,  0.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f,  1.0f } },
+				{ {  0.0f, -1.0f,  0.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f, -1.0f } },
+				{ {  0.0f,  0.0f,  1.0f }, {  1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } },
+				{ {  0.0f,  0.0f, -1.0f }, { -1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f } }
+			};
+
+			// ---------------------------------------------
+
+			// The source sky as linear RGB floats, with a box filtered mip chain standing in for the one glGenerateMipmap would make
+			struct SourceCubeMap
+			{
+				SourceCubeMap() : mLevels(), mSize(0), mLevelCount(0) { }
+
+				const float* GetFace(unsigned int level, unsigned int face) const { return mLevels[(level * 6) + face].data(); }
+				int          GetLevelSize(unsigned int level)               const { return std::max(mSize >> level, 1); }
+
+				std::vector<std::vector<float>> mLevels;
+				int                             mSize;
+				unsigned int                    mLevelCount;
+			};
+
+			// One GGX sample, already turned into the reflected light direction in the space around the normal
+			// The pdf only depends on the angle to the normal, so which source level to read from is worked out once here
+			struct PrefilterSample
+			{
+				float mTangentX;
+				float mTangentY;
+				float mTangentZ;
+				float mWeight; // N.L
+				float mSourceLevel;
+			};
+
+			// ---------------------------------------------
+
+			static bool LoadFace(const std::string& filePath, std::vector<float>& output, int& size)
+			{
+				BMPImage mappedImage;
+
+				if (mappedImage.Open(filePath))
+				{
+					if (mappedImage.GetWidth() != mappedImage.GetHeight())
+						return false;
+
+					size = mappedImage.GetWidth();
+					output.resize((size_t)size * (size_t)size * 3);
+
+					for (int row = 0; row < size; row++)
+					{
+						const unsigned char* texel       = mappedImage.GetRow(row);
+						float*               destination = &output[(size_t)row * (size_t)size * 3];
+
+						for (int column = 0; column < size; column++, texel += 3, destination += 3)
+						{
+							destination[0] = (float)texel[2] / 255.0f;
+							destination[1] = (float)texel[1] / 255.0f;
+							destination[2] = (float)texel[0] / 255.0f;
+						}
+					}
+
+					return true;
+				}
+
+				int width        = 0;
+				int height       = 0;
+				int channelCount = 0;
+
+				unsigned char* decodedPixels = stbi_load(filePath.c_str(), &width, &height, &channelCount, 3);
+
+				if (!decodedPixels || width != height)
+				{
+					stbi_image_free(decodedPixels);
+					return false;
+				}
+
+				size = width;
+				output.resize((size_t)size * (size_t)size * 3);
+
+				for (size_t i = 0; i < output.size(); i++)
+				{
+					output[i] = (float)decodedPixels[i] / 255.0f;
+				}
+
+				stbi_image_free(decodedPixels);
+
+				return true;
+			}
+
+			// ---------------------------------------------
+
+			static bool LoadSourceCubeMap(const std::string faceFilePaths[6], SourceCubeMap& output)
+			{
+				output.mLevels.clear();
+
+				std::vector<std::vector<float>> topLevel(6);
+
+				for (unsigned int i = 0; i < 6; i++)
+				{
+					int size = 0;
+
+					if (!LoadFace(faceFilePaths[i], topLevel[i], size) || size == 0)
+						return false;
+
+					if (i == 0)
+					{
+						output.mSize = size;
+					}
+					else if (size != output.mSize)
+					{
+						return false;
+					}
+				}
+
+				output.mLevelCount = 1;
+
+				while ((output.mSize >> output.mLevelCount) > 0)
+				{
+					output.mLevelCount++;
+				}
+
+				output.mLevels.resize(output.mLevelCount * 6);
+
+				for (unsigned int i = 0; i < 6; i++)
+				{
+					output.mLevels[i].swap(topLevel[i]);
+				}
+
+				// Each level is the average of the 2x2 block above it, the last row or column repeated for odd sizes
+				for (unsigned int level = 1; level < output.mLevelCount; level++)
+				{
+					const int previousSize = output.GetLevelSize(level - 1);
+					const int levelSize    = output.GetLevelSize(level);
+
+					for (unsigned int face = 0; face < 6; face++)
+					{
+						const float*        previous = output.GetFace(level - 1, face);
+						std::vector<float>& current  = output.mLevels[(level * 6) + face];
+
+						current.resize((size_t)levelSize * (size_t)levelSize * 3);
+
+						for (int y = 0; y < levelSize; y++)
+						{
+							const int row0 = std::min(y * 2,       previousSize - 1);
+							const int row1 = std::min((y * 2) + 1, previousSize - 1);
+
+							for (int x = 0; x < levelSize; x++)
+							{
+								const int column0 = std::min(x * 2,       previousSize - 1);
+								const int column1 = std::min((x * 2) + 1, previousSize - 1);
+
+								for (int channel = 0; channel < 3; channel++)
+								{
+									float sum = previous[(((size_t)row0 * previousSize) + column0) * 3 + channel] +
+										        previous[(((size_t)row0 * previousSize) + column1) * 3 + channel] +
+										        previous[(((size_t)row1 * previousSize) + column0) * 3 + channel] +
+										        previous[(((size_t)row1 * previousSize) + column1) * 3 + channel];
+
+									current[(((size_t)y * levelSize) + x) * 3 + channel] = sum * 0.25f;
+								}
+							}
+						}
+					}
+				}
+
+				return true;
+			}
+
+			// ---------------------------------------------
+
+			// Clamped to the edge of the face rather than filtering across the seam, the same as the GPU pass without seamless cube maps
+			static void SampleBilinear(const SourceCubeMap& source, unsigned int level, unsigned int face, float u, float v, float* colour)
+			{
+				const int    size   = source.GetLevelSize(level);
+				const float* texels = source.GetFace(level, face);
+
+				float x = std::min(std::max((((u * 0.5f) + 0.5f) * (float)size) - 0.5f, 0.0f), (float)(size - 1));
+				float y = std::min(std::max((((v * 0.5f) + 0.5f) * (float)size) - 0.5f, 0.0f), (float)(size - 1));
+
+				const int column0 = (int)x;
+				const int row0    = (int)y;
+				const int column1 = std::min(column0 + 1, size - 1);
+				const int row1    = std::min(row0 + 1,    size - 1);
+
+				const float blendX = x - (float)column0;
+				const float blendY = y - (float)row0;
+
+				const float* topLeft     = texels + (((size_t)row0 * size) + column0) * 3;
+				const float* topRight    = texels + (((size_t)row0 * size) + column1) * 3;
+				const float* bottomLeft  = texels + (((size_t)row1 * size) + column0) * 3;
+				const float* bottomRight = texels + (((size_t)row1 * size) + column1) * 3;
+
+				for (int channel = 0; channel < 3; channel++)
+				{
+					float top    = topLeft[channel]    + ((topRight[channel]    - topLeft[channel])    * blendX);
+					float bottom = bottomLeft[channel] + ((bottomRight[channel] - bottomLeft[channel]) * blendX);
+
+					colour[channel] = top + ((bottom - top) * blendY);
+				}
+			}
+
+			// ---------------------------------------------
+
+			static void SampleTrilinear(const SourceCubeMap& source, unsigned int face, float u, float v, float level, float* colour)
+			{
+				const unsigned int level0 = (unsigned int)level;
+				const unsigned int level1 = std::min(level0 + 1, source.mLevelCount - 1);
+				const float        blend  = level - (float)level0;
+
+				SampleBilinear(source, level0, face, u, v, colour);
+
+				if (level1 == level0 || blend <= 0.0f)
+					return;
+
+				float upper[3];
+				SampleBilinear(source, level1, face, u, v, upper);
+
+				colour[0] += (upper[0] - colour[0]) * blend;
+				colour[1] += (upper[1] - colour[1]) * blend;
+				colour[2] += (upper[2] - colour[2]) * blend;
+			}
+
+			// ---------------------------------------------
+
+			// Matches RadicalInverse_VdC and Hammersley in Include/ImportanceSampling.glsl
+			static float RadicalInverse(uint32_t bits)
+			{
+				bits = (bits << 16u) | (bits >> 16u);
+				bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+				bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+				bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+				bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+
+				return (float)bits * 2.3283064365386963e-10f;
+			}
+
+			// ---------------------------------------------
+
+			// The view direction is taken to be the normal, as it is in the shader, so every output texel on a level shares the same samples
+			// minimumSourceLevel is where one output texel covers one source texel, below which the sky would alias
+			static void BuildSampleTable(float roughness, unsigned int sampleCount, int sourceSize, float minimumSourceLevel, float maximumSourceLevel, std::vector<PrefilterSample>& samples, float& totalWeight)
+			{
+				samples.clear();
+				totalWeight = 0.0f;
+
+				// A mirror reflects along the normal whatever the sample, so one is enough
+				if (roughness <= 0.0f || sampleCount <= 1)
+				{
+					samples.push_back({ 0.0f, 0.0f, 1.0f, 1.0f, minimumSourceLevel });
+					totalWeight = 1.0f;
+					return;
+				}
+
+				const float a               = roughness * roughness;
+				const float aSquared        = a * a;
+				const float texelSolidAngle = (4.0f * kPi) / (6.0f * (float)sourceSize * (float)sourceSize);
+
+				for (unsigned int i = 0; i < sampleCount; i++)
+				{
+					const float xiX = (float)i / (float)sampleCount;
+					const float xiY = RadicalInverse(i);
+
+					const float phi      = 2.0f * kPi * xiX;
+					const float cosTheta = std::sqrt((1.0f - xiY) / (1.0f + ((aSquared - 1.0f) * xiY)));
+					const float sinTheta = std::sqrt(std::max(1.0f - (cosTheta * cosTheta), 0.0f));
+
+					const glm::vec3 halfway(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+
+					// Reflect the normal, (0, 0, 1) in this space, about the halfway vector
+					const glm::vec3 light = (2.0f * halfway.z * halfway) - glm::vec3(0.0f, 0.0f, 1.0f);
+
+					if (light.z <= 0.0f)
+						continue;
+
+					// N.H and H.V are the same here, so the pdf reduces to D / 4
+					const float denominator  = ((halfway.z * halfway.z) * (aSquared - 1.0f)) + 1.0f;
+					const float distribution = aSquared / (kPi * denominator * denominator);
+					const float pdf          = (distribution * 0.25f) + 0.0001f;
+
+					const float sampleSolidAngle = 1.0f / (((float)sampleCount * pdf) + 0.0001f);
+					const float sourceLevel      = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle);
+
+					samples.push_back({ light.x, light.y, light.z, light.z, std::min(std::max(sourceLevel, minimumSourceLevel), maximumSourceLevel) });
+
+					totalWeight += light.z;
+				}
+
+				// Padded to whole groups of four with samples that carry no weight
+				while ((samples.size() % 4) != 0)
+				{
+					samples.push_back({ 0.0f, 0.0f, 1.0f, 0.0f, minimumSourceLevel });
+				}
+			}
+
+			// ---------------------------------------------
+
+			static __m128 Select(__m128 mask, __m128 whenSet, __m128 whenClear)
+			{
+				return _mm_or_ps(_mm_and_ps(mask, whenSet), _mm_andnot_ps(mask, whenClear));
+			}
+
+			// ---------------------------------------------
+
+			// Four samples at a time - the directions, which face each lands on and where on it are done across the lanes,
+			// leaving only the texel fetches themselves to go one by one
+			static glm::vec3 PrefilterTexel(const SourceCubeMap& source, const std::vector<PrefilterSample>& samples, float totalWeight, const glm::vec3& normal)
+			{
+				if (samples.size() == 1)
+				{
+					float colour[3];
+
+					int   face = 0;
+					float u    = 0.0f;
+					float v    = 0.0f;
+
+					// Project the normal onto the face it points through
+					float absoluteX = std::abs(normal.x);
+					float absoluteY = std::abs(normal.y);
+					float absoluteZ = std::abs(normal.z);
+
+					if (absoluteX >= absoluteY && absoluteX >= absoluteZ)
+					{
+						face = normal.x > 0.0f ? 0 : 1;
+						u    = (normal.x > 0.0f ? -normal.z : normal.z) / absoluteX;
+						v    = -normal.y / absoluteX;
+					}
+					else if (absoluteY >= absoluteZ)
+					{
+						face = normal.y > 0.0f ? 2 : 3;
+						u    = normal.x / absoluteY;
+						v    = (normal.y > 0.0f ? normal.z : -normal.z) / absoluteY;
+					}
+					else
+					{
+						face = normal.z > 0.0f ? 4 : 5;
+						u    = (normal.z > 0.0f ? normal.x : -normal.x) / absoluteZ;
+						v    = -normal.y / absoluteZ;
+					}
+
+					SampleTrilinear(source, face, u, v, samples[0].mSourceLevel, colour);
+
+					return glm::vec3(colour[0], colour[1], colour[2]);
+				}
+
+				// Same basis as ImportanceSampleGGX
+				const glm::vec3 up        = std::abs(normal.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+				const glm::vec3 tangent   = glm::normalize(glm::cross(up, normal));
+				const glm::vec3 bitangent = glm::cross(normal, tangent);
+
+				const __m128 tangentX   = _mm_set1_ps(tangent.x);
+				const __m128 tangentY   = _mm_set1_ps(tangent.y);
+				const __m128 tangentZ   = _mm_set1_ps(tangent.z);
+				const __m128 bitangentX = _mm_set1_ps(bitangent.x);
+				const __m128 bitangentY = _mm_set1_ps(bitangent.y);
+				const __m128 bitangentZ = _mm_set1_ps(bitangent.z);
+				const __m128 normalX    = _mm_set1_ps(normal.x);
+				const __m128 normalY    = _mm_set1_ps(normal.y);
+				const __m128 normalZ    = _mm_set1_ps(normal.z);
+
+				const __m128 zero       = _mm_setzero_ps();
+				const __m128 signBit    = _mm_set1_ps(-0.0f);
+
+				glm::vec3 sum(0.0f);
+
+				for (size_t i = 0; i < samples.size(); i += 4)
+				{
+					const PrefilterSample* group = &samples[i];
+
+					const __m128 localX = _mm_setr_ps(group[0].mTangentX, group[1].mTangentX, group[2].mTangentX, group[3].mTangentX);
+					const __m128 localY = _mm_setr_ps(group[0].mTangentY, group[1].mTangentY, group[2].mTangentY, group[3].mTangentY);
+					const __m128 localZ = _mm_setr_ps(group[0].mTangentZ, group[1].mTangentZ, group[2].mTangentZ, group[3].mTangentZ);
+
+					const __m128 directionX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tangentX, localX), _mm_mul_ps(bitangentX, localY)), _mm_mul_ps(normalX, localZ));
+					const __m128 directionY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tangentY, localX), _mm_mul_ps(bitangentY, localY)), _mm_mul_ps(normalY, localZ));
+					const __m128 directionZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tangentZ, localX), _mm_mul_ps(bitangentZ, localY)), _mm_mul_ps(normalZ, localZ));
+
+					const __m128 absoluteX = _mm_andnot_ps(signBit, directionX);
+					const __m128 absoluteY = _mm_andnot_ps(signBit, directionY);
+					const __m128 absoluteZ = _mm_andnot_ps(signBit, directionZ);
+
+					// The largest component picks the face, in the same order of preference as the GL spec
+					const __m128 xMajor = _mm_and_ps(_mm_cmpge_ps(absoluteX, absoluteY), _mm_cmpge_ps(absoluteX, absoluteZ));
+					const __m128 yMajor = _mm_andnot_ps(xMajor, _mm_cmpge_ps(absoluteY, absoluteZ));
+
+					const __m128 xPositive = _mm_cmpgt_ps(directionX, zero);
+					const __m128 yPositive = _mm_cmpgt_ps(directionY, zero);
+					const __m128 zPositive = _mm_cmpgt_ps(directionZ, zero);
+
+					const __m128 negatedX = _mm_xor_ps(directionX, signBit);
+					const __m128 negatedY = _mm_xor_ps(directionY, signBit);
+					const __m128 negatedZ = _mm_xor_ps(directionZ, signBit);
+
+					const __m128 major = Select(xMajor, absoluteX, Select(yMajor, absoluteY, absoluteZ));
+					const __m128 faceU = Select(xMajor, Select(xPositive, negatedZ, directionZ), Select(yMajor, directionX, Select(zPositive, directionX, negatedX)));
+					const __m128 faceV = Select(yMajor, Select(yPositive, directionZ, negatedZ), negatedY);
+
+					const __m128 face  = Select(xMajor, Select(xPositive, _mm_set1_ps(0.0f), _mm_set1_ps(1.0f)),
+						                 Select(yMajor, Select(yPositive, _mm_set1_ps(2.0f), _mm_set1_ps(3.0f)),
+						                                Select(zPositive, _mm_set1_ps(4.0f), _mm_set1_ps(5.0f))));
+
+					const __m128 inverseMajor = _mm_div_ps(_mm_set1_ps(1.0f), major);
+
+					float u[4];
+					float v[4];
+					int   faces[4];
+
+					_mm_storeu_ps(u, _mm_mul_ps(faceU, inverseMajor));
+					_mm_storeu_ps(v, _mm_mul_ps(faceV, inverseMajor));
+					_mm_storeu_si128((__m128i*)faces, _mm_cvttps_epi32(face));
+
+					for (unsigned int lane = 0; lane < 4; lane++)
+					{
+						if (group[lane].mWeight <= 0.0f)
+							continue;
+
+						float colour[3];
+						SampleTrilinear(source, (unsigned int)faces[lane], u[lane], v[lane], group[lane].mSourceLevel, colour);
+
+						sum += glm::vec3(colour[0], colour[1], colour[2]) * group[lane].mWeight;
+					}
+				}
+
+				return sum / totalWeight;
+			}
+
+			// ---------------------------------------------
+
+			unsigned int GetCacheKey(const std::string faceFilePaths[6], const Settings& settings)
+			{
+				std::stringstream description;
+				description << "Specular GGX RGB16F v" << kBakerVersion << " " << settings.mFaceSize << " " << settings.mMipCount << " " << settings.mSampleCount;
+
+				return CubeMapCache::GenerateKey(faceFilePaths, {}, description.str());
+			}
+
+			// ---------------------------------------------
+
+			bool Bake(const std::string faceFilePaths[6], const Settings& settings, std::vector<std::vector<unsigned char>>& levelData)
+			{
+				levelData.clear();
+
+				if (settings.mFaceSize == 0 || settings.mMipCount == 0)
+					return false;
+
+				SourceCubeMap source;
+
+				if (!LoadSourceCubeMap(faceFilePaths, source))
+					return false;
+
+				unsigned int mipCount = 1;
+
+				while (mipCount < settings.mMipCount && (settings.mFaceSize >> mipCount) > 0)
+				{
+					mipCount++;
+				}
+
+				levelData.resize(mipCount);
+
+				std::vector<PrefilterSample> samples;
+				float                        totalWeight = 0.0f;
+
+				for (unsigned int mipLevel = 0; mipLevel < mipCount; mipLevel++)
+				{
+					const int   levelSize = (int)std::max(settings.mFaceSize >> mipLevel, 1u);
+					const float roughness = mipCount > 1 ? (float)mipLevel / (float)(mipCount - 1) : 0.0f;
+
+					const float minimumSourceLevel = std::max(std::log2((float)source.mSize / (float)levelSize), 0.0f);
+					const float maximumSourceLevel = (float)(source.mLevelCount - 1);
+
+					BuildSampleTable(roughness, settings.mSampleCount, source.mSize, std::min(minimumSourceLevel, maximumSourceLevel), maximumSourceLevel, samples, totalWeight);
+
+					if (totalWeight <= 0.0f)
+						return false;
+
+					levelData[mipLevel].resize(CubeMapCache::GetFaceSizeBytes(settings.mFaceSize, mipLevel) * 6);
+
+					unsigned char* output = levelData[mipLevel].data();
+
+					// Every row of every face is one item, the rougher levels being smaller but costing far more a texel
+					Engine::Parallel::ParallelFor(0, 6 * (unsigned int)levelSize, 1, [&](unsigned int rowStart, unsigned int rowEnd)
+					{
+						for (unsigned int row = rowStart; row < rowEnd; row++)
+						{
+							const unsigned int     faceIndex = row / (unsigned int)levelSize;
+							const int              y         = (int)(row % (unsigned int)levelSize);
+							const CubeMapFaceAxes& axes      = kFaceAxes[faceIndex];
+
+							const float v = (2.0f * ((float)y + 0.5f) / (float)levelSize) - 1.0f;
+
+							uint16_t* destination = (uint16_t*)(output + ((size_t)row * (size_t)levelSize * 6));
+
+							for (int x = 0; x < levelSize; x++)
+							{
+								const float u = (2.0f * ((float)x + 0.5f) / (float)levelSize) - 1.0f;
+
+								const glm::vec3 normal = glm::normalize(axes.mMajor + (u * axes.mUAxis) + (v * axes.mVAxis));
+								const glm::vec3 colour = PrefilterTexel(source, samples, totalWeight, normal);
+
+								destination[(x * 3) + 0] = glm::packHalf1x16(colour.r);
+								destination[(x * 3) + 1] = glm::packHalf1x16(colour.g);
+								destination[(x * 3) + 2] = glm::packHalf1x16(colour.b);
+							}
+						}
+					});
+				}
+
+				return true;
+			}
+
+			// ---------------------------------------------
+
+			std::string BakeSkyboxDirectory(const std::string& directory, const Settings& settings)
+			{
+				std::stringstream report;
+
+				std::error_code                     error;
+				std::filesystem::directory_iterator folders(directory, error);
+
+				if (error)
+				{
+					report << "Could not open " << directory << "\n";
+					return report.str();
+				}
+
+				report << std::fixed << std::setprecision(2);
+
+				// Sorted so that the report reads the same on every platform
+				std::vector<std::filesystem::path> skyboxFolders;
+
+				for (const std::filesystem::directory_entry& entry : folders)
+				{
+					if (entry.is_directory(error))
+						skyboxFolders.push_back(entry.path());
+				}
+
+				std::sort(skyboxFolders.begin(), skyboxFolders.end());
+
+				for (const std::filesystem::path& folder : skyboxFolders)
+				{
+					std::string faceFilePaths[6];
+
+					report << folder.filename().string() << ": ";
+
+					if (!Skybox::FindFaceFilePaths(folder.string(), faceFilePaths))
+					{
+						report << "skipped, does not hold six faces\n";
+						continue;
+					}
+
+					std::chrono::time_point<std::chrono::steady_clock> start = std::chrono::steady_clock::now();
+
+					std::vector<std::vector<unsigned char>> levelData;
+
+					if (!Bake(faceFilePaths, settings, levelData))
+					{
+						report << "failed, the faces could not be read or are not matching squares\n";
+						continue;
+					}
+
+					unsigned int key = GetCacheKey(faceFilePaths, settings);
+
+					if (!CubeMapCache::Save(key, settings.mFaceSize, levelData))
+					{
+						report << "failed, the bake could not be written into the cache\n";
+						continue;
+					}
+
+					float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+					report << levelData.size() << " levels from " << settings.mFaceSize << " at " << settings.mSampleCount << " samples in " << seconds << "s, key " << std::hex << std::setw(8) << std::setfill('0') << key << std::dec << std::setfill(' ') << "\n";
+				}
+
+				return report.str();
+			}
+
+			// ---------------------------------------------
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+// CPU baker for the roughness mip chain that ConvoluteCubeMap_Reflections.frag builds on the GPU
+// Each level below the first is a GGX importance sampled prefilter of the sky at a roughness stepping evenly up to one, written
+// into the cube map cache so that the running program only ever loads the result
+
+#include <vector>
+#include <string>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		namespace SpecularPrefilter
+		{
+			// ---------------------------------------
+
+			struct Settings
+			{
+				Settings()
+					: mFaceSize(128)
+					, mMipCount(5)
+					, mSampleCount(1024)
+				{ }
+
+				unsigned int mFaceSize;    // Size of the top level, which is a straight copy of the sky at roughness zero
+				unsigned int mMipCount;    // Limited to the number of levels the face size has
+				unsigned int mSampleCount; // Per output texel, on every level below the first
+			};
+
+			// ---------------------------------------
+
+			// Covers the faces, the layout of the output and the sample budget, so a bake made with a different budget is never loaded in place of this one
+			unsigned int GetCacheKey(const std::string faceFilePaths[6], const Settings& settings);
+
+			// Fills levelData in the layout CubeMapCache::Save expects - false if a face can not be read, is not square, or the faces differ in size
+			// Every level is split across the worker threads by row
+			bool         Bake(const std::string faceFilePaths[6], const Settings& settings, std::vector<std::vector<unsigned char>>& levelData);
+
+			// Bakes every folder directly under directory that holds the six faces of a skybox, and saves each into the cache
+			// Returns a line per folder saying what was done with it
+			std::string  BakeSkyboxDirectory(const std::string& directory, const Settings& settings);
+
+			// ---------------------------------------
+		}
+	}
+}
@@ -1,10 +1,15 @@
 #include "Texture.h"
+#include "CubeMapCache.h"
+#include "PixelConversion.h"
 
 #include "Rendering/Code/STB_Image/STB_ImageInit.h"
 #include "Rendering/Code/Window.h"
 #include "Rendering/Code/Shaders/ShaderProgram.h"
 
 #include "Rendering/Code/RenderingResourceTracking.h"
+#include "Rendering/Code/GLStateCache.h"
+#include "Rendering/Code/GLErrorChecking.h"
+#include "Rendering/Code/MemoryBarrierTracker.h"
 
 #include "Rendering/Code/Framebuffers.h"
 
@@ -13,6 +18,11 @@
 #include "Rendering/Code/Shaders/Shader.h"
 
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <future>
+#include <chrono>
+#include <cstring>
 
 namespace Rendering
 {
@@ -20,6 +30,37 @@ namespace Rendering
 	{
 		// ----------------------------------------------------------------------------------------------------------
 
+		// Rows of four byte pixels always meet GL's default unpack alignment, whatever the width
+		static const GLint kFourChannelRowAlignment = 4;
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		// Framebuffer::SetActive and its destructor both leave zero bound, which could be half way through a frame drawing elsewhere
+		// Declared before the temporary framebuffer, so it is put back once that has gone, along with the viewport of whatever was bound
+		struct RenderTargetBindings
+		{
+			RenderTargetBindings()
+				: mDrawFramebuffer(GLStateCache::GetBoundFramebuffer(GL_DRAW_FRAMEBUFFER))
+				, mReadFramebuffer(GLStateCache::GetBoundFramebuffer(GL_READ_FRAMEBUFFER))
+			{
+				GLStateCache::GetViewport(mViewport);
+			}
+
+			~RenderTargetBindings()
+			{
+				GLStateCache::BindFramebuffer(GL_DRAW_FRAMEBUFFER, mDrawFramebuffer);
+				GLStateCache::BindFramebuffer(GL_READ_FRAMEBUFFER, mReadFramebuffer);
+
+				GLStateCache::SetViewport(mViewport[0], mViewport[1], mViewport[2], mViewport[3]);
+			}
+
+			unsigned int mDrawFramebuffer;
+			unsigned int mReadFramebuffer;
+			int          mViewport[4];
+		};
+
+		// ----------------------------------------------------------------------------------------------------------
+
 		Texture2D::Texture2D() 
 			:  mFilePath("")
 			, mTextureID(0)
@@ -32,6 +73,8 @@ namespace Rendering
 			, mInitialised(false)
 			, mForVideo(false)
 			, mHasAlpha(false)
+			, mHasMipMaps(false)
+			, mReloadable(false)
 			, mLastDataInvalid(true)
 			, mLastPixelDataFromGPU(nullptr)
 
@@ -40,8 +83,11 @@ namespace Rendering
 			, mExternalFormat(GL_RGB)
 
 			, mLoadedImageData(nullptr)
+			, mMappedImage()
 		{
 			glGenTextures(1, &mTextureID);
+
+			TextureResidency::Register(this, mTextureID, GL_TEXTURE_2D, TextureCategory::General);
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
@@ -50,12 +96,17 @@ namespace Rendering
 		{
 			FreeCachedImageData();
 
+			TextureResidency::Unregister(mTextureID);
+
 			glDeleteTextures(1, &mTextureID);
+			GLStateCache::OnTextureDeleted(mTextureID);
+			MemoryBarrierTracker::Forget(GPUResourceType::Texture, mTextureID);
 			mTextureID   = 0;
 
 			if (mPBO != 0)
 			{
 				glDeleteBuffers(1, &mPBO);
+				GLStateCache::OnBufferDeleted(mPBO);
 				mPBO = 0;
 			}
 
@@ -88,29 +139,34 @@ namespace Rendering
 				return false;
 			}
 
-			return SendTextureDataToGPU();
+			mReloadable = SendTextureDataToGPU();
+
+			return mReloadable;
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
 
 		void Texture2D::Bind(GLenum unitToBindTo)
-		{			
-			OpenGLRenderPipeline* pipeline = (OpenGLRenderPipeline*)Window::GetRenderPipeline();
-
-			pipeline->BindTextureToTextureUnit(unitToBindTo, mTextureID, true);
+		{
+			// Almost always followed by something that edits the texture, so the unit has to end up active
+			GLStateCache::BindTextureForUpdate(unitToBindTo - GL_TEXTURE0, GL_TEXTURE_2D, mTextureID);
 
-			GLenum error = glGetError();
-			ASSERTMSG(error  != 0, "Error binding texture2D.");
+			GL_CHECK_ERROR("Error binding texture2D.");
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
 
 		void Texture2D::BindForComputeShader(GLuint unit, GLint level, bool layered, GLint layer, GLenum access, GLenum format)
 		{
-			glBindImageTexture(unit, mTextureID, level, layered, layer, access, format);
+			// Anything a shader writes is lost on eviction
+			if (access != GL_READ_ONLY)
+			{
+				mReloadable = false;
+			}
 
-			GLenum error = glGetError();
-			ASSERTMSG(error != 0, "Error binding texture2D.");
+			GLStateCache::BindImageTexture(unit, mTextureID, level, layered, layer, access, format);
+
+			GL_CHECK_ERROR("Error binding texture2D.");
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
@@ -140,7 +196,7 @@ namespace Rendering
 				return false;
 
 			// Bind the texture
-			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, mTextureID);
+			GLStateCache::BindTextureForUpdate(0, GL_TEXTURE_2D, mTextureID);
 
 				SetTextureMinMagFilters(minMagFilters);
 				SetTextureWrappingSettings(textureWrapSettings);
@@ -163,8 +219,10 @@ namespace Rendering
 
 			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, mWidth, mHeight, 0, format, internalDataType, nullptr);
 
-			int error = glGetError();
-			ASSERTMSG(error != 0, "Error with setting texture data");
+			GL_CHECK_ERROR("Error with setting texture data");
+
+			mReloadable = false;
+			UpdateResidentSize();
 
 			return true;
 		}
@@ -204,6 +262,9 @@ namespace Rendering
 
 			UnBind();
 
+			mReloadable = false;
+			UpdateResidentSize();
+
 			return true;
 		}
 
@@ -212,6 +273,7 @@ namespace Rendering
 		bool Texture2D::ReplaceTextureData(unsigned char* data)
 		{
 			mLastDataInvalid = true;
+			mReloadable      = false;
 
 			Bind();
 			
@@ -233,6 +295,7 @@ namespace Rendering
 			}
 
 			mLastDataInvalid = true;
+			mReloadable      = false;
 
 			// Bind the texture
 			Bind();
@@ -243,8 +306,7 @@ namespace Rendering
 			// Unbind
 			UnBind();
 
-			GLenum error = glGetError();
-			ASSERTMSG(error != 0, "Failure setting texture data");
+			GL_CHECK_ERROR("Failure setting texture data");
 
 			return true;
 		}
@@ -274,7 +336,7 @@ namespace Rendering
 			// -----------------
 
 			// Bind the PBO
-			glBindBuffer(GL_PIXEL_PACK_BUFFER, mPBO);
+			GLStateCache::BindBuffer(GL_PIXEL_PACK_BUFFER, mPBO);
 
 			// Setup the internal data
 			if(mHasAlpha)
@@ -285,7 +347,7 @@ namespace Rendering
 			// -----------------
 
 			// Bind the texture to be read from
-			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, mTextureID);
+			GLStateCache::BindTextureForUpdate(0, GL_TEXTURE_2D, mTextureID);
 
 			// -----------------
 
@@ -322,7 +384,7 @@ namespace Rendering
 
 			// -----------------
 
-			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			GLStateCache::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
 			mLastDataInvalid = false;
 
@@ -361,6 +423,23 @@ namespace Rendering
 
 		// ----------------------------------------------------------------------------------------------------------
 
+		std::future<ReadbackResult> Texture2D::ReadPixelsAsync(int x, int y, int width, int height, GLenum format, GLenum type, unsigned int mipLevel, ReadbackCallback callback)
+		{
+			OpenGLRenderPipeline* renderPipeline = (OpenGLRenderPipeline*)Window::GetRenderPipeline();
+
+			if (!renderPipeline || !renderPipeline->GetAsyncReadback())
+			{
+				std::promise<ReadbackResult> failed;
+				failed.set_value(ReadbackResult());
+
+				return failed.get_future();
+			}
+
+			return renderPipeline->GetAsyncReadback()->ReadTexture(this, x, y, width, height, format, type, mipLevel, std::move(callback));
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
 		// The texture needs to be bound before calling this
 		void Texture2D::SetTextureMinMagFilters(TextureMinMagFilters minMagFilters)
 		{
@@ -387,6 +466,28 @@ namespace Rendering
 
 		// ----------------------------------------------------------------------------------------------------------
 
+		void Texture2D::GenerateMipMaps()
+		{
+			OpenGLRenderPipeline* renderPipeline = (OpenGLRenderPipeline*)Window::GetRenderPipeline();
+
+			if (!renderPipeline)
+				return;
+
+			GLStateCache::BindTextureForUpdate(0, GL_TEXTURE_2D, mTextureID);
+
+				glGenerateMipmap(GL_TEXTURE_2D);
+
+			GL_CHECK_ERROR("Error generating texture mip maps");
+
+			if (!mHasMipMaps)
+			{
+				mHasMipMaps = true;
+				UpdateResidentSize();
+			}
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
 		unsigned int Texture2D::GetDataSize()
 		{
 			if (mHasAlpha)
@@ -404,6 +505,20 @@ namespace Rendering
 
 		bool Texture2D::LoadInImageData(std::string filePath)
 		{
+			FreeCachedImageData();
+
+			// Nothing to decode, so the pixels stay in the file mapping until they are uploaded
+			if (mMappedImage.Open(filePath))
+			{
+				mFilePath = filePath;
+
+				mWidth    = mMappedImage.GetWidth();
+				mHeight   = mMappedImage.GetHeight();
+				mFormat   = 3;
+
+				return true;
+			}
+
 			int width, height, format;
 
 			// Load the image data
@@ -437,7 +552,21 @@ namespace Rendering
 			SetTextureMinMagFilters(mMinMagFilters);
 			SetTextureWrappingSettings(mTextureWrapSettings);
 
-			if (mFormat == 3)
+			if (mMappedImage.GetIsOpen())
+			{
+#ifdef _DEBUG_BUILD
+				Rendering::TrackingData::AdjustGPUMemoryUsed(mWidth * mHeight * 3);
+#endif
+
+				mHasAlpha = false;
+
+				// Allocated empty, then filled from the mapping in the layout the file uses
+				glTexImage2D(GL_TEXTURE_2D, 0, mInternalFormat, mWidth, mHeight, 0, mExternalFormat, mInternalDataType, nullptr);
+
+				mMappedImage.Upload(GL_TEXTURE_2D);
+				mMappedImage.Close();
+			}
+			else if (mFormat == 3)
 			{
 #ifdef _DEBUG_BUILD
 				Rendering::TrackingData::AdjustGPUMemoryUsed(mWidth * mHeight * 3);
@@ -445,7 +574,28 @@ namespace Rendering
 
 				mHasAlpha       = false;
 				//mInternalFormat = GL_RGB;
-				glTexImage2D(GL_TEXTURE_2D, 0, mInternalFormat, mWidth, mHeight, 0, mExternalFormat, mInternalDataType, (const GLvoid*)mLoadedImageData);
+
+				if (mInternalDataType == GL_UNSIGNED_BYTE && (mExternalFormat == GL_RGB || mExternalFormat == GL_BGR))
+				{
+					// Padded out to four bytes here rather than by the driver, which does it a pixel at a time - the texture itself stays three channel
+					std::vector<unsigned char> expanded((size_t)mWidth * (size_t)mHeight * 4);
+
+					PixelConversion::ExpandToFourChannels(mLoadedImageData, expanded.data(), (size_t)mWidth * (size_t)mHeight);
+
+					glTexImage2D(GL_TEXTURE_2D, 0, mInternalFormat, mWidth, mHeight, 0, mExternalFormat == GL_RGB ? GL_RGBA : GL_BGRA, mInternalDataType, (const GLvoid*)expanded.data());
+				}
+				else
+				{
+					// Three channel rows are only four byte aligned when the width happens to make them so
+					GLint previousAlignment = 0;
+					glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+
+					glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+					glTexImage2D(GL_TEXTURE_2D, 0, mInternalFormat, mWidth, mHeight, 0, mExternalFormat, mInternalDataType, (const GLvoid*)mLoadedImageData);
+
+					glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+				}
 			}
 			else if (mFormat == 4)
 			{
@@ -482,6 +632,8 @@ namespace Rendering
 			stbi_image_free(mLoadedImageData);
 			mLoadedImageData = nullptr;
 
+			UpdateResidentSize();
+
 			mInitialised = true;
 			return true;
 		}
@@ -490,6 +642,8 @@ namespace Rendering
 
 		void Texture2D::FreeCachedImageData()
 		{
+			mMappedImage.Close();
+
 			if (mLoadedImageData)
 			{
 				stbi_image_free(mLoadedImageData);
@@ -512,7 +666,7 @@ namespace Rendering
 				return;
 
 			// Bind the texture
-			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, mTextureID);
+			GLStateCache::BindTextureForUpdate(0, GL_TEXTURE_2D, mTextureID);
 
 #ifdef _DEBUG_BUILD
 			if (mFormat == 3)
@@ -529,11 +683,16 @@ namespace Rendering
 
 			glTexImage2D(GL_TEXTURE_2D, 0, mInternalFormat, (GLsizei)width, (GLsizei)height, 0, mExternalFormat, mInternalDataType, nullptr);
 
-			GLenum error = glGetError();
-			ASSERTMSG(error != 0, "Error resizing image");
+			GL_CHECK_ERROR("Error resizing image");
 
-			mWidth  = width;
-			mHeight = height;
+			mWidth      = width;
+			mHeight     = height;
+
+			// Only level 0 is re-specified, so any mip chain is incomplete until it is generated again
+			mHasMipMaps = false;
+			mReloadable = false;
+
+			UpdateResidentSize();
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
@@ -565,11 +724,90 @@ namespace Rendering
 				mExternalFormat = GL_RGBA;
 			}
 
+			mLastDataInvalid = true;
+			mReloadable      = false;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void Texture2D::SetResidencyCategory(TextureCategory category)
+		{
+			TextureResidency::SetCategory(mTextureID, category);
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void Texture2D::UpdateResidentSize()
+		{
+			unsigned int levelCount = mHasMipMaps ? TextureResidency::GetFullChainLevelCount(mWidth, mHeight) : 1;
+
+			TextureResidency::SetSize(mTextureID, TextureResidency::GetLevelChainBytes(mWidth, mHeight, mInternalFormat, levelCount));
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool Texture2D::GetCanEvict() const
+		{
+			return mReloadable && mInitialised && !mForVideo && !mFilePath.empty();
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void Texture2D::Evict()
+		{
+			unsigned int levelCount = mHasMipMaps ? TextureResidency::GetFullChainLevelCount(mWidth, mHeight) : 1;
+
+			Bind();
+
+			// Zero sized levels hold no storage, but the name and its parameters are kept
+			for (unsigned int level = 0; level < levelCount; level++)
+			{
+				glTexImage2D(GL_TEXTURE_2D, level, mInternalFormat, 0, 0, 0, mExternalFormat, mInternalDataType, nullptr);
+			}
+
+			UnBind();
+
+			GL_CHECK_ERROR("Error evicting texture2D");
+
 			mLastDataInvalid = true;
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
+
+		bool Texture2D::Reload()
+		{
+			bool hadMipMaps = mHasMipMaps;
+
+			if (!LoadTextureFromFile(mFilePath, mMinMagFilters, mTextureWrapSettings))
+				return false;
+
+			if (hadMipMaps)
+			{
+				GenerateMipMaps();
+			}
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+		// ----------------------------------------------------------------------------------------------------------
+		// ----------------------------------------------------------------------------------------------------------
+
+		struct CubeMapStreamedLoad
+		{
+			std::future<GLenum> mDecodes[6]; // The format each face was written in, zero if it failed
+			unsigned int        mPixelUnpackBuffers[6];
+			bool                mUploaded[6];
+			unsigned int        mUploadedCount;
+		};
+
 		// ----------------------------------------------------------------------------------------------------------
+
+		static const char         kConvolutionVertexShader[]   = "Code/Shaders/Vertex/ConvoluteCubeMap.vert";
+		static const char         kConvolutionFragmentShader[] = "Code/Shaders/Fragment/ConvoluteCubeMap.frag";
+
+		static const unsigned int kIrradianceMapSize           = 32;
+
 		// ----------------------------------------------------------------------------------------------------------
 
 		ShaderPrograms::ShaderProgram* CubeMapTexture::mConvolutionShader          = nullptr;
@@ -589,15 +827,25 @@ namespace Rendering
 			: mTextureID(0)
 			, mWidth(0)
 			, mHeight(0)
+			, mStreamedLoad(nullptr)
+			, mSource(ContentSource::None)
+			, mSourceFilePaths()
+			, mSourceCacheKey(0)
+			, mMinMagFilters()
+			, mWrapSettings()
+			, mInternalFormat(GL_RGB)
+			, mLevelCount(1)
 		{
 			glGenTextures(1, &mTextureID);
 
+			TextureResidency::Register(this, mTextureID, GL_TEXTURE_CUBE_MAP, TextureCategory::General);
+
 			if (!mConvolutionShader)
 			{
 				mConvolutionShader = new ShaderPrograms::ShaderProgram();
 
-				Shaders::VertexShader*   vertexShader   = new Shaders::VertexShader("Code/Shaders/Vertex/ConvoluteCubeMap.vert");
-				Shaders::FragmentShader* fragmentShader = new Shaders::FragmentShader("Code/Shaders/Fragment/ConvoluteCubeMap.frag");
+				Shaders::VertexShader*   vertexShader   = new Shaders::VertexShader(kConvolutionVertexShader);
+				Shaders::FragmentShader* fragmentShader = new Shaders::FragmentShader(kConvolutionFragmentShader);
 
 				mConvolutionShader->AttachShader(vertexShader);
 				mConvolutionShader->AttachShader(fragmentShader);
@@ -635,7 +883,13 @@ namespace Rendering
 
 		CubeMapTexture::~CubeMapTexture()
 		{
+			// The workers are writing into mapped buffers, so they have to finish before the buffers can go
+			EndStreamedLoad();
+
+			TextureResidency::Unregister(mTextureID);
+
 			glDeleteTextures(1, &mTextureID);
+			GLStateCache::OnTextureDeleted(mTextureID);
 			mTextureID = 0;
 
 			// This assumes that all images in the cube map are of the same size
@@ -646,11 +900,10 @@ namespace Rendering
 
 		void CubeMapTexture::Bind(GLenum unitToBindTo)
 		{
-			OpenGLRenderPipeline* pipeline = (OpenGLRenderPipeline*)Window::GetRenderPipeline();
-
-			pipeline->BindTextureToTextureUnit(unitToBindTo, mTextureID, false);
+			// Almost always followed by something that edits the texture, so the unit has to end up active
+			GLStateCache::BindTextureForUpdate(unitToBindTo - GL_TEXTURE0, GL_TEXTURE_CUBE_MAP, mTextureID);
 
-			ASSERTMSG(glGetError() != 0, "Error binding cubemap");
+			GL_CHECK_ERROR("Error binding cubemap");
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
@@ -664,34 +917,128 @@ namespace Rendering
 
 		// ----------------------------------------------------------------------------------------------------------
 
+		CubeMapFaceImages::CubeMapFaceImages()
+			: mData{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr }
+			, mWidth{ 0, 0, 0, 0, 0, 0 }
+			, mHeight{ 0, 0, 0, 0, 0, 0 }
+		{
+
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		CubeMapFaceImages::~CubeMapFaceImages()
+		{
+			Free();
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapFaceImages::Free()
+		{
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				stbi_image_free(mData[i]);
+				mData[i] = nullptr;
+			}
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapTexture::DecodeFaces(const std::string filePaths[6], CubeMapFaceImages& output)
+		{
+			output.Free();
+
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				int channelCount = 0;
+
+				// Forced to three channels to match the texture, whatever the file holds
+				output.mData[i] = stbi_load(filePaths[i].c_str(), &output.mWidth[i], &output.mHeight[i], &channelCount, 3);
+			}
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
 		void CubeMapTexture::LoadInTextures(std::string filePaths[6], TextureMinMagFilters minMagFilters, TextureWrappingSettings wrapSettings)
+		{
+			if (!LoadInMappedBMPs(filePaths, minMagFilters, wrapSettings))
+			{
+				CubeMapFaceImages faces;
+
+				DecodeFaces(filePaths, faces);
+
+				LoadInTextures(faces, minMagFilters, wrapSettings);
+			}
+
+			SetSourceFiles(filePaths);
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool CubeMapTexture::LoadInMappedBMPs(std::string filePaths[6], TextureMinMagFilters minMagFilters, TextureWrappingSettings wrapSettings)
+		{
+			BMPImage faces[6];
+
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				if (!faces[i].Open(filePaths[i]))
+					return false;
+
+				if (faces[i].GetWidth() != faces[0].GetWidth() || faces[i].GetHeight() != faces[0].GetHeight())
+					return false;
+			}
+
+			SetupInteralData(faces[0].GetWidth(), faces[0].GetHeight(), GL_UNSIGNED_BYTE, GL_RGB, GL_RGB, minMagFilters, wrapSettings);
+
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				faces[i].Upload(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
+
+				Rendering::TrackingData::AdjustGPUMemoryUsed(faces[i].GetWidth() * faces[i].GetHeight() * 3);
+			}
+
+			UnBind();
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapTexture::LoadInTextures(CubeMapFaceImages& faces, TextureMinMagFilters minMagFilters, TextureWrappingSettings wrapSettings)
 		{
 			Bind();
 
-			int width, height, nrChannels;
+			// Shared by every face, as they are almost always the same size
+			std::vector<unsigned char> expanded;
 
 			// Loop through all 6 sides of the image
 			for (unsigned int i = 0; i < 6; i++)
 			{
-				unsigned char* data = stbi_load(filePaths[i].c_str(), &width, &height, &nrChannels, 0);
-
-				if (data)
+				if (faces.mData[i])
 				{
-					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+					const size_t pixelCount = (size_t)faces.mWidth[i] * (size_t)faces.mHeight[i];
 
-					Rendering::TrackingData::AdjustGPUMemoryUsed(width * height * 3);
+					// Handed over as four channels, the layout the driver keeps RGB8 in, so that the upload is a straight copy
+					expanded.resize(pixelCount * 4);
 
-					mHeight = height;
-					mWidth  = width;
+					PixelConversion::ExpandToFourChannels(faces.mData[i], expanded.data(), pixelCount);
+
+					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, faces.mWidth[i], faces.mHeight[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, expanded.data());
+
+					Rendering::TrackingData::AdjustGPUMemoryUsed(faces.mWidth[i] * faces.mHeight[i] * 3);
+
+					mHeight = faces.mHeight[i];
+					mWidth  = faces.mWidth[i];
 				}
 				else
 				{
 					ASSERTFAIL("Failed to load image for cubemap");
 				}
-				stbi_image_free(data);
-				data = nullptr;
 			}
 
+			faces.Free();
+
 			// ----------
 
 			SetTextureMinMagFilters(minMagFilters);
@@ -700,6 +1047,242 @@ namespace Rendering
 			UnBind();
 
 			// ----------
+
+			mSource = ContentSource::None;
+			UpdateResidentSize(GL_RGB, 1);
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool CubeMapTexture::BeginStreamedLoad(const std::string filePaths[6], glm::vec3 placeholderColour, TextureMinMagFilters minMagFilters, TextureWrappingSettings wrapSettings)
+		{
+			if (mStreamedLoad)
+				return false;
+
+			// All six faces share one size, so the first header is enough to allocate the whole texture
+			int width        = 0;
+			int height       = 0;
+			int channelCount = 0;
+
+			if (!stbi_info(filePaths[0].c_str(), &width, &height, &channelCount) || width <= 0 || height <= 0)
+			{
+				ASSERTFAIL("Failed to read the size of a cubemap face");
+				return false;
+			}
+
+			SetupInteralData(width, height, GL_UNSIGNED_BYTE, GL_RGB8, GL_RGB, minMagFilters, wrapSettings);
+
+			Rendering::TrackingData::AdjustGPUMemoryUsed(width * height * 3 * 6);
+
+			// Cleared through a framebuffer rather than uploading a full face of one colour six times
+			GLfloat clearColour[4] = { placeholderColour.x, placeholderColour.y, placeholderColour.z, 1.0f };
+
+			{
+				RenderTargetBindings savedBindings;
+
+				Framebuffer FBO = Framebuffer();
+				FBO.SetActive(true, true);
+
+				for (unsigned int i = 0; i < 6; i++)
+				{
+					glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mTextureID, 0);
+
+					glClearBufferfv(GL_COLOR, 0, clearColour);
+				}
+			}
+
+			GL_CHECK_ERROR("Error clearing cubemap to its placeholder colour");
+
+			// ----------
+
+			mStreamedLoad                 = new CubeMapStreamedLoad();
+			mStreamedLoad->mUploadedCount = 0;
+
+			// Four bytes a pixel, so every face uploads as a straight copy whether it came from a BMP or stb_image
+			GLsizeiptr faceSize = (GLsizeiptr)GetStreamedRowStride(width) * (GLsizeiptr)height;
+
+			glGenBuffers(6, mStreamedLoad->mPixelUnpackBuffers);
+
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				mStreamedLoad->mUploaded[i] = false;
+
+				GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, mStreamedLoad->mPixelUnpackBuffers[i]);
+
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, faceSize, nullptr, GL_STREAM_DRAW);
+
+				// The pointer stays valid on any thread until the buffer is unmapped, which only happens once the worker has finished with it
+				unsigned char* destination = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, faceSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+				std::string filePath = filePaths[i];
+
+				mStreamedLoad->mDecodes[i] = std::async(std::launch::async, [filePath, destination, width, height]()
+				{
+					return DecodeFaceInto(filePath, destination, width, height);
+				});
+			}
+
+			// Left bound, every other texture upload would read from this buffer instead of client memory
+			GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			GL_CHECK_ERROR("Error mapping the cubemap's pixel unpack buffers");
+
+			UnBind();
+
+			SetSourceFiles(filePaths);
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool CubeMapTexture::UpdateStreamedLoad()
+		{
+			if (!mStreamedLoad)
+				return false;
+
+			bool  uploadedAny       = false;
+			GLint previousAlignment = 0;
+
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				if (mStreamedLoad->mUploaded[i])
+					continue;
+
+				if (mStreamedLoad->mDecodes[i].wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+					continue;
+
+				GLenum format = mStreamedLoad->mDecodes[i].get();
+
+				GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, mStreamedLoad->mPixelUnpackBuffers[i]);
+
+				// False if the driver lost the contents while it was mapped, in which case the face keeps its placeholder
+				bool unmapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+
+				if (format != 0 && unmapped)
+				{
+					if (!uploadedAny)
+					{
+						Bind();
+
+						glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+						glPixelStorei(GL_UNPACK_ALIGNMENT, kFourChannelRowAlignment);
+					}
+
+					// Sourced from the bound buffer, so the copy to the GPU happens without stalling this thread
+					glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, 0, 0, mWidth, mHeight, format, GL_UNSIGNED_BYTE, nullptr);
+
+					GL_CHECK_ERROR("Error uploading a streamed cubemap face");
+
+					uploadedAny = true;
+				}
+				else
+				{
+					ASSERTFAIL("Failed to load image for cubemap");
+				}
+
+				mStreamedLoad->mUploaded[i] = true;
+				mStreamedLoad->mUploadedCount++;
+			}
+
+			GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			if (uploadedAny)
+			{
+				glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+
+				UnBind();
+			}
+
+			if (mStreamedLoad->mUploadedCount < 6)
+				return false;
+
+			EndStreamedLoad();
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapTexture::EndStreamedLoad()
+		{
+			if (!mStreamedLoad)
+				return;
+
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				if (mStreamedLoad->mUploaded[i])
+					continue;
+
+				mStreamedLoad->mDecodes[i].wait();
+
+				GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, mStreamedLoad->mPixelUnpackBuffers[i]);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			}
+
+			GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			// Any upload still reading from these keeps its own reference, so they can go straight away
+			glDeleteBuffers(6, mStreamedLoad->mPixelUnpackBuffers);
+
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				GLStateCache::OnBufferDeleted(mStreamedLoad->mPixelUnpackBuffers[i]);
+			}
+
+			delete mStreamedLoad;
+			mStreamedLoad = nullptr;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		GLenum CubeMapTexture::DecodeFaceInto(const std::string& filePath, unsigned char* destination, int width, int height)
+		{
+			if (!destination)
+				return 0;
+
+			unsigned int rowStride = GetStreamedRowStride(width);
+
+			// Uncompressed BMPs only need their rows turning the right way up and padding out, the channels staying blue first
+			BMPImage mappedImage;
+
+			if (mappedImage.Open(filePath))
+			{
+				if (mappedImage.GetWidth() != width || mappedImage.GetHeight() != height)
+					return 0;
+
+				for (int row = 0; row < height; row++)
+				{
+					PixelConversion::ExpandToFourChannels(mappedImage.GetRow(row), destination + (size_t)row * rowStride, (size_t)width);
+				}
+
+				return GL_BGRA;
+			}
+
+			int faceWidth    = 0;
+			int faceHeight   = 0;
+			int channelCount = 0;
+
+			// Forced to three channels to match the upload, whatever the file holds
+			unsigned char* pixels = stbi_load(filePath.c_str(), &faceWidth, &faceHeight, &channelCount, 3);
+
+			bool matches = pixels && faceWidth == width && faceHeight == height;
+
+			if (matches)
+			{
+				PixelConversion::ExpandToFourChannels(pixels, destination, (size_t)width * (size_t)height);
+			}
+
+			stbi_image_free(pixels);
+
+			return matches ? GL_RGBA : 0;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		unsigned int CubeMapTexture::GetStreamedRowStride(int width)
+		{
+			return (unsigned int)width * 4;
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
@@ -716,7 +1299,7 @@ namespace Rendering
 			// Create the output cubemap
 			CubeMapTexture* newCubemap = new CubeMapTexture();
 
-			newCubemap->SetupInteralData(32, 32, GL_FLOAT, GL_RGB16F, GL_RGB, { GL_LINEAR, GL_LINEAR }, { GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE });
+			newCubemap->SetupInteralData(kIrradianceMapSize, kIrradianceMapSize, GL_FLOAT, GL_RGB16F, GL_RGB, { GL_LINEAR, GL_LINEAR }, { GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE });
 
 			// ----
 
@@ -730,8 +1313,11 @@ namespace Rendering
 			// Bind this cubemap to the active texture ID
 			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, mTextureID, false);
 
+			// May be asked for part way through a frame, which carries on into whatever was bound before
+			RenderTargetBindings savedBindings;
+
 			// Set the viewport to the right size for the texture
-			glViewport(0, 0, 32, 32);
+			GLStateCache::SetViewport(0, 0, kIrradianceMapSize, kIrradianceMapSize);
 
 			Framebuffer* FBO = new Framebuffer();
 			FBO->SetActive(true, true);
@@ -745,11 +1331,7 @@ namespace Rendering
 
 				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, newCubemap->GetTextureID(), 0);
 
-				GLenum error = glGetError();
-				if (error != 0)
-				{
-					std::cout << "we have problems";
-				}
+				GL_CHECK_ERROR("Error attaching cube map face to the convolution framebuffer");
 
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -764,18 +1346,120 @@ namespace Rendering
 
 			cubeVAO->Unbind();
 
-			// ----
+			return newCubemap;
+		}
 
-			// Reset the viewport to the screen size
-			glViewport(0, 0, Window::GetWindowWidth(), Window::GetWindowHeight());
+		// ----------------------------------------------------------------------------------------------------------
 
-			return newCubemap;
+		unsigned int CubeMapTexture::GetIrradianceCacheKey(const std::string faceFilePaths[6])
+		{
+			std::vector<std::string> shaderFilePaths = { kConvolutionVertexShader, kConvolutionFragmentShader };
+
+			return CubeMapCache::GenerateKey(faceFilePaths, shaderFilePaths, "Irradiance RGB16F " + std::to_string(kIrradianceMapSize));
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool CubeMapTexture::LoadFromCache(unsigned int key, TextureMinMagFilters minMagFilters, TextureWrappingSettings wrapSettings)
+		{
+			CubeMapCache cache;
+
+			if (!cache.Open(key))
+				return false;
+
+			unsigned int faceSize = cache.GetFaceSize();
+			unsigned int mipCount = cache.GetMipCount();
+
+			Bind();
+
+			// A row of half float RGB is six bytes a texel, so only two byte aligned once a level is an odd size
+			GLint previousAlignment = 0;
+			glGetIntegerv(GL_UNPACK_ALIGNMENT, &previousAlignment);
+
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+
+			for (unsigned int mipLevel = 0; mipLevel < mipCount; mipLevel++)
+			{
+				unsigned int levelSize = std::max(faceSize >> mipLevel, 1u);
+
+				for (unsigned int i = 0; i < 6; i++)
+				{
+					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mipLevel, GL_RGB16F, levelSize, levelSize, 0, GL_RGB, GL_HALF_FLOAT, cache.GetFaceData(mipLevel, i));
+				}
+			}
+
+			glPixelStorei(GL_UNPACK_ALIGNMENT, previousAlignment);
+
+			// Only the levels in the entry exist, so sampling has to stop at the last of them
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL,  (GLint)mipCount - 1);
+
+			SetTextureMinMagFilters(minMagFilters);
+			SetTextureWrappingSettings(wrapSettings);
+
+			UnBind();
+
+			GL_CHECK_ERROR("Error uploading cached cubemap");
+
+			mWidth  = faceSize;
+			mHeight = faceSize;
+
+			SetSourceCache(key);
+			UpdateResidentSize(GL_RGB16F, mipCount);
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapTexture::SaveToCache(unsigned int key, unsigned int mipCount)
+		{
+			if (key == 0 || mWidth == 0 || mWidth != mHeight || mipCount == 0)
+				return;
+
+			std::vector<std::vector<unsigned char>> levelData(mipCount);
+
+			Bind();
+
+			// Read into client memory, not whatever pack buffer was last used for a readback
+			GLStateCache::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+			GLint previousAlignment = 0;
+			glGetIntegerv(GL_PACK_ALIGNMENT, &previousAlignment);
+
+			glPixelStorei(GL_PACK_ALIGNMENT, 2);
+
+			for (unsigned int mipLevel = 0; mipLevel < mipCount; mipLevel++)
+			{
+				size_t faceBytes = CubeMapCache::GetFaceSizeBytes(mWidth, mipLevel);
+
+				levelData[mipLevel].resize(faceBytes * 6);
+
+				for (unsigned int i = 0; i < 6; i++)
+				{
+					glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mipLevel, GL_RGB, GL_HALF_FLOAT, levelData[mipLevel].data() + faceBytes * i);
+				}
+			}
+
+			glPixelStorei(GL_PACK_ALIGNMENT, previousAlignment);
+
+			UnBind();
+
+			GL_CHECK_ERROR("Error reading back cubemap for the cache");
+
+			// The entry holds exactly what is in the texture, so it can be reloaded from there from now on
+			if (CubeMapCache::Save(key, mWidth, levelData) && mipCount >= mLevelCount)
+			{
+				SetSourceCache(key);
+			}
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
 
 		void CubeMapTexture::SetTextureMinMagFilters(TextureMinMagFilters minMagFilters)
 		{
+			mMinMagFilters = minMagFilters;
+
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, minMagFilters.mMinFilter);
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, minMagFilters.mMagFilter);
 		}
@@ -785,6 +1469,8 @@ namespace Rendering
 		// The texture needs to be bound before calling this
 		void CubeMapTexture::SetTextureWrappingSettings(TextureWrappingSettings settings)
 		{
+			mWrapSettings = settings;
+
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, settings.mSSetting);
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, settings.mTSetting);
 			glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, settings.mRSetting);
@@ -811,6 +1497,9 @@ namespace Rendering
 			{
 				glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
 			}
+
+			mSource = ContentSource::None;
+			UpdateResidentSize(internalFormat, generateMipMaps ? TextureResidency::GetFullChainLevelCount(width, height) : 1);
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
@@ -839,6 +1528,8 @@ namespace Rendering
 			// Grab the cube VAO
 			cubeVAO->Bind();
 
+			RenderTargetBindings savedBindings;
+
 			Framebuffer  FBO = Framebuffer();
 			RenderBuffer RBO = RenderBuffer();
 
@@ -857,7 +1548,7 @@ namespace Rendering
 				RBO.SetStorageData(GL_DEPTH_COMPONENT24, textureWidth, textureHeight);
 
 				// Now set the viewport
-				glViewport(0, 0, textureWidth, textureHeight);
+				GLStateCache::SetViewport(0, 0, textureWidth, textureHeight);
 
 				// Calculate the roughness value for this level and set in the shader
 				float roughness = (float)mipLevel / (float)(mipMapLevels - 1);
@@ -884,8 +1575,97 @@ namespace Rendering
 
 			cubeVAO->Unbind();
 
-			// Reset the viewport
-			glViewport(0, 0, Window::GetWindowWidth(), Window::GetWindowHeight());
+			mSource = ContentSource::None;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapTexture::SetResidencyCategory(TextureCategory category)
+		{
+			TextureResidency::SetCategory(mTextureID, category);
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapTexture::SetSourceFiles(const std::string filePaths[6])
+		{
+			mSource = ContentSource::Files;
+
+			for (unsigned int i = 0; i < 6; i++)
+			{
+				mSourceFilePaths[i] = filePaths[i];
+			}
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapTexture::SetSourceCache(unsigned int key)
+		{
+			mSource         = ContentSource::Cache;
+			mSourceCacheKey = key;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapTexture::UpdateResidentSize(GLenum internalFormat, unsigned int levelCount)
+		{
+			mInternalFormat = internalFormat;
+			mLevelCount     = levelCount;
+
+			TextureResidency::SetSize(mTextureID, TextureResidency::GetLevelChainBytes(mWidth, mHeight, internalFormat, levelCount) * 6);
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool CubeMapTexture::GetCanEvict() const
+		{
+			return mSource != ContentSource::None && !mStreamedLoad;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void CubeMapTexture::Evict()
+		{
+			Bind();
+
+			for (unsigned int mipLevel = 0; mipLevel < mLevelCount; mipLevel++)
+			{
+				for (unsigned int i = 0; i < 6; i++)
+				{
+					glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, mipLevel, mInternalFormat, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+				}
+			}
+
+			UnBind();
+
+			GL_CHECK_ERROR("Error evicting cubemap");
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool CubeMapTexture::Reload()
+		{
+			// Never through the streamed load, which goes through a framebuffer and would hand back the placeholder for a few frames
+			if (mSource == ContentSource::Files)
+			{
+				std::string filePaths[6];
+
+				for (unsigned int i = 0; i < 6; i++)
+				{
+					filePaths[i] = mSourceFilePaths[i];
+				}
+
+				LoadInTextures(filePaths, mMinMagFilters, mWrapSettings);
+
+				return true;
+			}
+
+			if (mSource == ContentSource::Cache)
+			{
+				return LoadFromCache(mSourceCacheKey, mMinMagFilters, mWrapSettings);
+			}
+
+			return false;
 		}
 
 		// ----------------------------------------------------------------------------------------------------------
@@ -6,6 +6,10 @@
 #include <glm/matrix.hpp>
 
 #include "TextureSettings.h"
+#include "BMPImage.h"
+
+#include "Rendering/Code/AsyncReadback.h"
+#include "Rendering/Code/TextureResidency.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -27,7 +31,7 @@ namespace Rendering
 	{
 		// ---------------------------------------------------
 
-		class Texture2D final
+		class Texture2D final : public ResidentTexture
 		{
 		public:
 			Texture2D();
@@ -43,9 +47,12 @@ namespace Rendering
 			bool           ReplaceTextureData(unsigned char* data);
 			bool           ReplaceTextureData(unsigned char* data, unsigned int x, unsigned int y, unsigned int width, unsigned int height, unsigned int mipMapLevel = 0);
 
+			// Both wait on the GPU to read the whole of level 0 - ReadPixelsAsync reads any rectangle without waiting
 			unsigned char* GetPixelData();
 			unsigned char* GetPixelData(unsigned int xOffset, unsigned int yOffset);
 
+			std::future<ReadbackResult> ReadPixelsAsync(int x, int y, int width, int height, GLenum format, GLenum type, unsigned int mipLevel = 0, ReadbackCallback callback = nullptr);
+
 			// -------
 
 			// Init
@@ -92,11 +99,15 @@ namespace Rendering
 
 			// Setters
 			void           SetIsForVideo() { mForVideo = true; }
+			void           SetResidencyCategory(TextureCategory category);
 
 			void           SetTextureMinMagFilters(TextureMinMagFilters minMagFilters);
 			void           SetTextureWrappingSettings(TextureWrappingSettings settings);
 			void           SetCompareMode(GLenum mode, GLenum function);
 
+			// Rebuilds every mip level from level 0 - needs calling each time level 0 is rewritten
+			void           GenerateMipMaps();
+
 			// -------
 
 			bool           LoadInImageData(std::string filePath);
@@ -108,7 +119,16 @@ namespace Rendering
 
 			void           Resize(unsigned int width, unsigned int height);
 
+			// -------
+
+			// Only textures loaded from a file and left untouched since can be evicted, as the file is all a reload has to go on
+			bool           GetCanEvict() const override;
+			void           Evict()             override;
+			bool           Reload()            override;
+
 		private:
+			void           UpdateResidentSize();
+
 
 			std::string    mFilePath;
 
@@ -122,12 +142,17 @@ namespace Rendering
 			bool           mInitialised;
 			bool           mForVideo;
 			bool           mHasAlpha;
+			bool           mHasMipMaps;
+			bool           mReloadable;
 
 			bool           mLastDataInvalid;
 			unsigned char* mLastPixelDataFromGPU; // The pixel store of what we have last requested from the GPU - will not be up-to date pixel data, mainly here to prevent memory leaks
 
 			unsigned char* mLoadedImageData;
 
+			// Uncompressed BMPs are kept mapped between loading and upload in place of mLoadedImageData
+			BMPImage       mMappedImage;
+
 			TextureMinMagFilters    mMinMagFilters;
 			TextureWrappingSettings mTextureWrapSettings;
 
@@ -138,7 +163,31 @@ namespace Rendering
 
 		// ---------------------------------------------------
 
-		class CubeMapTexture final
+		// The six faces of a cube map decoded into CPU memory - filled in without touching GL, so it can be done on any thread
+		struct CubeMapFaceImages
+		{
+			CubeMapFaceImages();
+			~CubeMapFaceImages();
+
+			void Free();
+
+			unsigned char* mData[6];
+			int            mWidth[6];
+			int            mHeight[6];
+
+		private:
+			CubeMapFaceImages(const CubeMapFaceImages&)            = delete;
+			CubeMapFaceImages& operator=(const CubeMapFaceImages&) = delete;
+		};
+
+		// ---------------------------------------------------
+
+		// Workers and pixel unpack buffers for a cube map whose faces are still decoding, only exists while the load is in flight
+		struct CubeMapStreamedLoad;
+
+		// ---------------------------------------------------
+
+		class CubeMapTexture final : public ResidentTexture
 		{
 		public:
 			CubeMapTexture();
@@ -147,12 +196,38 @@ namespace Rendering
 			void            Bind(GLenum unitToBindTo = GL_TEXTURE0);
 			void            UnBind(GLenum unitToBindTo = GL_TEXTURE0);
 			unsigned int    GetTextureID() const { return mTextureID; }
+			unsigned int    GetLevelCount() const { return mLevelCount; }
 
 			void            LoadInTextures(std::string filePaths[6], TextureMinMagFilters minMagFilters = TextureMinMagFilters(), TextureWrappingSettings wrapSettings = TextureWrappingSettings());
 
+			// Uploads faces decoded ahead of time, then frees them
+			void            LoadInTextures(CubeMapFaceImages& faces, TextureMinMagFilters minMagFilters = TextureMinMagFilters(), TextureWrappingSettings wrapSettings = TextureWrappingSettings());
+
+			// CPU only, so safe to run on a worker thread while the render thread does something else
+			static void     DecodeFaces(const std::string filePaths[6], CubeMapFaceImages& output);
+
+			// Only reads the image headers before returning - the texture is allocated at full size and every face cleared to placeholderColour,
+			// then each face is decoded on a worker of its own straight into a mapped pixel unpack buffer
+			bool            BeginStreamedLoad(const std::string filePaths[6], glm::vec3 placeholderColour, TextureMinMagFilters minMagFilters = TextureMinMagFilters(), TextureWrappingSettings wrapSettings = TextureWrappingSettings());
+
+			// Called once a frame on the render thread, uploads whichever faces have finished decoding since the last call
+			// Returns true on the call that uploads the last face, so anything built from this texture knows to rebuild
+			bool            UpdateStreamedLoad();
+
+			bool            GetIsStreaming() const { return mStreamedLoad != nullptr; }
+
 			// Returns a new texture that has been convoluted
 			CubeMapTexture* ConvoluteTexture(Buffers::VertexArrayObject* cubeVAO);
 
+			// Identifies the irradiance map ConvoluteTexture makes from these faces, for use with the cache below
+			static unsigned int GetIrradianceCacheKey(const std::string faceFilePaths[6]);
+
+			// Fills this texture from a cube map cache entry, every face and level uploaded straight out of the mapping - false on a miss
+			bool            LoadFromCache(unsigned int key, TextureMinMagFilters minMagFilters = TextureMinMagFilters(), TextureWrappingSettings wrapSettings = TextureWrappingSettings());
+
+			// Reads the first mipCount levels back as half floats and writes them out - this waits on the GPU, so is only worth it after a convolution
+			void            SaveToCache(unsigned int key, unsigned int mipCount = 1);
+
 			// Convolutes this texture, but as it is roughness based the only blurred parts are the mip map levels
 			void            ConvoluteTexture_Roughness(Buffers::VertexArrayObject* cubeVAO);
 
@@ -163,14 +238,55 @@ namespace Rendering
 
 			glm::mat4       GetCaptureView(unsigned int ID) { return mCaptureViews[ID]; }
 
+			void            SetResidencyCategory(TextureCategory category);
+
+			// Evictable once filled from files or a cache entry, and not while it is still streaming in
+			bool            GetCanEvict() const override;
+			void            Evict()             override;
+			bool            Reload()            override;
+
 		private:
-			static glm::mat4 mCaptureViews[];
+			// Where the contents came from, so an evicted texture can be rebuilt - anything drawn into it can not be
+			enum class ContentSource
+			{
+				None,
+				Files,
+				Cache
+			};
+
+			void                SetSourceFiles(const std::string filePaths[6]);
+			void                SetSourceCache(unsigned int key);
+
+			void                UpdateResidentSize(GLenum internalFormat, unsigned int levelCount);
+
+			// Returns the format the face was written in - GL_BGRA from a mapped BMP, GL_RGBA from stb_image - or zero on failure
+			static GLenum       DecodeFaceInto(const std::string& filePath, unsigned char* destination, int width, int height);
+			static unsigned int GetStreamedRowStride(int width);
+
+			// False if any face is not an uncompressed BMP, or they differ in size, in which case nothing has been uploaded
+			bool                LoadInMappedBMPs(std::string filePaths[6], TextureMinMagFilters minMagFilters, TextureWrappingSettings wrapSettings);
+
+			void                EndStreamedLoad();
+
+			static glm::mat4    mCaptureViews[];
 
 			unsigned int mTextureID;
 
 			unsigned int mWidth;
 			unsigned int mHeight;
 
+			CubeMapStreamedLoad* mStreamedLoad;
+
+			ContentSource           mSource;
+			std::string             mSourceFilePaths[6];
+			unsigned int            mSourceCacheKey;
+
+			TextureMinMagFilters    mMinMagFilters;
+			TextureWrappingSettings mWrapSettings;
+
+			GLenum                  mInternalFormat;
+			unsigned int            mLevelCount;
+
 			static ShaderPrograms::ShaderProgram* mConvolutionShader;
 			static ShaderPrograms::ShaderProgram* mRoughnessConvolutionShader;
 		};
@@ -0,0 +1,348 @@
+#include "VideoTexture.h"
+
+#include "Texture.h"
+
+#include "Rendering/Code/GLStateCache.h"
+#include "Rendering/Code/GLErrorChecking.h"
+
+#include <algorithm>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		// ----------------------------------------------------------------------------------------------------------
+
+		VideoTexture::RingSlot::RingSlot()
+			: mState(SlotState::Free)
+			, mSequence(0)
+			, mFence(nullptr)
+		{
+
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		VideoTexture::VideoTexture()
+			: mVideo()
+			, mTexture(nullptr)
+			, mRingBuffer(0)
+			, mMappedRing(nullptr)
+			, mStagingRing()
+			, mSlotSizeBytes(0)
+			, mSlots()
+			, mDecodeThread()
+			, mSlotLock()
+			, mSlotFreed()
+			, mStopDecoding(false)
+			, mLoop(true)
+			, mPlaybackTime(0.0)
+			, mDisplayedSequence(-1)
+			, mUploadedFrameCount(0)
+			, mSkippedFrameCount(0)
+			, mLateFrameCount(0)
+		{
+
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		VideoTexture::~VideoTexture()
+		{
+			Close();
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool VideoTexture::Open(const std::string& filePath, bool loop)
+		{
+			Close();
+
+			if (!mVideo.Open(filePath))
+				return false;
+
+			mTexture = new Texture2D();
+			mTexture->SetIsForVideo();
+			mTexture->SetResidencyCategory(TextureCategory::Video);
+
+			if (!mTexture->InitEmpty(mVideo.GetWidth(), mVideo.GetHeight(), true, GL_UNSIGNED_BYTE, GL_RGBA8, GL_RGBA, { GL_LINEAR, GL_LINEAR }, { GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE }))
+			{
+				Close();
+				return false;
+			}
+
+			mSlotSizeBytes = (size_t)mVideo.GetWidth() * (size_t)mVideo.GetHeight() * 4;
+
+			const GLsizeiptr ringSizeBytes = (GLsizeiptr)(mSlotSizeBytes * kRingSlotCount);
+
+			// Coherent, so a slot the worker has finished writing is visible to any upload issued after it, with no flush
+			if (GLAD_GL_VERSION_4_4 && glBufferStorage)
+			{
+				const GLbitfield mappingFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+				glGenBuffers(1, &mRingBuffer);
+
+				GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, mRingBuffer);
+
+				glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringSizeBytes, nullptr, mappingFlags);
+
+				mMappedRing = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringSizeBytes, mappingFlags);
+
+				GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+				if (!mMappedRing)
+				{
+					glDeleteBuffers(1, &mRingBuffer);
+					GLStateCache::OnBufferDeleted(mRingBuffer);
+
+					mRingBuffer = 0;
+				}
+			}
+
+			if (!mMappedRing)
+			{
+				mStagingRing.resize((size_t)ringSizeBytes);
+			}
+
+			GL_CHECK_ERROR("Error creating video pixel unpack ring");
+
+			mLoop         = loop;
+			mStopDecoding = false;
+
+			mDecodeThread = std::thread(&VideoTexture::DecodeLoop, this);
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void VideoTexture::Close()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mSlotLock);
+				mStopDecoding = true;
+			}
+
+			mSlotFreed.notify_all();
+
+			if (mDecodeThread.joinable())
+			{
+				mDecodeThread.join();
+			}
+
+			for (unsigned int i = 0; i < kRingSlotCount; i++)
+			{
+				if (mSlots[i].mFence)
+				{
+					glDeleteSync(mSlots[i].mFence);
+				}
+
+				mSlots[i] = RingSlot();
+			}
+
+			// Any upload still reading from the buffer keeps it alive on the GPU until it is done
+			if (mRingBuffer)
+			{
+				GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, mRingBuffer);
+				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+				glDeleteBuffers(1, &mRingBuffer);
+				GLStateCache::OnBufferDeleted(mRingBuffer);
+
+				mRingBuffer = 0;
+			}
+
+			mMappedRing = nullptr;
+
+			mStagingRing.clear();
+			mStagingRing.shrink_to_fit();
+
+			delete mTexture;
+			mTexture = nullptr;
+
+			mVideo.Close();
+
+			mSlotSizeBytes      = 0;
+			mPlaybackTime       = 0.0;
+			mDisplayedSequence  = -1;
+			mUploadedFrameCount = 0;
+			mSkippedFrameCount  = 0;
+			mLateFrameCount     = 0;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		unsigned int VideoTexture::GetTextureID() const
+		{
+			return mTexture ? mTexture->GetTextureID() : 0;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		unsigned char* VideoTexture::GetSlotPixels(unsigned int slot)
+		{
+			unsigned char* ring = mMappedRing ? mMappedRing : mStagingRing.data();
+
+			return ring + (mSlotSizeBytes * slot);
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void VideoTexture::DecodeLoop()
+		{
+			const unsigned int frameCount = mVideo.GetFrameCount();
+			const size_t       rowStride  = (size_t)mVideo.GetWidth() * 4;
+
+			unsigned long long sequence = 0;
+			unsigned int       slot     = 0;
+
+			// The slots are filled in order, so the one after the last written is always the oldest
+			while (mLoop || sequence < frameCount)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mSlotLock);
+
+					mSlotFreed.wait(lock, [this, slot]() { return mStopDecoding || mSlots[slot].mState == SlotState::Free; });
+
+					if (mStopDecoding)
+						return;
+
+					mSlots[slot].mState = SlotState::Decoding;
+				}
+
+				// Outside of the lock, the render thread never touches a slot in this state
+				mVideo.DecodeFrameRGBA((unsigned int)(sequence % frameCount), GetSlotPixels(slot), rowStride);
+
+				{
+					std::lock_guard<std::mutex> lock(mSlotLock);
+
+					mSlots[slot].mSequence = sequence;
+					mSlots[slot].mState    = SlotState::Ready;
+				}
+
+				sequence++;
+				slot = (slot + 1) % kRingSlotCount;
+			}
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void VideoTexture::Update(float deltaTime)
+		{
+			if (!mTexture)
+				return;
+
+			bool freedSlot = false;
+
+			{
+				std::lock_guard<std::mutex> lock(mSlotLock);
+
+				// A zero timeout only asks, it never waits on the GPU
+				for (unsigned int i = 0; i < kRingSlotCount; i++)
+				{
+					if (mSlots[i].mState != SlotState::InFlight)
+						continue;
+
+					GLenum fenceStatus = glClientWaitSync(mSlots[i].mFence, 0, 0);
+
+					if (fenceStatus == GL_ALREADY_SIGNALED || fenceStatus == GL_CONDITION_SATISFIED)
+					{
+						glDeleteSync(mSlots[i].mFence);
+
+						mSlots[i].mFence = nullptr;
+						mSlots[i].mState = SlotState::Free;
+
+						freedSlot = true;
+					}
+				}
+
+				// ----------
+
+				mPlaybackTime += (double)deltaTime;
+
+				long long dueSequence = (long long)(mPlaybackTime * (double)mVideo.GetFramesPerSecond());
+
+				if (!mLoop)
+				{
+					dueSequence = std::min(dueSequence, (long long)mVideo.GetFrameCount() - 1);
+				}
+
+				int newestDue = -1;
+
+				for (unsigned int i = 0; i < kRingSlotCount; i++)
+				{
+					if (mSlots[i].mState != SlotState::Ready || (long long)mSlots[i].mSequence > dueSequence)
+						continue;
+
+					if (newestDue < 0 || mSlots[i].mSequence > mSlots[newestDue].mSequence)
+					{
+						newestDue = (int)i;
+					}
+				}
+
+				if (newestDue < 0)
+				{
+					if (mDisplayedSequence < dueSequence)
+					{
+						mLateFrameCount++;
+					}
+				}
+				else
+				{
+					// Anything older than the frame going up was never shown and never reached the GPU, so is handed straight back
+					for (unsigned int i = 0; i < kRingSlotCount; i++)
+					{
+						if (mSlots[i].mState == SlotState::Ready && mSlots[i].mSequence < mSlots[newestDue].mSequence)
+						{
+							mSlots[i].mState = SlotState::Free;
+
+							mSkippedFrameCount++;
+							freedSlot = true;
+						}
+					}
+
+					// ----------
+
+					RingSlot& slot = mSlots[newestDue];
+
+					// RGBA8 rows are always a multiple of four bytes, so the default unpack alignment is left as it is
+					GLStateCache::BindTextureForUpdate(0, GL_TEXTURE_2D, mTexture->GetTextureID());
+
+					if (mMappedRing)
+					{
+						// Sourced from the buffer, so this returns once the copy is queued rather than once it has happened
+						GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, mRingBuffer);
+
+						glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mVideo.GetWidth(), mVideo.GetHeight(), GL_RGBA, GL_UNSIGNED_BYTE, (const void*)(mSlotSizeBytes * (size_t)newestDue));
+
+						GLStateCache::BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+						slot.mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+						slot.mState = SlotState::InFlight;
+					}
+					else
+					{
+						// Client memory has been copied by the time the call returns
+						glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mVideo.GetWidth(), mVideo.GetHeight(), GL_RGBA, GL_UNSIGNED_BYTE, GetSlotPixels((unsigned int)newestDue));
+
+						slot.mState = SlotState::Free;
+						freedSlot   = true;
+					}
+
+					GL_CHECK_ERROR("Error uploading video frame");
+
+					mDisplayedSequence = (long long)slot.mSequence;
+					mUploadedFrameCount++;
+				}
+			}
+
+			if (freedSlot)
+			{
+				mSlotFreed.notify_all();
+			}
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+	}
+}
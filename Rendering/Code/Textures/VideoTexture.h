@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Y4MVideo.h"
+
+#include <glad/glad.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		// ---------------------------------------------------
+
+		class Texture2D;
+
+		// ---------------------------------------------------
+
+		// Plays a Y4M file into a Texture2D without the render thread ever waiting on it
+		// A worker decodes frames ahead into a ring of pixel unpack slots, all in one buffer that stays mapped for its whole life,
+		// and the render thread only issues the copy from a ready slot into the texture plus a fence to say when the slot is free again
+		// Everything is allocated when the video is opened, so playing it allocates nothing per frame
+		// Rows are top first, so the image wants sampling with flipV in VideoVertexShader.vert
+		class VideoTexture final
+		{
+		public:
+			// One being copied into the texture, one being decoded, and two decoded ahead to absorb a slow frame
+			static const unsigned int kRingSlotCount = 4;
+
+			VideoTexture();
+			~VideoTexture();
+
+			// Starts the decode worker straight away, so the first frame is usually ready before the next Update
+			bool         Open(const std::string& filePath, bool loop = true);
+			void         Close();
+
+			bool         GetIsOpen() const { return mTexture != nullptr; }
+
+			// Called once a frame on the render thread - frees the slots the GPU has finished copying from, then uploads the newest
+			// frame that is due, skipping any the worker decoded that are already out of date
+			void         Update(float deltaTime);
+
+			Texture2D*   GetTexture()   const { return mTexture; }
+			unsigned int GetTextureID() const;
+
+			int          GetWidth()     const { return mVideo.GetWidth();  }
+			int          GetHeight()    const { return mVideo.GetHeight(); }
+
+			// Without buffer storage the slots are plain memory the upload reads from instead, which costs the driver a copy
+			bool         GetIsPersistentlyMapped() const { return mMappedRing != nullptr; }
+
+			unsigned int GetUploadedFrameCount() const { return mUploadedFrameCount; }
+			unsigned int GetSkippedFrameCount()  const { return mSkippedFrameCount;  }
+			unsigned int GetLateFrameCount()     const { return mLateFrameCount;     }
+
+		private:
+			VideoTexture(const VideoTexture&)            = delete;
+			VideoTexture& operator=(const VideoTexture&) = delete;
+
+			enum class SlotState
+			{
+				Free,     // Waiting for the worker
+				Decoding, // The worker is writing into it
+				Ready,    // Holds a whole frame the render thread has not used yet
+				InFlight  // Copied from by a texture upload the fence has not signalled for
+			};
+
+			struct RingSlot
+			{
+				RingSlot();
+
+				SlotState          mState;
+				unsigned long long mSequence; // Counts up through every loop, so that the frame order survives wrapping
+				GLsync             mFence;
+			};
+
+			void           DecodeLoop();
+			unsigned char* GetSlotPixels(unsigned int slot);
+
+			Y4MVideo                   mVideo;
+			Texture2D*                 mTexture;
+
+			unsigned int               mRingBuffer;
+			unsigned char*             mMappedRing;
+			std::vector<unsigned char> mStagingRing;
+			size_t                     mSlotSizeBytes;
+
+			RingSlot                   mSlots[kRingSlotCount];
+
+			std::thread                mDecodeThread;
+			std::mutex                 mSlotLock;
+			std::condition_variable    mSlotFreed;
+			bool                       mStopDecoding;
+			bool                       mLoop;
+
+			double                     mPlaybackTime;
+			long long                  mDisplayedSequence;
+
+			unsigned int               mUploadedFrameCount;
+			unsigned int               mSkippedFrameCount;
+			unsigned int               mLateFrameCount;
+		};
+
+		// ---------------------------------------------------
+	}
+}
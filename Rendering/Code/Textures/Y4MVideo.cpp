@@ -0,0 +1,267 @@
+#include "Y4MVideo.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		// ----------------------------------------------------------------------------------------------------------
+
+		static const char   kStreamMagic[] = "YUV4MPEG2 ";
+		static const char   kFrameMagic[]  = "FRAME";
+
+		// Neither line is ever close to this long, so anything longer is not a stream this can read
+		static const size_t kMaxLineLength = 1024;
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		// Offset of the next '\n' at or after start, or zero if there is none within kMaxLineLength
+		static size_t FindLineEnd(const unsigned char* data, size_t sizeBytes, size_t start)
+		{
+			size_t end = std::min(sizeBytes, start + kMaxLineLength);
+
+			for (size_t i = start; i < end; i++)
+			{
+				if (data[i] == '\n')
+					return i;
+			}
+
+			return 0;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		static unsigned char ClampToByte(int value)
+		{
+			return (unsigned char)(value < 0 ? 0 : (value > 255 ? 255 : value));
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		Y4MVideo::Y4MVideo()
+			: mFile()
+			, mFrameOffsets()
+			, mWidth(0)
+			, mHeight(0)
+			, mChromaShiftX(1)
+			, mChromaShiftY(1)
+			, mMonochrome(false)
+			, mFramesPerSecond(0.0f)
+		{
+
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		Y4MVideo::~Y4MVideo()
+		{
+			Close();
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool Y4MVideo::Open(const std::string& filePath)
+		{
+			Close();
+
+			if (!mFile.Open(filePath))
+				return false;
+
+			const unsigned char* data      = mFile.GetData();
+			size_t               sizeBytes = mFile.GetSizeBytes();
+
+			const size_t magicLength = sizeof(kStreamMagic) - 1;
+
+			if (sizeBytes < magicLength || std::memcmp(data, kStreamMagic, magicLength) != 0)
+			{
+				Close();
+				return false;
+			}
+
+			size_t headerEnd = FindLineEnd(data, sizeBytes, magicLength);
+
+			if (headerEnd == 0)
+			{
+				Close();
+				return false;
+			}
+
+			// ----------
+
+			// Space separated parameters, each named by its first character - 4:2:0 with JPEG siting is the default when C is left out
+			std::string header((const char*)data + magicLength, headerEnd - magicLength);
+			std::string colourSpace = "420jpeg";
+
+			int frameRateNumerator   = 25;
+			int frameRateDenominator = 1;
+
+			size_t tokenStart = 0;
+
+			while (tokenStart < header.size())
+			{
+				size_t tokenEnd = header.find(' ', tokenStart);
+
+				if (tokenEnd == std::string::npos)
+					tokenEnd = header.size();
+
+				std::string token = header.substr(tokenStart, tokenEnd - tokenStart);
+
+				if (!token.empty())
+				{
+					std::string value = token.substr(1);
+
+					switch (token[0])
+					{
+					case 'W':
+						mWidth = std::atoi(value.c_str());
+					break;
+
+					case 'H':
+						mHeight = std::atoi(value.c_str());
+					break;
+
+					case 'F':
+						frameRateNumerator   = std::atoi(value.c_str());
+						frameRateDenominator = value.find(':') != std::string::npos ? std::atoi(value.c_str() + value.find(':') + 1) : 1;
+					break;
+
+					case 'C':
+						colourSpace = value;
+					break;
+
+					default:
+					break;
+					}
+				}
+
+				tokenStart = tokenEnd + 1;
+			}
+
+			if (colourSpace == "420jpeg" || colourSpace == "420paldv" || colourSpace == "420mpeg2" || colourSpace == "420")
+			{
+				mChromaShiftX = 1;
+				mChromaShiftY = 1;
+			}
+			else if (colourSpace == "422")
+			{
+				mChromaShiftX = 1;
+				mChromaShiftY = 0;
+			}
+			else if (colourSpace == "444")
+			{
+				mChromaShiftX = 0;
+				mChromaShiftY = 0;
+			}
+			else if (colourSpace == "mono")
+			{
+				mMonochrome = true;
+			}
+			else
+			{
+				// Higher bit depths and alpha channels
+				Close();
+				return false;
+			}
+
+			if (mWidth <= 0 || mHeight <= 0 || frameRateNumerator <= 0 || frameRateDenominator <= 0)
+			{
+				Close();
+				return false;
+			}
+
+			mFramesPerSecond = (float)frameRateNumerator / (float)frameRateDenominator;
+
+			// ----------
+
+			const size_t lumaSize   = (size_t)mWidth * (size_t)mHeight;
+			const size_t chromaSize = mMonochrome ? 0 : (size_t)((mWidth + (1 << mChromaShiftX) - 1) >> mChromaShiftX) * (size_t)((mHeight + (1 << mChromaShiftY) - 1) >> mChromaShiftY);
+			const size_t frameSize  = lumaSize + (chromaSize * 2);
+
+			const size_t frameMagicLength = sizeof(kFrameMagic) - 1;
+
+			// Every frame has its own header line, which may carry parameters, so the offsets can not simply be worked out
+			size_t offset = headerEnd + 1;
+
+			while (offset + frameMagicLength <= sizeBytes && std::memcmp(data + offset, kFrameMagic, frameMagicLength) == 0)
+			{
+				size_t frameHeaderEnd = FindLineEnd(data, sizeBytes, offset + frameMagicLength);
+
+				// A truncated last frame is dropped rather than read past the end of the mapping
+				if (frameHeaderEnd == 0 || frameHeaderEnd + 1 + frameSize > sizeBytes)
+					break;
+
+				mFrameOffsets.push_back(frameHeaderEnd + 1);
+
+				offset = frameHeaderEnd + 1 + frameSize;
+			}
+
+			if (mFrameOffsets.empty())
+			{
+				Close();
+				return false;
+			}
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		void Y4MVideo::Close()
+		{
+			mFile.Close();
+
+			mFrameOffsets.clear();
+
+			mWidth           = 0;
+			mHeight          = 0;
+			mChromaShiftX    = 1;
+			mChromaShiftY    = 1;
+			mMonochrome      = false;
+			mFramesPerSecond = 0.0f;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+
+		bool Y4MVideo::DecodeFrameRGBA(unsigned int frame, unsigned char* destination, size_t rowStride) const
+		{
+			if (frame >= mFrameOffsets.size() || !destination)
+				return false;
+
+			const int chromaWidth  = (mWidth  + (1 << mChromaShiftX) - 1) >> mChromaShiftX;
+			const int chromaHeight = (mHeight + (1 << mChromaShiftY) - 1) >> mChromaShiftY;
+
+			const unsigned char* lumaPlane    = mFile.GetData() + mFrameOffsets[frame];
+			const unsigned char* chromaBPlane = lumaPlane    + ((size_t)mWidth * (size_t)mHeight);
+			const unsigned char* chromaRPlane = chromaBPlane + ((size_t)chromaWidth * (size_t)chromaHeight);
+
+			for (int y = 0; y < mHeight; y++)
+			{
+				const unsigned char* luma    = lumaPlane + ((size_t)y * (size_t)mWidth);
+				const unsigned char* chromaB = chromaBPlane + ((size_t)(y >> mChromaShiftY) * (size_t)chromaWidth);
+				const unsigned char* chromaR = chromaRPlane + ((size_t)(y >> mChromaShiftY) * (size_t)chromaWidth);
+
+				unsigned char* output = destination + ((size_t)y * rowStride);
+
+				for (int x = 0; x < mWidth; x++, output += 4)
+				{
+					// Fixed point in 1/256ths, the usual integer form of the BT.601 studio swing matrix
+					const int scaledLuma = 298 * ((int)luma[x] - 16);
+					const int blue       = mMonochrome ? 0 : (int)chromaB[x >> mChromaShiftX] - 128;
+					const int red        = mMonochrome ? 0 : (int)chromaR[x >> mChromaShiftX] - 128;
+
+					output[0] = ClampToByte((scaledLuma + (409 * red) + 128) >> 8);
+					output[1] = ClampToByte((scaledLuma - (100 * blue) - (208 * red) + 128) >> 8);
+					output[2] = ClampToByte((scaledLuma + (516 * blue) + 128) >> 8);
+					output[3] = 255;
+				}
+			}
+
+			return true;
+		}
+
+		// ----------------------------------------------------------------------------------------------------------
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Maths/Code/MemoryMappedFile.h"
+
+#include <vector>
+#include <string>
+
+namespace Rendering
+{
+	namespace Texture
+	{
+		// ---------------------------------------------------
+
+		// Uncompressed YUV4MPEG2 video read straight from a file mapping, as written by ffmpeg with -f yuv4mpegpipe
+		// Only 8 bit 4:2:0, 4:2:2, 4:4:4 and mono are understood - nothing here touches GL, so frames can be decoded on any thread
+		class Y4MVideo final
+		{
+		public:
+			Y4MVideo();
+			~Y4MVideo();
+
+			// Reads the stream header and finds where every frame starts - false if the file is not a Y4M stream this can read
+			bool         Open(const std::string& filePath);
+			void         Close();
+
+			bool         GetIsOpen()          const { return !mFrameOffsets.empty(); }
+
+			int          GetWidth()           const { return mWidth;  }
+			int          GetHeight()          const { return mHeight; }
+			unsigned int GetFrameCount()      const { return (unsigned int)mFrameOffsets.size(); }
+			float        GetFramesPerSecond() const { return mFramesPerSecond; }
+
+			// Converts a frame to RGBA8 with the BT.601 limited range matrix, rows top first and rowStride bytes apart
+			bool         DecodeFrameRGBA(unsigned int frame, unsigned char* destination, size_t rowStride) const;
+
+		private:
+			Y4MVideo(const Y4MVideo&)            = delete;
+			Y4MVideo& operator=(const Y4MVideo&) = delete;
+
+			Engine::MemoryMappedFile mFile;
+
+			std::vector<size_t>      mFrameOffsets; // To the Y plane of each frame, past its FRAME line
+
+			int                      mWidth;
+			int                      mHeight;
+
+			// Each chroma sample covers 1 << shift luma texels across and down
+			int                      mChromaShiftX;
+			int                      mChromaShiftY;
+			bool                     mMonochrome;
+
+			float                    mFramesPerSecond;
+		};
+
+		// ---------------------------------------------------
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// CPU side mirrors of the std140 uniform blocks shared between shaders
+// Every member is a vec4 or mat4 so the C++ layout matches std140 without any manual padding rules
+// Any change here needs making to the matching block declarations in the shaders as well
+
+#include <glm/matrix.hpp>
+
+namespace Rendering
+{
+	// ---------------------------------------
+
+	// Fixed binding points - each shader declares its blocks with layout(std140, binding = N) using these values
+	enum class UniformBlockBindings : unsigned int
+	{
+		PerFrameCamera   = 0,
+		PerFrameLighting = 1,
+		WaterMaterial    = 2,
+
+		Count
+	};
+
+	// ---------------------------------------
+
+	// Written once per frame by the render pipeline
+	struct PerFrameCameraBlock
+	{
+		glm::mat4 mViewMat;
+		glm::mat4 mProjectionMat;
+		glm::mat4 mViewProjectionMat;
+
+		glm::vec4 mCameraPosition;  // w unused
+		glm::vec4 mViewport;        // width, height, near, far
+	};
+
+	// Written once per frame by the water simulation
+	struct PerFrameLightingBlock
+	{
+		glm::vec4 mDirectionalLightDirection; // w unused
+		glm::vec4 mAmbientColour;             // w unused
+
+		// The sky's irradiance from IrradianceSH9, rgb with w unused - each takes a whole vec4 under std140 anyway
+		glm::vec4 mIrradianceSH[9];
+	};
+
+	// Written once per frame by the water simulation
+	struct WaterMaterialBlock
+	{
+		glm::vec4 mWaterColour;               // w = reflection proportion
+
+		// x = 1 when the sine wave normals are in world space rather than tangent space
+		// y = 1 when there is a prefiltered sky to reflect, z = the level of it to sample, w unused
+		glm::vec4 mFlags;
+	};
+
+	// ---------------------------------------
+}
@@ -7,8 +7,16 @@
 #include "Textures/Texture.h"
 #include "Shaders/ShaderProgram.h"
 #include "Shaders/Shader.h"
+#include "Shaders/ShaderProgramBatch.h"
+#include "Shaders/ComputeKernel.h"
 
 #include "Buffers.h"
+#include "GridMesh.h"
+#include "WaterPatchCulling.h"
+#include "WaterFarField.h"
+#include "GLStateCache.h"
+#include "RenderCommandQueue.h"
+#include "MemoryBarrierTracker.h"
 
 #include "Maths/Code/Matrix.h"
 #include "Camera.h"
@@ -18,11 +26,66 @@
 
 #include <GLFW/glfw3.h>
 #include <random>
+#include <future>
+#include <algorithm>
+#include <cmath>
 
 namespace Rendering
 {
 	// ---------------------------------------------
 
+	static void DeclareImageAccess(Texture::Texture2D* texture, GPUResourceAccess access)
+	{
+		MemoryBarrierTracker::Access(GPUResourceType::Texture, texture->GetTextureID(), access);
+	}
+
+	// ---------------------------------------------
+
+	// Stands in for the wave count when a kernel is using its generic program
+	static const unsigned int kGenericWaveKernel = 0xFFFFFFFF;
+
+	// Only asks the kernel for a variant when the wave count or the setting has changed, as every request builds the variant's key
+	static void SpecialiseWaveKernel(ShaderPrograms::ComputeKernel* kernel, bool specialise, unsigned int waveCount, unsigned int& specialisedWaveCount)
+	{
+		unsigned int wantedWaveCount = specialise ? waveCount : kGenericWaveKernel;
+
+		if (specialisedWaveCount == wantedWaveCount)
+			return;
+
+		Shaders::ShaderDefines defines;
+
+		if (specialise)
+			defines.Set("WAVE_COUNT", (int)waveCount);
+
+		if (kernel->Specialise(defines))
+			specialisedWaveCount = wantedWaveCount;
+	}
+
+	// ---------------------------------------------
+
+	static const float kPi = 3.14159265359f;
+
+	// CPU copy of PhillipsSpectrum() in GenerateH0_Tessendorf.comp, so the two must be kept in step
+	static float PhillipsSpectrum(float kx, float kz, const TessendorfWaveData& data)
+	{
+		float kSquared   = std::max((kx * kx) + (kz * kz), 0.001f);
+		float kToTheFour = kSquared * kSquared;
+
+		float windSpeed  = std::max(std::sqrt((data.mWindVelocity.x * data.mWindVelocity.x) + (data.mWindVelocity.y * data.mWindVelocity.y)), 0.01f);
+		float L          = (windSpeed * windSpeed) / data.mGravity;
+
+		// normalize(k) in the shader, where the zero vector gives no alignment with the wind
+		float kLength    = std::sqrt((kx * kx) + (kz * kz));
+		float alignment  = kLength > 0.0f ? std::abs(((kx * data.mWindVelocity.x) + (kz * data.mWindVelocity.y)) / (kLength * windSpeed)) : 0.0f;
+
+		float exponentialFactor = std::exp(-1.0f / (kSquared * L * L)) / kToTheFour;
+		float convergenceFactor = std::exp(-kSquared * std::pow(data.mLxLz.x / 2000.0f, 2.0f));
+
+		return std::clamp(data.mPhilipsConstant * exponentialFactor * alignment * alignment * convergenceFactor, -4000.0f, 4000.0f);
+	}
+
+	// ---------------------------------------------
+
 	WaterSimulation::WaterSimulation()
 		: mModellingApproach(SimulationMethods::Sine)
 
@@ -35,6 +98,7 @@ namespace Rendering
 		, mGenerateH0_ComputeShader(nullptr)
 		, mCreateFrequencyValues_ComputeShader(nullptr)
 		, mConvertToHeightValues_ComputeShader_FFT(nullptr)
+		, mGenerateButterflyFFTData(nullptr)
 		, mFFTFinalStageProgram(nullptr)
 
 		, mPositionalBuffer(nullptr)
@@ -53,6 +117,10 @@ namespace Rendering
 		, mGersnterWaveData()
 		, mGerstnerWaveSSBO()
 
+		, mSpecialiseWaveKernels(true)
+		, mSpecialisedSineWaveCount(kGenericWaveKernel)
+		, mSpecialisedGerstnerWaveCount(kGenericWaveKernel)
+
 		, mLevelOfDetailCount(0)
 		, mUsingLODs(true)
 
@@ -67,29 +135,68 @@ namespace Rendering
 		, mWaterEBO(nullptr)
 
 		, mSurfaceRenderShaders(nullptr)
+		, mPerFrameLightingUBO(nullptr)
+		, mWaterMaterialUBO(nullptr)
 
 		, mVertexCount(0)
 		, mElementCount(0)
 
+		, mIndexBatches()
+		, mVertexCacheStatistics()
+
+		, mPatchCulling(nullptr)
+		, mUseGPUCulling(true)
+		, mVerifyGPUCulling(false)
+		, mGPUVisiblePatchCount(0)
+		, mTessendorfHeightDeviation(0.0f)
+
+		, mFarField(nullptr)
+		, mUseFarField(true)
+		, mFarFieldPixelThreshold(0.5f)
+		, mFarFieldSwitchDistance(0.0f)
+		, mFirstFarFieldRing(1)
+		, mLastDisplacedRing(0)
+		, mSlopeMipMapsOutOfDate(true)
+
+		, mTessellatedSurfaceShaders(nullptr)
+		, mTessellationVAO(nullptr)
+		, mTessellationVBO(nullptr)
+		, mTessellationEBO(nullptr)
+		, mTessellationIndexCount(0)
+		, mUseTessellation(false)
+		, mTessellationTargetEdgePixels(8.0f)
+		, mMaxTessellationLevel(64)
+
 		, mRenderingData()
+		, mSkyIrradiance()
+		, mSkyReflection(nullptr)
 
 		, mSimulationPaused(false)
 		, mWireframe(false)
 
 		, mRunningTime(0.0f)
-		, mMemoryBarrierBlockBits(GL_ALL_BARRIER_BITS)
 		, mScaleFactor(6.25f)
 
-		, kComputeShaderThreadClusterSize(16)
+		, kTessellationBaseGridCells(64)
 	{
+		// Neither of these touch GL, so they run on other threads while the render thread waits on the shader compiles
+		GridMesh gridMesh;
+
+		std::future<void>                            gridMeshGeneration = std::async(std::launch::async, [this, &gridMesh]() { gridMesh.Create(mDimensions, mDistanceBetweenVerticies); });
+		std::future<Maths::Vector::Vector4D<float>*> noiseGeneration    = std::async(std::launch::async, [this]() { return GenerateGaussianData(); });
+
 		// Compute and final render shaders
 		SetupShaders();
 
 		// VBO and VAO
-		SetupBuffers();
+		gridMeshGeneration.wait();
+		SetupBuffers(gridMesh);
 
 		// Storage textures
-		SetupTextures();
+		SetupTextures(noiseGeneration.get());
+
+		// Needs every texture and buffer the passes use, and leaves the images with throwaway contents that the passes below replace
+		TuneComputeKernels();
 
 		GenerateH0();
 	}
@@ -103,6 +210,9 @@ namespace Rendering
 		delete mSurfaceRenderShaders;
 		mSurfaceRenderShaders = nullptr;
 
+		delete mTessellatedSurfaceShaders;
+		mTessellatedSurfaceShaders = nullptr;
+
 		// --------------------------------------
 
 		delete mWaterMovementComputeShader_Sine;
@@ -125,14 +235,38 @@ namespace Rendering
 		delete mFFTFinalStageProgram;
 		mFFTFinalStageProgram = nullptr;
 
+		delete mGenerateButterflyFFTData;
+		mGenerateButterflyFFTData = nullptr;
+
 		// --------------------------------------
 
+		delete mPatchCulling;
+		mPatchCulling = nullptr;
+
+		delete mFarField;
+		mFarField = nullptr;
+
 		delete mWaterVAO;
 		mWaterVAO = nullptr;
 
 		delete mWaterVBO;
 		mWaterVBO = nullptr;
 
+		delete mTessellationVAO;
+		mTessellationVAO = nullptr;
+
+		delete mTessellationVBO;
+		mTessellationVBO = nullptr;
+
+		delete mTessellationEBO;
+		mTessellationEBO = nullptr;
+
+		delete mPerFrameLightingUBO;
+		mPerFrameLightingUBO = nullptr;
+
+		delete mWaterMaterialUBO;
+		mWaterMaterialUBO = nullptr;
+
 		// --------------------------------------
 
 		delete mPositionalBuffer;
@@ -174,171 +308,167 @@ namespace Rendering
 		if (!mH0Buffer || !mGenerateH0_ComputeShader || !mRandomNumberBuffer)
 			return;
 
-		mGenerateH0_ComputeShader->UseProgram();
+		ShaderPrograms::ShaderProgram* program = mGenerateH0_ComputeShader->GetProgram();
+
+		program->UseProgram();
 			mH0Buffer          ->BindForComputeShader(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
 			mRandomNumberBuffer->BindForComputeShader(1, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
 
-			mGenerateH0_ComputeShader->SetVec2("windVelocity", mTessendorfData.mWindVelocity);
-			mGenerateH0_ComputeShader->SetFloat("gravity",          mTessendorfData.mGravity);
-			mGenerateH0_ComputeShader->SetFloat("phillipsConstant", mTessendorfData.mPhilipsConstant);
-			mGenerateH0_ComputeShader->SetVec2("LxLz",              mTessendorfData.mLxLz);
+			program->SetVec2("windVelocity", mTessendorfData.mWindVelocity);
+			program->SetFloat("gravity",          mTessendorfData.mGravity);
+			program->SetFloat("phillipsConstant", mTessendorfData.mPhilipsConstant);
+			program->SetVec2("LxLz",              mTessendorfData.mLxLz);
 
-			glDispatchCompute(mTextureResolution / kComputeShaderThreadClusterSize, mTextureResolution / kComputeShaderThreadClusterSize, 1);
-	}
+			DeclareImageAccess(mRandomNumberBuffer, GPUResourceAccess::ImageLoad);
+			DeclareImageAccess(mH0Buffer,           GPUResourceAccess::ImageStore);
+			MemoryBarrierTracker::IssueBarriers();
 
-	// ---------------------------------------------
+			mGenerateH0_ComputeShader->Dispatch(mTextureResolution, mTextureResolution);
 
-	void WaterSimulation::SetupShaders()
-	{
-		// --------------------------------------------------------------
+		// Each h~(k) carries P(k) of expected energy, so the inverse FFT's heights have a deviation of sqrt(sum P) / N^2 before the final scale
+		double spectrumEnergy = 0.0;
 
-		if (!mSurfaceRenderShaders)
+		for (unsigned int y = 0; y < mTextureResolution; y++)
 		{
-			mSurfaceRenderShaders = new ShaderPrograms::ShaderProgram();
-
-			Shaders::VertexShader*   vertexShader   = new Shaders::VertexShader("Code/Shaders/Vertex/WaterSurface.vert");
-			Shaders::FragmentShader* fragmentShader = new Shaders::FragmentShader("Code/Shaders/Fragment/WaterSurface.frag");
-
-			mSurfaceRenderShaders->AttachShader(vertexShader);
-			mSurfaceRenderShaders->AttachShader(fragmentShader);
+			for (unsigned int x = 0; x < mTextureResolution; x++)
+			{
+				// Same centred n, m and k as the compute shader
+				float n = (float)x - (mTextureResolution / 2.0f);
+				float m = (float)y - (mTextureResolution / 2.0f);
 
-				mSurfaceRenderShaders->LinkShadersToProgram();
+				spectrumEnergy += PhillipsSpectrum((2.0f * kPi * n) / mTessendorfData.mLxLz.x, (2.0f * kPi * m) / mTessendorfData.mLxLz.y, mTessendorfData);
+			}
+		}
 
-			mSurfaceRenderShaders->DetachShader(vertexShader);
-			mSurfaceRenderShaders->DetachShader(fragmentShader);
+		mTessendorfHeightDeviation = (float)(std::sqrt(spectrumEnergy) / ((double)mTextureResolution * mTextureResolution));
+	}
 
-			delete vertexShader;
-			delete fragmentShader;
+	// ---------------------------------------------
 
-			mSurfaceRenderShaders->UseProgram();
-				mSurfaceRenderShaders->SetInt("positionalBuffer", 0);
-				mSurfaceRenderShaders->SetInt("normalBuffer",     1);
-				mSurfaceRenderShaders->SetInt("tangentBuffer",    2);
-				mSurfaceRenderShaders->SetInt("binormalBuffer",   3);
+	void WaterSimulation::TuneComputeKernels()
+	{
+		if (!mH0Buffer || !mFourierDomainValues || !mButterflyTexture || !mPositionalBuffer || !mSecondPositionalBuffer)
+			return;
 
-				mSurfaceRenderShaders->SetVec3("ambientColour", { 0.7765f, 0.902f, 0.9255f });
-		}
+		// In pipeline order, so each pass is timed reading what the real pass before it would have written
+		mGenerateH0_ComputeShader           ->Tune([this]() { GenerateH0(); });
+		mWaterMovementComputeShader_Sine    ->Tune([this]() { UpdateSineSurface(); });
+		mWaterMovementComputeShader_Gerstner->Tune([this]() { UpdateGerstnerSurface(); });
+		mCreateFrequencyValues_ComputeShader->Tune([this]() { UpdateTessendorfFrequencies(); });
 
-		// --------------------------------------------------------------
+		// Both run inside the inverse FFT, but each kernel only times its own dispatches
+		mConvertToHeightValues_ComputeShader_FFT->Tune([this]() { RunInverseFFT(); });
+		mFFTFinalStageProgram                   ->Tune([this]() { RunInverseFFT(); });
+	}
 
-		if(!mWaterMovementComputeShader_Sine)
-		{
-			mWaterMovementComputeShader_Sine = new ShaderPrograms::ShaderProgram();
+	// ---------------------------------------------
 
-			Shaders::ComputeShader* computeShader = new Shaders::ComputeShader("Code/Shaders/Compute/SurfaceUpdate_Sine.comp");
+	void WaterSimulation::SetupShaders()
+	{
+		// Every program is submitted before any of them are waited on, so the driver can compile them side by side
+		ShaderPrograms::ShaderProgramBatch programBatch;
 
-			mWaterMovementComputeShader_Sine->AttachShader(computeShader);
+		// --------------------------------------------------------------
 
-				mWaterMovementComputeShader_Sine->LinkShadersToProgram();
+		bool newSurfaceShaders     = !mSurfaceRenderShaders;
+		bool newTessellatedShaders = !mTessellatedSurfaceShaders;
 
-			mWaterMovementComputeShader_Sine->DetachShader(computeShader);
+		if (newSurfaceShaders)
+		{
+			mSurfaceRenderShaders = new ShaderPrograms::ShaderProgram();
 
-			delete computeShader;
+			programBatch.Add(mSurfaceRenderShaders, { new Shaders::VertexShader("Code/Shaders/Vertex/WaterSurface.vert"),
+			                                          new Shaders::FragmentShader("Code/Shaders/Fragment/WaterSurface.frag") });
 		}
 
-		if(!mWaterMovementComputeShader_Gerstner)
+		if (newTessellatedShaders)
 		{
-			mWaterMovementComputeShader_Gerstner = new ShaderPrograms::ShaderProgram();
+			mTessellatedSurfaceShaders = new ShaderPrograms::ShaderProgram();
 
-			Shaders::ComputeShader* computeShader = new Shaders::ComputeShader("Code/Shaders/Compute/SurfaceUpdate_Gerstner.comp");
-
-			mWaterMovementComputeShader_Gerstner->AttachShader(computeShader);
+			programBatch.Add(mTessellatedSurfaceShaders, { new Shaders::VertexShader("Code/Shaders/Vertex/WaterSurface_Tessellated.vert"),
+			                                               new Shaders::TessellationControlShader("Code/Shaders/Tessellation/WaterSurface.tesc"),
+			                                               new Shaders::TessellationEvaluationShader("Code/Shaders/Tessellation/WaterSurface.tese"),
+			                                               new Shaders::FragmentShader("Code/Shaders/Fragment/WaterSurface.frag") });
+		}
 
-				mWaterMovementComputeShader_Gerstner->LinkShadersToProgram();
+		// --------------------------------------------------------------
 
-			mWaterMovementComputeShader_Gerstner->DetachShader(computeShader);
+		if(!mWaterMovementComputeShader_Sine)
+		{
+			mWaterMovementComputeShader_Sine = new ShaderPrograms::ComputeKernel("Code/Shaders/Compute/SurfaceUpdate_Sine.comp");
 
-			delete computeShader;
+			mWaterMovementComputeShader_Sine->AddToBatch(programBatch);
 		}
 
-		if (!mGenerateH0_ComputeShader)
+		if(!mWaterMovementComputeShader_Gerstner)
 		{
-			mGenerateH0_ComputeShader = new ShaderPrograms::ShaderProgram();
+			mWaterMovementComputeShader_Gerstner = new ShaderPrograms::ComputeKernel("Code/Shaders/Compute/SurfaceUpdate_Gerstner.comp");
 
-			Shaders::ComputeShader* computeShader = new Shaders::ComputeShader("Code/Shaders/Compute/GenerateH0_Tessendorf.comp");
-
-			mGenerateH0_ComputeShader->AttachShader(computeShader);
-
-				mGenerateH0_ComputeShader->LinkShadersToProgram();
-
-			mGenerateH0_ComputeShader->DetachShader(computeShader);
-
-			delete computeShader;
+			mWaterMovementComputeShader_Gerstner->AddToBatch(programBatch);
 		}
 
 		if (!mGenerateH0_ComputeShader)
 		{
-			mGenerateH0_ComputeShader = new ShaderPrograms::ShaderProgram();
-
-			Shaders::ComputeShader* computeShader = new Shaders::ComputeShader("Code/Shaders/Compute/GenerateH0_Tessendorf.comp");
-
-			mGenerateH0_ComputeShader->AttachShader(computeShader);
+			mGenerateH0_ComputeShader = new ShaderPrograms::ComputeKernel("Code/Shaders/Compute/GenerateH0_Tessendorf.comp");
 
-				mGenerateH0_ComputeShader->LinkShadersToProgram();
-
-			mGenerateH0_ComputeShader->DetachShader(computeShader);
-
-			delete computeShader;
+			mGenerateH0_ComputeShader->AddToBatch(programBatch);
 		}
 
 		if (!mCreateFrequencyValues_ComputeShader)
 		{
-			mCreateFrequencyValues_ComputeShader = new ShaderPrograms::ShaderProgram();
-
-			Shaders::ComputeShader* computeShader = new Shaders::ComputeShader("Code/Shaders/Compute/GenerateHeight_Tessendorf.comp");
-
-			mCreateFrequencyValues_ComputeShader->AttachShader(computeShader);
-
-				mCreateFrequencyValues_ComputeShader->LinkShadersToProgram();
-
-			mCreateFrequencyValues_ComputeShader->DetachShader(computeShader);
+			mCreateFrequencyValues_ComputeShader = new ShaderPrograms::ComputeKernel("Code/Shaders/Compute/GenerateHeight_Tessendorf.comp");
 
-			delete computeShader;
+			mCreateFrequencyValues_ComputeShader->AddToBatch(programBatch);
 		}
 
 		if (!mConvertToHeightValues_ComputeShader_FFT)
 		{
-			mConvertToHeightValues_ComputeShader_FFT = new ShaderPrograms::ShaderProgram();
+			mConvertToHeightValues_ComputeShader_FFT = new ShaderPrograms::ComputeKernel("Code/Shaders/Compute/ConvertFrequencyToWorldHeight.comp");
 
-			Shaders::ComputeShader* computeShader = new Shaders::ComputeShader("Code/Shaders/Compute/ConvertFrequencyToWorldHeight.comp");
-
-			mConvertToHeightValues_ComputeShader_FFT->AttachShader(computeShader);
-
-				mConvertToHeightValues_ComputeShader_FFT->LinkShadersToProgram();
-
-			mConvertToHeightValues_ComputeShader_FFT->DetachShader(computeShader);
-
-			delete computeShader;
+			mConvertToHeightValues_ComputeShader_FFT->AddToBatch(programBatch);
 		}
 
 		if (!mGenerateButterflyFFTData)
 		{
-			mGenerateButterflyFFTData = new ShaderPrograms::ShaderProgram();
-
-			Shaders::ComputeShader* computeShader = new Shaders::ComputeShader("Code/Shaders/Compute/GenerateButterflyTexture.comp");
-
-			mGenerateButterflyFFTData->AttachShader(computeShader);
+			// Only run when the resolution changes, so it keeps the size it was written for rather than being tuned
+			mGenerateButterflyFFTData = new ShaderPrograms::ComputeKernel("Code/Shaders/Compute/GenerateButterflyTexture.comp", { 1, 16 });
 
-				mGenerateButterflyFFTData->LinkShadersToProgram();
-
-			mGenerateButterflyFFTData->DetachShader(computeShader);
-
-			delete computeShader;
+			mGenerateButterflyFFTData->AddToBatch(programBatch);
 		}
 
 		if (!mFFTFinalStageProgram)
 		{
-			mFFTFinalStageProgram = new ShaderPrograms::ShaderProgram();
+			mFFTFinalStageProgram = new ShaderPrograms::ComputeKernel("Code/Shaders/Compute/InvertAndScaleFFTResult.comp");
 
-			Shaders::ComputeShader* computeShader = new Shaders::ComputeShader("Code/Shaders/Compute/InvertAndScaleFFTResult.comp");
+			mFFTFinalStageProgram->AddToBatch(programBatch);
+		}
 
-			mFFTFinalStageProgram->AttachShader(computeShader);
+		// --------------------------------------------------------------
 
-				mFFTFinalStageProgram->LinkShadersToProgram();
+		programBatch.LinkAll();
 
-			mFFTFinalStageProgram->DetachShader(computeShader);
+		// Uniforms can only be set once the programs have finished linking
+		if (newSurfaceShaders)
+		{
+			mSurfaceRenderShaders->UseProgram();
+				mSurfaceRenderShaders->SetInt("positionalBuffer", 0);
+				mSurfaceRenderShaders->SetInt("normalBuffer",     1);
+				mSurfaceRenderShaders->SetInt("tangentBuffer",    2);
+				mSurfaceRenderShaders->SetInt("binormalBuffer",   3);
+				mSurfaceRenderShaders->SetInt("skyReflection",    4);
+		}
 
-			delete computeShader;
+		if (newTessellatedShaders)
+		{
+			mTessellatedSurfaceShaders->UseProgram();
+				mTessellatedSurfaceShaders->SetInt("positionalBuffer", 0);
+				mTessellatedSurfaceShaders->SetInt("normalBuffer",     1);
+				mTessellatedSurfaceShaders->SetInt("tangentBuffer",    2);
+				mTessellatedSurfaceShaders->SetInt("binormalBuffer",   3);
+				mTessellatedSurfaceShaders->SetInt("skyReflection",    4);
+
+			// The subdivision level of a single edge can not go above what the driver supports
+			glGetIntegerv(GL_MAX_TESS_GEN_LEVEL, &mMaxTessellationLevel);
 		}
 
 		mModellingApproach = SimulationMethods::Sine;
@@ -348,15 +478,16 @@ namespace Rendering
 
 	// ---------------------------------------------
 
-	void WaterSimulation::SetupBuffers()
+	void WaterSimulation::SetupBuffers(GridMesh& gridMesh)
 	{
+		// Generated in parallel, or mapped straight from the mesh cache if this grid has been built before
 		if (!mWaterVBO)
 		{
 			mWaterVBO = new Buffers::VertexBufferObject();
 
-			Maths::Vector::Vector2D<float>* vertexData = GenerateVertexData(mDimensions, mDistanceBetweenVerticies);
+			mVertexCount = gridMesh.GetVertexCount();
 
-			mWaterVBO->SetBufferData((void*)vertexData, mVertexCount * sizeof(Maths::Vector::Vector2D<float>), GL_STATIC_DRAW);
+			mWaterVBO->SetBufferData((void*)gridMesh.GetVertexData(), gridMesh.GetVertexDataBytes(), GL_STATIC_DRAW);
 
 			// ----------------
 
@@ -371,22 +502,28 @@ namespace Rendering
 					mSurfaceRenderShaders->SetFloat("maxDistanceFromOrigin", startingDistanceFromCentre);
 			}
 
-			// ----------------
-
-			delete[] vertexData;
+			if (mTessellatedSurfaceShaders)
+			{
+				mTessellatedSurfaceShaders->UseProgram();
+					mTessellatedSurfaceShaders->SetFloat("maxDistanceFromOrigin", startingDistanceFromCentre);
+			}
 		}
 
 		if (!mWaterEBO)
 		{
 			mWaterEBO = new Buffers::ElementBufferObjects();
 
-			unsigned int* elementData = GenerateElementData(mDimensions);
+			// Split into 16 bit batches and re-ordered for the post-transform cache, as every vertex invocation samples the positional buffer
+			mIndexBatches = gridMesh.GetBatches();
+			mElementCount = gridMesh.GetIndexCount();
 
-			mWaterEBO->SetBufferData(mElementCount * sizeof(unsigned int), elementData, GL_STATIC_DRAW);
+			mWaterEBO->SetBufferData(gridMesh.GetIndexDataBytes(), gridMesh.GetIndexData(), GL_STATIC_DRAW);
 
-			delete[] elementData;
+			mVertexCacheStatistics = MeshOptimisation::AnalyseVertexCache(gridMesh.GetIndexData(), mIndexBatches, MeshOptimisation::kDefaultPostTransformCacheSize);
 		}
 
+		gridMesh.Release();
+
 		if (!mWaterVAO)
 		{
 			mWaterVAO = new Buffers::VertexArrayObject();
@@ -403,6 +540,40 @@ namespace Rendering
 			mWaterVBO->UnBind();
 		}
 
+		if (!mPatchCulling)
+		{
+			mPatchCulling = new WaterPatchCulling();
+
+			mPatchCulling->BuildPatches(mIndexBatches, mDimensions, mDistanceBetweenVerticies, mLevelOfDetailCount);
+
+			// Per-patch transform, picked by each draw's base instance
+			mPatchCulling->SetupInstanceAttribute(mWaterVAO, 1);
+		}
+
+		if (!mFarField)
+		{
+			mFarField = new WaterFarField();
+
+			mFarField->Setup(mDimensions, mDistanceBetweenVerticies);
+		}
+
+		SetupTessellationBuffers();
+
+		// Nothing else binds to these points, so they only need attaching once
+		if (!mPerFrameLightingUBO)
+		{
+			mPerFrameLightingUBO = new Buffers::UniformBufferObject();
+			mPerFrameLightingUBO->AllocateMemory(sizeof(PerFrameLightingBlock), GL_DYNAMIC_DRAW);
+			mPerFrameLightingUBO->BindToBufferIndex((unsigned int)UniformBlockBindings::PerFrameLighting);
+		}
+
+		if (!mWaterMaterialUBO)
+		{
+			mWaterMaterialUBO = new Buffers::UniformBufferObject();
+			mWaterMaterialUBO->AllocateMemory(sizeof(WaterMaterialBlock), GL_DYNAMIC_DRAW);
+			mWaterMaterialUBO->BindToBufferIndex((unsigned int)UniformBlockBindings::WaterMaterial);
+		}
+
 		if (!mSineWaveSSBO)
 		{
 			mSineWaveSSBO = new Buffers::ShaderStorageBufferObject();
@@ -420,6 +591,67 @@ namespace Rendering
 
 	// ---------------------------------------------
 
+	void WaterSimulation::SetupTessellationBuffers()
+	{
+		if (mTessellationVAO)
+			return;
+
+		// A unit square centred on the origin, stretched over the whole ocean in the vertex shader
+		// Kept small so that every patch is well under the maximum tessellation level once subdivided
+		const unsigned int verticiesPerRow = kTessellationBaseGridCells + 1;
+
+		std::vector<float> vertexData((size_t)verticiesPerRow * verticiesPerRow * 2);
+		GridMesh::GenerateVertexData(kTessellationBaseGridCells, 1.0f / (float)kTessellationBaseGridCells, vertexData.data());
+
+		// One four point patch per cell - rows run towards -Z, so (x + 1) is +U and (row + 1) is +V
+		std::vector<unsigned short> indexData;
+		indexData.reserve((size_t)kTessellationBaseGridCells * kTessellationBaseGridCells * 4);
+
+		for (unsigned int row = 0; row < kTessellationBaseGridCells; row++)
+		{
+			for (unsigned int x = 0; x < kTessellationBaseGridCells; x++)
+			{
+				unsigned short current = (unsigned short)((row * verticiesPerRow) + x);
+				unsigned short below   = (unsigned short)(current + verticiesPerRow);
+
+				indexData.push_back(current);
+				indexData.push_back(current + 1);
+				indexData.push_back(below   + 1);
+				indexData.push_back(below);
+			}
+		}
+
+		mTessellationIndexCount = (unsigned int)indexData.size();
+
+		mTessellationVBO = new Buffers::VertexBufferObject();
+		mTessellationVBO->SetBufferData(vertexData.data(), (unsigned int)(vertexData.size() * sizeof(float)), GL_STATIC_DRAW);
+
+		mTessellationEBO = new Buffers::ElementBufferObjects();
+		mTessellationEBO->SetBufferData((unsigned int)(indexData.size() * sizeof(unsigned short)), indexData.data(), GL_STATIC_DRAW);
+
+		mTessellationVAO = new Buffers::VertexArrayObject();
+
+		mTessellationVAO->Bind();
+		mTessellationVBO->Bind();
+		mTessellationEBO->Bind();
+
+		mTessellationVAO->EnableVertexAttribArray(0);
+		mTessellationVAO->SetVertexAttributePointers(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GL_FLOAT), 0, true);
+
+		mTessellationVAO->Unbind();
+		mTessellationVBO->UnBind();
+	}
+
+	// ---------------------------------------------
+
+	float WaterSimulation::GetTessellatedSurfaceExtent()
+	{
+		// The outermost LOD ring is three tiles wide, with each tile three times the size of the ring inside it
+		return mHighestLODDimensions * 2.0f * std::pow(3.0f, (float)(mLevelOfDetailCount + 1));
+	}
+
+	// ---------------------------------------------
+
 	void WaterSimulation::UpdateSineWaveDataSet()
 	{
 		         int waveCount   = (int)mSineWaveData.size();
@@ -458,7 +690,45 @@ namespace Rendering
 
 	// ---------------------------------------------
 
-	void WaterSimulation::SetupTextures()
+	float WaterSimulation::GetMaximumDisplacement()
+	{
+		float displacement = 0.0f;
+
+		switch (mModellingApproach)
+		{
+		case SimulationMethods::Sine:
+			// Sine waves only move the surface vertically
+			for (unsigned int i = 0; i < mSineWaveData.size(); i++)
+			{
+				displacement += std::abs(mSineWaveData[i].mAmplitude);
+			}
+		break;
+
+		case SimulationMethods::Gerstner:
+			// Horizontal movement is steepness * amplitude, vertical is amplitude
+			for (unsigned int i = 0; i < mGersnterWaveData.size(); i++)
+			{
+				displacement += std::abs(mGersnterWaveData[i].mAmplitude) * std::max(1.0f, std::abs(mGersnterWaveData[i].mSteepness));
+			}
+		break;
+
+		case SimulationMethods::Tessendorf:
+		{
+			// The heights are gaussian, and the largest of N^2 samples stays within sqrt(2 ln N^2) deviations.
+			// The final stage only writes heights, so there is no horizontal (choppy) displacement to add
+			float sampleCount = (float)mTextureResolution * mTextureResolution;
+
+			displacement = mTessendorfHeightDeviation * std::abs(mScaleFactor) * std::sqrt(2.0f * std::log(sampleCount));
+		}
+		break;
+		}
+
+		return displacement;
+	}
+
+	// ---------------------------------------------
+
+	void WaterSimulation::SetupTextures(Maths::Vector::Vector4D<float>* randomNumberData)
 	{
 		if (!mPositionalBuffer)
 		{
@@ -474,25 +744,29 @@ namespace Rendering
 			mSecondPositionalBuffer->InitEmpty(mTextureResolution, mTextureResolution, true, GL_FLOAT, GL_RGBA32F, GL_RGBA, { GL_LINEAR, GL_NEAREST }, {});
 		}
 
+		// The slope buffers are mip-mapped so that the far field gets filtered slopes rather than a sparkle of aliased normals
 		if (!mNormalBuffer)
 		{
 			mNormalBuffer = new Texture::Texture2D();
 
-			mNormalBuffer->InitEmpty(mTextureResolution, mTextureResolution, true, GL_FLOAT, GL_RGBA32F, GL_RGBA);
+			mNormalBuffer->InitEmpty(mTextureResolution, mTextureResolution, true, GL_FLOAT, GL_RGBA32F, GL_RGBA, { GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR }, {});
+			mNormalBuffer->GenerateMipMaps();
 		}
 
 		if (!mTangentBuffer)
 		{
 			mTangentBuffer = new Texture::Texture2D();
 
-			mTangentBuffer->InitEmpty(mTextureResolution, mTextureResolution, true, GL_FLOAT, GL_RGBA32F, GL_RGBA);
+			mTangentBuffer->InitEmpty(mTextureResolution, mTextureResolution, true, GL_FLOAT, GL_RGBA32F, GL_RGBA, { GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR }, {});
+			mTangentBuffer->GenerateMipMaps();
 		}
 
 		if (!mBiNormalBuffer)
 		{
 			mBiNormalBuffer = new Texture::Texture2D();
 
-			mBiNormalBuffer->InitEmpty(mTextureResolution, mTextureResolution, true, GL_FLOAT, GL_RGBA32F, GL_RGBA);
+			mBiNormalBuffer->InitEmpty(mTextureResolution, mTextureResolution, true, GL_FLOAT, GL_RGBA32F, GL_RGBA, { GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR }, {});
+			mBiNormalBuffer->GenerateMipMaps();
 		}
 
 		if (!mH0Buffer)
@@ -513,14 +787,69 @@ namespace Rendering
 		{
 			mRandomNumberBuffer = new Texture::Texture2D();
 
-			Maths::Vector::Vector4D<float>* randomNumberData = GenerateGaussianData();
-
 			mRandomNumberBuffer->InitWithData(mTextureResolution, mTextureResolution, randomNumberData, true, GL_FLOAT, GL_RGBA32F, GL_RGBA);
-
-			delete[] randomNumberData;
 		}
 
+		delete[] randomNumberData;
+
 		CreateButterflyTexture();
+
+		// Rewritten by the simulation every frame, so never worth evicting however long since they were last sampled
+		Texture::Texture2D* simulationTextures[] = { mPositionalBuffer, mSecondPositionalBuffer, mNormalBuffer, mTangentBuffer, mBiNormalBuffer, mH0Buffer, mFourierDomainValues, mRandomNumberBuffer, mButterflyTexture };
+
+		for (Texture::Texture2D* texture : simulationTextures)
+		{
+			texture->SetResidencyCategory(TextureCategory::Simulation);
+		}
+	}
+
+	// ---------------------------------------------
+
+	void WaterSimulation::GenerateSlopeMipMaps()
+	{
+		if (!mSlopeMipMapsOutOfDate)
+			return;
+
+		mNormalBuffer  ->GenerateMipMaps();
+		mTangentBuffer ->GenerateMipMaps();
+		mBiNormalBuffer->GenerateMipMaps();
+
+		mSlopeMipMapsOutOfDate = false;
+	}
+
+	// ---------------------------------------------
+
+	void WaterSimulation::UpdateFarFieldSplit(Rendering::Camera* camera, const glm::mat4& projectionMat, float displacementBound)
+	{
+		Maths::Vector::Vector3D<float> cameraPosition = camera->GetPosition();
+
+		float viewportHeight = (float)Window::GetWindowHeight();
+
+		mFarFieldSwitchDistance = WaterFarField::CalculateSwitchDistance(projectionMat, viewportHeight, displacementBound, mFarFieldPixelThreshold);
+
+		if (mUseFarField && mFarField)
+		{
+			mFirstFarFieldRing = WaterFarField::CalculateFirstFarFieldRing({ cameraPosition.x, cameraPosition.y, cameraPosition.z }, projectionMat, viewportHeight, displacementBound, mFarFieldPixelThreshold, mHighestLODDimensions, mLevelOfDetailCount);
+		}
+		else
+		{
+			mFirstFarFieldRing = mLevelOfDetailCount + 1;
+		}
+
+		// Far rings are left out of the culling pass entirely, so none of their patches reach the indirect draw
+		int lastDisplacedRing = mFirstFarFieldRing - 1;
+
+		if (mPatchCulling && lastDisplacedRing != mLastDisplacedRing)
+		{
+			mPatchCulling->BuildPatches(mIndexBatches, mDimensions, mDistanceBetweenVerticies, lastDisplacedRing);
+
+			mLastDisplacedRing = lastDisplacedRing;
+		}
+
+		if (mFarField)
+		{
+			mFarField->SetRingRange(mFirstFarFieldRing, mLevelOfDetailCount);
+		}
 	}
 
 	// ---------------------------------------------
@@ -543,14 +872,19 @@ namespace Rendering
 
 		delete[] bitReversedIndicies;
 
-		mGenerateButterflyFFTData->UseProgram();
-			mButterflyTexture        ->BindForComputeShader(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		ShaderPrograms::ShaderProgram* program = mGenerateButterflyFFTData->GetProgram();
 
-			mGenerateButterflyFFTData->SetInt("N", (int)mTextureResolution);
+		program->UseProgram();
+			mButterflyTexture->BindForComputeShader(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+			program->SetInt("N", (int)mTextureResolution);
 
 			indexDataBuffer->BindToBufferIndex(1);
 
-			glDispatchCompute((unsigned int)std::log2(mTextureResolution), mTextureResolution / kComputeShaderThreadClusterSize, 1);
+			DeclareImageAccess(mButterflyTexture, GPUResourceAccess::ImageStore);
+			MemoryBarrierTracker::IssueBarriers();
+
+			mGenerateButterflyFFTData->Dispatch((unsigned int)std::log2(mTextureResolution), mTextureResolution);
 	}
 
 	// ---------------------------------------------
@@ -609,22 +943,16 @@ namespace Rendering
 				if (ImGui::Button("Sine Waves"))
 				{
 					mModellingApproach = SimulationMethods::Sine;
-
-					mSurfaceRenderShaders->SetBool("renderingSineGeneration", true);
 				}
 
 				if (ImGui::Button("Gerstner Waves"))
 				{
 					mModellingApproach = SimulationMethods::Gerstner;
-
-					mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 				}
 
 				if (ImGui::Button("Ocean simulation"))
 				{
 					mModellingApproach = SimulationMethods::Tessendorf;
-
-					mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 				}
 			}
 
@@ -633,6 +961,57 @@ namespace Rendering
 			{
 				if (mLevelOfDetailCount < 0)
 					mLevelOfDetailCount = 0;
+
+				if (mPatchCulling)
+					mPatchCulling->BuildPatches(mIndexBatches, mDimensions, mDistanceBetweenVerticies, mLevelOfDetailCount);
+
+				mLastDisplacedRing = mLevelOfDetailCount;
+			}
+
+			if (ImGui::CollapsingHeader("Far field") && mFarField)
+			{
+				ImGui::Checkbox("Flat normal mapped far field", &mUseFarField);
+
+				ImGui::DragFloat("Switch threshold (pixels)", &mFarFieldPixelThreshold, 0.01f, 0.05f, 8.0f);
+
+				ImGui::Text("Switch distance: %.1f",    mFarFieldSwitchDistance);
+				ImGui::Text("First flat ring: %d",      mFirstFarFieldRing);
+				ImGui::Text("Flat tiles: %u",           mFarField->GetTileCount());
+				ImGui::Text("Triangles per flat tile: %u", mFarField->GetTriangleCountPerTile());
+			}
+
+			if (ImGui::CollapsingHeader("Tessellation") && mTessellatedSurfaceShaders)
+			{
+				ImGui::Checkbox("Hardware tessellation", &mUseTessellation);
+
+				ImGui::DragFloat("Target edge length (pixels)", &mTessellationTargetEdgePixels, 0.1f, 1.0f, 64.0f);
+
+				ImGui::Text("Base patches: %u",          mTessellationIndexCount / 4);
+				ImGui::Text("Max tessellation level: %d", mMaxTessellationLevel);
+				ImGui::Text("Surface extent: %.1f",       GetTessellatedSurfaceExtent());
+			}
+
+			if (ImGui::CollapsingHeader("Culling") && mPatchCulling)
+			{
+				ImGui::Checkbox("GPU culling (multi-draw indirect)", &mUseGPUCulling);
+				ImGui::Checkbox("Compare GPU result with CPU (stalls)", &mVerifyGPUCulling);
+
+				ImGui::Text("Patches: %u",                mPatchCulling->GetPatchCount());
+				ImGui::Text("Displacement bound: %.2f",   GetMaximumDisplacement());
+				ImGui::Text("Indirect count path: %s",    mPatchCulling->GetUsingIndirectCount() ? "glMultiDrawElementsIndirectCount" : "glMultiDrawElementsIndirect");
+
+				if (mUseGPUCulling)
+				{
+					if (mVerifyGPUCulling)
+					{
+						ImGui::Text("Visible (GPU): %u", mGPUVisiblePatchCount);
+						ImGui::Text("Visible (CPU): %u", mPatchCulling->GetCPUVisibleCount());
+					}
+				}
+				else
+				{
+					ImGui::Text("Visible (CPU): %u", mPatchCulling->GetCPUVisibleCount());
+				}
 			}
 
 			if (ImGui::DragFloat3("Directional light direction", &mRenderingData.mLightDirection.x, 0.01f, -1.0f, 1.0f))
@@ -644,8 +1023,48 @@ namespace Rendering
 			ImGui::DragFloat3("Water colour", &mRenderingData.mWaterColour.x, 0.001f, 0.0f, 2.0f);
 
 			ImGui::DragFloat("Reflection Proportion", &mRenderingData.mReflectionFactor, 0.001f, 0.0f, 1.0f);
+			ImGui::DragFloat("Reflection Roughness",  &mRenderingData.mReflectionRoughness, 0.001f, 0.0f, 1.0f);
 
 			ImGui::DragFloat3("Ambient colour", &mRenderingData.mAmbientColour.x, 0.001f, 0.0f, 1.0f);
+
+			if (ImGui::CollapsingHeader("Compute workgroup sizes"))
+			{
+				ImGui::Checkbox("Specialise wave kernels on wave count", &mSpecialiseWaveKernels);
+
+				const char*                          kernelNames[] = { "Sine", "Gerstner", "H0", "Frequencies", "FFT pass", "FFT invert", "Butterfly" };
+				const ShaderPrograms::ComputeKernel* kernels[]     = { mWaterMovementComputeShader_Sine, mWaterMovementComputeShader_Gerstner, mGenerateH0_ComputeShader,
+				                                                       mCreateFrequencyValues_ComputeShader, mConvertToHeightValues_ComputeShader_FFT, mFFTFinalStageProgram,
+				                                                       mGenerateButterflyFFTData };
+
+				for (unsigned int i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+				{
+					if (!kernels[i])
+						continue;
+
+					const ShaderPrograms::WorkgroupSize& size = kernels[i]->GetWorkgroupSize();
+
+					// Sizes loaded from a previous run were not timed this time round
+					if (kernels[i]->GetTunedTimeMs() > 0.0f)
+						ImGui::Text("%s: %ux%u (%.3f ms)", kernelNames[i], size.mX, size.mY, kernels[i]->GetTunedTimeMs());
+					else
+						ImGui::Text("%s: %ux%u", kernelNames[i], size.mX, size.mY);
+
+					if (kernels[i]->GetSpecialisationCount() > 0)
+					{
+						ImGui::SameLine();
+						ImGui::Text("- %u variants, %s", kernels[i]->GetSpecialisationCount(), kernels[i]->GetIsSpecialised() ? "specialised" : "generic");
+					}
+				}
+			}
+
+			if (ImGui::CollapsingHeader("Surface mesh"))
+			{
+				ImGui::Text("Verticies: %u",      mVertexCount);
+				ImGui::Text("Triangles: %u",      mVertexCacheStatistics.mTriangleCount);
+				ImGui::Text("16 bit batches: %u", (unsigned int)mIndexBatches.size());
+				ImGui::Text("ACMR: %.3f",         mVertexCacheStatistics.mAverageCacheMissRatio);
+				ImGui::Text("ATVR: %.3f",         mVertexCacheStatistics.mAverageTransformToVertexRatio);
+			}
 		ImGui::End();
 
 		
@@ -707,22 +1126,16 @@ namespace Rendering
 					if (ImGui::Button("Calm##sine"))
 					{
 						SetPreset(Rendering::SimulationMethods::Sine, (char)SineWavePresets::Calm);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", true);
 					}
 
 					if (ImGui::Button("Choppy##sine"))
 					{
 						SetPreset(Rendering::SimulationMethods::Sine, (char)SineWavePresets::Chopppy);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", true);
 					}
 
 					if (ImGui::Button("Strange##sine"))
 					{
 						SetPreset(Rendering::SimulationMethods::Sine, (char)SineWavePresets::Strange);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", true);
 					}
 				}
 			}
@@ -785,22 +1198,16 @@ namespace Rendering
 					if (ImGui::Button("Calm##Gerstner"))
 					{
 						SetPreset(Rendering::SimulationMethods::Gerstner, (char)GerstnerWavePresets::Calm);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 					}
 
 					if (ImGui::Button("Choppy##Gerstner"))
 					{
 						SetPreset(Rendering::SimulationMethods::Gerstner, (char)GerstnerWavePresets::Chopppy);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 					}
 
 					if (ImGui::Button("Strange##Gerstner"))
 					{
 						SetPreset(Rendering::SimulationMethods::Gerstner, (char)GerstnerWavePresets::Strange);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 					}
 				}
 			}
@@ -811,36 +1218,26 @@ namespace Rendering
 					if (ImGui::Button("Calm1##Tessendorf"))
 					{
 						SetPreset(Rendering::SimulationMethods::Tessendorf, (char)TessendorfWavePresets::Calm1);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 					}
 
 					if (ImGui::Button("Calm2##Tessendorf"))
 					{
 						SetPreset(Rendering::SimulationMethods::Tessendorf, (char)TessendorfWavePresets::Calm2);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 					}
 
 					if (ImGui::Button("Calm3##Tessendorf"))
 					{
 						SetPreset(Rendering::SimulationMethods::Tessendorf, (char)TessendorfWavePresets::Calm3);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 					}
 
 					if (ImGui::Button("Choppy1##Tessendorf"))
 					{
 						SetPreset(Rendering::SimulationMethods::Tessendorf, (char)TessendorfWavePresets::Chopppy1);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 					}
 
 					if (ImGui::Button("Choppy2##Tessendorf"))
 					{
 						SetPreset(Rendering::SimulationMethods::Tessendorf, (char)TessendorfWavePresets::Chopppy2);
-
-						mSurfaceRenderShaders->SetBool("renderingSineGeneration", false);
 					}
 				}
 
@@ -856,7 +1253,11 @@ namespace Rendering
 						GenerateH0();
 					}
 
-					ImGui::InputFloat("Gravity##Tessendorf", &mTessendorfData.mGravity);
+					if (ImGui::InputFloat("Gravity##Tessendorf", &mTessendorfData.mGravity))
+					{
+						GenerateH0();
+					}
+
 					ImGui::InputFloat("Repeat After Time##Tessendorf", &mTessendorfData.mRepeatAfterTime);
 
 					if (ImGui::InputFloat2("LxLz", &mTessendorfData.mLxLz.x))
@@ -883,315 +1284,387 @@ namespace Rendering
 		switch(mModellingApproach)
 		{
 			case SimulationMethods::Sine:
+				UpdateSineSurface();
+			break;
 
-				glMemoryBarrier(mMemoryBarrierBlockBits);
+			case SimulationMethods::Gerstner:
+				UpdateGerstnerSurface();
+			break;
 
-				mWaterMovementComputeShader_Sine->UseProgram();
+			case SimulationMethods::Tessendorf:
+				UpdateTessendorfFrequencies();
 
-				mWaterMovementComputeShader_Sine->SetFloat("time", mRunningTime);
-			
-				if(mSineWaveSSBO)
-					mSineWaveSSBO->BindToBufferIndex(5);
+				RunInverseFFT();
+			break;
+		}
 
-				mWaterMovementComputeShader_Sine->SetInt("waveCount", (int)mSineWaveData.size());
+		mSlopeMipMapsOutOfDate = true;
+	}
 
-				mPositionalBuffer->BindForComputeShader(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-				mNormalBuffer    ->BindForComputeShader(1, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-				mTangentBuffer   ->BindForComputeShader(2, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-				mBiNormalBuffer  ->BindForComputeShader(3, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+	// ---------------------------------------------
 
-				glDispatchCompute(mTextureResolution / kComputeShaderThreadClusterSize, mTextureResolution / kComputeShaderThreadClusterSize, 1);
-			break;
+	void WaterSimulation::UpdateSineSurface()
+	{
+		SpecialiseWaveKernel(mWaterMovementComputeShader_Sine, mSpecialiseWaveKernels, (unsigned int)mSineWaveData.size(), mSpecialisedSineWaveCount);
 
-			case SimulationMethods::Gerstner:
+		ShaderPrograms::ShaderProgram* program = mWaterMovementComputeShader_Sine->GetProgram();
 
-				glMemoryBarrier(mMemoryBarrierBlockBits);
+		program->UseProgram();
 
-				mWaterMovementComputeShader_Gerstner->UseProgram();
+		program->SetFloat("time", mRunningTime);
 
-				if (mGerstnerWaveSSBO)
-					mGerstnerWaveSSBO->BindToBufferIndex(5);
+		if(mSineWaveSSBO)
+			mSineWaveSSBO->BindToBufferIndex(5);
 
-				mWaterMovementComputeShader_Gerstner->SetFloat("time", mRunningTime);
-				mWaterMovementComputeShader_Gerstner->SetInt("waveCount", (int)mGersnterWaveData.size());
+		program->SetInt("waveCount", (int)mSineWaveData.size());
 
-				mPositionalBuffer->BindForComputeShader(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-				mNormalBuffer    ->BindForComputeShader(1, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-				mTangentBuffer   ->BindForComputeShader(2, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-				mBiNormalBuffer  ->BindForComputeShader(3, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		mPositionalBuffer->BindForComputeShader(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		mNormalBuffer    ->BindForComputeShader(1, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		mTangentBuffer   ->BindForComputeShader(2, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		mBiNormalBuffer  ->BindForComputeShader(3, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
 
-				glDispatchCompute(mTextureResolution / kComputeShaderThreadClusterSize, mTextureResolution / kComputeShaderThreadClusterSize, 1);
+		DeclareSurfaceWrites(mPositionalBuffer);
 
-			break;
+		mWaterMovementComputeShader_Sine->Dispatch(mTextureResolution, mTextureResolution);
+	}
 
-			case SimulationMethods::Tessendorf:
+	// ---------------------------------------------
 
-				// Generate the frequency values
-				mCreateFrequencyValues_ComputeShader->UseProgram();
+	void WaterSimulation::UpdateGerstnerSurface()
+	{
+		SpecialiseWaveKernel(mWaterMovementComputeShader_Gerstner, mSpecialiseWaveKernels, (unsigned int)mGersnterWaveData.size(), mSpecialisedGerstnerWaveCount);
 
-					mCreateFrequencyValues_ComputeShader->SetFloat("time",            mRunningTime);
-					mCreateFrequencyValues_ComputeShader->SetFloat("gravity",         mTessendorfData.mGravity);
-					mCreateFrequencyValues_ComputeShader->SetFloat("repeatAfterTime", mTessendorfData.mRepeatAfterTime);
-					mCreateFrequencyValues_ComputeShader->SetVec2("LxLz",             mTessendorfData.mLxLz);
+		ShaderPrograms::ShaderProgram* program = mWaterMovementComputeShader_Gerstner->GetProgram();
 
-					mFourierDomainValues->BindForComputeShader(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F); // Output fourier domain values
-					mNormalBuffer       ->BindForComputeShader(1, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F); // Normals
-					mTangentBuffer      ->BindForComputeShader(2, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F); // Tangent
-					mBiNormalBuffer     ->BindForComputeShader(3, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F); // Binormals
-					 
-					mH0Buffer           ->BindForComputeShader(4, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);  // H0 values created at startup
+		program->UseProgram();
 
-				glDispatchCompute(mTextureResolution / kComputeShaderThreadClusterSize, mTextureResolution / kComputeShaderThreadClusterSize, 1);
+		if (mGerstnerWaveSSBO)
+			mGerstnerWaveSSBO->BindToBufferIndex(5);
 
-				RunInverseFFT();
-				
-			break;
-		}
+		program->SetFloat("time", mRunningTime);
+		program->SetInt("waveCount", (int)mGersnterWaveData.size());
+
+		mPositionalBuffer->BindForComputeShader(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		mNormalBuffer    ->BindForComputeShader(1, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		mTangentBuffer   ->BindForComputeShader(2, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+		mBiNormalBuffer  ->BindForComputeShader(3, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
 
-		glMemoryBarrier(0);
+		DeclareSurfaceWrites(mPositionalBuffer);
+
+		mWaterMovementComputeShader_Gerstner->Dispatch(mTextureResolution, mTextureResolution);
 	}
 
+	// ---------------------------------------------
+
+	void WaterSimulation::UpdateTessendorfFrequencies()
+	{
+		ShaderPrograms::ShaderProgram* program = mCreateFrequencyValues_ComputeShader->GetProgram();
+
+		// Generate the frequency values
+		program->UseProgram();
+
+			program->SetFloat("time",            mRunningTime);
+			program->SetFloat("gravity",         mTessendorfData.mGravity);
+			program->SetFloat("repeatAfterTime", mTessendorfData.mRepeatAfterTime);
+			program->SetVec2("LxLz",             mTessendorfData.mLxLz);
+
+			mFourierDomainValues->BindForComputeShader(0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F); // Output fourier domain values
+			mNormalBuffer       ->BindForComputeShader(1, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F); // Normals
+			mTangentBuffer      ->BindForComputeShader(2, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F); // Tangent
+			mBiNormalBuffer     ->BindForComputeShader(3, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F); // Binormals
+					 
+			mH0Buffer           ->BindForComputeShader(4, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);  // H0 values created at startup
+
+			DeclareImageAccess(mH0Buffer, GPUResourceAccess::ImageLoad);
+			DeclareSurfaceWrites(mFourierDomainValues);
+
+		mCreateFrequencyValues_ComputeShader->Dispatch(mTextureResolution, mTextureResolution);
+	}
+
+	// ---------------------------------------------
+
 	void WaterSimulation::RunInverseFFT()
 	{
 		// Now convert to world space heights
 		// Determine how many passess are needed
 		int passCount = (int)std::log2(mTextureResolution);
 
-		mConvertToHeightValues_ComputeShader_FFT->UseProgram();
+		ShaderPrograms::ShaderProgram* fftProgram = mConvertToHeightValues_ComputeShader_FFT->GetProgram();
+
+		fftProgram->UseProgram();
 
 		mFourierDomainValues     ->BindForComputeShader(0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
 		mPositionalBuffer        ->BindForComputeShader(1, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
 		mSecondPositionalBuffer  ->BindForComputeShader(2, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
 		mButterflyTexture        ->BindForComputeShader(3, 0, GL_FALSE, 0, GL_READ_ONLY,  GL_RGBA32F);
 
-		mConvertToHeightValues_ComputeShader_FFT->SetBool("horizontal", true);
+		fftProgram->SetBool("horizontal", true);
 
 		bool storingResultInBuffer1 = true;
 
 		// Horizontal passes
 		for (int i = 0; i < passCount; i++)
 		{
-			glMemoryBarrier(mMemoryBarrierBlockBits);
+			DeclareFFTPassAccesses();
 
-			mConvertToHeightValues_ComputeShader_FFT->SetInt("passCount", i);
-			mConvertToHeightValues_ComputeShader_FFT->SetBool("storeDataInOutput1", storingResultInBuffer1);
+			fftProgram->SetInt("passCount", i);
+			fftProgram->SetBool("storeDataInOutput1", storingResultInBuffer1);
 
-			glDispatchCompute(mTextureResolution / kComputeShaderThreadClusterSize, mTextureResolution / kComputeShaderThreadClusterSize, 1);
+			mConvertToHeightValues_ComputeShader_FFT->Dispatch(mTextureResolution, mTextureResolution);
 
 			storingResultInBuffer1 = !storingResultInBuffer1;
 		}
 
-		mConvertToHeightValues_ComputeShader_FFT->SetBool("horizontal", false);
+		fftProgram->SetBool("horizontal", false);
 
 		// Vertical passes
 		for (int i = 0; i < passCount; i++)
 		{
-			glMemoryBarrier(mMemoryBarrierBlockBits);
+			DeclareFFTPassAccesses();
 
-			mConvertToHeightValues_ComputeShader_FFT->SetInt("passCount", i);
-			mConvertToHeightValues_ComputeShader_FFT->SetBool("storeDataInOutput1", storingResultInBuffer1);
+			fftProgram->SetInt("passCount", i);
+			fftProgram->SetBool("storeDataInOutput1", storingResultInBuffer1);
 
-			glDispatchCompute(mTextureResolution / kComputeShaderThreadClusterSize, mTextureResolution / kComputeShaderThreadClusterSize, 1);
+			mConvertToHeightValues_ComputeShader_FFT->Dispatch(mTextureResolution, mTextureResolution);
 			
 			if(i != passCount - 1)
 				storingResultInBuffer1 = !storingResultInBuffer1;
 		}
 
-		glMemoryBarrier(mMemoryBarrierBlockBits);
-
 		// Now apply the correct scale factor and positive/negative multipliers
-		mFFTFinalStageProgram->UseProgram();
-			mFFTFinalStageProgram->SetBool("readFromPositionBuffer1", storingResultInBuffer1);
+		ShaderPrograms::ShaderProgram* finalStageProgram = mFFTFinalStageProgram->GetProgram();
+
+		finalStageProgram->UseProgram();
+			finalStageProgram->SetBool("readFromPositionBuffer1", storingResultInBuffer1);
 
-			mFFTFinalStageProgram->SetFloat("scale", mScaleFactor);
+			finalStageProgram->SetFloat("scale", mScaleFactor);
 
 			mSecondPositionalBuffer->BindForComputeShader(0, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
 			mPositionalBuffer      ->BindForComputeShader(1, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
 
-		glDispatchCompute(mTextureResolution / kComputeShaderThreadClusterSize, mTextureResolution / kComputeShaderThreadClusterSize, 1);
+			MemoryBarrierTracker::ReadWriteImage(mSecondPositionalBuffer->GetTextureID());
+			MemoryBarrierTracker::ReadWriteImage(mPositionalBuffer->GetTextureID());
+			MemoryBarrierTracker::IssueBarriers();
 
-		glMemoryBarrier(mMemoryBarrierBlockBits);
+		mFFTFinalStageProgram->Dispatch(mTextureResolution, mTextureResolution);
 	}
 
 	// ---------------------------------------------
 
-	void WaterSimulation::Render(Rendering::Camera* camera, Texture::CubeMapTexture* skybox)
+	void WaterSimulation::DeclareFFTPassAccesses()
 	{
-		// Existance checks
-		if (!mWaterVAO || !mWaterVBO || !mPositionalBuffer || !mSecondPositionalBuffer || !mNormalBuffer || !mTangentBuffer || !mBiNormalBuffer || !mSurfaceRenderShaders)
-			return;
-
-		// Rendering of the surface is done through passing the positional texture into the vertex shader to create the final world position
-		// Then the fragment shader used information given to it from the other textures output by the compute shader
+		// Every pass reads the other pass's output and writes over what the pass before that read, so an image barrier is always needed
+		// between passes - but only that bit, and the Fourier input and butterfly texture only ever need it once after they are written
+		DeclareImageAccess(mFourierDomainValues, GPUResourceAccess::ImageLoad);
+		DeclareImageAccess(mButterflyTexture,    GPUResourceAccess::ImageLoad);
 
-		// Make sure the compute shader has finished before reading from the textures
-		glMemoryBarrier(mMemoryBarrierBlockBits);
+		MemoryBarrierTracker::ReadWriteImage(mPositionalBuffer->GetTextureID());
+		MemoryBarrierTracker::ReadWriteImage(mSecondPositionalBuffer->GetTextureID());
 
-		mWaterVAO->Bind();
+		MemoryBarrierTracker::IssueBarriers();
+	}
 
-		mSurfaceRenderShaders->UseProgram();
+	// ---------------------------------------------
 
-			OpenGLRenderPipeline* renderPipeline = ((OpenGLRenderPipeline*)Window::GetRenderPipeline());
+	void WaterSimulation::DeclareSurfaceWrites(Texture::Texture2D* firstOutput)
+	{
+		// The previous frame's draws only sampled these, which does not need a barrier before they are overwritten
+		DeclareImageAccess(firstOutput,     GPUResourceAccess::ImageStore);
+		DeclareImageAccess(mNormalBuffer,   GPUResourceAccess::ImageStore);
+		DeclareImageAccess(mTangentBuffer,  GPUResourceAccess::ImageStore);
+		DeclareImageAccess(mBiNormalBuffer, GPUResourceAccess::ImageStore);
 
-			renderPipeline->SetBackFaceCulling(true);
+		MemoryBarrierTracker::IssueBarriers();
+	}
 
-			renderPipeline->SetLineModeEnabled(mWireframe);
+	// ---------------------------------------------
 
-			// Textures
-			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE0, mPositionalBuffer->GetTextureID(), true);
-			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE1, mNormalBuffer->GetTextureID(),     true);
-			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE2, mTangentBuffer->GetTextureID(),    true);
-			renderPipeline->BindTextureToTextureUnit(GL_TEXTURE3, mBiNormalBuffer->GetTextureID(),   true);
+	void WaterSimulation::PrepareRender(Rendering::Camera* camera)
+	{
+		// Existance checks
+		if (!mWaterVAO || !mWaterVBO || !mPositionalBuffer || !mSecondPositionalBuffer || !mNormalBuffer || !mTangentBuffer || !mBiNormalBuffer || !mSurfaceRenderShaders || !camera)
+			return;
 
-			if (skybox)
-			{
-				renderPipeline->BindTextureToTextureUnit(GL_TEXTURE4, skybox->GetTextureID(), false);
-			}
+		// Make sure the compute shader has finished before the mip chains are built and the surface samples the textures
+		// Draws are replayed later from the queue, but nothing else is dispatched in between so barriering here covers them
+		if (mSlopeMipMapsOutOfDate)
+		{
+			DeclareImageAccess(mNormalBuffer,   GPUResourceAccess::TextureUpdate);
+			DeclareImageAccess(mTangentBuffer,  GPUResourceAccess::TextureUpdate);
+			DeclareImageAccess(mBiNormalBuffer, GPUResourceAccess::TextureUpdate);
+		}
 
-			glm::mat4 identity = glm::mat4(1.0f);
-			mSurfaceRenderShaders->SetMat4("modelMat", &identity[0][0]);
+		DeclareImageAccess(mPositionalBuffer, GPUResourceAccess::TextureFetch);
+		DeclareImageAccess(mNormalBuffer,     GPUResourceAccess::TextureFetch);
+		DeclareImageAccess(mTangentBuffer,    GPUResourceAccess::TextureFetch);
+		DeclareImageAccess(mBiNormalBuffer,   GPUResourceAccess::TextureFetch);
 
-			// view and projection matricies from the camera
-			glm::mat4 viewMat = camera->GetViewMatrix();
-			mSurfaceRenderShaders->SetMat4("viewMat", &viewMat[0][0]);
+		MemoryBarrierTracker::IssueBarriers();
 
-			glm::mat4 projectionMat = camera->GetPerspectiveMatrix();
-			mSurfaceRenderShaders->SetMat4("projectionMat", &projectionMat[0][0]);
+		GenerateSlopeMipMaps();
 
-			mSurfaceRenderShaders->SetVec3("cameraPosition", camera->GetPosition());
+		// The camera block is written by the render pipeline, this covers the lighting and material blocks
+		UpdateUniformBlocks();
 
-			mSurfaceRenderShaders->SetVec3("directionalLightDirection", mRenderingData.mLightDirection);
-			mSurfaceRenderShaders->SetFloat("reflectionProportion",     mRenderingData.mReflectionFactor);
-			mSurfaceRenderShaders->SetVec3("waterColour",               mRenderingData.mWaterColour);
-			mSurfaceRenderShaders->SetVec3("ambientColour",             mRenderingData.mAmbientColour);
+		// The tessellated surface works out its own density and culling per patch, so none of the LOD tile work is needed
+		if (mUseTessellation && mTessellationVAO && mTessellatedSurfaceShaders)
+			return;
 
-			// ------------------------------------------------------------------------------------------------
+		// Can rebuild the patch buffer, so this has to happen before any commands are recorded from it
+		UpdateFarFieldSplit(camera, camera->GetPerspectiveMatrix(), GetMaximumDisplacement());
+	}
 
-			// Determine if the camera is below the surface of the water, and if so then we need to flip the culling order
-			/*if(IsBelowSurface(camera->GetPosition()))
-			{
-				glCullFace(GL_FRONT);
-			}
-			else
-			{
-				glCullFace(GL_BACK);
-			}*/
+	// ---------------------------------------------
 
-			// Now handle the LODs
-			for (int i = 0; i <= mLevelOfDetailCount; i++)
-			{
-				float                          LODscaleFactor = (float)std::powf(3.0f, i);
-				float                          dimensions     = (mHighestLODDimensions * LODscaleFactor) * 2.0f;
+	void WaterSimulation::RecordRenderCommands(RenderCommandList& commandList, const glm::mat4& viewMat, const glm::mat4& projectionMat, const glm::vec3& cameraPosition, float farDistance)
+	{
+		// Existance checks
+		if (!mWaterVAO || !mWaterVBO || !mPositionalBuffer || !mSecondPositionalBuffer || !mNormalBuffer || !mTangentBuffer || !mBiNormalBuffer || !mSurfaceRenderShaders)
+			return;
 
-				Maths::Vector::Vector2D<float> backLeftPos    = Maths::Vector::Vector2D<float>(-dimensions, -dimensions);
+		// Rendering of the surface is done through passing the positional texture into the vertex shader to create the final world position
+		// Then the fragment shader used information given to it from the other textures output by the compute shader
 
-				for (int j = 0; j < 9; j++)
-				{
-					// Skip the middle one
-					if (j == 4 && i != 0)
-						continue;
+		glm::mat4 viewProjection    = projectionMat * viewMat;
+		float     displacementBound = GetMaximumDisplacement();
 
-					// See if this is visible to the camera
+		RenderCommand drawState;
+		drawState.mStateFlags = kRenderStateDepthTest | kRenderStateBackFaceCulling | (mWireframe ? (unsigned int)kRenderStateWireframe : 0u);
 
-					// Create the model matrix for this LOD so that it is the right scale
-					Maths::Matrix::Matrix4X4 modelMat = Maths::Matrix::Matrix4X4();
+		// Textures
+		drawState.AddTexture(0, mPositionalBuffer->GetTextureID());
+		drawState.AddTexture(1, mNormalBuffer->GetTextureID());
+		drawState.AddTexture(2, mTangentBuffer->GetTextureID());
+		drawState.AddTexture(3, mBiNormalBuffer->GetTextureID());
 
-					modelMat.scaleX(LODscaleFactor);
-					modelMat.scaleZ(LODscaleFactor);
+		if (mSkyReflection)
+			drawState.AddTexture(4, mSkyReflection->GetTextureID(), true);
 
-					unsigned int row    = j / 3;
-					unsigned int column = j % 3;
+		if (mUseTessellation && mTessellationVAO && mTessellatedSurfaceShaders)
+		{
+			RecordTessellatedSurface(commandList, drawState, viewProjection, displacementBound);
+			return;
+		}
 
-					modelMat.transform(Maths::Vector::Vector3D<float>(backLeftPos.x + (column * dimensions), 0.0f, backLeftPos.y + (row * dimensions)));
+		drawState.mProgramID     = mSurfaceRenderShaders->GetId();
+		drawState.mVertexArrayID = mWaterVAO->GetVAOID();
+		drawState.mSortKey       = RenderSortKey::Make(RenderPass::Opaque, drawState.mProgramID, RenderSortKey::HashTextures(drawState), 0.0f);
 
-					mSurfaceRenderShaders->SetMat4("modelMat", &modelMat[0]);
+		// ------------------------------------------------------------------------------------------------
 
-					mSurfaceRenderShaders->SetFloat("textureCoordScale", LODscaleFactor);
+		// Draw the LOD tiles - each patch carries its own scale and offset through the instanced attribute
+		if (mPatchCulling)
+		{
+			if (mUseGPUCulling)
+			{
+				// Sorted into the compute pass, so the culling always lands before the draw that reads its output
+				mPatchCulling->RecordGPUCulling(commandList, RenderSortKey::Make(RenderPass::Compute, 0, 0, 0.0f), viewProjection, displacementBound);
+				mPatchCulling->RecordGPUCulledDraw(commandList, drawState);
 
-					// Draw the LOD
-					glDrawElements(GL_TRIANGLES, mElementCount, GL_UNSIGNED_INT, 0);
+				if (mVerifyGPUCulling)
+				{
+					// Same key as the draw and recorded after it, so the stable sort keeps it behind the draw
+					commandList.AddCallback(drawState.mSortKey, [this, viewProjection, displacementBound]()
+					{
+						mGPUVisiblePatchCount = mPatchCulling->ReadBackGPUVisibleCount();
 
-					ASSERTMSG(glGetError() != 0, "?");
+						// Runs the CPU test purely to compare the counts, so nothing is drawn twice
+						mPatchCulling->CountCPUVisible(viewProjection, displacementBound);
+					});
 				}
 			}
+			else
+			{
+				mPatchCulling->RecordCPUCulledDraws(commandList, drawState, viewProjection, displacementBound, cameraPosition, farDistance);
+			}
+		}
 
-			// ------------------------------------------------------------------------------------------------
-
-			renderPipeline->SetLineModeEnabled(false);
-			renderPipeline->SetBackFaceCulling(true);
+		// ------------------------------------------------------------------------------------------------
 
-		mWaterVAO->Unbind();
+		// Rings past the switch distance - the far field swaps in its own program and mesh but keeps the slope textures
+		if (mFarField && mFirstFarFieldRing <= mLevelOfDetailCount)
+		{
+			mFarField->RecordDraw(commandList, drawState);
+		}
 	}
 
 	// ---------------------------------------------
 
-	bool WaterSimulation::IsBelowSurface(Maths::Vector::Vector3D<float> position)
+	void WaterSimulation::UpdateUniformBlocks()
 	{
-		if (!mPositionalBuffer)
-			return false;
+		if (!mPerFrameLightingUBO || !mWaterMaterialUBO)
+			return;
 
-		// See if the position is out of bounds of the data
+		PerFrameLightingBlock lighting;
+		lighting.mDirectionalLightDirection = glm::vec4(mRenderingData.mLightDirection.x, mRenderingData.mLightDirection.y, mRenderingData.mLightDirection.z, 0.0f);
+		lighting.mAmbientColour             = glm::vec4(mRenderingData.mAmbientColour.x,  mRenderingData.mAmbientColour.y,  mRenderingData.mAmbientColour.z,  1.0f);
 
-		// Get the offset stored in the buffer
+		for (unsigned int i = 0; i < 9; i++)
+		{
+			lighting.mIrradianceSH[i] = glm::vec4(mSkyIrradiance.mCoefficients[i], 0.0f);
+		}
 
-		// See if the position passed in is below or above the value from the buffer
-		
+		mPerFrameLightingUBO->SubBufferUpdate(0, sizeof(PerFrameLightingBlock), &lighting);
 
-		return false;
+		WaterMaterialBlock material;
+		material.mWaterColour = glm::vec4(mRenderingData.mWaterColour.x, mRenderingData.mWaterColour.y, mRenderingData.mWaterColour.z, mRenderingData.mReflectionFactor);
+
+		// Sine waves write their normals in world space, everything else in tangent space
+		// The reflection's roughness is scaled into its mip chain here, so the shader does not need the level count
+		float reflectionLevel = mSkyReflection ? mRenderingData.mReflectionRoughness * (float)(mSkyReflection->GetLevelCount() - 1) : 0.0f;
+
+		material.mFlags       = glm::vec4(mModellingApproach == SimulationMethods::Sine ? 1.0f : 0.0f, mSkyReflection ? 1.0f : 0.0f, reflectionLevel, 0.0f);
+
+		mWaterMaterialUBO->SubBufferUpdate(0, sizeof(WaterMaterialBlock), &material);
 	}
 
 	// ---------------------------------------------
 
-	Maths::Vector::Vector2D<float>* WaterSimulation::GenerateVertexData(unsigned int dimensions, float distanceBetweenVertex)
-	{		
-		mVertexCount = (dimensions + 1) * (dimensions + 1);
-		Maths::Vector::Vector2D<float>* newData = new Maths::Vector::Vector2D<float>[mVertexCount];
-
-		unsigned int halfDimensions = dimensions / 2;
+	void WaterSimulation::RecordTessellatedSurface(RenderCommandList& commandList, const RenderCommand& drawState, const glm::mat4& viewProjection, float displacementBound)
+	{
+		glm::vec4 frustumPlanes[6];
+		WaterPatchCulling::ExtractFrustumPlanes(viewProjection, frustumPlanes);
 
-		float                          startingDistanceFromCentre = halfDimensions * distanceBetweenVertex;
-		Maths::Vector::Vector2D<float> topLeftXPos                = Maths::Vector::Vector2D(-startingDistanceFromCentre, -startingDistanceFromCentre);
+		RenderCommand command  = drawState;
+		command.mProgramID     = mTessellatedSurfaceShaders->GetId();
+		command.mVertexArrayID = mTessellationVAO->GetVAOID();
+		command.mSortKey       = RenderSortKey::Make(RenderPass::Opaque, command.mProgramID, RenderSortKey::HashTextures(command), 0.0f);
 
-		unsigned int currentVertexID = 0;
+		float surfaceExtent        = GetTessellatedSurfaceExtent();
+		float targetEdgePixels     = mTessellationTargetEdgePixels;
+		float maxTessellationLevel = (float)mMaxTessellationLevel;
 
-		// Looped in reverse to get the winding order correct
-		for (int z = dimensions; z >= 0; z--)
+		// Screen space error controls - uniforms are GL calls, so they are set on the render thread just before the draw
+		commandList.AddCallback(command.mSortKey, [this, frustumPlanes, displacementBound, surfaceExtent, targetEdgePixels, maxTessellationLevel]()
 		{
-			for (int x = 0; x <= dimensions; x++)
-			{
-				newData[currentVertexID++] = Maths::Vector::Vector2D<float>(topLeftXPos.x + (x * distanceBetweenVertex), topLeftXPos.y + (z * distanceBetweenVertex));
-			}
-		}
+			mTessellatedSurfaceShaders->SetFloat("surfaceExtent",          surfaceExtent);
+			mTessellatedSurfaceShaders->SetFloat("targetEdgeLengthPixels", targetEdgePixels);
+			mTessellatedSurfaceShaders->SetFloat("maxTessellationLevel",   maxTessellationLevel);
+
+			mTessellatedSurfaceShaders->SetVec4Array("frustumPlanes",    6, &frustumPlanes[0].x);
+			mTessellatedSurfaceShaders->SetFloat("displacementBound",    displacementBound);
+		});
+
+		command.mDraw.mPatchVertices = 4;
 
-		return newData;
+		commandList.AddDrawElements(command, GL_PATCHES, mTessellationIndexCount, 0);
 	}
 
 	// ---------------------------------------------
 
-	unsigned int* WaterSimulation::GenerateElementData(unsigned int dimensions)
+	bool WaterSimulation::IsBelowSurface(Maths::Vector::Vector3D<float> position)
 	{
-		mElementCount = (dimensions) * (dimensions) * 6;
-		unsigned int* elementData = new unsigned int[mElementCount];
+		if (!mPositionalBuffer)
+			return false;
 
-		unsigned int elementIndex = 0;
-		for (unsigned int z = 0; z < dimensions; z++)
-		{
-			unsigned int startOfRow     = (dimensions + 1) * z;
-			unsigned int startOfNextRow = startOfRow + (dimensions + 1);
+		// See if the position is out of bounds of the data
 
-			for (unsigned int x = 0; x < dimensions; x++)
-			{
-				elementData[elementIndex++] = startOfRow     + x;
-				elementData[elementIndex++] = startOfRow     + (x + 1);
-				elementData[elementIndex++] = startOfNextRow + x;
+		// Get the offset stored in the buffer
 
-				elementData[elementIndex++] = startOfRow     + (x + 1);
-				elementData[elementIndex++] = startOfNextRow + (x + 1);
-				elementData[elementIndex++] = startOfNextRow + x;
-			}
-		}
+		// See if the position passed in is below or above the value from the buffer
+		
 
-		return elementData;
+		return false;
 	}
 
 	// ---------------------------------------------
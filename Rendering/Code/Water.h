@@ -2,6 +2,11 @@
 
 #include "Maths/Code/Vector.h"
 #include "Rendering/Code/WaterStructures.h"
+#include "Rendering/Code/MeshOptimisation.h"
+#include "Rendering/Code/UniformBlocks.h"
+#include "Rendering/Code/SphericalHarmonics.h"
+
+#include <glm/matrix.hpp>
 
 #include <vector>
 #include <string>
@@ -17,6 +22,7 @@ namespace Rendering
 	namespace ShaderPrograms
 	{
 		class ShaderProgram;
+		class ComputeKernel;
 	}
 
 	namespace Buffers
@@ -25,9 +31,15 @@ namespace Rendering
 		class VertexArrayObject;
 		class ElementBufferObjects;
 		class ShaderStorageBufferObject;
+		class UniformBufferObject;
 	}
 
 	class Camera;
+	class WaterPatchCulling;
+	class WaterFarField;
+	class GridMesh;
+	class RenderCommandList;
+	struct RenderCommand;
 
 	// ---------------------------------------	
 
@@ -40,7 +52,17 @@ namespace Rendering
 		void                RenderDebugMenu();
 
 		void                Update(const float deltaTime);
-		void                Render(Rendering::Camera* camera, Texture::CubeMapTexture* skybox);
+		// GL work that has to happen on the render thread before any commands are recorded - barriers, mip maps, uniform blocks and the LOD split
+		void                PrepareRender(Rendering::Camera* camera);
+
+		// Only builds command packets and does the CPU culling, so this can run on a worker thread once PrepareRender has returned
+		void                RecordRenderCommands(RenderCommandList& commandList, const glm::mat4& viewMat, const glm::mat4& projectionMat, const glm::vec3& cameraPosition, float farDistance);
+
+		// Diffuse light from the sky, uploaded with the rest of the lighting block in PrepareRender
+		void                SetSkyIrradiance(const IrradianceSH9& irradiance) { mSkyIrradiance = irradiance; }
+
+		// Roughness prefiltered sky the surface reflects - null leaves the surface lit by the irradiance alone
+		void                SetSkyReflection(Texture::CubeMapTexture* reflection)  { mSkyReflection = reflection; }
 
 		bool                IsBelowSurface(Maths::Vector::Vector3D<float> position);
 
@@ -58,21 +80,52 @@ namespace Rendering
 		void                SetPreset(SimulationMethods approach, char preset);
 
 	private:
-		void SetupBuffers();
+		// The grid mesh and noise are generated off the render thread while the shaders compile, then handed in here
+		void SetupBuffers(GridMesh& gridMesh);
 		void SetupShaders();
-		void SetupTextures();
+		void SetupTextures(Maths::Vector::Vector4D<float>* randomNumberData);
+
+		// Coarse base grid for the hardware tessellation path
+		void SetupTessellationBuffers();
+
+		// Rebuilds the mip chains of the buffers read by the fragment shader, so distant surfaces filter instead of aliasing
+		void GenerateSlopeMipMaps();
+
+		// Picks which LOD rings are displaced and which are drawn flat, and updates the culling and far field to match
+		void UpdateFarFieldSplit(Rendering::Camera* camera, const glm::mat4& projectionMat, float displacementBound);
+
+		// Width of the area covered by all of the LOD rings, which the tessellated grid is stretched across
+		float GetTessellatedSurfaceExtent();
+
+		// Single upload of the lighting and material blocks shared by every surface program
+		void UpdateUniformBlocks();
+
+		void RecordTessellatedSurface(RenderCommandList& commandList, const RenderCommand& drawState, const glm::mat4& viewProjection, float displacementBound);
 
 		void GenerateH0();
 
+		// Times each compute kernel's candidate workgroup sizes in its real pass - does nothing for kernels with a size stored from a previous run
+		void TuneComputeKernels();
+
+		// The per-method halves of Update, split out so TuneComputeKernels can run them on their own
+		void UpdateSineSurface();
+		void UpdateGerstnerSurface();
+		void UpdateTessendorfFrequencies();
+
 		void UpdateSineWaveDataSet();
 		void UpdateGerstnerWaveDataSet();
 
-		Maths::Vector::Vector2D<float>*         GenerateVertexData(unsigned int dimensions, float distanceBetweenVertex);
-		unsigned int*                           GenerateElementData(unsigned int dimensions);
+		// Largest distance the current simulation can move a vertex from its flat position, used to pad the culling bounds
+		float GetMaximumDisplacement();
+
 		Maths::Vector::Vector4D<float>*         GenerateGaussianData();
 
 		void RunInverseFFT();
 
+		// Declare each compute pass's image accesses to MemoryBarrierTracker and issue whatever barrier they need
+		void DeclareFFTPassAccesses();
+		void DeclareSurfaceWrites(Texture::Texture2D* firstOutput);
+
 		// this needs to be re-ran every time the resolution of the heightmap changes
 		void CreateButterflyTexture();
 		int* GenerateBitReversedIndicies();
@@ -94,16 +147,16 @@ namespace Rendering
 
 		// Shader for modeling the movement of waves
 		// Writes out the new X-Y-Z position of the verticies to an RGB buffer
-		ShaderPrograms::ShaderProgram* mWaterMovementComputeShader_Sine;
-		ShaderPrograms::ShaderProgram* mWaterMovementComputeShader_Gerstner;
+		ShaderPrograms::ComputeKernel* mWaterMovementComputeShader_Sine;
+		ShaderPrograms::ComputeKernel* mWaterMovementComputeShader_Gerstner;
 
 		// Tessendorf functionality
-		ShaderPrograms::ShaderProgram* mGenerateH0_ComputeShader;                 // Create H0 texture
-		ShaderPrograms::ShaderProgram* mCreateFrequencyValues_ComputeShader;      // Convert H0 to H(k, t)
-		ShaderPrograms::ShaderProgram* mConvertToHeightValues_ComputeShader_FFT;  // Converts from H(k, t) to a height map
+		ShaderPrograms::ComputeKernel* mGenerateH0_ComputeShader;                 // Create H0 texture
+		ShaderPrograms::ComputeKernel* mCreateFrequencyValues_ComputeShader;      // Convert H0 to H(k, t)
+		ShaderPrograms::ComputeKernel* mConvertToHeightValues_ComputeShader_FFT;  // Converts from H(k, t) to a height map
 
-		ShaderPrograms::ShaderProgram* mGenerateButterflyFFTData;
-		ShaderPrograms::ShaderProgram* mFFTFinalStageProgram;
+		ShaderPrograms::ComputeKernel* mGenerateButterflyFFTData;
+		ShaderPrograms::ComputeKernel* mFFTFinalStageProgram;
 
 		// Buffer that holds the world space X-Y-Z 
 		Texture::Texture2D*            mPositionalBuffer;
@@ -135,6 +188,12 @@ namespace Rendering
 		std::vector<SingleGerstnerWaveData> mGersnterWaveData;
 		Buffers::ShaderStorageBufferObject* mGerstnerWaveSSBO;
 
+		// The wave kernels are rebuilt with the wave count as a constant so their loops unroll
+		// Holds the count each kernel was last specialised for, so the variant is only looked up again when it changes
+		bool                                mSpecialiseWaveKernels;
+		unsigned int                        mSpecialisedSineWaveCount;
+		unsigned int                        mSpecialisedGerstnerWaveCount;
+
 		// Level of detail - to allow for the ocean to go on forever
 		int                                 mLevelOfDetailCount;
 		bool                                mUsingLODs;
@@ -152,10 +211,57 @@ namespace Rendering
 		// Shader program used for rendering the surface of the water volume
 		ShaderPrograms::ShaderProgram*      mSurfaceRenderShaders;
 
+		// std140 blocks bound at UniformBlockBindings::PerFrameLighting and UniformBlockBindings::WaterMaterial
+		Buffers::UniformBufferObject*       mPerFrameLightingUBO;
+		Buffers::UniformBufferObject*       mWaterMaterialUBO;
+
 		unsigned int                        mVertexCount;
 		unsigned int                        mElementCount;
 
+		// 16 bit index ranges of the element buffer, each drawn with its own base vertex
+		std::vector<MeshOptimisation::IndexBatch> mIndexBatches;
+		MeshOptimisation::VertexCacheStatistics   mVertexCacheStatistics;
+
+		// Frustum culling of the LOD tiles, done on the GPU with indirect draws by default
+		WaterPatchCulling*                  mPatchCulling;
+		bool                                mUseGPUCulling;
+		bool                                mVerifyGPUCulling;
+		unsigned int                        mGPUVisiblePatchCount;
+
+		// Deviation of the unscaled Tessendorf heights, summed from the Phillips spectrum whenever H0 is regenerated
+		float                               mTessendorfHeightDeviation;
+
+		// Flat, normal mapped rings past the distance where displacement becomes sub-pixel
+		WaterFarField*                      mFarField;
+		bool                                mUseFarField;
+		float                               mFarFieldPixelThreshold;
+		float                               mFarFieldSwitchDistance;
+		int                                 mFirstFarFieldRing;
+
+		// Last ring handed to the patch culling, so the patch list is only rebuilt when the switch moves
+		int                                 mLastDisplacedRing;
+
+		// Set whenever the simulation rewrites the normal, tangent and binormal buffers
+		bool                                mSlopeMipMapsOutOfDate;
+
+		// Hardware tessellation path - a small grid of quad patches that the GPU subdivides based on their projected size
+		ShaderPrograms::ShaderProgram*      mTessellatedSurfaceShaders;
+
+		Buffers::VertexArrayObject*         mTessellationVAO;
+		Buffers::VertexBufferObject*        mTessellationVBO;
+		Buffers::ElementBufferObjects*      mTessellationEBO;
+
+		unsigned int                        mTessellationIndexCount;
+
+		bool                                mUseTessellation;
+		float                               mTessellationTargetEdgePixels;
+		int                                 mMaxTessellationLevel;
+
+		const unsigned int                  kTessellationBaseGridCells;
+
 		RenderingWaterData                  mRenderingData;
+		IrradianceSH9                       mSkyIrradiance;
+		Texture::CubeMapTexture*            mSkyReflection;
 
 		// --------------------- Other --------------------- //
 
@@ -165,11 +271,8 @@ namespace Rendering
 
 		float                          mRunningTime;
 
-		unsigned int                   mMemoryBarrierBlockBits;
 
 		float                          mScaleFactor;
-
-		const unsigned int             kComputeShaderThreadClusterSize;
 	};
 
 	// ---------------------------------------
@@ -0,0 +1,227 @@
+#include "WaterFarField.h"
+
+#include "Shaders/ShaderProgram.h"
+#include "Shaders/Shader.h"
+
+#include "Buffers.h"
+#include "GridMesh.h"
+#include "MeshOptimisation.h"
+#include "RenderCommandQueue.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Rendering
+{
+	// ---------------------------------------------
+
+	WaterFarField::WaterFarField()
+		: mFarFieldProgram(nullptr)
+		, mVAO(nullptr)
+		, mVBO(nullptr)
+		, mEBO(nullptr)
+		, mInstanceBuffer(nullptr)
+		, mTileTransforms()
+		, mIndexCount(0)
+		, mDimensions(0)
+		, mDistanceBetweenVerticies(0.0f)
+		, mFirstRing(-1)
+		, mLastRing(-1)
+		, kFarFieldTileCells(8)
+	{
+		SetupShaders();
+	}
+
+	// ---------------------------------------------
+
+	WaterFarField::~WaterFarField()
+	{
+		delete mFarFieldProgram;
+		mFarFieldProgram = nullptr;
+
+		delete mVAO;
+		mVAO = nullptr;
+
+		delete mVBO;
+		mVBO = nullptr;
+
+		delete mEBO;
+		mEBO = nullptr;
+
+		delete mInstanceBuffer;
+		mInstanceBuffer = nullptr;
+	}
+
+	// ---------------------------------------------
+
+	void WaterFarField::SetupShaders()
+	{
+		if (mFarFieldProgram)
+			return;
+
+		mFarFieldProgram = new ShaderPrograms::ShaderProgram();
+
+		// Shares the surface fragment shader, which only reads the normal, tangent and binormal buffers
+		Shaders::VertexShader*   vertexShader   = new Shaders::VertexShader("Code/Shaders/Vertex/WaterSurface_FarField.vert");
+		Shaders::FragmentShader* fragmentShader = new Shaders::FragmentShader("Code/Shaders/Fragment/WaterSurface.frag");
+
+		mFarFieldProgram->AttachShader(vertexShader);
+		mFarFieldProgram->AttachShader(fragmentShader);
+
+			mFarFieldProgram->LinkShadersToProgram();
+
+		mFarFieldProgram->DetachShader(vertexShader);
+		mFarFieldProgram->DetachShader(fragmentShader);
+
+		delete vertexShader;
+		delete fragmentShader;
+
+		mFarFieldProgram->UseProgram();
+			mFarFieldProgram->SetInt("normalBuffer",   1);
+			mFarFieldProgram->SetInt("tangentBuffer",  2);
+			mFarFieldProgram->SetInt("binormalBuffer", 3);
+			mFarFieldProgram->SetInt("skyReflection",  4);
+	}
+
+	// ---------------------------------------------
+
+	void WaterFarField::Setup(unsigned int dimensions, float distanceBetweenVerticies)
+	{
+		if (mVAO)
+			return;
+
+		mDimensions               = dimensions;
+		mDistanceBetweenVerticies = distanceBetweenVerticies;
+
+		// Spread the few cells over the same width as a full resolution tile so the tile transforms can be shared
+		const float tileWidth = (float)(dimensions / 2) * distanceBetweenVerticies * 2.0f;
+
+		std::vector<float> vertexData((size_t)(kFarFieldTileCells + 1) * (kFarFieldTileCells + 1) * 2);
+		GridMesh::GenerateVertexData(kFarFieldTileCells, tileWidth / (float)kFarFieldTileCells, vertexData.data());
+
+		std::vector<unsigned short>               indexData;
+		std::vector<MeshOptimisation::IndexBatch> batches;
+		MeshOptimisation::GenerateGridIndexBatches(kFarFieldTileCells, false, indexData, batches);
+
+		mIndexCount = (unsigned int)indexData.size();
+
+		mVBO = new Buffers::VertexBufferObject();
+		mVBO->SetBufferData(vertexData.data(), (unsigned int)(vertexData.size() * sizeof(float)), GL_STATIC_DRAW);
+
+		mEBO = new Buffers::ElementBufferObjects();
+		mEBO->SetBufferData((unsigned int)(indexData.size() * sizeof(unsigned short)), indexData.data(), GL_STATIC_DRAW);
+
+		mInstanceBuffer = new Buffers::VertexBufferObject();
+
+		mVAO = new Buffers::VertexArrayObject();
+
+		mVAO->Bind();
+		mVBO->Bind();
+		mEBO->Bind();
+
+			mVAO->EnableVertexAttribArray(0);
+			mVAO->SetVertexAttributePointers(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GL_FLOAT), 0, true);
+
+		mInstanceBuffer->Bind();
+
+			mVAO->EnableVertexAttribArray(1);
+			mVAO->SetVertexAttributePointers(1, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GL_FLOAT), 0, false);
+
+		mVAO->Unbind();
+		mInstanceBuffer->UnBind();
+
+		if (mFarFieldProgram)
+		{
+			mFarFieldProgram->UseProgram();
+				mFarFieldProgram->SetFloat("maxDistanceFromOrigin", tileWidth * 0.5f);
+		}
+	}
+
+	// ---------------------------------------------
+
+	float WaterFarField::CalculateSwitchDistance(const glm::mat4& projectionMat, float viewportHeight, float maximumDisplacement, float pixelThreshold)
+	{
+		// Projected size in pixels = (size * projection[1][1] * height / 2) / distance, solved for the distance
+		return (maximumDisplacement * projectionMat[1][1] * viewportHeight * 0.5f) / std::max(pixelThreshold, 0.0001f);
+	}
+
+	// ---------------------------------------------
+
+	int WaterFarField::CalculateFirstFarFieldRing(const glm::vec3& cameraPosition, const glm::mat4& projectionMat, float viewportHeight, float maximumDisplacement, float pixelThreshold, float highestLODDimensions, int levelOfDetailCount)
+	{
+		const float switchDistance     = CalculateSwitchDistance(projectionMat, viewportHeight, maximumDisplacement, pixelThreshold);
+		const float cameraFromCentre   = std::max(std::abs(cameraPosition.x), std::abs(cameraPosition.z));
+
+		// Ring zero holds the centre tile, so it is always displaced
+		for (int ring = 1; ring <= levelOfDetailCount; ring++)
+		{
+			// Each ring surrounds a square hole of half width highestLODDimensions * 3^ring
+			float innerHalfWidth     = highestLODDimensions * std::pow(3.0f, (float)ring);
+			float horizontalDistance = std::max(innerHalfWidth - cameraFromCentre, 0.0f);
+			float closestDistance    = std::sqrt((horizontalDistance * horizontalDistance) + (cameraPosition.y * cameraPosition.y));
+
+			// Rings only get further away from here out
+			if (closestDistance > switchDistance && horizontalDistance > 0.0f)
+				return ring;
+		}
+
+		return levelOfDetailCount + 1;
+	}
+
+	// ---------------------------------------------
+
+	void WaterFarField::SetRingRange(int firstRing, int lastRing)
+	{
+		if (firstRing == mFirstRing && lastRing == mLastRing)
+			return;
+
+		mFirstRing = firstRing;
+		mLastRing  = lastRing;
+
+		mTileTransforms.clear();
+
+		const float startingDistanceFromCentre = (float)(mDimensions / 2) * mDistanceBetweenVerticies;
+
+		// Same 3x3 layout used by the displaced LOD rings
+		for (int i = firstRing; i <= lastRing; i++)
+		{
+			float LODscaleFactor = std::pow(3.0f, (float)i);
+			float tileSize       = (startingDistanceFromCentre * LODscaleFactor) * 2.0f;
+
+			for (int j = 0; j < 9; j++)
+			{
+				if (j == 4 && i != 0)
+					continue;
+
+				unsigned int row    = j / 3;
+				unsigned int column = j % 3;
+
+				mTileTransforms.push_back(glm::vec4(-tileSize + (column * tileSize), -tileSize + (row * tileSize), LODscaleFactor, LODscaleFactor));
+			}
+		}
+
+		if (mInstanceBuffer && !mTileTransforms.empty())
+		{
+			mInstanceBuffer->SetBufferData(mTileTransforms.data(), (unsigned int)(mTileTransforms.size() * sizeof(glm::vec4)), GL_STATIC_DRAW);
+		}
+	}
+
+	// ---------------------------------------------
+
+	void WaterFarField::RecordDraw(RenderCommandList& commandList, const RenderCommand& drawState)
+	{
+		if (!mVAO || !mFarFieldProgram || mTileTransforms.empty())
+			return;
+
+		RenderCommand command  = drawState;
+		command.mProgramID     = mFarFieldProgram->GetId();
+		command.mVertexArrayID = mVAO->GetVAOID();
+
+		// Always behind the displaced rings, so it goes at the back of its pass
+		command.mSortKey       = RenderSortKey::Make(RenderSortKey::GetPass(drawState.mSortKey), command.mProgramID, RenderSortKey::HashTextures(command), 1.0f);
+
+		commandList.AddDrawElements(command, GL_TRIANGLES, mIndexCount, 0, 0, (unsigned int)mTileTransforms.size(), 0);
+	}
+
+	// ---------------------------------------------
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glm/matrix.hpp>
+
+#include <vector>
+
+namespace Rendering
+{
+	namespace ShaderPrograms
+	{
+		class ShaderProgram;
+	}
+
+	namespace Buffers
+	{
+		class VertexBufferObject;
+		class VertexArrayObject;
+		class ElementBufferObjects;
+	}
+
+	class  RenderCommandList;
+	struct RenderCommand;
+
+	// ---------------------------------------
+
+	// Outer LOD rings where the wave displacement projects to less than a pixel
+	// These are drawn as a coarse flat grid with no vertex texture fetches, and the waves are only shown through the (mip-mapped) normals
+	class WaterFarField final
+	{
+	public:
+		WaterFarField();
+		~WaterFarField();
+
+		// Creates the coarse tile mesh, matching the world size of a single full resolution tile
+		void         Setup(unsigned int dimensions, float distanceBetweenVerticies);
+
+		// Works out the first LOD ring whose closest point to the camera is beyond the distance where the displacement becomes sub-pixel
+		// Returns levelOfDetailCount + 1 when every ring still needs displacing
+		static int   CalculateFirstFarFieldRing(const glm::vec3& cameraPosition, const glm::mat4& projectionMat, float viewportHeight, float maximumDisplacement, float pixelThreshold, float highestLODDimensions, int levelOfDetailCount);
+
+		// Distance at which the given displacement projects to pixelThreshold pixels
+		static float CalculateSwitchDistance(const glm::mat4& projectionMat, float viewportHeight, float maximumDisplacement, float pixelThreshold);
+
+		// Rebuilds the tile instances for the rings [firstRing, lastRing] - only re-uploads when the range changes
+		void         SetRingRange(int firstRing, int lastRing);
+
+		// drawState carries the water's textures (normal, tangent and binormal on units 1 - 3) and pass, the far field swaps in its own program and mesh
+		// The camera and lighting come from the shared uniform blocks
+		void         RecordDraw(RenderCommandList& commandList, const RenderCommand& drawState);
+
+		ShaderPrograms::ShaderProgram* GetShaderProgram()  const { return mFarFieldProgram; }
+
+		unsigned int GetTileCount()                         const { return (unsigned int)mTileTransforms.size(); }
+		unsigned int GetTriangleCountPerTile()              const { return mIndexCount / 3; }
+
+	private:
+		void         SetupShaders();
+
+		ShaderPrograms::ShaderProgram*  mFarFieldProgram;
+
+		Buffers::VertexArrayObject*     mVAO;
+		Buffers::VertexBufferObject*    mVBO;
+		Buffers::ElementBufferObjects*  mEBO;
+
+		// offset X, offset Z, scale, texture coord scale - one per far field tile
+		Buffers::VertexBufferObject*    mInstanceBuffer;
+		std::vector<glm::vec4>          mTileTransforms;
+
+		unsigned int                    mIndexCount;
+
+		unsigned int                    mDimensions;
+		float                           mDistanceBetweenVerticies;
+
+		int                             mFirstRing;
+		int                             mLastRing;
+
+		// Cells along each side of a far field tile, against the hundreds used by a displaced tile
+		const unsigned int              kFarFieldTileCells;
+	};
+
+	// ---------------------------------------
+}
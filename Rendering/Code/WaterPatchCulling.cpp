@@ -0,0 +1,320 @@
+#include "WaterPatchCulling.h"
+
+#include "Shaders/ShaderProgram.h"
+#include "Shaders/Shader.h"
+
+#include "Buffers.h"
+#include "GLStateCache.h"
+#include "RenderCommandQueue.h"
+
+#include <glm/geometric.hpp>
+
+#include <cmath>
+
+namespace Rendering
+{
+	// ---------------------------------------------
+
+	WaterPatchCulling::WaterPatchCulling()
+		: mPatches()
+		, mCullingProgram(nullptr)
+		, mPatchBuffer(nullptr)
+		, mDrawCommandBuffer(nullptr)
+		, mDrawCountBuffer(nullptr)
+		, mVisiblePatches()
+		, mCPUVisibleCount(0)
+		, mIndirectCountSupported(false)
+		, kCullingThreadGroupSize(64)
+	{
+		mIndirectCountSupported = GLAD_GL_VERSION_4_6 && glMultiDrawElementsIndirectCount;
+
+		mPatchBuffer       = new Buffers::ShaderStorageBufferObject();
+		mDrawCommandBuffer = new Buffers::ShaderStorageBufferObject();
+		mDrawCountBuffer   = new Buffers::ShaderStorageBufferObject();
+
+		unsigned int zero = 0;
+		mDrawCountBuffer->SetBufferData(&zero, sizeof(unsigned int), GL_DYNAMIC_DRAW);
+
+		SetupShader();
+	}
+
+	// ---------------------------------------------
+
+	WaterPatchCulling::~WaterPatchCulling()
+	{
+		delete mCullingProgram;
+		mCullingProgram = nullptr;
+
+		delete mPatchBuffer;
+		mPatchBuffer = nullptr;
+
+		delete mDrawCommandBuffer;
+		mDrawCommandBuffer = nullptr;
+
+		delete mDrawCountBuffer;
+		mDrawCountBuffer = nullptr;
+	}
+
+	// ---------------------------------------------
+
+	void WaterPatchCulling::SetupShader()
+	{
+		if (mCullingProgram)
+			return;
+
+		mCullingProgram = new ShaderPrograms::ShaderProgram();
+
+		Shaders::ComputeShader* computeShader = new Shaders::ComputeShader("Code/Shaders/Compute/CullWaterPatches.comp");
+
+		mCullingProgram->AttachShader(computeShader);
+
+			mCullingProgram->LinkShadersToProgram();
+
+		mCullingProgram->DetachShader(computeShader);
+
+		delete computeShader;
+	}
+
+	// ---------------------------------------------
+
+	void WaterPatchCulling::BuildPatches(const std::vector<MeshOptimisation::IndexBatch>& batches, unsigned int dimensions, float distanceBetweenVerticies, int levelOfDetailCount)
+	{
+		mPatches.clear();
+
+		const unsigned int verticiesPerRow            = dimensions + 1;
+		const unsigned int halfDimensions             = dimensions / 2;
+		const float        startingDistanceFromCentre = (float)halfDimensions * distanceBetweenVerticies;
+
+		// Same tile layout as the LOD rings have always used - 3x3 tiles per ring, each ring three times the scale of the last
+		for (int i = 0; i <= levelOfDetailCount; i++)
+		{
+			float LODscaleFactor = std::pow(3.0f, (float)i);
+			float tileSize       = (startingDistanceFromCentre * LODscaleFactor) * 2.0f;
+
+			for (int j = 0; j < 9; j++)
+			{
+				// The middle of each outer ring is covered by the ring inside it
+				if (j == 4 && i != 0)
+					continue;
+
+				unsigned int row    = j / 3;
+				unsigned int column = j % 3;
+
+				float offsetX = -tileSize + (column * tileSize);
+				float offsetZ = -tileSize + (row    * tileSize);
+
+				for (unsigned int b = 0; b < batches.size(); b++)
+				{
+					const MeshOptimisation::IndexBatch& batch = batches[b];
+
+					// Verticies are stored with Z decreasing down the rows
+					unsigned int firstRow = batch.mBaseVertex / verticiesPerRow;
+					unsigned int lastRow  = firstRow + (batch.mVertexCount / verticiesPerRow) - 1;
+
+					float localMinZ = -startingDistanceFromCentre + ((dimensions - lastRow)  * distanceBetweenVerticies);
+					float localMaxZ = -startingDistanceFromCentre + ((dimensions - firstRow) * distanceBetweenVerticies);
+					float localMinX = -startingDistanceFromCentre;
+					float localMaxX = -startingDistanceFromCentre + (dimensions * distanceBetweenVerticies);
+
+					WaterPatchData patch;
+					patch.mOffsetX           = offsetX;
+					patch.mOffsetZ           = offsetZ;
+					patch.mScale             = LODscaleFactor;
+					patch.mTextureCoordScale = LODscaleFactor;
+
+					patch.mBoundsMinX        = (localMinX * LODscaleFactor) + offsetX;
+					patch.mBoundsMinZ        = (localMinZ * LODscaleFactor) + offsetZ;
+					patch.mBoundsMaxX        = (localMaxX * LODscaleFactor) + offsetX;
+					patch.mBoundsMaxZ        = (localMaxZ * LODscaleFactor) + offsetZ;
+
+					patch.mIndexCount        = batch.mIndexCount;
+					patch.mFirstIndex        = batch.mFirstIndex;
+					patch.mBaseVertex        = batch.mBaseVertex;
+					patch.mPadding           = 0;
+
+					mPatches.push_back(patch);
+				}
+			}
+		}
+
+		mPatchBuffer->SetBufferData(mPatches.data(), (unsigned int)(mPatches.size() * sizeof(WaterPatchData)), GL_STATIC_DRAW);
+		mDrawCommandBuffer->SetBufferData(nullptr, (unsigned int)(mPatches.size() * sizeof(DrawElementsIndirectCommand)), GL_DYNAMIC_DRAW);
+
+		mVisiblePatches.reserve(mPatches.size());
+	}
+
+	// ---------------------------------------------
+
+	void WaterPatchCulling::SetupInstanceAttribute(Buffers::VertexArrayObject* vao, unsigned int attributeIndex)
+	{
+		if (!vao)
+			return;
+
+		vao->Bind();
+
+		mPatchBuffer->BindToTarget(GL_ARRAY_BUFFER);
+
+		vao->EnableVertexAttribArray(attributeIndex);
+		vao->SetVertexAttributePointers(attributeIndex, 4, GL_FLOAT, GL_FALSE, sizeof(WaterPatchData), 0, false);
+
+		vao->Unbind();
+
+		GLStateCache::BindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// ---------------------------------------------
+
+	void WaterPatchCulling::RecordGPUCulling(RenderCommandList& commandList, unsigned long long sortKey, const glm::mat4& viewProjection, float displacementBound)
+	{
+		if (mPatches.empty() || !mCullingProgram)
+			return;
+
+		glm::vec4    planes[6];
+		ExtractFrustumPlanes(viewProjection, planes);
+
+		unsigned int patchCount = (unsigned int)mPatches.size();
+
+		// The buffer clears and uniforms are GL calls, so they run on the render thread just ahead of the dispatch
+		commandList.AddCallback(sortKey, [this, planes, displacementBound, patchCount]()
+		{
+			// Reset the compaction counter, and when every slot is going to be submitted make sure the unused ones draw nothing
+			mDrawCountBuffer->ClearToZero();
+
+			if (!mIndirectCountSupported)
+				mDrawCommandBuffer->ClearToZero();
+
+			mCullingProgram->SetVec4Array("frustumPlanes",   6, &planes[0].x);
+			mCullingProgram->SetFloat("displacementBound",    displacementBound);
+			mCullingProgram->SetUnsignedInt("patchCount",     (int)patchCount);
+
+			mPatchBuffer      ->BindToBufferIndex(0);
+			mDrawCommandBuffer->BindToBufferIndex(1);
+			mDrawCountBuffer  ->BindToBufferIndex(2);
+		});
+
+		commandList.AddDispatchCompute(sortKey, mCullingProgram->GetId(), (patchCount + kCullingThreadGroupSize - 1) / kCullingThreadGroupSize, 1, 1);
+
+		// Make the written commands visible to the indirect draw
+		commandList.AddMemoryBarrier(sortKey, GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+
+	// ---------------------------------------------
+
+	void WaterPatchCulling::RecordGPUCulledDraw(RenderCommandList& commandList, const RenderCommand& drawState)
+	{
+		if (mPatches.empty())
+			return;
+
+		// Constant CPU cost regardless of how many patches there are
+		commandList.AddDrawElementsIndirect(drawState, GL_TRIANGLES, mDrawCommandBuffer->GetSSBOID(), mIndirectCountSupported ? mDrawCountBuffer->GetSSBOID() : 0, (unsigned int)mPatches.size());
+	}
+
+	// ---------------------------------------------
+
+	void WaterPatchCulling::RecordCPUCulledDraws(RenderCommandList& commandList, const RenderCommand& drawState, const glm::mat4& viewProjection, float displacementBound, const glm::vec3& cameraPosition, float farDistance)
+	{
+		CountCPUVisible(viewProjection, displacementBound);
+
+		RenderCommand command = drawState;
+
+		for (unsigned int i = 0; i < mVisiblePatches.size(); i++)
+		{
+			const WaterPatchData& patch = mPatches[mVisiblePatches[i]];
+
+			// Closest patches first so that the depth test can reject more of the ones behind
+			float centreX  = (patch.mBoundsMinX + patch.mBoundsMaxX) * 0.5f;
+			float centreZ  = (patch.mBoundsMinZ + patch.mBoundsMaxZ) * 0.5f;
+			float distance = glm::length(glm::vec3(centreX, 0.0f, centreZ) - cameraPosition);
+
+			command.mSortKey = RenderSortKey::SetDepth(drawState.mSortKey, farDistance > 0.0f ? distance / farDistance : 0.0f);
+
+			commandList.AddDrawElements(command, GL_TRIANGLES, patch.mIndexCount, patch.mFirstIndex, patch.mBaseVertex, 1, mVisiblePatches[i]);
+		}
+	}
+
+	// ---------------------------------------------
+
+	unsigned int WaterPatchCulling::CountCPUVisible(const glm::mat4& viewProjection, float displacementBound)
+	{
+		glm::vec4 planes[6];
+		ExtractFrustumPlanes(viewProjection, planes);
+
+		mVisiblePatches.clear();
+
+		for (unsigned int i = 0; i < mPatches.size(); i++)
+		{
+			if (PatchIsVisible(mPatches[i], planes, displacementBound))
+				mVisiblePatches.push_back(i);
+		}
+
+		mCPUVisibleCount = (unsigned int)mVisiblePatches.size();
+
+		return mCPUVisibleCount;
+	}
+
+	// ---------------------------------------------
+
+	unsigned int WaterPatchCulling::ReadBackGPUVisibleCount()
+	{
+		unsigned int visibleCount = 0;
+
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		mDrawCountBuffer->ReadBufferData(0, sizeof(unsigned int), &visibleCount);
+
+		return visibleCount;
+	}
+
+	// ---------------------------------------------
+
+	void WaterPatchCulling::ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+	{
+		// glm is column major, so row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+		glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		planes[0] = row3 + row0; // Left
+		planes[1] = row3 - row0; // Right
+		planes[2] = row3 + row1; // Bottom
+		planes[3] = row3 - row1; // Top
+		planes[4] = row3 + row2; // Near
+		planes[5] = row3 - row2; // Far
+
+		for (unsigned int i = 0; i < 6; i++)
+		{
+			float length = std::sqrt((planes[i].x * planes[i].x) + (planes[i].y * planes[i].y) + (planes[i].z * planes[i].z));
+
+			if (length > 0.0f)
+				planes[i] /= length;
+		}
+	}
+
+	// ---------------------------------------------
+
+	bool WaterPatchCulling::PatchIsVisible(const WaterPatchData& patch, const glm::vec4 planes[6], float displacementBound)
+	{
+		// Expand the flat bounds by how far the simulation can move a vertex in any direction
+		// Horizontal displacement is scaled along with the tile, height is not
+		float     horizontalBound = displacementBound * patch.mScale;
+
+		glm::vec3 minimum = glm::vec3(patch.mBoundsMinX - horizontalBound, -displacementBound, patch.mBoundsMinZ - horizontalBound);
+		glm::vec3 maximum = glm::vec3(patch.mBoundsMaxX + horizontalBound,  displacementBound, patch.mBoundsMaxZ + horizontalBound);
+
+		for (unsigned int i = 0; i < 6; i++)
+		{
+			// Test the corner furthest along the plane normal - if that is outside then the whole box is
+			glm::vec3 positiveVertex = glm::vec3(planes[i].x >= 0.0f ? maximum.x : minimum.x,
+												 planes[i].y >= 0.0f ? maximum.y : minimum.y,
+												 planes[i].z >= 0.0f ? maximum.z : minimum.z);
+
+			if ((planes[i].x * positiveVertex.x) + (planes[i].y * positiveVertex.y) + (planes[i].z * positiveVertex.z) + planes[i].w < 0.0f)
+				return false;
+		}
+
+		return true;
+	}
+
+	// ---------------------------------------------
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Rendering/Code/MeshOptimisation.h"
+
+#include <glm/matrix.hpp>
+
+#include <vector>
+
+namespace Rendering
+{
+	namespace ShaderPrograms
+	{
+		class ShaderProgram;
+	}
+
+	namespace Buffers
+	{
+		class ShaderStorageBufferObject;
+		class VertexArrayObject;
+	}
+
+	class  RenderCommandList;
+	struct RenderCommand;
+
+	// ---------------------------------------
+
+	// One drawable piece of the ocean - a single 16 bit index batch of one LOD tile
+	// Matches the std430 layout of WaterPatch in CullWaterPatches.comp, and is also read as a per-instance vertex attribute
+	struct WaterPatchData
+	{
+		// World space = (local.x * mScale + mOffsetX, height, local.z * mScale + mOffsetZ)
+		float        mOffsetX;
+		float        mOffsetZ;
+		float        mScale;
+		float        mTextureCoordScale;
+
+		// Undisplaced world space X-Z extents
+		float        mBoundsMinX;
+		float        mBoundsMinZ;
+		float        mBoundsMaxX;
+		float        mBoundsMaxZ;
+
+		unsigned int mIndexCount;
+		unsigned int mFirstIndex;
+		int          mBaseVertex;
+		unsigned int mPadding;
+	};
+
+	// Layout required by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand
+	{
+		unsigned int mCount;
+		unsigned int mInstanceCount;
+		unsigned int mFirstIndex;
+		int          mBaseVertex;
+		unsigned int mBaseInstance;
+	};
+
+	// ---------------------------------------
+
+	// Frustum culling of the water tiles, either on the GPU (compute pass writing a compacted indirect draw buffer)
+	// or on the CPU as a reference/fallback path. Both paths draw through baseInstance so the vertex shader
+	// fetches its patch transform from the same instanced attribute
+	class WaterPatchCulling final
+	{
+	public:
+		WaterPatchCulling();
+		~WaterPatchCulling();
+
+		// Rebuilds the patch list for the LOD rings - needs calling whenever the LOD count or the grid changes
+		void         BuildPatches(const std::vector<MeshOptimisation::IndexBatch>& batches, unsigned int dimensions, float distanceBetweenVerticies, int levelOfDetailCount);
+
+		// Links the patch buffer into the VAO as a per-instance vec4 attribute (offset X, offset Z, scale, texture coord scale)
+		void         SetupInstanceAttribute(Buffers::VertexArrayObject* vao, unsigned int attributeIndex);
+
+		// Records the compute pass that fills the indirect draw buffer - sortKey needs to come before the draw in the queue
+		void         RecordGPUCulling(RenderCommandList& commandList, unsigned long long sortKey, const glm::mat4& viewProjection, float displacementBound);
+
+		// drawState carries the water program, VAO, textures and sort key for the patch draws
+		// The CPU path does the visibility test while recording, so it can run on a worker thread, and sorts the patches front to back
+		void         RecordGPUCulledDraw(RenderCommandList& commandList, const RenderCommand& drawState);
+		void         RecordCPUCulledDraws(RenderCommandList& commandList, const RenderCommand& drawState, const glm::mat4& viewProjection, float displacementBound, const glm::vec3& cameraPosition, float farDistance);
+
+		// Runs the CPU visibility test without drawing anything, for checking the GPU result against
+		unsigned int CountCPUVisible(const glm::mat4& viewProjection, float displacementBound);
+
+		unsigned int GetPatchCount()         const { return (unsigned int)mPatches.size(); }
+		unsigned int GetCPUVisibleCount()    const { return mCPUVisibleCount; }
+
+		// Reads back the count written by the last GPU pass - stalls the pipeline, so only used for verification
+		unsigned int ReadBackGPUVisibleCount();
+
+		// Tells the caller whether the draw count is being read from the GPU, or all slots are submitted with culled ones zeroed
+		bool         GetUsingIndirectCount() const { return mIndirectCountSupported; }
+
+		// Gribb-Hartmann plane extraction, normals point into the frustum
+		static void  ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6]);
+		static bool  PatchIsVisible(const WaterPatchData& patch, const glm::vec4 planes[6], float displacementBound);
+
+	private:
+		void         SetupShader();
+
+		std::vector<WaterPatchData>         mPatches;
+
+		ShaderPrograms::ShaderProgram*      mCullingProgram;
+
+		Buffers::ShaderStorageBufferObject* mPatchBuffer;
+		Buffers::ShaderStorageBufferObject* mDrawCommandBuffer;
+		Buffers::ShaderStorageBufferObject* mDrawCountBuffer;
+
+		// Used by the CPU path so it does not allocate every frame
+		std::vector<unsigned int>           mVisiblePatches;
+		unsigned int                        mCPUVisibleCount;
+
+		// glMultiDrawElementsIndirectCount is core in 4.6
+		bool                                mIndirectCountSupported;
+
+		const unsigned int                  kCullingThreadGroupSize;
+	};
+
+	// ---------------------------------------
+}
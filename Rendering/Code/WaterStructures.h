@@ -96,6 +96,7 @@ namespace Rendering
 			, mAmbientColour(0.1f, 0.1f, 0.2f)
 			, mLightDirection(0.1f, -1.0f, 0.1f)
 			, mReflectionFactor(1.0f)
+			, mReflectionRoughness(0.1f)
 		{
 			mLightDirection.Normalise();
 		}
@@ -104,6 +105,7 @@ namespace Rendering
 		Maths::Vector::Vector3D<float> mAmbientColour;
 		Maths::Vector::Vector3D<float> mLightDirection;
 		float                          mReflectionFactor;
+		float                          mReflectionRoughness; // Picks the level of the prefiltered sky that is reflected
 	};
 
 	// ---------------------------------------
@@ -15,6 +15,9 @@
 #include "Input/Code/MouseInput.h"
 
 #include "Framebuffers.h"
+#include "GLStateCache.h"
+#include "MemoryBarrierTracker.h"
+#include "TextureResidency.h"
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -102,7 +105,7 @@ namespace Rendering
 			sRenderPipeline->ClearFinalRenderBuffer();
 		}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		GLStateCache::BindFramebuffer(GL_FRAMEBUFFER, 0);
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 		glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 	}
@@ -254,10 +257,12 @@ namespace Rendering
 
 			secondCounter += deltaTime;
 
-			if (sRenderPipeline)
-			{
-				((OpenGLRenderPipeline*)sRenderPipeline)->ResetTextureBindingInfo();
-			}
+			// Start counting the state changes for this frame
+			GLStateCache::BeginFrame();
+			MemoryBarrierTracker::BeginFrame();
+
+			// Evicts with last frame finished, so nothing it drops is still waiting to be drawn with
+			TextureResidency::BeginFrame();
 
 			// -------
 
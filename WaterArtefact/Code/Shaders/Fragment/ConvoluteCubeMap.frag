@@ -5,7 +5,7 @@ out vec4 FragColor;
 
 uniform samplerCube enviromentMap;
 
-const float PI = 3.14159265359;
+#include "Include/Constants.glsl"
 
 void main()
 {
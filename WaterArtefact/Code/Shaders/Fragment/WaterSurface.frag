@@ -1,4 +1,4 @@
-#version 330 core
+#version 430 core
 
 out vec4 FragColor;
 
@@ -10,27 +10,13 @@ uniform sampler2D binormalBuffer;
 
 uniform sampler2D positionalBuffer;
 
-// ----------------------------------------------------------------
-
-// Eye position
-uniform vec3        cameraPosition;
-
-// Sun direction
-uniform vec3        directionalLightDirection;
-
-// Skybox being reflected
-uniform samplerCube skyboxImage;
-
-// How clear the reflection of the sky is visible in the water
-uniform float       reflectionProportion;
-
-// The colour of the water
-uniform vec3        waterColour;
+// Baked by --bake-skyboxes, each level a rougher reflection of the sky - only bound when materialFlags.y is set
+uniform samplerCube skyReflection;
 
-// The ambient brightness of the ocean
-uniform vec3        ambientColour;
+// ----------------------------------------------------------------
 
-uniform bool        renderingSineGeneration;
+#include "Include/UniformBlocks.glsl"
+#include "Include/SphericalHarmonics.glsl"
 
 // ----------------------------------------------------------------
 
@@ -48,7 +34,7 @@ vec3 unpackMappedValues(vec3 value)
 
 vec3 CalculateDiffuse(vec3 normal)
 {
-	return vec3(max(dot(normal, directionalLightDirection), 0.0));
+	return vec3(max(dot(normal, directionalLightDirection.xyz), 0.0));
 }
 
 // ----------------------------------------------------------------
@@ -57,7 +43,7 @@ vec3 CalculateSpecular(vec3 normal, vec3 viewDirection)
 {
 	float specularStrength = 0.5;
 
-	vec3 reflectDirection = reflect(-directionalLightDirection, normal);
+	vec3 reflectDirection = reflect(-directionalLightDirection.xyz, normal);
 	float specularPortion = pow(max(dot(viewDirection, reflectDirection), 0.0), 64);
 	
 	return vec3(specularPortion * specularStrength);
@@ -82,7 +68,7 @@ void main()
 	// ----------------------------------------------------------------
 
 	// Need to differentiate due to sine waves outputting their data in world space and gerstner waves in tangent space
-	if(!renderingSineGeneration)
+	if(materialFlags.x == 0.0)
 	{
 		// Calculate the TBN matrix to convert from texture space into world space
 		mat3 surfaceToWorldMatrix = mat3(tangent, binormal, normal);
@@ -95,17 +81,27 @@ void main()
 	// ----------------------------------------------------------------
 
 	// pixel to camera direction
-	vec3 toCamera = normalize(cameraPosition - worldPosition);
+	vec3 toCamera = normalize(cameraPosition.xyz - worldPosition);
 
 	// Calculate fresnel effect
 	float refractiveFactor = dot(toCamera, unpackedNormal);
 
-	//vec3 finalColour 
+	// Light from the whole sky, evaluated from the nine coefficients rather than fetched from an irradiance cube map
+	vec3 irradiance = EvaluateIrradianceSH(unpackedNormal);
+
+	vec3 finalColour = waterColourAndReflection.rgb * irradiance;
+
+	if(materialFlags.y > 0.0)
+	{
+		vec3 reflectedSky = textureLod(skyReflection, reflect(-toCamera, unpackedNormal), materialFlags.z).rgb;
+
+		// Schlick's approximation with water's reflectance head on, scaled by how clear the reflection is set to be
+		float fresnel = 0.02 + 0.98 * pow(1.0 - clamp(refractiveFactor, 0.0, 1.0), 5.0);
 
-	// Mix in the colour of the water
-	//finalColour = mix(finalColour, waterColour, 0.2);
+		finalColour = mix(finalColour, reflectedSky, fresnel * waterColourAndReflection.a);
+	}
 
-	FragColor = vec4(0.0, 0.2, 0.7, 1.0);
+	FragColor = vec4(finalColour, 1.0);
 }
 
 // ----------------------------------------------------------------
\ No newline at end of file
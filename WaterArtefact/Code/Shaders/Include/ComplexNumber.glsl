@@ -0,0 +1,35 @@
+// Complex arithmetic used by the Tessendorf and FFT kernels
+
+struct ComplexNumber
+{
+	float real;
+	float complex;
+};
+
+// --------------------------------------------------------------------------------
+
+ComplexNumber AddComplex(ComplexNumber num1, ComplexNumber num2)
+{
+	return ComplexNumber(num1.real + num2.real, num1.complex + num2.complex);
+}
+
+ComplexNumber MultiplyComplex(ComplexNumber num1, ComplexNumber num2)
+{
+	return ComplexNumber((num1.real * num2.real)    - (num1.complex * num2.complex), 
+	                     (num1.real * num2.complex) + (num1.complex * num2.real));
+}
+
+ComplexNumber MultiplyComplex(ComplexNumber num1, float multiplier)
+{
+	return ComplexNumber(num1.real * multiplier, num1.complex * multiplier);
+}
+
+ComplexNumber Conjugate(ComplexNumber num)
+{
+	return ComplexNumber(num.real, -num.complex);
+}
+
+ComplexNumber ComplexCast(vec2 inputValues)
+{
+	return ComplexNumber(inputValues.x, inputValues.y);
+}
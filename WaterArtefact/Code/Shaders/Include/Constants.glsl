@@ -0,0 +1,4 @@
+// Shared between every stage - pulled in with #include "Include/Constants.glsl"
+
+const float PI     = 3.14159265359;
+const float TWO_PI = 6.28318530718;
@@ -0,0 +1,21 @@
+// Evaluates irradiance stored as nine spherical harmonic coefficients, as projected by IrradianceSH9 in SphericalHarmonics.cpp
+// The coefficients are already convolved with the cosine lobe and divided by pi, so this gives what the irradiance cube map held
+// Needs Include/UniformBlocks.glsl for irradianceSH
+
+vec3 EvaluateIrradianceSH(vec3 normal)
+{
+	vec3 irradiance = irradianceSH[0].rgb * 0.282095;
+
+	irradiance += irradianceSH[1].rgb * 0.488603 * normal.y;
+	irradiance += irradianceSH[2].rgb * 0.488603 * normal.z;
+	irradiance += irradianceSH[3].rgb * 0.488603 * normal.x;
+
+	irradiance += irradianceSH[4].rgb * 1.092548 * normal.x * normal.y;
+	irradiance += irradianceSH[5].rgb * 1.092548 * normal.y * normal.z;
+	irradiance += irradianceSH[6].rgb * 0.315392 * (3.0 * normal.z * normal.z - 1.0);
+	irradiance += irradianceSH[7].rgb * 1.092548 * normal.x * normal.z;
+	irradiance += irradianceSH[8].rgb * 0.546274 * (normal.x * normal.x - normal.y * normal.y);
+
+	// Ringing in the fit can dip just below zero opposite a bright sun
+	return max(irradiance, vec3(0.0));
+}
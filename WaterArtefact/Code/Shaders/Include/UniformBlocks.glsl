@@ -0,0 +1,28 @@
+// Every uniform block the renderer binds - a block a shader does not use is left inactive, so any stage can include all of them
+
+// Matches PerFrameCameraBlock in UniformBlocks.h
+layout (std140, binding = 0) uniform PerFrameCamera
+{
+	mat4 viewMat;
+	mat4 projectionMat;
+	mat4 viewProjectionMat;
+
+	vec4 cameraPosition; // w unused
+	vec4 viewport;       // width, height, near, far
+};
+
+// Matches PerFrameLightingBlock in UniformBlocks.h
+layout (std140, binding = 1) uniform PerFrameLighting
+{
+	vec4 directionalLightDirection; // w unused
+	vec4 ambientColour;             // w unused
+
+	vec4 irradianceSH[9];           // rgb, read through EvaluateIrradianceSH in Include/SphericalHarmonics.glsl
+};
+
+// Matches WaterMaterialBlock in UniformBlocks.h
+layout (std140, binding = 2) uniform WaterMaterial
+{
+	vec4 waterColourAndReflection; // rgb = water colour, a = how clear the reflection of the sky is
+	vec4 materialFlags;            // x = 1 when the normals are in world space (sine waves), y = 1 when skyReflection is bound, z = its level to sample
+};
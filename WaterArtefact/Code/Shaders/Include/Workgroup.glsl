@@ -0,0 +1,21 @@
+// Shared by the compute kernels that run one invocation per texel - pulled in with #include "Include/Workgroup.glsl"
+// Declares the work group size, so a kernel wanting a different fallback defines it before the include
+
+// Replaced with the size picked for this device when built through ComputeKernel
+#ifndef WORKGROUP_SIZE_X
+	#define WORKGROUP_SIZE_X 16
+#endif
+
+#ifndef WORKGROUP_SIZE_Y
+	#define WORKGROUP_SIZE_Y 16
+#endif
+
+layout(local_size_x = WORKGROUP_SIZE_X, local_size_y = WORKGROUP_SIZE_Y, local_size_z = 1) in;
+
+// --------------------------------------------------------------------------------
+
+// The group count is rounded up, so the last groups along each edge can hang off the image
+bool IsOutsideImage(ivec2 size)
+{
+	return any(greaterThanEqual(ivec2(gl_GlobalInvocationID.xy), size));
+}
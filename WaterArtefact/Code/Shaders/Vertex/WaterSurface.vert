@@ -1,19 +1,19 @@
-#version 330 core
+#version 430 core
 
 layout (location = 0) in vec2 vertexPosition;
 
+// Per-patch data, selected through the draw's base instance
+// offset X, offset Z, scale, texture coord scale
+layout (location = 1) in vec4 patchTransform;
+
 // Offset buffer provided by the water simulation
 uniform sampler2D positionalBuffer;
 
-uniform mat4 modelMat;
-uniform mat4 viewMat;
-uniform mat4 projectionMat;
+#include "Include/UniformBlocks.glsl"
 
 // Used for texture coord calculations
 uniform float maxDistanceFromOrigin;
 
-uniform float textureCoordScale;
-
 out vec2 textureCoords;
 out vec3 worldPosition;
 
@@ -27,10 +27,14 @@ void main()
 	// We now have the vertex position in the range 0 -> dimensions * distance between verticies
 	// We need to convert that position into a 0 -> 1 range
 	float totalDistance = maxDistanceFromOrigin * 2.0;
-	textureCoords = vec2(offsettedVertexPosition.x / totalDistance, offsettedVertexPosition.y / totalDistance) * textureCoordScale;
+	textureCoords = vec2(offsettedVertexPosition.x / totalDistance, offsettedVertexPosition.y / totalDistance) * patchTransform.w;
 
 	vec4 position = texture(positionalBuffer, textureCoords);
 	
-	worldPosition = vec3(modelMat * vec4(vertexPosition.x + position.x, position.y, vertexPosition.y + position.z, 1.0));
-	gl_Position   = projectionMat * viewMat * modelMat * vec4(vertexPosition.x + position.x, position.y, vertexPosition.y + position.z, 1.0);
+	// Scale the tile out to its LOD size and move it into place
+	worldPosition = vec3(((vertexPosition.x + position.x) * patchTransform.z) + patchTransform.x,
+	                     position.y,
+	                     ((vertexPosition.y + position.z) * patchTransform.z) + patchTransform.y);
+
+	gl_Position   = viewProjectionMat * vec4(worldPosition, 1.0);
 }
\ No newline at end of file
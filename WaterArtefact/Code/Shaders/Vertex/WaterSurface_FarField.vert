@@ -0,0 +1,29 @@
+#version 430 core
+
+layout (location = 0) in vec2 vertexPosition;
+
+// Per-tile data for the far field rings
+// offset X, offset Z, scale, texture coord scale
+layout (location = 1) in vec4 patchTransform;
+
+#include "Include/UniformBlocks.glsl"
+
+// Used for texture coord calculations
+uniform float maxDistanceFromOrigin;
+
+out vec2 textureCoords;
+out vec3 worldPosition;
+
+void main()
+{
+	// Same texture mapping as the displaced tiles, so the normals line up across the switch
+	float totalDistance = maxDistanceFromOrigin * 2.0;
+	textureCoords = ((vertexPosition + vec2(maxDistanceFromOrigin)) / totalDistance) * patchTransform.w;
+
+	// Displacement out here is smaller than a pixel, so the surface is left flat and only the shading shows the waves
+	worldPosition = vec3((vertexPosition.x * patchTransform.z) + patchTransform.x,
+	                     0.0,
+	                     (vertexPosition.y * patchTransform.z) + patchTransform.y);
+
+	gl_Position   = viewProjectionMat * vec4(worldPosition, 1.0);
+}
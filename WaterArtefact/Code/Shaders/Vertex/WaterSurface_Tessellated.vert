@@ -0,0 +1,17 @@
+#version 430 core
+
+// Corner of the coarse base grid, in the range -0.5 -> 0.5
+layout (location = 0) in vec2 vertexPosition;
+
+// Width of the whole ocean surface in world units
+uniform float surfaceExtent;
+
+out vec3 controlPointWorldPosition;
+
+void main()
+{
+	// Displacement is applied after tessellation, so the control points stay flat
+	vec2 scaledPosition = vertexPosition * surfaceExtent;
+
+	controlPointWorldPosition = vec3(scaledPosition.x, 0.0, scaledPosition.y);
+}
@@ -1,12 +1,76 @@
 #include "Artefact.h"
 
+#include "Rendering/Code/MeshOptimisation.h"
+#include "Rendering/Code/Textures/SpecularPrefilter.h"
+#include "Rendering/Code/Textures/PixelConversion.h"
+
 #include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
 
 const float kFPSGoal       = 144.0f;
 const float kTimePerUpdate = 1.0f / kFPSGoal;
 
-int main()
+// Offline tools which run without opening a window
+// Returns true if a tool was ran, in which case the program should exit
+bool RunOfflineTools(int argc, char** argv)
 {
+	for (int i = 1; i < argc; i++)
+	{
+		// --mesh-report <dimensions> : vertex cache statistics for the water grid at the given size
+		if (std::strcmp(argv[i], "--mesh-report") == 0)
+		{
+			unsigned int dimensions = 250;
+
+			if (i + 1 < argc)
+				dimensions = (unsigned int)std::strtoul(argv[i + 1], nullptr, 10);
+
+			std::cout << Rendering::MeshOptimisation::GenerateGridReport(dimensions);
+
+			return true;
+		}
+
+		// --bake-skyboxes <directory> <sample count> : prefilters every skybox under the directory for reflections, into the cube map cache
+		// The water only looks up bakes made at the default sample count, any other count is for comparing against it
+		if (std::strcmp(argv[i], "--bake-skyboxes") == 0)
+		{
+			std::string                                     directory = "Skybox/";
+			Rendering::Texture::SpecularPrefilter::Settings settings;
+
+			if (i + 1 < argc)
+				directory = argv[i + 1];
+
+			if (i + 2 < argc)
+				settings.mSampleCount = (unsigned int)std::strtoul(argv[i + 2], nullptr, 10);
+
+			std::cout << Rendering::Texture::SpecularPrefilter::BakeSkyboxDirectory(directory, settings);
+
+			return true;
+		}
+
+		// --benchmark-pixel-conversion <megapixels> : throughput of each texture upload conversion, vectorised against plain C++
+		if (std::strcmp(argv[i], "--benchmark-pixel-conversion") == 0)
+		{
+			unsigned int megapixelCount = 16;
+
+			if (i + 1 < argc)
+				megapixelCount = (unsigned int)std::strtoul(argv[i + 1], nullptr, 10);
+
+			std::cout << Rendering::Texture::PixelConversion::RunBenchmark(megapixelCount);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	if (RunOfflineTools(argc, argv))
+		return 0;
+
 	Artefact::ArtefactProgram* program = new Artefact::ArtefactProgram();
 
 	bool                                               running            = true;